@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <net/if.h>
+#include <linux/can.h>
+#include <linux/can/raw.h>
+
+#include "acf_can.h"
+#include "avtp.h"
+
+/*
+ * public functions
+ */
+int acf_can_open(const char *ifname)
+{
+	struct sockaddr_can addr;
+	struct ifreq ifr;
+	int fd;
+	int enable = 1;
+
+	fd = socket(PF_CAN, SOCK_RAW, CAN_RAW);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	memset(&ifr, 0, sizeof(ifr));
+	strncpy(ifr.ifr_name, ifname, IFNAMSIZ - 1);
+	if (ioctl(fd, SIOCGIFINDEX, &ifr) < 0) {
+		perror(ifname);
+		goto error;
+	}
+
+	/* accept both of CAN and CAN FD frames */
+	if (setsockopt(fd, SOL_CAN_RAW, CAN_RAW_FD_FRAMES,
+					&enable, sizeof(enable)) < 0) {
+		perror("CAN_RAW_FD_FRAMES");
+		goto error;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.can_family = AF_CAN;
+	addr.can_ifindex = ifr.ifr_ifindex;
+	if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("bind");
+		goto error;
+	}
+
+	return fd;
+
+error:
+	close(fd);
+
+	return -1;
+}
+
+int acf_can_read(int fd, struct canfd_frame *cf, bool *fdf)
+{
+	int ret;
+
+	ret = read(fd, cf, sizeof(*cf));
+	if (ret == CANFD_MTU)
+		*fdf = true;
+	else if (ret == CAN_MTU)
+		*fdf = false;
+	else
+		return -1;
+
+	return 0;
+}
+
+int acf_can_write(int fd, struct canfd_frame *cf, bool fdf)
+{
+	int len = (fdf) ? CANFD_MTU : CAN_MTU;
+
+	if (write(fd, cf, len) != len)
+		return -1;
+
+	return 0;
+}
+
+/* size of ACF CAN message for the frame, padded to quadlet */
+int acf_can_msg_size(struct canfd_frame *cf, bool brief)
+{
+	int hlen = (brief) ? ACF_CAN_BRIEF_HEADER_SIZE : ACF_CAN_HEADER_SIZE;
+
+	return hlen + ((cf->len + 3) & ~3);
+}
+
+/*
+ * pack CAN frame to ACF CAN (or CAN brief) message
+ *
+ * return the size of message
+ */
+int acf_can_pack(void *msg, struct canfd_frame *cf, bool fdf,
+		 bool brief, uint64_t timestamp)
+{
+	int size, hlen, pad;
+	uint8_t flags = 0;
+	uint32_t id;
+
+	size = acf_can_msg_size(cf, brief);
+	hlen = (brief) ? ACF_CAN_BRIEF_HEADER_SIZE : ACF_CAN_HEADER_SIZE;
+	pad = size - hlen - cf->len;
+
+	if (cf->can_id & CAN_EFF_FLAG) {
+		flags |= ACF_CAN_FLAG_EFF;
+		id = cf->can_id & CAN_EFF_MASK;
+	} else {
+		id = cf->can_id & CAN_SFF_MASK;
+	}
+	if (cf->can_id & CAN_RTR_FLAG)
+		flags |= ACF_CAN_FLAG_RTR;
+	if (fdf) {
+		flags |= ACF_CAN_FLAG_FDF;
+		if (cf->flags & CANFD_BRS)
+			flags |= ACF_CAN_FLAG_BRS;
+		if (cf->flags & CANFD_ESI)
+			flags |= ACF_CAN_FLAG_ESI;
+	}
+	if (!brief)
+		flags |= ACF_CAN_FLAG_MTV;
+
+	set_acf_msg_type_length(msg, (brief) ?
+			ACF_MSG_TYPE_CAN_BRIEF : ACF_MSG_TYPE_CAN, size);
+	set_acf_can_flags(msg, (pad << ACF_CAN_PAD_SHIFT) | flags);
+	set_acf_can_bus_id(msg, 0);
+
+	if (brief) {
+		set_acf_can_brief_identifier(msg, id);
+	} else {
+		set_acf_can_message_timestamp(msg, timestamp);
+		set_acf_can_identifier(msg, id);
+	}
+
+	memcpy(msg + hlen, cf->data, cf->len);
+	memset(msg + hlen + cf->len, 0, pad);
+
+	return size;
+}
+
+/*
+ * unpack ACF CAN (or CAN brief) message to CAN frame
+ *
+ * return the size of message, 0 if the message is not CAN,
+ * or -1 if the message is malformed.
+ */
+int acf_can_unpack(void *msg, int len, struct canfd_frame *cf, bool *fdf)
+{
+	int size, hlen, pad;
+	uint8_t type, flags;
+	uint32_t id;
+
+	if (len < ACF_MSG_HEADER_SIZE)
+		return -1;
+
+	type = get_acf_msg_type(msg);
+	size = get_acf_msg_length(msg);
+	if (size < ACF_MSG_HEADER_SIZE || size > len)
+		return -1;
+
+	if (type == ACF_MSG_TYPE_CAN_BRIEF)
+		hlen = ACF_CAN_BRIEF_HEADER_SIZE;
+	else if (type == ACF_MSG_TYPE_CAN)
+		hlen = ACF_CAN_HEADER_SIZE;
+	else
+		return 0;
+
+	if (size < hlen)
+		return -1;
+
+	flags = get_acf_can_flags(msg);
+	pad = flags >> ACF_CAN_PAD_SHIFT;
+	if (size - hlen - pad < 0 || size - hlen - pad > CANFD_MAX_DLEN)
+		return -1;
+
+	if (type == ACF_MSG_TYPE_CAN_BRIEF)
+		id = get_acf_can_brief_identifier(msg) & ACF_CAN_ID_MASK;
+	else
+		id = get_acf_can_identifier(msg) & ACF_CAN_ID_MASK;
+
+	memset(cf, 0, sizeof(*cf));
+	cf->len = size - hlen - pad;
+	if (flags & ACF_CAN_FLAG_EFF)
+		cf->can_id = (id & CAN_EFF_MASK) | CAN_EFF_FLAG;
+	else
+		cf->can_id = id & CAN_SFF_MASK;
+	if (flags & ACF_CAN_FLAG_RTR)
+		cf->can_id |= CAN_RTR_FLAG;
+
+	*fdf = !!(flags & ACF_CAN_FLAG_FDF);
+	if (*fdf) {
+		if (flags & ACF_CAN_FLAG_BRS)
+			cf->flags |= CANFD_BRS;
+		if (flags & ACF_CAN_FLAG_ESI)
+			cf->flags |= CANFD_ESI;
+	} else if (cf->len > CAN_MAX_DLEN) {
+		return -1;
+	}
+
+	memcpy(cf->data, msg + hlen, cf->len);
+
+	return size;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __ACF_CAN_H__
+#define __ACF_CAN_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <linux/can.h>
+
+/* the largest ACF CAN message (CAN FD with 64 bytes of data) */
+#define ACF_CAN_MSG_SIZE_MAX (16 + CANFD_MAX_DLEN)
+
+extern int acf_can_open(const char *ifname);
+extern int acf_can_read(int fd, struct canfd_frame *cf, bool *fdf);
+extern int acf_can_write(int fd, struct canfd_frame *cf, bool fdf);
+extern int acf_can_msg_size(struct canfd_frame *cf, bool brief);
+extern int acf_can_pack(void *msg, struct canfd_frame *cf, bool fdf,
+			bool brief, uint64_t timestamp);
+extern int acf_can_unpack(void *msg, int len, struct canfd_frame *cf,
+			  bool *fdf);
+
+#endif /* __ACF_CAN_H__ */
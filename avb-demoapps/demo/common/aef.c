@@ -0,0 +1,332 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <inttypes.h>
+#include <openssl/evp.h>
+
+#include "aef.h"
+#include "avtp.h"
+
+#define NSEC_SCALE (1000000000)
+
+#define AEF_SALT_SIZE    (4)
+#define AEF_KEY_SIZE_MAX (32)
+#define AEF_IV_SIZE      (12)
+
+/*
+ * The key file contains the AES key (16 or 32 bytes) followed by the
+ * salt (4 bytes), as the keying material of RFC4106. The IV of each
+ * packet is salt + 64bit packet number carried in the AEF header.
+ *
+ * EVP selects AES-NI/ARMv8 Crypto Extensions at runtime when available.
+ */
+struct aef_ctx {
+	EVP_CIPHER_CTX *evp;
+	int            mode;
+	int            encrypt;
+	uint32_t       key_id;
+	uint8_t        salt[AEF_SALT_SIZE];
+	uint64_t       packet_number;
+
+	/* statistics */
+	uint64_t       packets;
+	uint64_t       bytes;
+	uint64_t       errors;
+	uint64_t       cpu_time; /* nsec */
+};
+
+static const EVP_CIPHER *aef_cipher(int mode, int keylen)
+{
+	switch (mode) {
+	case AVTP_AEF_MODE_CTR:
+		return (keylen == 16) ? EVP_aes_128_ctr() : EVP_aes_256_ctr();
+	case AVTP_AEF_MODE_GCM:
+		return (keylen == 16) ? EVP_aes_128_gcm() : EVP_aes_256_gcm();
+	default:
+		return NULL;
+	}
+}
+
+static uint64_t aef_cpu_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+	return (uint64_t)ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static int aef_init_iv(struct aef_ctx *ctx, uint64_t pn)
+{
+	uint8_t iv[16];
+	int i;
+
+	memcpy(iv, ctx->salt, AEF_SALT_SIZE);
+	for (i = 0; i < 8; i++)
+		iv[AEF_SALT_SIZE + i] = pn >> (56 - i * 8);
+
+	/* CTR uses 96bit IV + 32bit block counter starting from 1 */
+	iv[12] = 0;
+	iv[13] = 0;
+	iv[14] = 0;
+	iv[15] = 1;
+
+	return EVP_CipherInit_ex(ctx->evp, NULL, NULL, NULL, iv, ctx->encrypt);
+}
+
+/*
+ * encrypt the payload of one AEF packet in place
+ *
+ * stream_data_length holds the length of the plain payload, which is
+ * replaced by the length of the encrypted data.
+ */
+static int aef_encrypt(struct aef_ctx *ctx, void *packet)
+{
+	void *payload = packet + AVTP_AEF_PAYLOAD_OFFSET;
+	int icv = aef_icv_size(ctx->mode);
+	int len, outl;
+	uint64_t pn;
+
+	len = get_avtp_stream_data_length(packet);
+	pn = ctx->packet_number++;
+
+	set_avtp_aef_key_id(packet, ctx->key_id);
+	set_avtp_aef_mode(packet, ctx->mode);
+	set_avtp_aef_packet_number(packet, pn);
+	set_avtp_stream_data_length(packet,
+			AVTP_AEF_PAYLOAD_OFFSET - AVTP_PAYLOAD_OFFSET +
+			len + icv);
+
+	if (!aef_init_iv(ctx, pn))
+		return -1;
+
+	/* the AVTP header and the packet number are authenticated */
+	if (ctx->mode == AVTP_AEF_MODE_GCM &&
+	    !EVP_CipherUpdate(ctx->evp, NULL, &outl, packet + AVTP_OFFSET,
+				AVTP_AEF_PAYLOAD_OFFSET - AVTP_OFFSET))
+		return -1;
+
+	if (!EVP_CipherUpdate(ctx->evp, payload, &outl, payload, len))
+		return -1;
+	if (!EVP_CipherFinal_ex(ctx->evp, payload + outl, &outl))
+		return -1;
+
+	if (ctx->mode == AVTP_AEF_MODE_GCM &&
+	    !EVP_CIPHER_CTX_ctrl(ctx->evp, EVP_CTRL_GCM_GET_TAG, icv,
+				payload + len))
+		return -1;
+
+	ctx->bytes += len;
+
+	return AVTP_AEF_PAYLOAD_OFFSET + len + icv;
+}
+
+/*
+ * decrypt the payload of one AEF packet in place
+ *
+ * return the length of the plain payload, or -1 if the packet can not
+ * be decrypted or authenticated.
+ */
+static int aef_decrypt(struct aef_ctx *ctx, void *packet, int length)
+{
+	void *payload = packet + AVTP_AEF_PAYLOAD_OFFSET;
+	int icv = aef_icv_size(ctx->mode);
+	int len, outl;
+
+	if (get_avtp_subtype(packet) != AVTP_SUBTYPE_AEF_CONTINUOUS ||
+	    get_avtp_aef_mode(packet) != ctx->mode ||
+	    get_avtp_aef_key_id(packet) != ctx->key_id)
+		return -1;
+
+	len = get_avtp_stream_data_length(packet) -
+		(AVTP_AEF_PAYLOAD_OFFSET - AVTP_PAYLOAD_OFFSET) - icv;
+	if (len < 0 || AVTP_AEF_PAYLOAD_OFFSET + len + icv > length)
+		return -1;
+
+	if (!aef_init_iv(ctx, get_avtp_aef_packet_number(packet)))
+		return -1;
+
+	if (ctx->mode == AVTP_AEF_MODE_GCM) {
+		if (!EVP_CIPHER_CTX_ctrl(ctx->evp, EVP_CTRL_GCM_SET_TAG, icv,
+					payload + len))
+			return -1;
+		if (!EVP_CipherUpdate(ctx->evp, NULL, &outl,
+					packet + AVTP_OFFSET,
+					AVTP_AEF_PAYLOAD_OFFSET - AVTP_OFFSET))
+			return -1;
+	}
+
+	if (!EVP_CipherUpdate(ctx->evp, payload, &outl, payload, len))
+		return -1;
+	if (!EVP_CipherFinal_ex(ctx->evp, payload + outl, &outl))
+		return -1; /* authentication failure */
+
+	ctx->bytes += len;
+
+	return len;
+}
+
+/*
+ * public functions
+ */
+int aef_parse_mode(const char *name)
+{
+	if (!strcmp(name, "ctr"))
+		return AVTP_AEF_MODE_CTR;
+	else if (!strcmp(name, "gcm"))
+		return AVTP_AEF_MODE_GCM;
+
+	return -1;
+}
+
+int aef_icv_size(int mode)
+{
+	return (mode == AVTP_AEF_MODE_GCM) ? AVTP_AEF_ICV_SIZE : 0;
+}
+
+struct aef_ctx *aef_ctx_new(const char *keyfile, int mode,
+			    uint32_t key_id, int encrypt)
+{
+	struct aef_ctx *ctx;
+	const EVP_CIPHER *cipher;
+	/* one spare byte to detect an oversized key file */
+	uint8_t key[AEF_KEY_SIZE_MAX + AEF_SALT_SIZE + 1];
+	struct timespec ts;
+	int fd, len;
+
+	fd = open(keyfile, O_RDONLY);
+	if (fd < 0) {
+		perror(keyfile);
+		return NULL;
+	}
+	len = read(fd, key, sizeof(key));
+	close(fd);
+
+	len -= AEF_SALT_SIZE;
+	cipher = aef_cipher(mode, len);
+	if ((len != 16 && len != 32) || !cipher) {
+		fprintf(stderr, "[AVB] AEF key file should have 16 or 32 bytes key and 4 bytes salt\n");
+		memset(key, 0, sizeof(key));
+		return NULL;
+	}
+
+	ctx = calloc(1, sizeof(*ctx));
+	if (!ctx)
+		return NULL;
+
+	ctx->mode = mode;
+	ctx->encrypt = encrypt;
+	ctx->key_id = key_id;
+	memcpy(ctx->salt, key + len, AEF_SALT_SIZE);
+
+	/* keep the IV unique over restarts with the same key */
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ctx->packet_number = (uint64_t)ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+
+	ctx->evp = EVP_CIPHER_CTX_new();
+	if (!ctx->evp)
+		goto error;
+
+	if (!EVP_CipherInit_ex(ctx->evp, cipher, NULL, key, NULL, encrypt))
+		goto error;
+
+	memset(key, 0, sizeof(key));
+
+	return ctx;
+
+error:
+	memset(key, 0, sizeof(key));
+	aef_ctx_free(ctx);
+
+	return NULL;
+}
+
+void aef_ctx_free(struct aef_ctx *ctx)
+{
+	if (!ctx)
+		return;
+
+	if (ctx->evp)
+		EVP_CIPHER_CTX_free(ctx->evp);
+	free(ctx);
+}
+
+/*
+ * encrypt a batch of packets
+ *
+ * @lens  [out] frame length of each packet, -1 on error
+ */
+int aef_encrypt_batch(struct aef_ctx *ctx, void **packets, int *lens,
+		      int count)
+{
+	uint64_t t;
+	int i, ret = 0;
+
+	t = aef_cpu_time();
+
+	for (i = 0; i < count; i++) {
+		lens[i] = aef_encrypt(ctx, packets[i]);
+		if (lens[i] < 0) {
+			ctx->errors++;
+			ret = -1;
+		}
+	}
+
+	ctx->packets += count;
+	ctx->cpu_time += aef_cpu_time() - t;
+
+	return ret;
+}
+
+/*
+ * decrypt a batch of packets, NULL entries are skipped
+ *
+ * @lens  [in] frame length of each packet
+ *        [out] payload length of each packet, -1 on error
+ */
+int aef_decrypt_batch(struct aef_ctx *ctx, void **packets, int *lens,
+		      int count)
+{
+	uint64_t t;
+	int i, ret = 0;
+
+	t = aef_cpu_time();
+
+	for (i = 0; i < count; i++) {
+		if (!packets[i])
+			continue;
+
+		lens[i] = aef_decrypt(ctx, packets[i], lens[i]);
+		if (lens[i] < 0) {
+			ctx->errors++;
+			ret = -1;
+		}
+		ctx->packets++;
+	}
+
+	ctx->cpu_time += aef_cpu_time() - t;
+
+	return ret;
+}
+
+void aef_report(struct aef_ctx *ctx, char *buf, int buflen)
+{
+	double gbps = 0;
+
+	if (ctx->cpu_time)
+		gbps = (double)ctx->bytes * 8 / ctx->cpu_time;
+
+	snprintf(buf, buflen,
+		"AEF %s %"PRIu64"packets %"PRIu64"bytes %"PRIu64"errors, %.3fGbps per core",
+		(ctx->mode == AVTP_AEF_MODE_GCM) ? "AES-GCM" : "AES-CTR",
+		ctx->packets, ctx->bytes, ctx->errors, gbps);
+}
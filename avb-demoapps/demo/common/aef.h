@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __AEF_H__
+#define __AEF_H__
+
+#include <stdint.h>
+
+struct aef_ctx;
+
+extern int aef_parse_mode(const char *name);
+extern struct aef_ctx *aef_ctx_new(const char *keyfile, int mode,
+				   uint32_t key_id, int encrypt);
+extern void aef_ctx_free(struct aef_ctx *ctx);
+extern int aef_icv_size(int mode);
+extern int aef_encrypt_batch(struct aef_ctx *ctx, void **packets,
+			     int *lens, int count);
+extern int aef_decrypt_batch(struct aef_ctx *ctx, void **packets,
+			     int *lens, int count);
+extern void aef_report(struct aef_ctx *ctx, char *buf, int buflen);
+
+#endif /* __AEF_H__ */
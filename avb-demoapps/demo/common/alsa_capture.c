@@ -0,0 +1,303 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+
+#include "alsa_capture.h"
+
+#define NSEC_SCALE	(1000000000)
+
+static snd_pcm_format_t alsa_capture_format(int width)
+{
+	switch (width) {
+	case 2:
+		return SND_PCM_FORMAT_S16_BE;
+	case 3:
+		return SND_PCM_FORMAT_S24_3BE;
+	case 4:
+		return SND_PCM_FORMAT_S32_BE;
+	default:
+		return SND_PCM_FORMAT_UNKNOWN;
+	}
+}
+
+static int alsa_capture_hw_params(struct alsa_capture *c, int channels,
+				  int width, int period, int periods)
+{
+	snd_pcm_t *pcm = c->pcm;
+	snd_pcm_hw_params_t *hw;
+	snd_pcm_uframes_t size;
+	unsigned int n;
+	int err;
+
+	snd_pcm_hw_params_alloca(&hw);
+
+	err = snd_pcm_hw_params_any(pcm, hw);
+	if (err < 0)
+		goto error;
+
+	err = snd_pcm_hw_params_set_access(pcm, hw,
+					   SND_PCM_ACCESS_MMAP_INTERLEAVED);
+	if (err < 0) {
+		fprintf(stderr, "ALSA: mmap access is not supported\n");
+		goto error;
+	}
+
+	err = snd_pcm_hw_params_set_format(pcm, hw, alsa_capture_format(width));
+	if (err < 0) {
+		fprintf(stderr, "ALSA: %d bit big endian is not supported, use plughw:\n",
+			width * 8);
+		goto error;
+	}
+
+	err = snd_pcm_hw_params_set_channels(pcm, hw, channels);
+	if (err < 0) {
+		fprintf(stderr, "ALSA: %d channels are not supported\n",
+			channels);
+		goto error;
+	}
+
+	err = snd_pcm_hw_params_set_rate(pcm, hw, c->rate, 0);
+	if (err < 0) {
+		fprintf(stderr, "ALSA: %d Hz is not supported\n", c->rate);
+		goto error;
+	}
+
+	/*
+	 * The period has to be exact, it is a whole number of AAF PDUs.
+	 * The buffer is a whole number of periods so that no PDU straddles
+	 * the end of the ring buffer.
+	 */
+	size = period;
+	err = snd_pcm_hw_params_set_period_size(pcm, hw, size, 0);
+	if (err < 0) {
+		fprintf(stderr, "ALSA: period of %d frames is not supported\n",
+			period);
+		goto error;
+	}
+
+	err = snd_pcm_hw_params_set_periods_integer(pcm, hw);
+	if (err < 0)
+		goto error;
+
+	n = periods;
+	err = snd_pcm_hw_params_set_periods_near(pcm, hw, &n, 0);
+	if (err < 0)
+		goto error;
+
+	err = snd_pcm_hw_params(pcm, hw);
+	if (err < 0)
+		goto error;
+
+	snd_pcm_hw_params_get_period_size(hw, &c->period, 0);
+	snd_pcm_hw_params_get_buffer_size(hw, &c->buffer);
+	if (c->period != (snd_pcm_uframes_t)period ||
+	    c->buffer % c->period) {
+		fprintf(stderr, "ALSA: period %lu, buffer %lu frames are not aligned\n",
+			c->period, c->buffer);
+		return -EINVAL;
+	}
+
+	return 0;
+
+error:
+	fprintf(stderr, "ALSA: hw_params: %s\n", snd_strerror(err));
+	return err;
+}
+
+static int alsa_capture_sw_params(struct alsa_capture *c)
+{
+	snd_pcm_t *pcm = c->pcm;
+	snd_pcm_sw_params_t *sw;
+	int err;
+
+	snd_pcm_sw_params_alloca(&sw);
+
+	err = snd_pcm_sw_params_current(pcm, sw);
+	if (err < 0)
+		goto error;
+
+	/* wake up once a period */
+	err = snd_pcm_sw_params_set_avail_min(pcm, sw, c->period);
+	if (err < 0)
+		goto error;
+
+	/* timestamp of the last period, on the clock of the correlation */
+	err = snd_pcm_sw_params_set_tstamp_mode(pcm, sw, SND_PCM_TSTAMP_ENABLE);
+	if (err < 0)
+		goto error;
+
+	err = snd_pcm_sw_params_set_tstamp_type(pcm, sw,
+						SND_PCM_TSTAMP_TYPE_MONOTONIC);
+	if (err < 0)
+		goto error;
+
+	err = snd_pcm_sw_params(pcm, sw);
+	if (err < 0)
+		goto error;
+
+	return 0;
+
+error:
+	fprintf(stderr, "ALSA: sw_params: %s\n", snd_strerror(err));
+	return err;
+}
+
+struct alsa_capture *alsa_capture_open(const char *name, int rate,
+				       int channels, int width,
+				       int period, int periods)
+{
+	struct alsa_capture *c;
+	int err;
+
+	c = calloc(1, sizeof(*c));
+	if (!c)
+		return NULL;
+
+	err = snd_pcm_open(&c->pcm, name, SND_PCM_STREAM_CAPTURE, 0);
+	if (err < 0) {
+		fprintf(stderr, "ALSA: open %s: %s\n", name, snd_strerror(err));
+		free(c);
+		return NULL;
+	}
+
+	c->rate = rate;
+	c->frame_bytes = channels * width;
+
+	if (alsa_capture_hw_params(c, channels, width, period, periods) < 0)
+		goto error;
+
+	if (alsa_capture_sw_params(c) < 0)
+		goto error;
+
+	return c;
+
+error:
+	alsa_capture_close(c);
+	return NULL;
+}
+
+void alsa_capture_close(struct alsa_capture *c)
+{
+	if (!c)
+		return;
+
+	snd_pcm_close(c->pcm);
+	free(c);
+}
+
+int alsa_capture_start(struct alsa_capture *c)
+{
+	int err;
+
+	err = snd_pcm_start(c->pcm);
+	if (err < 0)
+		fprintf(stderr, "ALSA: start: %s\n", snd_strerror(err));
+
+	return err;
+}
+
+/* recover from an overrun and restart the capture */
+static int alsa_capture_recover(struct alsa_capture *c, int err)
+{
+	c->xruns++;
+
+	err = snd_pcm_recover(c->pcm, err, 1);
+	if (err < 0) {
+		fprintf(stderr, "ALSA: recover: %s\n", snd_strerror(err));
+		return err;
+	}
+
+	return alsa_capture_start(c);
+}
+
+/* returns 1:a period is ready, 0:timeout, -1:error */
+int alsa_capture_wait(struct alsa_capture *c, int timeout)
+{
+	int err;
+
+	err = snd_pcm_wait(c->pcm, timeout);
+	if (err < 0) {
+		if (alsa_capture_recover(c, err) < 0)
+			return -1;
+		return 1;
+	}
+	if (err)
+		c->wakeups++;
+
+	return !!err;
+}
+
+/*
+ * Map up to frames captured frames which are contiguous in the ring
+ * buffer, and return the number of frames mapped at data. tstamp is the
+ * CLOCK_MONOTONIC time of the first frame mapped, derived from the
+ * timestamp of the last period.
+ *
+ * returns frames mapped, 0:none, -1:the stream was restarted after an
+ * overrun and the timeline of the captured frames is broken, -2:error
+ */
+int alsa_capture_begin(struct alsa_capture *c, void **data,
+		       int frames, uint64_t *tstamp)
+{
+	const snd_pcm_channel_area_t *areas;
+	snd_pcm_uframes_t avail, offset, n;
+	snd_htimestamp_t ts;
+	int err;
+
+	err = snd_pcm_htimestamp(c->pcm, &avail, &ts);
+	if (err == -EPIPE || err == -ESTRPIPE)
+		goto recover;
+	if (err < 0 || (!ts.tv_sec && !ts.tv_nsec)) {
+		/* no timestamp by the driver, take the time now */
+		c->no_tstamp++;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		avail = snd_pcm_avail_update(c->pcm);
+	}
+	if ((snd_pcm_sframes_t)avail < 0) {
+		err = (snd_pcm_sframes_t)avail;
+		goto recover;
+	}
+	if (!avail)
+		return 0;
+
+	*tstamp = (uint64_t)ts.tv_sec * NSEC_SCALE + ts.tv_nsec -
+		(uint64_t)avail * NSEC_SCALE / c->rate;
+
+	n = frames;
+	err = snd_pcm_mmap_begin(c->pcm, &areas, &offset, &n);
+	if (err < 0)
+		goto recover;
+
+	c->offset = offset;
+	c->mapped = n;
+	*data = (uint8_t *)areas[0].addr + offset * c->frame_bytes;
+
+	return n;
+
+recover:
+	if (alsa_capture_recover(c, err) < 0)
+		return -2;
+	return -1;
+}
+
+/* release the first frames of the mapped ones */
+void alsa_capture_commit(struct alsa_capture *c, int frames)
+{
+	snd_pcm_sframes_t ret;
+
+	ret = snd_pcm_mmap_commit(c->pcm, c->offset, frames);
+	if (ret < 0 || ret != frames)
+		alsa_capture_recover(c, ret < 0 ? ret : -EPIPE);
+	else
+		c->frames += frames;
+
+	c->mapped = 0;
+}
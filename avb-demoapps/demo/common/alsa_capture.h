@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __ALSA_CAPTURE_H__
+#define __ALSA_CAPTURE_H__
+
+#include <stdint.h>
+#include <alsa/asoundlib.h>
+
+/*
+ * PCM capture of an ALSA device in mmap mode. The captured frames are
+ * used in place in the ring buffer of the device, big endian integer
+ * samples of 2, 3 or 4 bytes as AAF carries them. Use plughw: for a
+ * card without big endian formats.
+ */
+struct alsa_capture {
+	snd_pcm_t          *pcm;
+	int                rate;
+	int                frame_bytes;
+	snd_pcm_uframes_t  period;
+	snd_pcm_uframes_t  buffer;
+
+	/* frames mapped by alsa_capture_begin() */
+	snd_pcm_uframes_t  offset;
+	snd_pcm_uframes_t  mapped;
+
+	/* statistics */
+	uint64_t           frames;
+	uint64_t           wakeups;
+	uint64_t           xruns;
+	uint64_t           no_tstamp;   /* timestamps taken by the CPU */
+};
+
+extern struct alsa_capture *alsa_capture_open(const char *name, int rate,
+					      int channels, int width,
+					      int period, int periods);
+extern void alsa_capture_close(struct alsa_capture *c);
+extern int alsa_capture_start(struct alsa_capture *c);
+extern int alsa_capture_wait(struct alsa_capture *c, int timeout);
+extern int alsa_capture_begin(struct alsa_capture *c, void **data,
+			      int frames, uint64_t *tstamp);
+extern void alsa_capture_commit(struct alsa_capture *c, int frames);
+
+#endif /* __ALSA_CAPTURE_H__ */
@@ -0,0 +1,474 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "analyzer.h"
+#include "clock.h"
+
+/* sequence numbers more than half of the space behind are new ones */
+#define ANALYZER_SEQ_WINDOW (ANALYZER_SEQ_NUM / 2)
+
+static struct analyzer_stream *analyzer_lookup(struct analyzer *an,
+					       uint8_t *streamid)
+{
+	struct analyzer_stream *st;
+	int i;
+
+	/* most packets belong to the stream of the last one */
+	st = &an->streams[an->last];
+	if (an->nstreams &&
+	    !memcmp(st->StreamID, streamid, AVTP_STREAMID_SIZE))
+		return st;
+
+	for (i = 0, st = an->streams; i < an->nstreams; i++, st++) {
+		if (!memcmp(st->StreamID, streamid, AVTP_STREAMID_SIZE)) {
+			an->last = i;
+			return st;
+		}
+	}
+
+	if (an->nstreams == ANALYZER_STREAM_MAX)
+		return NULL;
+
+	an->last = an->nstreams;
+	st = &an->streams[an->nstreams++];
+	memcpy(st->StreamID, streamid, AVTP_STREAMID_SIZE);
+
+	return st;
+}
+
+/* loss, duplicate and reorder from the sequence number */
+static void analyzer_sequence(struct analyzer_stream *st, int seqno)
+{
+	struct analyzer_counts *c = &st->interval;
+	int d, k, depth;
+
+	if (!st->start) {
+		st->start = true;
+		st->expected = seqno;
+		st->first_seqno = seqno;
+	}
+
+	d = (seqno - st->expected + ANALYZER_SEQ_NUM) % ANALYZER_SEQ_NUM;
+
+	if (d < ANALYZER_SEQ_WINDOW) {
+		/* in order, or ahead of the expected one */
+		c->lost += d;
+		for (k = st->expected; ; k = (k + 1) % ANALYZER_SEQ_NUM) {
+			st->seen[k] = (k == seqno);
+			st->seen[(k + ANALYZER_SEQ_WINDOW) % ANALYZER_SEQ_NUM] = 0;
+			if (k == seqno)
+				break;
+		}
+		st->expected = (seqno + 1) % ANALYZER_SEQ_NUM;
+		return;
+	}
+
+	/* behind the expected one */
+	if (st->seen[seqno]) {
+		c->duplicates++;
+		return;
+	}
+
+	st->seen[seqno] = 1;
+	depth = ANALYZER_SEQ_NUM - d;
+	if (c->lost)
+		c->lost--;
+	else if (st->total.lost)
+		st->total.lost--; /* counted as lost in the last interval */
+	c->reordered++;
+	if (depth > c->reorder_depth)
+		c->reorder_depth = depth;
+}
+
+/* lateness against the presentation time, and jitter of transit time */
+static void analyzer_timing(struct analyzer_stream *st, uint32_t timestamp,
+			    uint64_t arrival)
+{
+	struct analyzer_counts *c = &st->interval;
+	int32_t margin;
+	int64_t transit, d;
+
+	margin = (int32_t)(timestamp - (uint32_t)arrival);
+	if (margin < 0) {
+		c->late++;
+		if ((uint64_t)-(int64_t)margin > c->late_max)
+			c->late_max = -(int64_t)margin;
+	} else {
+		hdr_hist_record(&st->margin, margin);
+	}
+
+	/* RFC 3550 style: difference of (arrival - timestamp) */
+	transit = -(int64_t)margin;
+	if (st->transit_valid) {
+		d = transit - st->transit;
+		hdr_hist_record(&st->jitter, (d < 0) ? -d : d);
+	} else {
+		st->first_transit = transit;
+		st->first_transit_valid = true;
+	}
+	st->transit = transit;
+	st->transit_valid = true;
+}
+
+/* frame size and frames per class interval against the reservation */
+static void analyzer_window(struct analyzer *an, struct analyzer_stream *st,
+			    int len, uint64_t arrival)
+{
+	struct analyzer_window *w = &st->window;
+	uint64_t index;
+	int size = len - AVTP_OFFSET; /* as MaxFrameSize */
+
+	st->bytes += len;
+	st->last_arrival = arrival;
+	if (size > st->frame_max)
+		st->frame_max = size;
+	if (an->MaxFrameSize && size > an->MaxFrameSize)
+		st->oversize++;
+
+	if (!an->class_interval)
+		return;
+
+	index = arrival / an->class_interval;
+	if (!w->frames || w->index != index) {
+		w->index = index;
+		w->frames = 0;
+		w->bytes = 0;
+	}
+	w->frames++;
+	w->bytes += len;
+
+	if (w->frames > st->window_frames_max)
+		st->window_frames_max = w->frames;
+	if (w->bytes > st->window_bytes_max)
+		st->window_bytes_max = w->bytes;
+	if (an->MaxIntervalFrames && w->frames == an->MaxIntervalFrames + 1)
+		st->overrun++;
+
+	if (!st->first_window.frames || st->first_window.index == index)
+		st->first_window = *w;
+}
+
+static void analyzer_counts_merge(struct analyzer_counts *to,
+				  const struct analyzer_counts *from)
+{
+	to->packets += from->packets;
+	to->lost += from->lost;
+	to->duplicates += from->duplicates;
+	to->reordered += from->reordered;
+	to->late += from->late;
+	if (from->reorder_depth > to->reorder_depth)
+		to->reorder_depth = from->reorder_depth;
+	if (from->late_max > to->late_max)
+		to->late_max = from->late_max;
+}
+
+static int analyzer_stream_format(struct analyzer_stream *st,
+				  struct analyzer_counts *c,
+				  struct hdr_hist *jitter,
+				  struct hdr_hist *margin,
+				  char *buf, int buflen)
+{
+	return snprintf(buf, buflen,
+		"%02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x "
+		"%"PRIu64"packets %"PRIu64"lost %"PRIu64"dup "
+		"%"PRIu64"reorder(depth %d) %"PRIu64"late(max %"PRIu64"ns) "
+		"jitter p50/p99/max %"PRIu64"/%"PRIu64"/%"PRIu64"ns "
+		"margin min/p1/p50 %"PRIu64"/%"PRIu64"/%"PRIu64"ns",
+		st->StreamID[0], st->StreamID[1],
+		st->StreamID[2], st->StreamID[3],
+		st->StreamID[4], st->StreamID[5],
+		st->StreamID[6], st->StreamID[7],
+		c->packets, c->lost, c->duplicates,
+		c->reordered, c->reorder_depth, c->late, c->late_max,
+		hdr_hist_percentile(jitter, 50),
+		hdr_hist_percentile(jitter, 99), jitter->max,
+		margin->min, hdr_hist_percentile(margin, 1),
+		hdr_hist_percentile(margin, 50));
+}
+
+/* bandwidth and conformance part of the summary */
+static int analyzer_reservation_format(struct analyzer *an,
+				       struct analyzer_stream *st,
+				       char *buf, int buflen)
+{
+	uint64_t duration = st->last_arrival - st->first_arrival;
+	int len;
+
+	len = snprintf(buf, buflen, " frame max %d", st->frame_max);
+	if (an->MaxFrameSize && len < buflen)
+		len += snprintf(buf + len, buflen - len, "(%"PRIu64" over %d)",
+				st->oversize, an->MaxFrameSize);
+	if (len < buflen)
+		len += snprintf(buf + len, buflen - len,
+				" interval max %dframes", st->window_frames_max);
+	if (an->MaxIntervalFrames && len < buflen)
+		len += snprintf(buf + len, buflen - len, "(%"PRIu64" over %d)",
+				st->overrun, an->MaxIntervalFrames);
+	if (len < buflen)
+		len += snprintf(buf + len, buflen - len,
+				" avg/peak %.1f/%.1fMbps",
+				(duration) ? st->bytes * 8000.0 / duration : 0.0,
+				st->window_bytes_max * 8000.0 /
+						an->class_interval);
+
+	return len;
+}
+
+/*
+ * Continue the stream analyzed until the boundary with the one of the
+ * following part of the capture. Loss and jitter across the boundary
+ * are counted here, and a class interval split by the boundary is
+ * checked as a whole.
+ */
+static void analyzer_stream_join(struct analyzer *an,
+				 struct analyzer_stream *to,
+				 struct analyzer_stream *from)
+{
+	struct analyzer_window w = to->window;
+	bool split, over_to, over_from;
+	int64_t d;
+	int gap;
+
+	gap = (from->first_seqno - to->expected + ANALYZER_SEQ_NUM) %
+			ANALYZER_SEQ_NUM;
+	if (gap < ANALYZER_SEQ_WINDOW)
+		to->total.lost += gap;
+	to->expected = from->expected;
+	memcpy(to->seen, from->seen, sizeof(to->seen));
+
+	if (to->transit_valid && from->first_transit_valid) {
+		d = from->first_transit - to->transit;
+		hdr_hist_record(&to->total_jitter, (d < 0) ? -d : d);
+	}
+	if (from->transit_valid) {
+		to->transit = from->transit;
+		to->transit_valid = true;
+	}
+
+	analyzer_counts_merge(&to->total, &from->total);
+	hdr_hist_merge(&to->total_jitter, &from->total_jitter);
+	hdr_hist_merge(&to->total_margin, &from->total_margin);
+
+	to->bytes += from->bytes;
+	to->last_arrival = from->last_arrival;
+	if (from->frame_max > to->frame_max)
+		to->frame_max = from->frame_max;
+	to->oversize += from->oversize;
+	to->overrun += from->overrun;
+	if (from->window_frames_max > to->window_frames_max)
+		to->window_frames_max = from->window_frames_max;
+	if (from->window_bytes_max > to->window_bytes_max)
+		to->window_bytes_max = from->window_bytes_max;
+
+	split = (an->class_interval && w.frames && from->first_window.frames &&
+		 from->first_window.index == w.index);
+	if (!split) {
+		to->window = from->window;
+		return;
+	}
+
+	w.frames += from->first_window.frames;
+	w.bytes += from->first_window.bytes;
+	if (w.frames > to->window_frames_max)
+		to->window_frames_max = w.frames;
+	if (w.bytes > to->window_bytes_max)
+		to->window_bytes_max = w.bytes;
+
+	/* count the joined interval once */
+	if (an->MaxIntervalFrames) {
+		over_to = (to->window.frames > an->MaxIntervalFrames);
+		over_from = (from->first_window.frames > an->MaxIntervalFrames);
+		if (over_to && over_from)
+			to->overrun--;
+		else if (!over_to && !over_from &&
+			 w.frames > an->MaxIntervalFrames)
+			to->overrun++;
+	}
+
+	to->window = (from->window.index == w.index) ? w : from->window;
+}
+
+/* fold the interval into the total */
+static void analyzer_fold(struct analyzer *an)
+{
+	struct analyzer_stream *st;
+	int i;
+
+	for (i = 0, st = an->streams; i < an->nstreams; i++, st++) {
+		analyzer_counts_merge(&st->total, &st->interval);
+		hdr_hist_merge(&st->total_jitter, &st->jitter);
+		hdr_hist_merge(&st->total_margin, &st->margin);
+
+		memset(&st->interval, 0, sizeof(st->interval));
+		hdr_hist_reset(&st->jitter);
+		hdr_hist_reset(&st->margin);
+	}
+}
+
+/*
+ * public functions
+ */
+struct analyzer *analyzer_new(char *name, clockid_t clkid, uint64_t interval)
+{
+	struct analyzer *an;
+
+	an = calloc(1, sizeof(*an));
+	if (!an)
+		return NULL;
+
+	an->name = name;
+	an->clkid = clkid;
+	an->interval = interval;
+	if (interval)
+		an->next_report = analyzer_now(an) + interval;
+
+	return an;
+}
+
+void analyzer_free(struct analyzer *an)
+{
+	free(an);
+}
+
+/* gPTP time used as the arrival time */
+uint64_t analyzer_now(struct analyzer *an)
+{
+	return clock_getcount(an->clkid);
+}
+
+/* check frames against the reservation, class_interval 0 disables it */
+void analyzer_set_reservation(struct analyzer *an, uint64_t class_interval,
+			      int MaxFrameSize, int MaxIntervalFrames)
+{
+	an->class_interval = class_interval;
+	an->MaxFrameSize = MaxFrameSize;
+	an->MaxIntervalFrames = MaxIntervalFrames;
+}
+
+void analyzer_process(struct analyzer *an, void *packet, int len,
+		      uint64_t arrival)
+{
+	struct analyzer_stream *st;
+	uint8_t streamid[AVTP_STREAMID_SIZE];
+	int subtype;
+
+	get_avtp_stream_id(packet, streamid);
+
+	st = analyzer_lookup(an, streamid);
+	if (!st) {
+		an->overflow++;
+		return;
+	}
+
+	if (!st->interval.packets && !st->total.packets)
+		st->first_arrival = arrival;
+	st->interval.packets++;
+	analyzer_window(an, st, len, arrival);
+
+	subtype = get_avtp_subtype(packet);
+	if (subtype == AVTP_SUBTYPE_NTSCF) {
+		analyzer_sequence(st, get_avtp_ntscf_sequence_num(packet));
+		return;
+	}
+
+	analyzer_sequence(st, get_avtp_sequence_num(packet));
+
+	if (get_avtp_stream_flags(packet) & AVTP_STREAM_FLAG_TV)
+		analyzer_timing(st, get_avtp_timestamp(packet), arrival);
+}
+
+/*
+ * Format the interval report in buf when the interval is elapsed, one
+ * line per stream. Returns the length, 0 when no report is due.
+ */
+int analyzer_tick(struct analyzer *an, uint64_t now, char *buf, int buflen)
+{
+	struct analyzer_stream *st;
+	int i, len = 0;
+
+	if (!an->interval || now < an->next_report)
+		return 0;
+
+	for (i = 0, st = an->streams; i < an->nstreams; i++, st++) {
+		if (len >= buflen)
+			break;
+		len += snprintf(buf + len, buflen - len, "%s%s: interval ",
+				(i) ? "\n" : "", an->name);
+		if (len >= buflen)
+			break;
+		len += analyzer_stream_format(st, &st->interval, &st->jitter,
+				&st->margin, buf + len, buflen - len);
+	}
+
+	analyzer_fold(an);
+
+	an->next_report += an->interval;
+	if (an->next_report <= now)
+		an->next_report = now + an->interval;
+
+	return len;
+}
+
+/*
+ * Append the analysis of the following part of the capture to the
+ * one of the preceding part. Both use the same reservation.
+ */
+void analyzer_merge(struct analyzer *to, struct analyzer *from)
+{
+	struct analyzer_stream *st, *t;
+	int i, n;
+
+	analyzer_fold(to);
+	analyzer_fold(from);
+
+	for (i = 0, st = from->streams; i < from->nstreams; i++, st++) {
+		n = to->nstreams;
+		t = analyzer_lookup(to, st->StreamID);
+		if (!t)
+			to->overflow += st->total.packets;
+		else if (n != to->nstreams)
+			*t = *st; /* new in the following part */
+		else
+			analyzer_stream_join(to, t, st);
+	}
+
+	to->overflow += from->overflow;
+}
+
+/* summary of all streams, one line each */
+int analyzer_report(struct analyzer *an, char *buf, int buflen)
+{
+	struct analyzer_stream *st;
+	int i, len = 0;
+
+	analyzer_fold(an);
+
+	for (i = 0, st = an->streams; i < an->nstreams; i++, st++) {
+		if (len >= buflen)
+			break;
+		len += snprintf(buf + len, buflen - len, "\n%s: ", an->name);
+		if (len >= buflen)
+			break;
+		len += analyzer_stream_format(st, &st->total,
+				&st->total_jitter, &st->total_margin,
+				buf + len, buflen - len);
+		if (an->class_interval && len < buflen)
+			len += analyzer_reservation_format(an, st,
+					buf + len, buflen - len);
+	}
+
+	if (an->overflow && len < buflen)
+		len += snprintf(buf + len, buflen - len,
+				"\n%s: %"PRIu64"packets of untracked streams",
+				an->name, an->overflow);
+
+	return len;
+}
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __ANALYZER_H__
+#define __ANALYZER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "avtp.h"
+#include "hdr_hist.h"
+
+#define ANALYZER_STREAM_MAX (64)
+#define ANALYZER_SEQ_NUM    (AVTP_SEQUENCE_NUM_MAX + 1)
+
+/* receive counters of a stream, per interval and in total */
+struct analyzer_counts {
+	uint64_t packets;
+	uint64_t lost;
+	uint64_t duplicates;
+	uint64_t reordered;
+	uint64_t late;
+	int      reorder_depth; /* maximum */
+	uint64_t late_max;      /* ns */
+};
+
+/* frames and bytes in a class interval */
+struct analyzer_window {
+	uint64_t index;                     /* arrival / class interval */
+	int      frames;
+	uint64_t bytes;
+};
+
+struct analyzer_stream {
+	uint8_t  StreamID[AVTP_STREAMID_SIZE];
+	bool     start;
+	int      expected;                  /* next sequence number */
+	uint8_t  seen[ANALYZER_SEQ_NUM];    /* received in the window */
+	int64_t  transit;                   /* last arrival - timestamp */
+	bool     transit_valid;
+
+	/* the first packet, to join analyzers of consecutive captures */
+	int      first_seqno;
+	int64_t  first_transit;
+	bool     first_transit_valid;
+
+	struct analyzer_counts interval;
+	struct analyzer_counts total;
+
+	/* inter-arrival jitter and presentation margin in ns */
+	struct hdr_hist jitter;
+	struct hdr_hist margin;
+	struct hdr_hist total_jitter;
+	struct hdr_hist total_margin;
+
+	/* bandwidth and conformance to the reservation */
+	uint64_t bytes;
+	uint64_t first_arrival;
+	uint64_t last_arrival;
+	int      frame_max;
+	uint64_t oversize;                  /* frames over MaxFrameSize */
+	struct analyzer_window window;
+	struct analyzer_window first_window;
+	int      window_frames_max;
+	uint64_t window_bytes_max;
+	uint64_t overrun;                   /* windows over MaxIntervalFrames */
+};
+
+struct analyzer {
+	char                   *name;
+	clockid_t              clkid;
+	uint64_t               interval;    /* ns, 0:summary only */
+	uint64_t               next_report;
+	int                    nstreams;
+	int                    last;        /* stream of the last packet */
+	/* reservation, 0:not checked */
+	uint64_t               class_interval; /* ns */
+	int                    MaxFrameSize;
+	int                    MaxIntervalFrames;
+	uint64_t               overflow;    /* packets of untracked streams */
+	struct analyzer_stream streams[ANALYZER_STREAM_MAX];
+};
+
+extern struct analyzer *analyzer_new(char *name, clockid_t clkid,
+				     uint64_t interval);
+extern void analyzer_free(struct analyzer *an);
+extern uint64_t analyzer_now(struct analyzer *an);
+extern void analyzer_set_reservation(struct analyzer *an,
+				    uint64_t class_interval,
+				    int MaxFrameSize, int MaxIntervalFrames);
+extern void analyzer_process(struct analyzer *an, void *packet, int len,
+			     uint64_t arrival);
+extern void analyzer_merge(struct analyzer *to, struct analyzer *from);
+extern int analyzer_tick(struct analyzer *an, uint64_t now, char *buf,
+			 int buflen);
+extern int analyzer_report(struct analyzer *an, char *buf, int buflen);
+
+#endif /* __ANALYZER_H__ */
@@ -0,0 +1,410 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "asrc.h"
+#include "avtp.h"
+
+#define NSEC_SCALE (1000000000)
+
+/* Kaiser window for 120dB stopband */
+#define ASRC_ATTENUATION  (120.0)
+
+/* input frames kept in the history in addition to the taps */
+#define ASRC_HISTORY      (4096)
+
+#define ASRC_ALIGN        (16)
+
+struct asrc {
+	int      channels;
+	double   nominal;  /* input frames per output frame */
+	double   step;     /* nominal * ratio */
+	double   pos;      /* position of the next output in the history */
+
+	float    *coef;    /* (ASRC_PHASES + 1) * ASRC_TAPS */
+	float    *work;    /* interpolated coefficients */
+	float    *hist[ASRC_CHANNELS_MAX];
+	int      filled;   /* frames in the history */
+
+	/* statistics */
+	double   ratio;
+	uint64_t in_frames;
+	uint64_t out_frames;
+	uint64_t overflows;
+	uint64_t cpu_time; /* nsec */
+};
+
+static uint64_t asrc_cpu_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+	return (uint64_t)ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+/*
+ * SIMD kernels, the coefficients are aligned and n is multiple of 4
+ */
+#if defined(__SSE__)
+static inline float asrc_dot(const float *x, const float *c, int n)
+{
+	__m128 acc0 = _mm_setzero_ps();
+	__m128 acc1 = _mm_setzero_ps();
+	float sum[4];
+	int i;
+
+	for (i = 0; i < n; i += 8) {
+		acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(x + i),
+						    _mm_load_ps(c + i)));
+		acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(x + i + 4),
+						    _mm_load_ps(c + i + 4)));
+	}
+	_mm_storeu_ps(sum, _mm_add_ps(acc0, acc1));
+
+	return (sum[0] + sum[1]) + (sum[2] + sum[3]);
+}
+
+static inline void asrc_interp(float *dst, const float *c0, const float *c1,
+			       float a, int n)
+{
+	__m128 va = _mm_set1_ps(a);
+	__m128 v0, v1;
+	int i;
+
+	for (i = 0; i < n; i += 4) {
+		v0 = _mm_load_ps(c0 + i);
+		v1 = _mm_load_ps(c1 + i);
+		_mm_store_ps(dst + i,
+			_mm_add_ps(v0, _mm_mul_ps(va, _mm_sub_ps(v1, v0))));
+	}
+}
+#elif defined(__ARM_NEON)
+static inline float asrc_dot(const float *x, const float *c, int n)
+{
+	float32x4_t acc0 = vdupq_n_f32(0);
+	float32x4_t acc1 = vdupq_n_f32(0);
+	float32x2_t sum;
+	int i;
+
+	for (i = 0; i < n; i += 8) {
+		acc0 = vmlaq_f32(acc0, vld1q_f32(x + i), vld1q_f32(c + i));
+		acc1 = vmlaq_f32(acc1, vld1q_f32(x + i + 4),
+					vld1q_f32(c + i + 4));
+	}
+	acc0 = vaddq_f32(acc0, acc1);
+	sum = vadd_f32(vget_low_f32(acc0), vget_high_f32(acc0));
+
+	return vget_lane_f32(vpadd_f32(sum, sum), 0);
+}
+
+static inline void asrc_interp(float *dst, const float *c0, const float *c1,
+			       float a, int n)
+{
+	float32x4_t v0, v1;
+	int i;
+
+	for (i = 0; i < n; i += 4) {
+		v0 = vld1q_f32(c0 + i);
+		v1 = vld1q_f32(c1 + i);
+		vst1q_f32(dst + i, vmlaq_n_f32(v0, vsubq_f32(v1, v0), a));
+	}
+}
+#else
+static inline float asrc_dot(const float *x, const float *c, int n)
+{
+	float sum = 0;
+	int i;
+
+	for (i = 0; i < n; i++)
+		sum += x[i] * c[i];
+
+	return sum;
+}
+
+static inline void asrc_interp(float *dst, const float *c0, const float *c1,
+			       float a, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		dst[i] = c0[i] + a * (c1[i] - c0[i]);
+}
+#endif
+
+/* zeroth order modified Bessel function of the first kind */
+static double asrc_bessel_i0(double x)
+{
+	double sum = 1, term = 1;
+	int k;
+
+	for (k = 1; k < 50; k++) {
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+		if (term < sum * 1e-17)
+			break;
+	}
+
+	return sum;
+}
+
+/*
+ * coef[p][k] = h(ASRC_TAPS / 2 - 1 + p / ASRC_PHASES - k), the output of
+ * phase p is at the fraction p / ASRC_PHASES after the tap ASRC_TAPS/2-1
+ */
+static void asrc_design(float *coef, double cutoff)
+{
+	double beta, width, half, u, x, w, h;
+	int p, k;
+
+	beta = 0.1102 * (ASRC_ATTENUATION - 8.7);
+	half = ASRC_TAPS / 2.0;
+
+	/* transition band of the window, the stopband starts at cutoff */
+	width = (ASRC_ATTENUATION - 7.95) / (14.36 * ASRC_TAPS);
+	cutoff -= width / 2;
+
+	for (p = 0; p <= ASRC_PHASES; p++) {
+		for (k = 0; k < ASRC_TAPS; k++) {
+			u = half - 1 + (double)p / ASRC_PHASES - k;
+			x = u / half;
+			if (fabs(x) >= 1) {
+				coef[p * ASRC_TAPS + k] = 0;
+				continue;
+			}
+			w = asrc_bessel_i0(beta * sqrt(1 - x * x)) /
+				asrc_bessel_i0(beta);
+			h = (u == 0) ? 2 * cutoff :
+				sin(2 * M_PI * cutoff * u) / (M_PI * u);
+			coef[p * ASRC_TAPS + k] = h * w;
+		}
+	}
+}
+
+/*
+ * public functions
+ */
+struct asrc *asrc_new(int channels, double in_rate, double out_rate)
+{
+	struct asrc *asrc;
+	double cutoff;
+	int i;
+
+	if (channels < 1 || channels > ASRC_CHANNELS_MAX ||
+	    in_rate <= 0 || out_rate <= 0)
+		return NULL;
+
+	asrc = calloc(1, sizeof(*asrc));
+	if (!asrc)
+		return NULL;
+
+	asrc->channels = channels;
+	asrc->nominal = in_rate / out_rate;
+	asrc->step = asrc->nominal;
+	asrc->ratio = 1.0;
+	asrc->pos = 0;
+
+	if (posix_memalign((void **)&asrc->coef, ASRC_ALIGN,
+			sizeof(float) * (ASRC_PHASES + 1) * ASRC_TAPS) ||
+	    posix_memalign((void **)&asrc->work, ASRC_ALIGN,
+			sizeof(float) * ASRC_TAPS))
+		goto error;
+
+	for (i = 0; i < channels; i++) {
+		asrc->hist[i] = calloc(ASRC_TAPS + ASRC_HISTORY,
+					sizeof(float));
+		if (!asrc->hist[i])
+			goto error;
+	}
+
+	/* half of the lower rate, relative to the input rate */
+	cutoff = 0.5 * ((out_rate < in_rate) ? out_rate / in_rate : 1.0);
+	asrc_design(asrc->coef, cutoff);
+
+	/* start with zeros of the taps in the history */
+	asrc->filled = ASRC_TAPS - 1;
+
+	return asrc;
+
+error:
+	asrc_free(asrc);
+
+	return NULL;
+}
+
+void asrc_free(struct asrc *asrc)
+{
+	int i;
+
+	if (!asrc)
+		return;
+
+	for (i = 0; i < asrc->channels; i++)
+		free(asrc->hist[i]);
+	free(asrc->work);
+	free(asrc->coef);
+	free(asrc);
+}
+
+/*
+ * ratio of the input clock to the output clock against their nominal
+ * rates, e.g. the media clock ratio of the stream divided by the ratio
+ * of the local DAC clock
+ */
+void asrc_set_ratio(struct asrc *asrc, double ratio)
+{
+	asrc->ratio = ratio;
+	asrc->step = asrc->nominal * ratio;
+}
+
+/* upper bound of the output frames for frames of input */
+int asrc_out_frames_max(struct asrc *asrc, int frames)
+{
+	return (int)((asrc->filled + frames) / asrc->step) + 2;
+}
+
+/*
+ * convert interleaved input frames, return the number of interleaved
+ * output frames
+ */
+int asrc_process(struct asrc *asrc, const float *in, int frames,
+		 float *out, int out_frames)
+{
+	const float *c0;
+	uint64_t t;
+	double phase;
+	int i, ch, n, index, p, consumed;
+
+	t = asrc_cpu_time();
+
+	/* planar history */
+	if (asrc->filled + frames > ASRC_TAPS + ASRC_HISTORY) {
+		asrc->overflows++;
+		frames = ASRC_TAPS + ASRC_HISTORY - asrc->filled;
+	}
+	for (ch = 0; ch < asrc->channels; ch++)
+		for (i = 0; i < frames; i++)
+			asrc->hist[ch][asrc->filled + i] =
+					in[i * asrc->channels + ch];
+	asrc->filled += frames;
+	asrc->in_frames += frames;
+
+	for (n = 0; n < out_frames; n++) {
+		index = (int)asrc->pos;
+		if (index + ASRC_TAPS > asrc->filled)
+			break;
+
+		phase = (asrc->pos - index) * ASRC_PHASES;
+		p = (int)phase;
+		c0 = asrc->coef + p * ASRC_TAPS;
+		asrc_interp(asrc->work, c0, c0 + ASRC_TAPS,
+				(float)(phase - p), ASRC_TAPS);
+
+		for (ch = 0; ch < asrc->channels; ch++)
+			out[n * asrc->channels + ch] =
+				asrc_dot(asrc->hist[ch] + index, asrc->work,
+					 ASRC_TAPS);
+
+		asrc->pos += asrc->step;
+	}
+
+	/* drop the consumed frames */
+	consumed = (int)asrc->pos;
+	if (consumed > asrc->filled)
+		consumed = asrc->filled;
+	for (ch = 0; ch < asrc->channels; ch++)
+		memmove(asrc->hist[ch], asrc->hist[ch] + consumed,
+			(asrc->filled - consumed) * sizeof(float));
+	asrc->filled -= consumed;
+	asrc->pos -= consumed;
+
+	asrc->out_frames += n;
+	asrc->cpu_time += asrc_cpu_time() - t;
+
+	return n;
+}
+
+/*
+ * samples of an AAF PCM frame of len bytes to interleaved float,
+ * return frames
+ */
+int asrc_from_aaf(void *packet, int len, float *out, int frames_max)
+{
+	uint8_t *p = packet + AVTP_AAF_PAYLOAD_OFFSET;
+	int size, channels, frames, dlen, i;
+	union {
+		uint32_t u;
+		float f;
+	} v;
+
+	if (len < AVTP_AAF_PAYLOAD_OFFSET)
+		return -1;
+
+	size = avtp_aaf_sample_size(get_avtp_aaf_format(packet));
+	channels = get_avtp_aaf_channels_per_frame(packet);
+	if (!size || !channels)
+		return -1;
+
+	dlen = get_avtp_stream_data_length(packet);
+	if (dlen > len - AVTP_AAF_PAYLOAD_OFFSET)
+		dlen = len - AVTP_AAF_PAYLOAD_OFFSET;
+	frames = dlen / (size * channels);
+	if (frames > frames_max)
+		frames = frames_max;
+
+	/* network byte order */
+	for (i = 0; i < frames * channels; i++, p += size) {
+		switch (get_avtp_aaf_format(packet)) {
+		case AVTP_AAF_FORMAT_FLOAT_32BIT:
+			v.u = ((uint32_t)p[0] << 24) | (p[1] << 16) |
+				(p[2] << 8) | p[3];
+			out[i] = v.f;
+			break;
+		case AVTP_AAF_FORMAT_INT_24BIT:
+			out[i] = (int32_t)(((uint32_t)p[0] << 24) |
+				(p[1] << 16) | (p[2] << 8)) / 2147483648.0f;
+			break;
+		case AVTP_AAF_FORMAT_INT_16BIT:
+			out[i] = (int16_t)((p[0] << 8) | p[1]) / 32768.0f;
+			break;
+		default: /* 32bit integer, AES3 */
+			out[i] = (int32_t)(((uint32_t)p[0] << 24) |
+				(p[1] << 16) | (p[2] << 8) | p[3]) /
+				2147483648.0f;
+			break;
+		}
+	}
+
+	return frames;
+}
+
+void asrc_report(struct asrc *asrc, char *buf, int buflen)
+{
+	double channels = 0;
+
+	/* channels which one core can convert to 48kHz in real time */
+	if (asrc->cpu_time)
+		channels = (double)asrc->out_frames * asrc->channels *
+			NSEC_SCALE / asrc->cpu_time / 48000;
+
+	snprintf(buf, buflen,
+		"ASRC %dch %dtaps %dphases ratio %.9f %"PRIu64"->%"PRIu64"frames %"PRIu64"overflows, %.1f channels per core at 48kHz",
+		asrc->channels, ASRC_TAPS, ASRC_PHASES, asrc->ratio,
+		asrc->in_frames, asrc->out_frames, asrc->overflows,
+		channels);
+}
@@ -0,0 +1,35 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __ASRC_H__
+#define __ASRC_H__
+
+#include <stdint.h>
+
+/*
+ * Asynchronous sample rate converter.
+ *
+ * Polyphase windowed sinc filter of ASRC_TAPS taps with ASRC_PHASES
+ * phases, the coefficients between two phases are linearly
+ * interpolated. The Kaiser window is designed for 120dB stopband
+ * attenuation at the Nyquist frequency of the lower rate.
+ */
+#define ASRC_TAPS         (128)
+#define ASRC_PHASES       (1024)
+#define ASRC_CHANNELS_MAX (64)
+
+struct asrc;
+
+extern struct asrc *asrc_new(int channels, double in_rate, double out_rate);
+extern void asrc_free(struct asrc *asrc);
+extern void asrc_set_ratio(struct asrc *asrc, double ratio);
+extern int asrc_process(struct asrc *asrc, const float *in, int frames,
+			float *out, int out_frames);
+extern int asrc_out_frames_max(struct asrc *asrc, int frames);
+extern int asrc_from_aaf(void *packet, int len, float *out, int frames_max);
+extern void asrc_report(struct asrc *asrc, char *buf, int buflen);
+
+#endif /* __ASRC_H__ */
@@ -11,12 +11,16 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <fcntl.h>
+#include <errno.h>
 
 #include "clock.h"
 
 #define ARRAY_SIZE(a) (sizeof(a)/sizeof(a[0]))
 #define NSEC_SCALE (1000000000)
 
+/* number of samples to find the tightest clock reading window */
+#define CLOCK_OFFSET_SAMPLES (5)
+
 /*
  * public functions
  */
@@ -83,3 +87,51 @@ uint64_t clock_getcount(clockid_t clk_id)
 
 	return t;
 }
+
+/*
+ * offset of clk_id against ref_id (clk_id - ref_id) in nsec
+ *
+ * The reading of clk_id is bracketed by two readings of ref_id and the
+ * tightest bracket of several tries is used, the same as phc2sys.
+ */
+int64_t clock_getoffset(clockid_t clk_id, clockid_t ref_id)
+{
+	int i;
+	uint64_t t1, t2, tc;
+	uint64_t delay, best_delay = UINT64_MAX;
+	int64_t offset = 0;
+
+	for (i = 0; i < CLOCK_OFFSET_SAMPLES; i++) {
+		t1 = clock_getcount(ref_id);
+		tc = clock_getcount(clk_id);
+		t2 = clock_getcount(ref_id);
+
+		delay = t2 - t1;
+		if (delay < best_delay) {
+			best_delay = delay;
+			offset = (int64_t)(tc - (t1 + delay / 2));
+		}
+	}
+
+	return offset;
+}
+
+/*
+ * sleep until clk_id reaches t (nsec)
+ *
+ * PTP clocks can not be used with clock_nanosleep(), so the deadline is
+ * converted to CLOCK_MONOTONIC with a freshly measured offset. EINTR is
+ * returned to let the caller check the signal flags.
+ */
+int clock_sleep_until(clockid_t clk_id, uint64_t t)
+{
+	struct timespec ts;
+	uint64_t mono;
+
+	mono = t - clock_getoffset(clk_id, CLOCK_MONOTONIC);
+
+	ts.tv_sec = mono / NSEC_SCALE;
+	ts.tv_nsec = mono % NSEC_SCALE;
+
+	return clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+}
@@ -29,5 +29,7 @@ static inline int get_clockfd(clockid_t clk_id)
 
 clockid_t clock_parse(char *name);
 extern uint64_t clock_getcount(clockid_t clk_id);
+extern int64_t clock_getoffset(clockid_t clk_id, clockid_t ref_id);
+extern int clock_sleep_until(clockid_t clk_id, uint64_t t);
 
 #endif /* __CLOCK_H_ */
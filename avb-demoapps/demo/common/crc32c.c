@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "crc32c.h"
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+/* Castagnoli polynomial (reflected) */
+#define CRC32C_POLY (0x82f63b78)
+
+static uint32_t (*crc32c_update)(uint32_t crc, const uint8_t *p, size_t len);
+static const char *crc32c_name;
+static uint32_t crc32c_table[256];
+
+static uint32_t crc32c_update_sw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	while (len--)
+		crc = crc32c_table[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+
+	return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc32c_update_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t v, c = crc;
+
+	for (; len && ((uintptr_t)p & 7); len--)
+		c = _mm_crc32_u8(c, *p++);
+
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, sizeof(v));
+		c = _mm_crc32_u64(c, v);
+	}
+
+	for (; len; len--)
+		c = _mm_crc32_u8(c, *p++);
+
+	return c;
+}
+
+static bool crc32c_hw_supported(void)
+{
+	return __builtin_cpu_supports("sse4.2");
+}
+
+#define CRC32C_HW_NAME "sse4.2"
+#elif defined(__aarch64__)
+__attribute__((target("+crc")))
+static uint32_t crc32c_update_hw(uint32_t crc, const uint8_t *p, size_t len)
+{
+	uint64_t v;
+
+	for (; len && ((uintptr_t)p & 7); len--)
+		crc = __crc32cb(crc, *p++);
+
+	for (; len >= 8; len -= 8, p += 8) {
+		memcpy(&v, p, sizeof(v));
+		crc = __crc32cd(crc, v);
+	}
+
+	for (; len; len--)
+		crc = __crc32cb(crc, *p++);
+
+	return crc;
+}
+
+static bool crc32c_hw_supported(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_CRC32);
+}
+
+#define CRC32C_HW_NAME "armv8-crc"
+#endif
+
+static void crc32c_init(void)
+{
+	uint32_t c;
+	int i, j;
+
+#ifdef CRC32C_HW_NAME
+	if (crc32c_hw_supported()) {
+		crc32c_update = crc32c_update_hw;
+		crc32c_name = CRC32C_HW_NAME;
+		return;
+	}
+#endif
+
+	for (i = 0; i < 256; i++) {
+		c = i;
+		for (j = 0; j < 8; j++)
+			c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : (c >> 1);
+		crc32c_table[i] = c;
+	}
+
+	crc32c_update = crc32c_update_sw;
+	crc32c_name = "software";
+}
+
+/*
+ * public functions
+ */
+uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
+{
+	if (!crc32c_update)
+		crc32c_init();
+
+	return ~crc32c_update(~crc, buf, len);
+}
+
+const char *crc32c_impl(void)
+{
+	if (!crc32c_update)
+		crc32c_init();
+
+	return crc32c_name;
+}
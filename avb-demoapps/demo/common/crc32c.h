@@ -0,0 +1,18 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __CRC32C_H__
+#define __CRC32C_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define CRC32C_SIZE (4)
+
+extern uint32_t crc32c(uint32_t crc, const void *buf, size_t len);
+extern const char *crc32c_impl(void);
+
+#endif /* __CRC32C_H__ */
@@ -4,15 +4,113 @@
  * http://opensource.org/licenses/mit-license.php
  */
 
+#define _GNU_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/eventfd.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
 
 #include "eavb_device.h"
 #include "eavb.h"
+#include "netif_util.h"
 
 #define EAVBDEVICE_DEBUG (0)
 
+#ifndef SOL_UDP
+#define SOL_UDP (17)
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT (103)
+#endif
+#ifndef UDP_GRO
+#define UDP_GRO (104)
+#endif
+
+/* page of a frame, room for a maximum frame with the Q-Tag */
+#define EAVB_UDP_FRAME_SIZE (2048)
+/* datagram received to a page, the Annex J header ends at AVTP_OFFSET */
+#define EAVB_UDP_DGRAM_MAX  (EAVB_UDP_FRAME_SIZE - \
+				(AVTP_OFFSET - AVTP_UDP_HEADER_SIZE))
+/* limits of a segmented send, UDP_MAX_SEGMENTS of the kernel */
+#define EAVB_UDP_GSO_SEGS   (64)
+#define EAVB_UDP_GSO_BYTES  (65000)
+#define EAVB_UDP_GRO_SIZE   (65536)
+
+/*
+ * The AVTPDU of a datagram is placed at AVTP_OFFSET of the page with the
+ * encapsulation_sequence_num just before it, so the applications build
+ * and parse the frames the same as with the eavb driver.
+ */
+struct eavb_udp {
+	int       sock;
+	bool      tx;
+	bool      offload; /* UDP_SEGMENT on tx, UDP_GRO on rx */
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+
+	void      *pages;   /* shared memory, to be handed over with pages_fd */
+	size_t    pages_size;
+	int       pages_fd;
+	struct mmsghdr *msgs;
+	struct iovec *iov;
+	char      *cmsgs;
+
+	/* coalesced datagrams of UDP_GRO being split into the entries */
+	uint8_t   *gro;
+	int       gro_len;
+	int       gro_off;
+	int       gro_seg;
+	/* readable while u->gro has segments, polled with the socket */
+	int       gro_fd;
+	bool      gro_pending;
+
+	uint32_t  seq;
+	bool      seq_valid;
+
+	/* statistics */
+	uint64_t  datagrams;
+	uint64_t  calls;
+	uint64_t  lost;
+	uint64_t  errors;
+};
+
+#define EAVB_UDP_CMSG_SIZE (CMSG_SPACE(sizeof(uint16_t)))
+
+/* frame pages of a tx device handed over, see eavb_device_export_pages() */
+struct eavb_device_pages {
+	int32_t   entrynum;
+	bool      udp;
+	bool      offload;
+	struct sockaddr_storage addr;
+	socklen_t addrlen;
+	uint64_t  pages_size;
+	struct {
+		uint32_t  paddr;
+		uint32_t  size;
+		uint64_t  offset; /* mmap offset in the fd of the pages */
+	} page[];
+};
+
+/* entries of a tx device handed over, see eavb_device_export_ring() */
+struct eavb_device_ring {
+	int32_t   wp;
+	int32_t   rp;
+	int32_t   remain;
+	int32_t   filled;
+	int32_t   p;
+	uint32_t  seq;
+	struct eavb_entry entry[];
+};
+
 static int eavb_device_get_separation_filter(
 		struct eavb_device *dev, char streamid[AVTP_STREAMID_SIZE])
 {
@@ -116,6 +214,374 @@ static int eavb_device_push_entry(struct eavb_device *dev, int count)
 	return ret;
 }
 
+/*
+ * IEEE1722 Annex J UDP transport
+ */
+static inline struct eavb_entry *eavb_udp_entry(struct eavb_device *dev,
+						int idx)
+{
+	return (struct eavb_entry *)dev->entrybuf + idx;
+}
+
+static inline uint8_t *eavb_udp_datagram(struct eavb_device *dev, int idx)
+{
+	return (uint8_t *)dev->frames[idx] + AVTP_OFFSET - AVTP_UDP_HEADER_SIZE;
+}
+
+static int eavb_udp_get_separation_filter(
+		struct eavb_device *dev, char streamid[AVTP_STREAMID_SIZE])
+{
+	/* no stream separation in the network stack */
+	return -1;
+}
+
+/* send the datagrams of a segmented message one by one */
+static void eavb_udp_send_each(struct eavb_udp *u, struct msghdr *msg)
+{
+	struct msghdr one;
+	int i;
+
+	memset(&one, 0, sizeof(one));
+	one.msg_name = msg->msg_name;
+	one.msg_namelen = msg->msg_namelen;
+	one.msg_iovlen = 1;
+
+	for (i = 0; i < msg->msg_iovlen; i++) {
+		one.msg_iov = &msg->msg_iov[i];
+		u->calls++;
+		if (sendmsg(u->sock, &one, 0) < 0)
+			u->errors++;
+	}
+}
+
+static int eavb_udp_send(struct eavb_device *dev, int count)
+{
+	struct eavb_udp *u = dev->udp;
+	struct msghdr *msg = NULL;
+	struct cmsghdr *cm;
+	uint8_t *data;
+	int i, idx, len, seg = 0, bytes = 0, nmsg = 0, sent, ret;
+
+	for (i = 0; i < count; i++) {
+		idx = (dev->wp + i) % dev->entrynum;
+		data = eavb_udp_datagram(dev, idx);
+		len = eavb_udp_entry(dev, idx)->vec[0].len -
+				AVTP_OFFSET + AVTP_UDP_HEADER_SIZE;
+
+		*(uint32_t *)data = htonl(u->seq++);
+		u->iov[i].iov_base = data;
+		u->iov[i].iov_len = len;
+
+		/* datagrams of the same length go as segments of one send */
+		if (u->offload && msg && len == seg &&
+		    msg->msg_iovlen < EAVB_UDP_GSO_SEGS &&
+		    bytes + len <= EAVB_UDP_GSO_BYTES) {
+			msg->msg_iovlen++;
+			bytes += len;
+			continue;
+		}
+
+		msg = &u->msgs[nmsg].msg_hdr;
+		memset(msg, 0, sizeof(*msg));
+		msg->msg_name = &u->addr;
+		msg->msg_namelen = u->addrlen;
+		msg->msg_iov = &u->iov[i];
+		msg->msg_iovlen = 1;
+		seg = len;
+		bytes = len;
+		nmsg++;
+	}
+
+	for (i = 0; i < nmsg; i++) {
+		msg = &u->msgs[i].msg_hdr;
+		if (msg->msg_iovlen < 2)
+			continue;
+		msg->msg_control = u->cmsgs + i * EAVB_UDP_CMSG_SIZE;
+		msg->msg_controllen = EAVB_UDP_CMSG_SIZE;
+		cm = CMSG_FIRSTHDR(msg);
+		cm->cmsg_level = SOL_UDP;
+		cm->cmsg_type = UDP_SEGMENT;
+		cm->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+		*(uint16_t *)CMSG_DATA(cm) = msg->msg_iov[0].iov_len;
+	}
+
+	for (sent = 0; sent < nmsg; ) {
+		u->calls++;
+		ret = sendmmsg(u->sock, u->msgs + sent, nmsg - sent, 0);
+		if (ret > 0) {
+			sent += ret;
+			continue;
+		}
+		if (errno == EINTR)
+			continue;
+
+		/* segmentation refused by the route, fall back for good */
+		msg = &u->msgs[sent].msg_hdr;
+		if (msg->msg_iovlen > 1 && (errno == EIO || errno == EINVAL)) {
+			fprintf(stderr, "[AVB] UDP_SEGMENT failed, send datagrams one by one\n");
+			u->offload = false;
+			eavb_udp_send_each(u, msg);
+		} else {
+			u->errors += msg->msg_iovlen;
+		}
+		sent++;
+	}
+
+	u->datagrams += count;
+
+	return count;
+}
+
+/* turn the datagram of the entry into a frame of the eavb driver */
+static void eavb_udp_received(struct eavb_device *dev, int idx, int len)
+{
+	struct eavb_udp *u = dev->udp;
+	uint8_t *frame = dev->frames[idx];
+	uint32_t seq;
+
+	if (len < AVTP_UDP_HEADER_SIZE) {
+		u->errors++;
+		len = AVTP_UDP_HEADER_SIZE;
+		memset(frame + AVTP_OFFSET - len, 0, len);
+	}
+
+	seq = ntohl(*(uint32_t *)(frame + AVTP_OFFSET - AVTP_UDP_HEADER_SIZE));
+	if (u->seq_valid && seq != u->seq && seq - u->seq < 0x80000000)
+		u->lost += seq - u->seq;
+	u->seq = seq + 1;
+	u->seq_valid = true;
+	u->datagrams++;
+
+	set_ieee8021q_tpid(frame, ETH_P_8021Q);
+	set_ieee8021q_tci(frame, 0);
+	set_ieee8021q_ethtype(frame, ETH_P_1722);
+
+	eavb_udp_entry(dev, idx)->vec[0].len =
+			len - AVTP_UDP_HEADER_SIZE + AVTP_OFFSET;
+}
+
+/*
+ * Segments left over in u->gro when the entries ran out are not seen by
+ * poll of the socket, gro_fd keeps dev->fd readable meanwhile.
+ */
+static void eavb_udp_gro_pending(struct eavb_udp *u, bool pending)
+{
+	eventfd_t val;
+
+	if (pending == u->gro_pending)
+		return;
+
+	if (pending)
+		eventfd_write(u->gro_fd, 1);
+	else
+		eventfd_read(u->gro_fd, &val);
+	u->gro_pending = pending;
+}
+
+/* receive into the entries from one UDP_GRO datagram after another */
+static int eavb_udp_recv_gro(struct eavb_device *dev, int count)
+{
+	struct eavb_udp *u = dev->udp;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cm;
+	char control[EAVB_UDP_CMSG_SIZE + CMSG_SPACE(sizeof(int))];
+	int n = 0, idx, len, copy, ret;
+
+	while (n < count) {
+		if (u->gro_off < u->gro_len) {
+			idx = (dev->rp + n) % dev->entrynum;
+			len = u->gro_len - u->gro_off;
+			if (len > u->gro_seg)
+				len = u->gro_seg;
+			/* cut a segment to the entry as recvmmsg would */
+			copy = len;
+			if (copy > EAVB_UDP_DGRAM_MAX) {
+				copy = EAVB_UDP_DGRAM_MAX;
+				u->errors++;
+			}
+			memcpy(eavb_udp_datagram(dev, idx),
+			       u->gro + u->gro_off, copy);
+			u->gro_off += len;
+			eavb_udp_received(dev, idx, copy);
+			n++;
+			continue;
+		}
+
+		memset(&msg, 0, sizeof(msg));
+		iov.iov_base = u->gro;
+		iov.iov_len = EAVB_UDP_GRO_SIZE;
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		u->calls++;
+		ret = recvmsg(u->sock, &msg, MSG_DONTWAIT);
+		if (ret < 0) {
+			if (errno != EAGAIN && errno != EINTR)
+				u->errors++;
+			break;
+		}
+
+		u->gro_len = ret;
+		u->gro_off = 0;
+		u->gro_seg = ret;
+		for (cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm))
+			if (cm->cmsg_level == SOL_UDP &&
+			    cm->cmsg_type == UDP_GRO)
+				u->gro_seg = *(int *)CMSG_DATA(cm);
+		if (u->gro_seg <= 0)
+			u->gro_seg = ret;
+		/* keep an empty datagram from being lost */
+		if (!ret) {
+			idx = (dev->rp + n) % dev->entrynum;
+			eavb_udp_received(dev, idx, 0);
+			n++;
+		}
+	}
+
+	eavb_udp_gro_pending(u, u->gro_off < u->gro_len);
+
+	return n;
+}
+
+static int eavb_udp_recv(struct eavb_device *dev, int count)
+{
+	struct eavb_udp *u = dev->udp;
+	struct msghdr *msg;
+	int i, idx, ret;
+
+	if (u->offload)
+		return eavb_udp_recv_gro(dev, count);
+
+	for (i = 0; i < count; i++) {
+		idx = (dev->rp + i) % dev->entrynum;
+		u->iov[i].iov_base = eavb_udp_datagram(dev, idx);
+		u->iov[i].iov_len = EAVB_UDP_DGRAM_MAX;
+		msg = &u->msgs[i].msg_hdr;
+		memset(msg, 0, sizeof(*msg));
+		msg->msg_iov = &u->iov[i];
+		msg->msg_iovlen = 1;
+	}
+
+	u->calls++;
+	ret = recvmmsg(u->sock, u->msgs, count, MSG_DONTWAIT, NULL);
+	if (ret < 0) {
+		if (errno != EAGAIN && errno != EINTR)
+			u->errors++;
+		return 0;
+	}
+
+	for (i = 0; i < ret; i++) {
+		if (u->msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+			u->errors++;
+		eavb_udp_received(dev, (dev->rp + i) % dev->entrynum,
+				  u->msgs[i].msg_len);
+	}
+
+	return ret;
+}
+
+/*
+ * On tx the eventfd of dev->fd stands for the completion of the driver,
+ * it is readable while sent entries are left to be taken back.
+ */
+static int eavb_udp_take_entry(struct eavb_device *dev, int count)
+{
+	uint64_t val;
+	int ret;
+
+	if (!dev)
+		return -1;
+
+	if (count > dev->filled)
+		count = dev->filled;
+	if (count <= 0)
+		return 0;
+
+	if (dev->udp->tx)
+		ret = count;
+	else
+		ret = eavb_udp_recv(dev, count);
+
+	if (ret <= 0)
+		return ret;
+
+	dev->remain += ret;
+	dev->filled -= ret;
+
+	if (dev->udp->tx && !dev->filled &&
+	    read(dev->fd, &val, sizeof(val)) < 0)
+		dev->udp->errors++;
+
+	dev->rp = (dev->rp + ret) % dev->entrynum;
+
+	return ret;
+}
+
+static int eavb_udp_push_entry(struct eavb_device *dev, int count)
+{
+	uint64_t val = 1;
+	int ret;
+
+	if (!dev)
+		return -1;
+
+	if (count > dev->remain)
+		count = dev->remain;
+	if (count <= 0)
+		return 0;
+
+	if (dev->udp->tx) {
+		ret = eavb_udp_send(dev, count);
+		if (write(dev->fd, &val, sizeof(val)) < 0)
+			dev->udp->errors++;
+	} else {
+		/* the entries are just handed over for the receive */
+		ret = count;
+	}
+
+	dev->remain -= ret;
+	dev->filled += ret;
+	dev->wp = (dev->wp + ret) % dev->entrynum;
+
+	return ret;
+}
+
+static int eavb_device_alloc_buffers(struct eavb_device *dev)
+{
+	/* allocate entry buffer */
+	dev->entrybuf = calloc(dev->entrynum, sizeof(struct eavb_entry));
+	if (!dev->entrybuf) {
+		fprintf(stderr, "[AVB] cannot allocate entrybuf\n");
+		return -1;
+	}
+
+	/* allocate entry work buffer */
+	dev->entryworkbuf = calloc(dev->entrynum, sizeof(struct eavb_entry));
+	if (!dev->entryworkbuf) {
+		fprintf(stderr, "[AVB] cannot allocate entryworkbuf\n");
+		return -1;
+	}
+
+	/* allocate frame info buffer */
+	dev->framebuf = calloc(dev->entrynum, sizeof(struct eavb_dma_alloc));
+	if (!dev->framebuf) {
+		fprintf(stderr, "[AVB] cannot allocate framebuf\n");
+		return -1;
+	}
+
+	/* allocate frame address table */
+	dev->frames = calloc(dev->entrynum, sizeof(void *));
+	if (!dev->frames) {
+		fprintf(stderr, "[AVB] cannot allocate frames\n");
+		return -1;
+	}
+
+	return 0;
+}
+
 /*
  * public functions
  */
@@ -144,30 +610,14 @@ struct eavb_device *eavb_device_new(char *name, int entrynum, mode_t mode)
 		goto error;
 	dev->fd = fd;
 
-	/* allocate entry buffer */
-	dev->entrybuf = calloc(dev->entrynum, sizeof(struct eavb_entry));
-	if (!dev->entrybuf) {
-		fprintf(stderr, "[AVB] cannot allocate entrybuf\n");
+	if (eavb_device_alloc_buffers(dev) < 0)
 		goto error;
-	}
-
-	/* allocate entry work buffer */
-	dev->entryworkbuf = calloc(dev->entrynum, sizeof(struct eavb_entry));
-	if (!dev->entryworkbuf) {
-		fprintf(stderr, "[AVB] cannot allocate entryworkbuf\n");
-		goto error;
-	}
-
-	/* allocate frame info buffer */
-	dev->framebuf = calloc(dev->entrynum, sizeof(struct eavb_dma_alloc));
-	if (!dev->framebuf) {
-		fprintf(stderr, "[AVB] cannot allocate framebuf\n");
-		goto error;
-	}
 
 	return dev; /* Success */
 
 error:
+	if (dev->frames)
+		free(dev->frames);
 	if (dev->framebuf)
 		free(dev->framebuf);
 	if (dev->entryworkbuf)
@@ -181,11 +631,411 @@ error:
 	return NULL;
 }
 
+static int eavb_udp_alloc_msgs(struct eavb_udp *u, int entrynum)
+{
+	u->msgs = calloc(entrynum, sizeof(*u->msgs));
+	u->iov = calloc(entrynum, sizeof(*u->iov));
+	u->cmsgs = calloc(entrynum, EAVB_UDP_CMSG_SIZE);
+	if (!u->msgs || !u->iov || !u->cmsgs) {
+		fprintf(stderr, "[AVB] cannot allocate UDP messages\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int eavb_udp_map_pages(struct eavb_udp *u)
+{
+	u->pages = mmap(NULL, u->pages_size, PROT_READ | PROT_WRITE,
+			MAP_SHARED, u->pages_fd, 0);
+	if (u->pages == MAP_FAILED) {
+		u->pages = NULL;
+		perror("[AVB] mmap");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* dev->fd of UDP_GRO polls both the socket and gro_fd */
+static int eavb_udp_gro_poll(struct eavb_device *dev)
+{
+	struct eavb_udp *u = dev->udp;
+	struct epoll_event ev;
+	int fd;
+
+	u->gro_fd = eventfd(0, EFD_NONBLOCK);
+	if (u->gro_fd < 0) {
+		perror("[AVB] eventfd");
+		return -1;
+	}
+
+	fd = epoll_create1(0);
+	if (fd < 0) {
+		perror("[AVB] epoll_create1");
+		return -1;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	if (epoll_ctl(fd, EPOLL_CTL_ADD, u->sock, &ev) < 0 ||
+	    epoll_ctl(fd, EPOLL_CTL_ADD, u->gro_fd, &ev) < 0) {
+		perror("[AVB] epoll_ctl");
+		close(fd);
+		return -1;
+	}
+	dev->fd = fd;
+
+	return 0;
+}
+
+struct eavb_device *eavb_device_new_udp(const struct sockaddr_storage *addr,
+					socklen_t addrlen, int entrynum,
+					bool tx, bool offload)
+{
+	struct eavb_device *dev;
+	struct eavb_udp *u;
+	int val;
+
+	dev = calloc(1, sizeof(*dev));
+	if (!dev)
+		return NULL;
+
+	dev->fd = -1;
+	dev->entrynum = entrynum;
+	dev->remain = entrynum;
+	dev->get_separation_filter = eavb_udp_get_separation_filter;
+	dev->take_entry = eavb_udp_take_entry;
+	dev->push_entry = eavb_udp_push_entry;
+
+	u = calloc(1, sizeof(*u));
+	if (!u)
+		goto error;
+	dev->udp = u;
+	u->sock = -1;
+	u->gro_fd = -1;
+	u->pages_fd = -1;
+	u->tx = tx;
+	memcpy(&u->addr, addr, addrlen);
+	u->addrlen = addrlen;
+
+	u->sock = netif_open_udp(addr, addrlen, !tx);
+	if (u->sock < 0)
+		goto error;
+
+	if (tx) {
+		dev->fd = eventfd(0, EFD_NONBLOCK);
+		if (dev->fd < 0) {
+			perror("[AVB] eventfd");
+			goto error;
+		}
+	} else {
+		dev->fd = u->sock;
+	}
+
+	/* the offloads are used only where the kernel knows them */
+	if (offload) {
+		val = tx ? 0 : 1;
+		u->offload = !setsockopt(u->sock, SOL_UDP,
+					 tx ? UDP_SEGMENT : UDP_GRO,
+					 &val, sizeof(val));
+		if (!u->offload)
+			fprintf(stderr, "[AVB] %s not supported, no UDP offload\n",
+					tx ? "UDP_SEGMENT" : "UDP_GRO");
+	}
+
+	if (eavb_device_alloc_buffers(dev) < 0)
+		goto error;
+
+	/* in a memfd like the DMA pages of the driver behind an fd */
+	u->pages_size = (size_t)entrynum * EAVB_UDP_FRAME_SIZE;
+	u->pages_fd = memfd_create("eavb_udp", MFD_CLOEXEC);
+	if (u->pages_fd < 0 || ftruncate(u->pages_fd, u->pages_size) < 0) {
+		perror("[AVB] memfd_create");
+		goto error;
+	}
+	if (eavb_udp_map_pages(u) < 0)
+		goto error;
+
+	if (eavb_udp_alloc_msgs(u, entrynum) < 0)
+		goto error;
+
+	if (!tx && u->offload) {
+		u->gro = malloc(EAVB_UDP_GRO_SIZE);
+		if (!u->gro) {
+			fprintf(stderr, "[AVB] cannot allocate UDP_GRO buffer\n");
+			goto error;
+		}
+		if (eavb_udp_gro_poll(dev) < 0)
+			goto error;
+	}
+
+	return dev; /* Success */
+
+error:
+	eavb_device_free(dev);
+
+	return NULL;
+}
+
+/* the frame page of the entry at the index of page in framebuf */
+int eavb_device_alloc_page(struct eavb_device *dev,
+			   struct eavb_dma_alloc *page)
+{
+	int i;
+
+	if (!dev->udp)
+		return eavb_dma_malloc_page(dev->fd, page);
+
+	i = page - (struct eavb_dma_alloc *)dev->framebuf;
+	if (i < 0 || i >= dev->entrynum)
+		return -1;
+
+	page->dma_paddr = 0;
+	page->dma_vaddr = dev->udp->pages + i * EAVB_UDP_FRAME_SIZE;
+	page->mmap_size = EAVB_UDP_FRAME_SIZE;
+
+	return 0;
+}
+
+/*
+ * Hand a tx device over to another process in two steps. The frame
+ * pages are exported first, they do not change while the device is in
+ * use and the other process maps them in advance. The entries are
+ * exported when the device is given up, the other process continues
+ * from them at once.
+ *
+ * The pages are described in buf and the fds to pass are set in fds,
+ * -1 for unused ones. Returns the bytes of the description, or the bytes
+ * needed with buf NULL, -1 on error.
+ */
+ssize_t eavb_device_export_pages(struct eavb_device *dev, void *buf,
+				 size_t len, int fds[EAVB_DEVICE_FDS])
+{
+	struct eavb_device_pages *pg = buf;
+	struct eavb_dma_alloc *p;
+	struct eavb_udp *u = dev->udp;
+	size_t size;
+	int i;
+
+	/* the receive state of UDP_GRO is not handed over */
+	if (u && !u->tx)
+		return -1;
+
+	size = sizeof(*pg) + (size_t)dev->entrynum * sizeof(pg->page[0]);
+	if (!buf)
+		return size;
+	if (len < size)
+		return -1;
+
+	memset(pg, 0, sizeof(*pg));
+	pg->entrynum = dev->entrynum;
+	if (u) {
+		pg->udp = true;
+		pg->offload = u->offload;
+		memcpy(&pg->addr, &u->addr, u->addrlen);
+		pg->addrlen = u->addrlen;
+		pg->pages_size = u->pages_size;
+	}
+
+	for (i = 0, p = dev->framebuf; i < dev->entrynum; i++, p++) {
+		pg->page[i].paddr = p->dma_paddr;
+		pg->page[i].size = p->mmap_size;
+		if (u)
+			pg->page[i].offset = (uint8_t *)p->dma_vaddr -
+						(uint8_t *)u->pages;
+		else
+			pg->page[i].offset = p->dma_paddr;
+	}
+
+	fds[0] = dev->fd;
+	fds[1] = (u) ? u->sock : -1;
+	fds[2] = (u) ? u->pages_fd : -1;
+
+	return size;
+}
+
+/*
+ * A device on the pages exported by another process. The fds are owned
+ * by the device, also on error. It has no entries in use until
+ * eavb_device_import_ring().
+ */
+struct eavb_device *eavb_device_import_pages(const void *buf, size_t len,
+					     const int fds[EAVB_DEVICE_FDS])
+{
+	const struct eavb_device_pages *pg = buf;
+	struct eavb_device *dev;
+	struct eavb_dma_alloc *p;
+	struct eavb_udp *u = NULL;
+	bool taken = false;
+	int i;
+
+	dev = calloc(1, sizeof(*dev));
+	if (!dev)
+		goto error;
+
+	dev->fd = fds[0];
+	if (len < sizeof(*pg) || pg->entrynum <= 0 ||
+	    len < sizeof(*pg) + (size_t)pg->entrynum * sizeof(pg->page[0]) ||
+	    dev->fd < 0 || (pg->udp && (fds[1] < 0 || fds[2] < 0 ||
+				       pg->addrlen > sizeof(u->addr)))) {
+		fprintf(stderr, "[AVB] invalid pages handed over\n");
+		goto error;
+	}
+
+	dev->entrynum = pg->entrynum;
+	dev->remain = pg->entrynum;
+
+	if (pg->udp) {
+		dev->get_separation_filter = eavb_udp_get_separation_filter;
+		dev->take_entry = eavb_udp_take_entry;
+		dev->push_entry = eavb_udp_push_entry;
+
+		u = calloc(1, sizeof(*u));
+		if (!u)
+			goto error;
+		dev->udp = u;
+		u->sock = fds[1];
+		u->pages_fd = fds[2];
+		u->gro_fd = -1;
+		taken = true;
+		u->tx = true;
+		u->offload = pg->offload;
+		memcpy(&u->addr, &pg->addr, pg->addrlen);
+		u->addrlen = pg->addrlen;
+		u->pages_size = pg->pages_size;
+
+		if (eavb_udp_map_pages(u) < 0 ||
+		    eavb_udp_alloc_msgs(u, dev->entrynum) < 0)
+			goto error;
+	} else {
+		dev->get_separation_filter = eavb_device_get_separation_filter;
+		dev->take_entry = eavb_device_take_entry;
+		dev->push_entry = eavb_device_push_entry;
+
+		/* only the device fd is used */
+		for (i = 1; i < EAVB_DEVICE_FDS; i++)
+			if (fds[i] >= 0)
+				close(fds[i]);
+		taken = true;
+	}
+
+	if (eavb_device_alloc_buffers(dev) < 0)
+		goto error;
+
+	for (i = 0, p = dev->framebuf; i < dev->entrynum; i++, p++) {
+		p->dma_paddr = pg->page[i].paddr;
+		p->mmap_size = pg->page[i].size;
+		if (u) {
+			if (pg->page[i].offset + p->mmap_size > u->pages_size)
+				goto error;
+			p->dma_vaddr = (uint8_t *)u->pages + pg->page[i].offset;
+		} else if (eavb_dma_map_page(dev->fd, p) < 0) {
+			goto error;
+		}
+		dev->frames[i] = p->dma_vaddr;
+	}
+
+	return dev; /* Success */
+
+error:
+	/* the fds which are not taken by the device yet */
+	if (!dev && fds[0] >= 0)
+		close(fds[0]);
+	if (!taken) {
+		for (i = 1; i < EAVB_DEVICE_FDS; i++)
+			if (fds[i] >= 0)
+				close(fds[i]);
+	}
+	eavb_device_free(dev);
+
+	return NULL;
+}
+
+/* the entries and the indexes to continue from, like export_pages */
+ssize_t eavb_device_export_ring(struct eavb_device *dev, void *buf,
+				size_t len)
+{
+	struct eavb_device_ring *r = buf;
+	size_t size;
+
+	size = sizeof(*r) + (size_t)dev->entrynum * sizeof(r->entry[0]);
+	if (!buf)
+		return size;
+	if (len < size)
+		return -1;
+
+	r->wp = dev->wp;
+	r->rp = dev->rp;
+	r->remain = dev->remain;
+	r->filled = dev->filled;
+	r->p = dev->p;
+	r->seq = (dev->udp) ? dev->udp->seq : 0;
+	memcpy(r->entry, dev->entrybuf, dev->entrynum * sizeof(r->entry[0]));
+
+	return size;
+}
+
+int eavb_device_import_ring(struct eavb_device *dev, const void *buf,
+			    size_t len)
+{
+	const struct eavb_device_ring *r = buf;
+
+	if (len < sizeof(*r) + (size_t)dev->entrynum * sizeof(r->entry[0]) ||
+	    r->remain + r->filled != dev->entrynum)
+		return -1;
+
+	dev->wp = r->wp;
+	dev->rp = r->rp;
+	dev->remain = r->remain;
+	dev->filled = r->filled;
+	dev->p = r->p;
+	if (dev->udp)
+		dev->udp->seq = r->seq;
+	memcpy(dev->entrybuf, r->entry, dev->entrynum * sizeof(r->entry[0]));
+
+	return 0;
+}
+
+int eavb_device_udp_report(struct eavb_device *dev, char *buf, int buflen)
+{
+	struct eavb_udp *u = dev->udp;
+
+	if (!u)
+		return 0;
+
+	return snprintf(buf, buflen,
+		"UDP %s: %"PRIu64" datagrams in %"PRIu64" calls (%.1f per call), "
+		"%s, %"PRIu64" lost, %"PRIu64" errors",
+		u->tx ? "tx" : "rx", u->datagrams, u->calls,
+		u->calls ? (double)u->datagrams / u->calls : 0.0,
+		u->offload ? (u->tx ? "UDP_SEGMENT" : "UDP_GRO") : "no offload",
+		u->lost, u->errors);
+}
+
 void eavb_device_free(struct eavb_device *dev)
 {
 	if (!dev)
 		return;
 
+	if (dev->udp) {
+		if (dev->udp->sock >= 0 && dev->udp->sock != dev->fd)
+			close(dev->udp->sock);
+		if (dev->udp->gro_fd >= 0)
+			close(dev->udp->gro_fd);
+		free(dev->udp->gro);
+		free(dev->udp->cmsgs);
+		free(dev->udp->iov);
+		free(dev->udp->msgs);
+		if (dev->udp->pages)
+			munmap(dev->udp->pages, dev->udp->pages_size);
+		if (dev->udp->pages_fd >= 0)
+			close(dev->udp->pages_fd);
+		free(dev->udp);
+	}
+
+	if (dev->frames)
+		free(dev->frames);
 	if (dev->framebuf)
 		free(dev->framebuf);
 	if (dev->entryworkbuf)
@@ -10,11 +10,20 @@
 #include "avtp.h"
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/socket.h>
 #include <linux/if_ether.h>
 
+struct eavb_dma_alloc;
+struct eavb_udp;
+
+#define EAVB_DEVICE_FDS (3) /* stream queue, UDP socket and UDP pages */
+
 struct eavb_device {
 	int       fd;
 	void      *framebuf;
+	void      **frames; /* dma_vaddr of framebuf in ring order */
 	void      *entrybuf;
 	void      *entryworkbuf;
 
@@ -29,6 +38,9 @@ struct eavb_device {
 	int       filled;
 	int       p;
 
+	/* IEEE1722 Annex J UDP transport, NULL with the eavb driver */
+	struct eavb_udp *udp;
+
 	int (*get_separation_filter)(struct eavb_device *dev,
 					char streamid[AVTP_STREAMID_SIZE]);
 	int (*take_entry)(struct eavb_device *dev, int count);
@@ -36,6 +48,20 @@ struct eavb_device {
 };
 
 struct eavb_device *eavb_device_new(char *name, int entrynum, mode_t mode);
+struct eavb_device *eavb_device_new_udp(const struct sockaddr_storage *addr,
+					socklen_t addrlen, int entrynum,
+					bool tx, bool offload);
 void eavb_device_free(struct eavb_device *dev);
+int eavb_device_alloc_page(struct eavb_device *dev,
+			   struct eavb_dma_alloc *page);
+int eavb_device_udp_report(struct eavb_device *dev, char *buf, int buflen);
+ssize_t eavb_device_export_pages(struct eavb_device *dev, void *buf,
+				 size_t len, int fds[EAVB_DEVICE_FDS]);
+struct eavb_device *eavb_device_import_pages(const void *buf, size_t len,
+					     const int fds[EAVB_DEVICE_FDS]);
+ssize_t eavb_device_export_ring(struct eavb_device *dev, void *buf,
+				size_t len);
+int eavb_device_import_ring(struct eavb_device *dev, const void *buf,
+			    size_t len);
 
 #endif /* __EAVB_DEVICE_H__ */
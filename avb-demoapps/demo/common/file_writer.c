@@ -0,0 +1,435 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#define _GNU_SOURCE /* O_DIRECT */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <inttypes.h>
+#include <sys/prctl.h>
+
+#include "file_writer.h"
+#include "clock.h"
+
+#define NSEC_SCALE (1000000000)
+
+/* O_DIRECT needs block aligned buffer, offset and length */
+#define FILE_WRITER_DIRECT_ALIGN (4096)
+#define FILE_WRITER_STAGE_SIZE   (1024 * 1024)
+
+/* period to measure the offset of the release clock */
+#define FILE_WRITER_OFFSET_PERIOD (100000000)
+
+static int file_writer_writev(int fd, struct iovec *iov, int iovcnt)
+{
+	ssize_t ret;
+
+	while (iovcnt > 0) {
+		ret = writev(fd, iov, iovcnt);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+
+		/* skip written iovec, and retry the rest on partial write */
+		while (iovcnt > 0 && ret >= iov->iov_len) {
+			ret -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base += ret;
+			iov->iov_len -= ret;
+		}
+	}
+
+	return 0;
+}
+
+static int file_writer_write(int fd, void *buf, size_t len)
+{
+	struct iovec iov = { .iov_base = buf, .iov_len = len };
+
+	return file_writer_writev(fd, &iov, 1);
+}
+
+/* copy the payloads to the aligned buffer, write the aligned part */
+static int file_writer_direct(struct file_writer *w, struct iovec *iov,
+			      int iovcnt)
+{
+	size_t len, aligned;
+	int i, ret = 0;
+
+	for (i = 0; i < iovcnt; i++) {
+		if (w->stage_len + iov[i].iov_len > FILE_WRITER_STAGE_SIZE) {
+			aligned = w->stage_len & ~(FILE_WRITER_DIRECT_ALIGN - 1);
+			if (file_writer_write(w->fd, w->stage, aligned) < 0)
+				ret = -1;
+			len = w->stage_len - aligned;
+			memmove(w->stage, w->stage + aligned, len);
+			w->stage_len = len;
+		}
+
+		memcpy(w->stage + w->stage_len, iov[i].iov_base,
+				iov[i].iov_len);
+		w->stage_len += iov[i].iov_len;
+	}
+
+	return ret;
+}
+
+/* write the unaligned tail without O_DIRECT */
+static int file_writer_direct_flush(struct file_writer *w)
+{
+	int flags;
+
+	if (!w->stage_len)
+		return 0;
+
+	flags = fcntl(w->fd, F_GETFL);
+	if (flags >= 0)
+		fcntl(w->fd, F_SETFL, flags & ~O_DIRECT);
+
+	return file_writer_write(w->fd, w->stage, w->stage_len);
+}
+
+/* sleep until t on the release clock, return the time of wake up */
+static uint64_t file_writer_sleep(struct file_writer *w, uint64_t t)
+{
+	struct timespec ts;
+	uint64_t mono, now;
+	int ret;
+
+	now = clock_getcount(CLOCK_MONOTONIC);
+
+	/* PTP clocks cannot be used with clock_nanosleep() */
+	if (now - w->offset_time > FILE_WRITER_OFFSET_PERIOD) {
+		w->offset = clock_getoffset(w->clkid, CLOCK_MONOTONIC);
+		w->offset_time = now;
+	}
+
+	mono = t - w->offset;
+	if (mono > now) {
+		ts.tv_sec = mono / NSEC_SCALE;
+		ts.tv_nsec = mono % NSEC_SCALE;
+		do {
+			ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME,
+					&ts, NULL);
+		} while (ret == EINTR);
+	}
+
+	return clock_getcount(w->clkid);
+}
+
+static inline uint64_t file_writer_error(uint64_t now, uint64_t t)
+{
+	return (now > t) ? now - t : t - now;
+}
+
+/* number of frames from index to be released now */
+static uint64_t file_writer_due(struct file_writer *w, int index, uint64_t n,
+				bool stopping)
+{
+	uint64_t i, now, t;
+
+	if (stopping)
+		return n;
+
+	t = w->release[index];
+	if (!t)
+		return 1;
+
+	now = file_writer_sleep(w, t);
+	hdr_hist_record(&w->release_error,
+				file_writer_error(now, t));
+
+	/* catch up the frames which are due already */
+	for (i = 1; i < n; i++) {
+		t = w->release[index + i];
+		if (t > now)
+			break;
+		if (t)
+			hdr_hist_record(&w->release_error,
+				file_writer_error(now, t));
+	}
+
+	return i;
+}
+
+/* collect the iovecs of n positions from index, return positions */
+static uint64_t file_writer_gather(struct file_writer *w, int index,
+				   uint64_t n, int *iovcnt)
+{
+	uint64_t i;
+	int cnt = 0;
+
+	for (i = 0; i < n; i++) {
+		if (cnt + w->iovcnt[index + i] > IOV_MAX)
+			break;
+		memcpy(&w->gather[cnt], &w->iov[(index + i) * w->chain],
+				w->iovcnt[index + i] * sizeof(*w->gather));
+		cnt += w->iovcnt[index + i];
+	}
+	*iovcnt = cnt;
+
+	return i;
+}
+
+static void *file_writer_thread(void *arg)
+{
+	struct file_writer *w = arg;
+	struct iovec *iov;
+	uint64_t n, i, len;
+	int index, iovcnt, ret;
+	bool stopping;
+
+	/* wake up on time for the paced release */
+	prctl(PR_SET_TIMERSLACK, 1);
+
+	pthread_mutex_lock(&w->lock);
+
+	for (;;) {
+		while (w->queued == w->written && !w->stop)
+			pthread_cond_wait(&w->cond, &w->lock);
+
+		if (w->queued == w->written)
+			break; /* stopped and drained */
+
+		/* write in ring order up to the end of ring */
+		n = w->queued - w->written;
+		index = w->written % w->entrynum;
+		if (n > w->entrynum - index)
+			n = w->entrynum - index;
+		if (n > IOV_MAX)
+			n = IOV_MAX;
+		stopping = w->stop;
+
+		pthread_mutex_unlock(&w->lock);
+
+		if (w->paced)
+			n = file_writer_due(w, index, n, stopping);
+
+		if (w->chain > 1) {
+			n = file_writer_gather(w, index, n, &iovcnt);
+			iov = w->gather;
+		} else {
+			iovcnt = n;
+			iov = &w->iov[index];
+		}
+		for (i = 0, len = 0; i < iovcnt; i++)
+			len += iov[i].iov_len;
+
+		if (w->direct)
+			ret = file_writer_direct(w, iov, iovcnt);
+		else
+			ret = file_writer_writev(w->fd, iov, iovcnt);
+
+		pthread_mutex_lock(&w->lock);
+
+		if (ret < 0)
+			w->errors++;
+		w->bytes += len;
+		w->written += n;
+		pthread_cond_broadcast(&w->cond);
+	}
+
+	pthread_mutex_unlock(&w->lock);
+
+	if (w->direct && file_writer_direct_flush(w) < 0)
+		w->errors++;
+
+	return NULL;
+}
+
+/*
+ * public functions
+ */
+struct file_writer *file_writer_new(int fd, int entrynum, bool direct)
+{
+	struct file_writer *w;
+	int flags;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return NULL;
+
+	w->fd = fd;
+	w->entrynum = entrynum;
+	w->direct = direct;
+	w->chain = 1;
+
+	w->iov = calloc(entrynum, sizeof(*w->iov));
+	if (!w->iov)
+		goto error;
+
+	if (direct) {
+		if (posix_memalign(&w->stage, FILE_WRITER_DIRECT_ALIGN,
+					FILE_WRITER_STAGE_SIZE))
+			goto error;
+
+		flags = fcntl(fd, F_GETFL);
+		if (flags < 0 || fcntl(fd, F_SETFL, flags | O_DIRECT) < 0) {
+			perror("O_DIRECT");
+			goto error;
+		}
+	}
+
+	pthread_mutex_init(&w->lock, NULL);
+	pthread_cond_init(&w->cond, NULL);
+
+	if (pthread_create(&w->thread, NULL, file_writer_thread, w)) {
+		pthread_cond_destroy(&w->cond);
+		pthread_mutex_destroy(&w->lock);
+		goto error;
+	}
+
+	return w;
+
+error:
+	free(w->stage);
+	free(w->iov);
+	free(w);
+
+	return NULL;
+}
+
+/* write all of queued payloads and stop the thread */
+void file_writer_free(struct file_writer *w)
+{
+	if (!w)
+		return;
+
+	pthread_mutex_lock(&w->lock);
+	w->stop = true;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+
+	pthread_join(w->thread, NULL);
+
+	pthread_cond_destroy(&w->cond);
+	pthread_mutex_destroy(&w->lock);
+	free(w->release);
+	free(w->stage);
+	free(w->gather);
+	free(w->iovcnt);
+	free(w->iov);
+	free(w);
+}
+
+/* queue count iovecs following the ones queued before */
+void file_writer_queue(struct file_writer *w, int count)
+{
+	int inflight;
+
+	pthread_mutex_lock(&w->lock);
+	w->queued += count;
+	inflight = w->queued - w->written;
+	if (inflight > w->max_inflight)
+		w->max_inflight = inflight;
+	pthread_cond_broadcast(&w->cond);
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* number of frames queued but not written yet */
+int file_writer_inflight(struct file_writer *w)
+{
+	int inflight;
+
+	pthread_mutex_lock(&w->lock);
+	inflight = w->queued - w->written;
+	pthread_mutex_unlock(&w->lock);
+
+	return inflight;
+}
+
+/* wait for progress of the writer thread (timeout in msec) */
+void file_writer_wait(struct file_writer *w, int timeout)
+{
+	struct timespec ts;
+	uint64_t written;
+
+	clock_gettime(CLOCK_REALTIME, &ts);
+	ts.tv_sec += timeout / 1000;
+	ts.tv_nsec += (timeout % 1000) * 1000000;
+	if (ts.tv_nsec >= NSEC_SCALE) {
+		ts.tv_sec++;
+		ts.tv_nsec -= NSEC_SCALE;
+	}
+
+	pthread_mutex_lock(&w->lock);
+	written = w->written;
+	while (w->written == written && w->queued != w->written) {
+		if (pthread_cond_timedwait(&w->cond, &w->lock, &ts))
+			break;
+	}
+	pthread_mutex_unlock(&w->lock);
+}
+
+/* write each iovec at its release time, call before queueing */
+int file_writer_set_paced(struct file_writer *w, clockid_t clkid)
+{
+	w->release = calloc(w->entrynum, sizeof(*w->release));
+	if (!w->release)
+		return -1;
+
+	w->clkid = clkid;
+	w->offset = clock_getoffset(clkid, CLOCK_MONOTONIC);
+	w->offset_time = clock_getcount(CLOCK_MONOTONIC);
+	hdr_hist_reset(&w->release_error);
+	w->paced = true;
+
+	return 0;
+}
+
+/* write up to chain iovecs per ring position, call before queueing */
+int file_writer_set_chain(struct file_writer *w, int chain)
+{
+	struct iovec *iov;
+
+	if (chain < 1 || chain > IOV_MAX)
+		return -1;
+	if (chain == 1)
+		return 0;
+
+	iov = calloc(w->entrynum * chain, sizeof(*iov));
+	w->iovcnt = calloc(w->entrynum, sizeof(*w->iovcnt));
+	w->gather = calloc(IOV_MAX, sizeof(*w->gather));
+	if (!iov || !w->iovcnt || !w->gather) {
+		free(iov);
+		return -1;
+	}
+
+	free(w->iov);
+	w->iov = iov;
+	w->chain = chain;
+
+	return 0;
+}
+
+void file_writer_report(struct file_writer *w, char *buf, int buflen)
+{
+	int len;
+
+	pthread_mutex_lock(&w->lock);
+	len = snprintf(buf, buflen,
+		"writer %"PRIu64"bytes %"PRIu64"errors max inflight %d/%d frames%s",
+		w->bytes, w->errors, w->max_inflight, w->entrynum,
+		(w->direct) ? " (O_DIRECT)" : "");
+	if (w->paced && len < buflen)
+		snprintf(buf + len, buflen - len,
+			" release error p50/p99/max %"PRIu64"/%"PRIu64"/%"PRIu64"ns",
+			hdr_hist_percentile(&w->release_error, 50),
+			hdr_hist_percentile(&w->release_error, 99),
+			w->release_error.max);
+	pthread_mutex_unlock(&w->lock);
+}
@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __FILE_WRITER_H__
+#define __FILE_WRITER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include <sys/uio.h>
+
+#include "hdr_hist.h"
+
+/*
+ * Writer thread which writes the payloads in the DMA frames of an eavb
+ * ring in ring order. The frame of an iovec is released to the ring only
+ * after it is written, see file_writer_inflight(). With a chain, each ring
+ * position has up to chain iovecs, see file_writer_set_chain().
+ */
+struct file_writer {
+	int             fd;
+	int             entrynum;
+	struct iovec    *iov;      /* indexed by the ring position */
+	int             chain;     /* iovecs per ring position */
+	int             *iovcnt;   /* iovecs used, if chain > 1 */
+	struct iovec    *gather;   /* iovecs of the positions to write */
+
+	pthread_t       thread;
+	pthread_mutex_t lock;
+	pthread_cond_t  cond;
+	uint64_t        queued;    /* frames queued by the ring owner */
+	uint64_t        written;   /* frames written by the thread */
+	bool            stop;
+
+	/* paced release at the time of each frame (jitter buffer) */
+	bool            paced;
+	clockid_t       clkid;
+	uint64_t        *release;  /* ns on clkid, 0:immediately */
+	int64_t         offset;    /* clkid - CLOCK_MONOTONIC */
+	uint64_t        offset_time;
+	struct hdr_hist release_error;
+
+	/* O_DIRECT staging buffer */
+	bool            direct;
+	void            *stage;
+	size_t          stage_len;
+
+	/* statistics */
+	uint64_t        bytes;
+	uint64_t        errors;
+	int             max_inflight;
+};
+
+extern struct file_writer *file_writer_new(int fd, int entrynum, bool direct);
+extern void file_writer_free(struct file_writer *w);
+extern void file_writer_queue(struct file_writer *w, int count);
+extern int file_writer_inflight(struct file_writer *w);
+extern void file_writer_wait(struct file_writer *w, int timeout);
+extern void file_writer_report(struct file_writer *w, char *buf, int buflen);
+extern int file_writer_set_paced(struct file_writer *w, clockid_t clkid);
+extern int file_writer_set_chain(struct file_writer *w, int chain);
+
+static inline struct iovec *file_writer_iov(struct file_writer *w, int index)
+{
+	return &w->iov[index * w->chain];
+}
+
+/* number of iovecs of index to be written (0..chain), used with a chain */
+static inline void file_writer_set_iovcnt(struct file_writer *w, int index,
+					  int iovcnt)
+{
+	w->iovcnt[index] = iovcnt;
+}
+
+/* time to write the iovec of index, used in paced mode */
+static inline void file_writer_set_release(struct file_writer *w, int index,
+					   uint64_t t)
+{
+	w->release[index] = t;
+}
+
+#endif /* __FILE_WRITER_H__ */
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "h264_depay.h"
+
+/* RFC 6184 Table 1. NAL unit types in RTP payloads */
+#define H264_NAL_TYPE(x)   ((x) & 0x1f)
+#define H264_NAL_SINGLE    (23) /* 1-23 */
+#define H264_NAL_STAP_A    (24)
+#define H264_NAL_FU_A      (28)
+
+#define H264_FU_START      (0x80)
+#define H264_FU_END        (0x40)
+
+#define H264_STAP_SIZE_LEN (2)
+
+static uint8_t h264_start_code[] = { 0x00, 0x00, 0x00, 0x01 };
+
+static int h264_depay_nal(struct h264_depay *d, struct iovec *iov, int n,
+			  void *nal, size_t len, bool start)
+{
+	if (n + 2 > H264_DEPAY_IOV_MAX)
+		return -1;
+
+	if (start) {
+		iov[n].iov_base = h264_start_code;
+		iov[n].iov_len = sizeof(h264_start_code);
+		n++;
+		d->au_bytes += sizeof(h264_start_code);
+		d->au_nals++;
+	}
+	iov[n].iov_base = nal;
+	iov[n].iov_len = len;
+	d->au_bytes += len;
+
+	return n + 1;
+}
+
+/* a NAL unit starts before the end of the fragmented one */
+static void h264_depay_fu_abort(struct h264_depay *d)
+{
+	if (d->in_fu)
+		d->broken = true;
+	d->in_fu = false;
+}
+
+/* iovecs of the NAL units in a payload, -1 if not supported */
+static int h264_depay_payload(struct h264_depay *d, uint8_t *p, size_t len,
+			      struct iovec *iov)
+{
+	uint8_t fu;
+	size_t size;
+	int n = 0;
+
+	switch (H264_NAL_TYPE(p[0])) {
+	case 1 ... H264_NAL_SINGLE:
+		h264_depay_fu_abort(d);
+		return h264_depay_nal(d, iov, 0, p, len, true);
+
+	case H264_NAL_STAP_A:
+		h264_depay_fu_abort(d);
+		p++;
+		len--;
+		while (len >= H264_STAP_SIZE_LEN) {
+			size = (p[0] << 8) | p[1];
+			p += H264_STAP_SIZE_LEN;
+			len -= H264_STAP_SIZE_LEN;
+			if (!size || size > len)
+				return -1;
+			n = h264_depay_nal(d, iov, n, p, size, true);
+			if (n < 0)
+				return -1;
+			p += size;
+			len -= size;
+		}
+		return (len) ? -1 : n;
+
+	case H264_NAL_FU_A:
+		if (len < 3)
+			return -1;
+		fu = p[1];
+		if (!(fu & H264_FU_START)) {
+			/* the start fragment is lost */
+			if (!d->in_fu) {
+				d->broken = true;
+				return 0;
+			}
+			d->in_fu = !(fu & H264_FU_END);
+			return h264_depay_nal(d, iov, 0, p + 2, len - 2,
+						false);
+		}
+		h264_depay_fu_abort(d);
+		d->in_fu = !(fu & H264_FU_END);
+
+		/* the NAL header from the indicator and the FU header */
+		p[1] = (p[0] & 0xe0) | H264_NAL_TYPE(fu);
+		return h264_depay_nal(d, iov, 0, p + 1, len - 1, true);
+
+	default:
+		return -1;
+	}
+}
+
+static int h264_depay_end(struct h264_depay *d)
+{
+	bool broken = d->broken || d->in_fu;
+
+	if (broken) {
+		d->dropped++;
+	} else {
+		d->aus++;
+		d->bytes += d->au_bytes;
+		d->nals += d->au_nals;
+	}
+
+	d->busy = false;
+	d->in_fu = false;
+	d->broken = false;
+	d->au_bytes = 0;
+	d->au_nals = 0;
+
+	return (broken) ? H264_DEPAY_DROP : H264_DEPAY_COMPLETE;
+}
+
+/*
+ * public functions
+ */
+struct h264_depay *h264_depay_new(void)
+{
+	struct h264_depay *d;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return NULL;
+
+	d->seqno = -1;
+
+	return d;
+}
+
+void h264_depay_free(struct h264_depay *d)
+{
+	free(d);
+}
+
+/*
+ * Depacketize a packet of framelen bytes of the first H.264 stream to
+ * iov (up to H264_DEPAY_IOV_MAX), the access unit is written by the
+ * caller only if it is completed. A sequence gap drops the access unit.
+ */
+int h264_depay_process(struct h264_depay *d, void *packet, int framelen,
+		       struct iovec *iov, int *iovcnt)
+{
+	uint8_t streamid[AVTP_STREAMID_SIZE];
+	int seqno, len, n;
+
+	*iovcnt = 0;
+
+	if (framelen < AVTP_CVF_H264_PAYLOAD_OFFSET ||
+	    get_avtp_subtype(packet) != AVTP_SUBTYPE_CVF ||
+	    get_avtp_cvf_format(packet) != AVTP_CVF_FORMAT_RFC ||
+	    get_avtp_cvf_format_subtype(packet) != AVTP_CVF_FORMAT_SUBTYPE_H264)
+		return H264_DEPAY_SKIP;
+
+	get_avtp_stream_id(packet, streamid);
+	if (!d->has_stream) {
+		memcpy(d->StreamID, streamid, AVTP_STREAMID_SIZE);
+		d->has_stream = true;
+	} else if (memcmp(d->StreamID, streamid, AVTP_STREAMID_SIZE)) {
+		return H264_DEPAY_SKIP;
+	}
+
+	d->packets++;
+	d->busy = true;
+
+	seqno = get_avtp_sequence_num(packet);
+	if (d->seqno >= 0 && seqno != d->seqno) {
+		d->lost += (seqno - d->seqno) & AVTP_SEQUENCE_NUM_MAX;
+		d->broken = true;
+	}
+	d->seqno = (seqno + 1) % (AVTP_SEQUENCE_NUM_MAX + 1);
+
+	/* h264_timestamp precedes the NAL units, all in the frame */
+	len = get_avtp_stream_data_length(packet) -
+			(AVTP_CVF_H264_PAYLOAD_OFFSET - AVTP_PAYLOAD_OFFSET);
+	if (AVTP_CVF_H264_PAYLOAD_OFFSET + len > framelen)
+		len = -1;
+	n = (len > 0) ? h264_depay_payload(d, packet +
+			AVTP_CVF_H264_PAYLOAD_OFFSET, len, iov) : -1;
+	if (n < 0) {
+		d->errors++;
+		d->broken = true;
+		d->in_fu = false;
+	} else {
+		*iovcnt = n;
+	}
+
+	if (get_avtp_cvf_flags(packet) & AVTP_CVF_FLAG_M)
+		return h264_depay_end(d);
+
+	return H264_DEPAY_PENDING;
+}
+
+/* drop the access unit in progress */
+void h264_depay_drop(struct h264_depay *d)
+{
+	if (!d->busy)
+		return;
+
+	d->broken = true;
+	h264_depay_end(d);
+}
+
+int h264_depay_report(struct h264_depay *d, char *buf, int buflen)
+{
+	return snprintf(buf, buflen,
+		"h264 %"PRIu64"packets %"PRIu64"AUs %"PRIu64"NALs %"PRIu64"bytes dropped %"PRIu64"AUs lost %"PRIu64"packets %"PRIu64"errors",
+		d->packets, d->aus, d->nals, d->bytes,
+		d->dropped, d->lost, d->errors);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __H264_DEPAY_H__
+#define __H264_DEPAY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/uio.h>
+
+#include "avtp.h"
+
+/* iovecs of a packet, a start code and a NAL unit for each NAL */
+#define H264_DEPAY_IOV_MAX (32)
+
+enum H264_DEPAY_RESULT {
+	H264_DEPAY_SKIP,     /* not of the H.264 stream */
+	H264_DEPAY_PENDING,  /* part of the access unit in progress */
+	H264_DEPAY_COMPLETE, /* end of an access unit */
+	H264_DEPAY_DROP,     /* end of an incomplete access unit */
+};
+
+/*
+ * Depacketizer of IEEE1722 CVF H.264 (RFC 6184 non-interleaved mode).
+ * NAL units are written in Annex-B byte stream from the DMA frames, the
+ * iovecs point to the payloads and to a shared start code. The FU-A
+ * indicator is rewritten in the frame to the header of the NAL unit.
+ */
+struct h264_depay {
+	bool     has_stream;
+	uint8_t  StreamID[AVTP_STREAMID_SIZE];
+	int      seqno;     /* expected, -1:unknown */
+
+	/* access unit in progress */
+	bool     busy;
+	bool     in_fu;
+	bool     broken;
+	uint64_t au_bytes;
+	int      au_nals;
+
+	/* statistics */
+	uint64_t packets;
+	uint64_t aus;
+	uint64_t bytes;
+	uint64_t nals;
+	uint64_t dropped;   /* access units */
+	uint64_t lost;      /* packets */
+	uint64_t errors;    /* unsupported or malformed packets */
+};
+
+extern struct h264_depay *h264_depay_new(void);
+extern void h264_depay_free(struct h264_depay *d);
+extern int h264_depay_process(struct h264_depay *d, void *packet,
+			      int framelen, struct iovec *iov, int *iovcnt);
+extern void h264_depay_drop(struct h264_depay *d);
+extern int h264_depay_report(struct h264_depay *d, char *buf, int buflen);
+
+/* access unit in progress, its frames cannot be written yet */
+static inline bool h264_depay_busy(struct h264_depay *d)
+{
+	return d->busy;
+}
+
+#endif /* __H264_DEPAY_H__ */
@@ -0,0 +1,226 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#define _GNU_SOURCE /* MSG_CMSG_CLOEXEC */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include "handoff.h"
+
+struct handoff_hdr {
+	uint32_t type;
+	uint32_t fdmask;  /* slots of the fds passed */
+};
+
+/*
+ * Run path with argv and "option=FD" appended, FD being the end of a
+ * socket pair for the new process. The other end is set in sock.
+ */
+pid_t handoff_spawn(const char *path, char *const argv[], const char *option,
+		    int *sock)
+{
+	char arg[64];
+	char **args;
+	int sv[2];
+	pid_t pid;
+	int i, n;
+
+	if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0) {
+		perror("socketpair");
+		return -1;
+	}
+
+	for (n = 0; argv[n]; n++)
+		;
+	args = calloc(n + 2, sizeof(*args));
+	if (!args) {
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+	for (i = 0; i < n; i++)
+		args[i] = argv[i];
+	snprintf(arg, sizeof(arg), "%s=%d", option, sv[1]);
+	args[n] = arg;
+
+	pid = fork();
+	if (pid < 0) {
+		perror("fork");
+		free(args);
+		close(sv[0]);
+		close(sv[1]);
+		return -1;
+	}
+
+	if (!pid) {
+		/* only the end of the new process survives the exec */
+		if (fcntl(sv[1], F_SETFD, 0) < 0)
+			_exit(127);
+		execvp(path, args);
+		perror("execvp");
+		_exit(127);
+	}
+
+	free(args);
+	close(sv[1]);
+	*sock = sv[0];
+
+	return pid;
+}
+
+int handoff_send(int sock, uint32_t type, const void *buf, size_t len,
+		 const int *fds, int nfds)
+{
+	struct handoff_hdr hdr;
+	struct msghdr msg;
+	struct iovec iov[2];
+	struct cmsghdr *cmsg;
+	union {
+		char buf[CMSG_SPACE(HANDOFF_FDS_MAX * sizeof(int))];
+		struct cmsghdr align;
+	} u;
+	int pass[HANDOFF_FDS_MAX];
+	int i, n = 0;
+
+	if (nfds > HANDOFF_FDS_MAX)
+		return -1;
+
+	hdr.type = type;
+	hdr.fdmask = 0;
+	for (i = 0; i < nfds; i++) {
+		if (fds[i] < 0)
+			continue;
+		hdr.fdmask |= 1 << i;
+		pass[n++] = fds[i];
+	}
+
+	iov[0].iov_base = &hdr;
+	iov[0].iov_len = sizeof(hdr);
+	iov[1].iov_base = (void *)buf;
+	iov[1].iov_len = len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	if (n) {
+		msg.msg_control = u.buf;
+		msg.msg_controllen = CMSG_SPACE(n * sizeof(int));
+		cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(n * sizeof(int));
+		memcpy(CMSG_DATA(cmsg), pass, n * sizeof(int));
+	}
+
+	while (sendmsg(sock, &msg, MSG_NOSIGNAL) < 0) {
+		if (errno == EINTR)
+			continue;
+		perror("handoff: sendmsg");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Receive a message in timeout msec, -1 to wait for ever. Returns the
+ * bytes of the payload, -EAGAIN on timeout, -EPIPE when the other
+ * process has gone, or -errno.
+ */
+ssize_t handoff_recv(int sock, uint32_t *type, void *buf, size_t len,
+		     int *fds, int nfds, int timeout)
+{
+	struct handoff_hdr hdr;
+	struct pollfd pfd;
+	struct msghdr msg;
+	struct iovec iov[2];
+	struct cmsghdr *cmsg;
+	union {
+		char buf[CMSG_SPACE(HANDOFF_FDS_MAX * sizeof(int))];
+		struct cmsghdr align;
+	} u;
+	int pass[HANDOFF_FDS_MAX];
+	ssize_t ret;
+	int i, n = 0, npass = 0;
+
+	if (nfds > HANDOFF_FDS_MAX)
+		return -EINVAL;
+	for (i = 0; i < nfds; i++)
+		fds[i] = -1;
+
+	pfd.fd = sock;
+	pfd.events = POLLIN;
+	do {
+		ret = poll(&pfd, 1, timeout);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		return -errno;
+	if (!ret)
+		return -EAGAIN;
+
+	iov[0].iov_base = &hdr;
+	iov[0].iov_len = sizeof(hdr);
+	iov[1].iov_base = buf;
+	iov[1].iov_len = len;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = iov;
+	msg.msg_iovlen = 2;
+	msg.msg_control = u.buf;
+	msg.msg_controllen = sizeof(u.buf);
+
+	do {
+		ret = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	} while (ret < 0 && errno == EINTR);
+	if (ret < 0)
+		return -errno;
+	if (!ret)
+		return -EPIPE;
+
+	for (cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+		if (cmsg->cmsg_level != SOL_SOCKET ||
+		    cmsg->cmsg_type != SCM_RIGHTS)
+			continue;
+		npass = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		memcpy(pass, CMSG_DATA(cmsg), npass * sizeof(int));
+	}
+
+	if (ret < sizeof(hdr) || (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC))) {
+		fprintf(stderr, "handoff: message truncated\n");
+		ret = -EMSGSIZE;
+		goto error;
+	}
+
+	for (i = 0; i < nfds; i++) {
+		if (!(hdr.fdmask & (1 << i)))
+			continue;
+		if (n >= npass)
+			break;
+		fds[i] = pass[n++];
+	}
+	if (n != npass || (hdr.fdmask >> i)) {
+		fprintf(stderr, "handoff: unexpected fds\n");
+		ret = -EPROTO;
+		goto error;
+	}
+
+	*type = hdr.type;
+
+	return ret - sizeof(hdr);
+
+error:
+	for (i = 0; i < npass; i++)
+		close(pass[i]);
+	for (i = 0; i < nfds; i++)
+		fds[i] = -1;
+
+	return ret;
+}
@@ -0,0 +1,29 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __HANDOFF_H__
+#define __HANDOFF_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define HANDOFF_FDS_MAX (8)
+
+/*
+ * State of a running process handed over to a new one. The messages go
+ * over a SOCK_SEQPACKET pair, each one a type, a payload and up to
+ * HANDOFF_FDS_MAX fds passed by SCM_RIGHTS. A slot of fds set to -1 is
+ * not passed and received as -1.
+ */
+extern pid_t handoff_spawn(const char *path, char *const argv[],
+			   const char *option, int *sock);
+extern int handoff_send(int sock, uint32_t type, const void *buf, size_t len,
+			const int *fds, int nfds);
+extern ssize_t handoff_recv(int sock, uint32_t *type, void *buf, size_t len,
+			    int *fds, int nfds, int timeout);
+
+#endif /* __HANDOFF_H__ */
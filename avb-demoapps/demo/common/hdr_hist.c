@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <string.h>
+
+#include "hdr_hist.h"
+
+static inline int hdr_hist_index(uint64_t value)
+{
+	int shift;
+
+	if (value < HDR_HIST_SUB_BUCKETS)
+		return value;
+
+	/* keep HDR_HIST_SUB_BITS + 1 significant bits */
+	shift = 63 - __builtin_clzll(value) - HDR_HIST_SUB_BITS;
+
+	return shift * HDR_HIST_SUB_BUCKETS + (value >> shift);
+}
+
+/* the highest value which is counted in the bucket */
+static inline uint64_t hdr_hist_value(int index)
+{
+	int shift;
+
+	if (index < HDR_HIST_SUB_BUCKETS)
+		return index;
+
+	shift = index / HDR_HIST_SUB_BUCKETS - 1;
+	index = index % HDR_HIST_SUB_BUCKETS + HDR_HIST_SUB_BUCKETS;
+
+	return (((uint64_t)index + 1) << shift) - 1;
+}
+
+/*
+ * public functions
+ */
+void hdr_hist_reset(struct hdr_hist *h)
+{
+	memset(h, 0, sizeof(*h));
+}
+
+void hdr_hist_record(struct hdr_hist *h, uint64_t value)
+{
+	int index;
+
+	if (!h->count || value < h->min)
+		h->min = value;
+	if (value > h->max)
+		h->max = value;
+	h->count++;
+
+	index = hdr_hist_index(value);
+	if (index >= HDR_HIST_BUCKETS)
+		h->overflow++;
+	else
+		h->buckets[index]++;
+}
+
+void hdr_hist_merge(struct hdr_hist *to, const struct hdr_hist *from)
+{
+	int i;
+
+	if (!from->count)
+		return;
+
+	if (!to->count || from->min < to->min)
+		to->min = from->min;
+	if (from->max > to->max)
+		to->max = from->max;
+	to->count += from->count;
+	to->overflow += from->overflow;
+
+	for (i = 0; i < HDR_HIST_BUCKETS; i++)
+		to->buckets[i] += from->buckets[i];
+}
+
+/* value at the percentile p (0-100), bounded by the recorded maximum */
+uint64_t hdr_hist_percentile(const struct hdr_hist *h, double p)
+{
+	uint64_t target, sum = 0;
+	uint64_t value;
+	int i;
+
+	if (!h->count)
+		return 0;
+
+	target = (uint64_t)(h->count * p / 100);
+	if (target < 1)
+		target = 1;
+
+	for (i = 0; i < HDR_HIST_BUCKETS; i++) {
+		sum += h->buckets[i];
+		if (sum >= target) {
+			value = hdr_hist_value(i);
+			return (value < h->max) ? value : h->max;
+		}
+	}
+
+	return h->max;
+}
@@ -0,0 +1,37 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __HDR_HIST_H__
+#define __HDR_HIST_H__
+
+#include <stdint.h>
+
+/*
+ * High dynamic range histogram of nanosecond values.
+ * Each power of two range is split into HDR_HIST_SUB_BUCKETS linear
+ * buckets, which keeps the relative error under 1/HDR_HIST_SUB_BUCKETS
+ * from 1ns up to HDR_HIST_MAX_BITS (about 68 seconds).
+ */
+#define HDR_HIST_SUB_BITS    (5)
+#define HDR_HIST_SUB_BUCKETS (1 << HDR_HIST_SUB_BITS)
+#define HDR_HIST_MAX_BITS    (36)
+#define HDR_HIST_BUCKETS \
+	((HDR_HIST_MAX_BITS - HDR_HIST_SUB_BITS + 1) * HDR_HIST_SUB_BUCKETS)
+
+struct hdr_hist {
+	uint64_t count;
+	uint64_t min;
+	uint64_t max;
+	uint64_t overflow;
+	uint32_t buckets[HDR_HIST_BUCKETS];
+};
+
+extern void hdr_hist_reset(struct hdr_hist *h);
+extern void hdr_hist_record(struct hdr_hist *h, uint64_t value);
+extern void hdr_hist_merge(struct hdr_hist *to, const struct hdr_hist *from);
+extern uint64_t hdr_hist_percentile(const struct hdr_hist *h, double p);
+
+#endif /* __HDR_HIST_H__ */
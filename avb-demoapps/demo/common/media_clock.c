@@ -0,0 +1,262 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <inttypes.h>
+
+#include "media_clock.h"
+
+#define NSEC_SCALE (1000000000)
+
+/* locked after the phase error stays in LOCK_NS for LOCK_COUNT updates */
+#define MEDIA_CLOCK_LOCK_NS     (1000.0)
+#define MEDIA_CLOCK_LOCK_COUNT  (64)
+#define MEDIA_CLOCK_UNLOCK_NS   (10000.0)
+/* restart the loop on a timestamp discontinuity */
+#define MEDIA_CLOCK_RESET_NS    (1000000.0)
+
+static void media_clock_start(struct media_clock *mc, uint32_t timestamp,
+			      double nominal)
+{
+	mc->start = true;
+	mc->anchor = timestamp;
+	mc->time = 0;
+	mc->period = NSEC_SCALE / nominal;
+	mc->lock_count = 0;
+
+	mc->status.locked = false;
+	mc->status.nominal = nominal;
+	mc->status.rate = nominal;
+	mc->status.ratio = 1.0;
+	mc->status.phase_error = 0;
+}
+
+/* nominal rate of an AAF or CRF stream, 0 if unknown */
+static double media_clock_nominal(void *packet)
+{
+	uint32_t pbf;
+	double base;
+	static const double pull[] = {
+		[AVTP_CRF_PULL_1_0]    = 1.0,
+		[AVTP_CRF_PULL_1_1001] = 1.0 / 1.001,
+		[AVTP_CRF_PULL_1001]   = 1.001,
+		[AVTP_CRF_PULL_24_25]  = 24.0 / 25.0,
+		[AVTP_CRF_PULL_25_24]  = 25.0 / 24.0,
+		[AVTP_CRF_PULL_1_8]    = 1.0 / 8.0,
+	};
+
+	switch (get_avtp_subtype(packet)) {
+	case AVTP_SUBTYPE_AAF:
+		return avtp_aaf_nsr_rate(get_avtp_aaf_nsr(packet));
+	case AVTP_SUBTYPE_CRF:
+		pbf = get_avtp_crf_pull_base_frequency(packet);
+		base = pbf & AVTP_CRF_BASE_FREQUENCY_MAX;
+		if ((pbf >> AVTP_CRF_PULL_SHIFT) > AVTP_CRF_PULL_MAX)
+			return 0;
+		return base * pull[pbf >> AVTP_CRF_PULL_SHIFT];
+	default:
+		return 0;
+	}
+}
+
+/*
+ * public functions
+ */
+struct media_clock *media_clock_new(double bandwidth)
+{
+	struct media_clock *mc;
+
+	if (bandwidth <= 0)
+		return NULL;
+
+	mc = calloc(1, sizeof(*mc));
+	if (!mc)
+		return NULL;
+
+	mc->bandwidth = bandwidth;
+	mc->seqno = -1;
+
+	return mc;
+}
+
+void media_clock_free(struct media_clock *mc)
+{
+	free(mc);
+}
+
+void media_clock_reset(struct media_clock *mc)
+{
+	if (mc->start)
+		mc->status.resets++;
+	mc->start = false;
+	mc->pending = 0;
+	mc->seqno = -1;
+}
+
+/*
+ * feed a timestamp which is events of the media clock after the
+ * previous one, nominal is the nominal rate of the media clock in Hz
+ */
+void media_clock_update(struct media_clock *mc, uint32_t timestamp,
+			uint32_t events, double nominal)
+{
+	struct media_clock_status *st = &mc->status;
+	double predict, error, omega, b, c;
+	int64_t elapsed;
+
+	if (nominal <= 0)
+		return;
+
+	if (!mc->start || nominal != st->nominal) {
+		media_clock_start(mc, timestamp, nominal);
+		return;
+	}
+
+	/* events are unknown (lost frames), restart from the timestamp */
+	if (!events) {
+		mc->anchor = timestamp;
+		mc->time = 0;
+		return;
+	}
+
+	/* extend 32bit avtp_timestamp from the last one */
+	elapsed = (int32_t)(timestamp - (uint32_t)mc->anchor);
+
+	predict = mc->time + mc->period * events;
+	error = elapsed - predict;
+
+	if (fabs(error) > MEDIA_CLOCK_RESET_NS) {
+		st->resets++;
+		if (st->locked)
+			st->unlocks++;
+		media_clock_start(mc, timestamp, nominal);
+		return;
+	}
+
+	/* loop coefficients for the time between the updates */
+	omega = 2 * M_PI * mc->bandwidth * events / nominal;
+	b = M_SQRT2 * omega;
+	c = omega * omega;
+
+	mc->time = predict + b * error - elapsed;
+	mc->period += c * error / events;
+	mc->anchor += elapsed;
+
+	st->updates++;
+	st->phase_error = error;
+	st->rate = NSEC_SCALE / mc->period;
+	st->ratio = st->rate / nominal;
+
+	if (fabs(error) < MEDIA_CLOCK_LOCK_NS) {
+		if (!st->locked && ++mc->lock_count >= MEDIA_CLOCK_LOCK_COUNT) {
+			st->locked = true;
+			st->phase_error_max = 0;
+		}
+	} else {
+		mc->lock_count = 0;
+		if (st->locked && fabs(error) > MEDIA_CLOCK_UNLOCK_NS) {
+			st->locked = false;
+			st->unlocks++;
+		}
+	}
+
+	if (st->locked && fabs(error) > st->phase_error_max)
+		st->phase_error_max = fabs(error);
+}
+
+/*
+ * feed an AAF or CRF frame of len bytes, the loop follows the first
+ * stream seen
+ * return 1 if the loop is updated
+ */
+int media_clock_process(struct media_clock *mc, void *packet, int len)
+{
+	uint8_t streamid[AVTP_STREAMID_SIZE];
+	double nominal;
+	uint32_t events, interval;
+	int i, n, size, channels, seqno, dlen;
+	bool gap;
+
+	/* the CRF header is the shorter one */
+	if (len < AVTP_CRF_PAYLOAD_OFFSET)
+		return 0;
+
+	nominal = media_clock_nominal(packet);
+	if (!nominal)
+		return 0;
+
+	get_avtp_stream_id(packet, streamid);
+	if (!mc->has_stream) {
+		memcpy(mc->StreamID, streamid, AVTP_STREAMID_SIZE);
+		mc->has_stream = true;
+	} else if (memcmp(mc->StreamID, streamid, AVTP_STREAMID_SIZE)) {
+		return 0;
+	}
+
+	/* the events of lost frames are unknown */
+	seqno = get_avtp_sequence_num(packet);
+	gap = (mc->seqno >= 0 && seqno != mc->seqno);
+	mc->seqno = (seqno + 1) % (AVTP_SEQUENCE_NUM_MAX + 1);
+
+	if (get_avtp_subtype(packet) == AVTP_SUBTYPE_CRF) {
+		/* every timestamp is interval events after the previous */
+		interval = get_avtp_crf_timestamp_interval(packet);
+		dlen = get_avtp_crf_data_length(packet);
+		if (dlen > len - AVTP_CRF_PAYLOAD_OFFSET)
+			dlen = len - AVTP_CRF_PAYLOAD_OFFSET;
+		n = dlen / AVTP_CRF_TIMESTAMP_SIZE;
+		for (i = 0; i < n; i++)
+			media_clock_update(mc,
+				(uint32_t)get_avtp_crf_timestamp(packet, i),
+				(i || !gap) ? interval : 0, nominal);
+		return n > 0;
+	}
+
+	/* AAF: timestamp of the first sample, events of the last frame */
+	if (len < AVTP_AAF_PAYLOAD_OFFSET)
+		return 0;
+	size = avtp_aaf_sample_size(get_avtp_aaf_format(packet));
+	channels = get_avtp_aaf_channels_per_frame(packet);
+	if (!size || !channels)
+		return 0;
+
+	events = (gap) ? 0 : mc->pending;
+	dlen = get_avtp_stream_data_length(packet);
+	if (dlen > len - AVTP_AAF_PAYLOAD_OFFSET)
+		dlen = len - AVTP_AAF_PAYLOAD_OFFSET;
+	mc->pending = dlen / (size * channels);
+
+	/* sparse mode or no timestamp, count the samples only */
+	if (!(get_avtp_stream_flags(packet) & AVTP_STREAM_FLAG_TV)) {
+		mc->pending = (gap) ? 0 : mc->pending + events;
+		return 0;
+	}
+
+	media_clock_update(mc, get_avtp_timestamp(packet), events, nominal);
+
+	return 1;
+}
+
+void media_clock_get(struct media_clock *mc,
+		     struct media_clock_status *status)
+{
+	*status = mc->status;
+}
+
+int media_clock_report(struct media_clock *mc, char *buf, int buflen)
+{
+	struct media_clock_status *st = &mc->status;
+
+	return snprintf(buf, buflen,
+		"\nmedia clock %s %.3fHz (nominal %.0fHz ratio %.9f) phase error %.0fns (max %.0fns) %"PRIu64"updates %"PRIu64"unlocks %"PRIu64"resets",
+		(st->locked) ? "locked" : "unlocked",
+		st->rate, st->nominal, st->ratio,
+		st->phase_error, st->phase_error_max,
+		st->updates, st->unlocks, st->resets);
+}
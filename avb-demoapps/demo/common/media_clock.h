@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __MEDIA_CLOCK_H__
+#define __MEDIA_CLOCK_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "avtp.h"
+
+/*
+ * Media clock recovery by a second order DLL over avtp_timestamp.
+ *
+ * avtp_timestamp is gPTP time, so the recovered period of the media
+ * clock events (audio samples, CRF events) gives the media clock rate
+ * against gPTP. The phase error is the difference between the received
+ * timestamp and the timestamp predicted by the loop.
+ */
+struct media_clock_status {
+	bool     locked;
+	double   rate;        /* Hz of the recovered media clock */
+	double   nominal;     /* Hz of the nominal media clock */
+	double   ratio;       /* rate / nominal */
+	double   phase_error; /* ns, last update */
+	double   phase_error_max; /* ns, absolute value while locked */
+	uint64_t updates;
+	uint64_t unlocks;
+	uint64_t resets;
+};
+
+struct media_clock {
+	double   bandwidth;   /* Hz of the loop */
+
+	/* stream followed by the loop */
+	bool     has_stream;
+	uint8_t  StreamID[AVTP_STREAMID_SIZE];
+	uint32_t pending;     /* events since the last timestamp */
+	int      seqno;       /* next sequence_num, -1:unknown */
+
+	/* loop state */
+	bool     start;
+	uint64_t anchor;      /* ns, last timestamp extended to 64bit */
+	double   time;        /* ns, filtered time relative to anchor */
+	double   period;      /* ns per event */
+	int      lock_count;
+
+	struct media_clock_status status;
+};
+
+extern struct media_clock *media_clock_new(double bandwidth);
+extern void media_clock_free(struct media_clock *mc);
+extern void media_clock_reset(struct media_clock *mc);
+extern void media_clock_update(struct media_clock *mc, uint32_t timestamp,
+			       uint32_t events, double nominal);
+extern int media_clock_process(struct media_clock *mc, void *packet,
+			       int len);
+extern void media_clock_get(struct media_clock *mc,
+			    struct media_clock_status *status);
+extern int media_clock_report(struct media_clock *mc, char *buf, int buflen);
+
+#endif /* __MEDIA_CLOCK_H__ */
@@ -0,0 +1,337 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <inttypes.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+#include "mixer.h"
+
+#define NSEC_SCALE (1000000000)
+
+static uint64_t mixer_cpu_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+
+	return (uint64_t)ts.tv_sec * NSEC_SCALE + ts.tv_nsec;
+}
+
+static inline int16_t mixer_sat16(int32_t v)
+{
+	return (v > INT16_MAX) ? INT16_MAX : (v < INT16_MIN) ? INT16_MIN : v;
+}
+
+/*
+ * acc[i] = saturate(acc[i] + round(src[i] * gain / 32768))
+ */
+static void mixer_accumulate(int16_t *acc, const int16_t *src, int16_t gain,
+			     int n)
+{
+	int i = 0;
+
+#if defined(__SSE2__)
+	__m128i g = _mm_set1_epi16(gain);
+	__m128i round = _mm_set1_epi32(1 << 14);
+	__m128i a, s, lo, hi, p0, p1;
+
+	for (; i + 8 <= n; i += 8) {
+		s = _mm_loadu_si128((const __m128i *)(src + i));
+		a = _mm_loadu_si128((const __m128i *)(acc + i));
+
+		/* 32bit products, rounded and saturated to Q15 */
+		lo = _mm_mullo_epi16(s, g);
+		hi = _mm_mulhi_epi16(s, g);
+		p0 = _mm_srai_epi32(_mm_add_epi32(
+				_mm_unpacklo_epi16(lo, hi), round), 15);
+		p1 = _mm_srai_epi32(_mm_add_epi32(
+				_mm_unpackhi_epi16(lo, hi), round), 15);
+
+		a = _mm_adds_epi16(a, _mm_packs_epi32(p0, p1));
+		_mm_storeu_si128((__m128i *)(acc + i), a);
+	}
+#elif defined(__ARM_NEON)
+	int16x8_t g = vdupq_n_s16(gain);
+
+	for (; i + 8 <= n; i += 8)
+		vst1q_s16(acc + i, vqaddq_s16(vld1q_s16(acc + i),
+				vqrdmulhq_s16(vld1q_s16(src + i), g)));
+#endif
+
+	for (; i < n; i++)
+		acc[i] = mixer_sat16(acc[i] +
+				((src[i] * gain + (1 << 14)) >> 15));
+}
+
+static int16_t mixer_gain_q15(double db)
+{
+	double g = pow(10, db / 20);
+
+	/* Q15 cannot express the unity gain exactly */
+	return (g >= 1.0) ? INT16_MAX : (int16_t)lrint(g * 32768);
+}
+
+static struct mixer_stream *mixer_lookup(struct mixer *m, uint8_t streamid[])
+{
+	struct mixer_stream *st;
+	int i;
+
+	for (i = 0, st = m->streams; i < m->nstreams; i++, st++)
+		if (!memcmp(st->StreamID, streamid, AVTP_STREAMID_SIZE))
+			return st;
+
+	if (m->nstreams == MIXER_STREAM_MAX)
+		return NULL;
+
+	st = &m->streams[m->nstreams++];
+	memcpy(st->StreamID, streamid, AVTP_STREAMID_SIZE);
+	st->gain_db = 0;
+	st->gain = mixer_gain_q15(0);
+
+	return st;
+}
+
+/* AAF samples to host 16bit, mapped to the mixer channels */
+static int mixer_from_aaf(struct mixer *m, void *packet, int frames,
+			  int channels, int size)
+{
+	uint8_t *p = packet + AVTP_PAYLOAD_OFFSET;
+	int16_t *dst = m->work;
+	int format = get_avtp_aaf_format(packet);
+	int i, ch;
+	union {
+		uint32_t u;
+		float f;
+	} v;
+
+	for (i = 0; i < frames; i++) {
+		for (ch = 0; ch < channels; ch++, p += size) {
+			if (ch >= m->channels)
+				continue;
+			if (format == AVTP_AAF_FORMAT_FLOAT_32BIT) {
+				v.u = ((uint32_t)p[0] << 24) | (p[1] << 16) |
+					(p[2] << 8) | p[3];
+				dst[ch] = mixer_sat16(lrintf(v.f * 32768));
+			} else {
+				/* integer formats, the upper 16bit */
+				dst[ch] = (int16_t)((p[0] << 8) | p[1]);
+			}
+		}
+		for (; ch < m->channels; ch++)
+			dst[ch] = 0;
+		dst += m->channels;
+	}
+
+	return frames;
+}
+
+/*
+ * public functions
+ */
+struct mixer *mixer_new(int channels)
+{
+	struct mixer *m;
+
+	if (channels < 1 || channels > MIXER_CHANNELS_MAX)
+		return NULL;
+
+	m = calloc(1, sizeof(*m));
+	if (!m)
+		return NULL;
+
+	m->channels = channels;
+	m->acc = calloc(MIXER_FRAMES * channels, sizeof(*m->acc));
+	m->work = calloc(MIXER_FRAMES * channels, sizeof(*m->work));
+	if (!m->acc || !m->work) {
+		mixer_free(m);
+		return NULL;
+	}
+
+	return m;
+}
+
+void mixer_free(struct mixer *m)
+{
+	if (!m)
+		return;
+
+	free(m->work);
+	free(m->acc);
+	free(m);
+}
+
+/* gain of the stream in dB, 0dB and below */
+int mixer_set_gain(struct mixer *m, uint8_t streamid[], double db)
+{
+	struct mixer_stream *st;
+
+	st = mixer_lookup(m, streamid);
+	if (!st)
+		return -1;
+
+	st->gain_db = db;
+	st->gain = mixer_gain_q15(db);
+
+	return 0;
+}
+
+/*
+ * mix an AAF PDU of len bytes at its presentation time,
+ * now is gPTP time
+ */
+int mixer_add(struct mixer *m, void *packet, int len, uint64_t now)
+{
+	struct mixer_stream *st;
+	uint8_t streamid[AVTP_STREAMID_SIZE];
+	uint32_t rate;
+	int64_t pos;
+	int size, channels, frames, dlen, index, n;
+	uint64_t t, ts;
+
+	if (len < AVTP_AAF_PAYLOAD_OFFSET ||
+	    get_avtp_subtype(packet) != AVTP_SUBTYPE_AAF ||
+	    !(get_avtp_stream_flags(packet) & AVTP_STREAM_FLAG_TV))
+		return 0;
+
+	get_avtp_stream_id(packet, streamid);
+	st = mixer_lookup(m, streamid);
+	if (!st)
+		return -1;
+
+	st->active = true;
+	st->packets++;
+
+	rate = avtp_aaf_nsr_rate(get_avtp_aaf_nsr(packet));
+	size = avtp_aaf_sample_size(get_avtp_aaf_format(packet));
+	channels = get_avtp_aaf_channels_per_frame(packet);
+	if (!rate || !size || !channels || (m->rate && rate != m->rate)) {
+		st->errors++;
+		return -1;
+	}
+
+	if (!m->start) {
+		m->start = true;
+		m->rate = rate;
+		m->period = (double)NSEC_SCALE / rate;
+		m->t0 = now;
+		m->released = 0;
+	}
+
+	t = mixer_cpu_time();
+
+	/* extend 32bit avtp_timestamp around now */
+	ts = now + (int32_t)(get_avtp_timestamp(packet) - (uint32_t)now);
+	pos = llround(((int64_t)(ts - m->t0)) / m->period);
+
+	dlen = get_avtp_stream_data_length(packet);
+	if (dlen > len - AVTP_AAF_PAYLOAD_OFFSET)
+		dlen = len - AVTP_AAF_PAYLOAD_OFFSET;
+	frames = dlen / (size * channels);
+	if (frames > MIXER_FRAMES)
+		frames = MIXER_FRAMES;
+
+	if (pos < (int64_t)m->released) {
+		st->late++;
+		return -1;
+	}
+	if (pos + frames > (int64_t)(m->released + MIXER_FRAMES)) {
+		st->early++;
+		return -1;
+	}
+
+	mixer_from_aaf(m, packet, frames, channels, size);
+
+	/* the timeline is a ring, split at the end */
+	index = pos % MIXER_FRAMES;
+	n = MIXER_FRAMES - index;
+	if (n > frames)
+		n = frames;
+	mixer_accumulate(m->acc + index * m->channels, m->work, st->gain,
+			n * m->channels);
+	if (n < frames)
+		mixer_accumulate(m->acc, m->work + n * m->channels, st->gain,
+				(frames - n) * m->channels);
+
+	m->samples += frames * channels;
+	m->cpu_time += mixer_cpu_time() - t;
+
+	return 0;
+}
+
+/* move the frames presented by now to out, return the number of frames */
+int mixer_release(struct mixer *m, uint64_t now, int16_t *out, int frames)
+{
+	uint64_t end;
+	int index, n, total = 0;
+
+	if (!m->start || now < m->t0)
+		return 0;
+
+	end = (uint64_t)((now - m->t0) / m->period);
+	if (end <= m->released)
+		return 0;
+	if (end - m->released < frames)
+		frames = end - m->released;
+
+	while (total < frames) {
+		index = m->released % MIXER_FRAMES;
+		n = MIXER_FRAMES - index;
+		if (n > frames - total)
+			n = frames - total;
+
+		memcpy(out + total * m->channels,
+			m->acc + index * m->channels,
+			n * m->channels * sizeof(*m->acc));
+		memset(m->acc + index * m->channels, 0,
+			n * m->channels * sizeof(*m->acc));
+
+		m->released += n;
+		total += n;
+	}
+
+	m->frames += total;
+
+	return total;
+}
+
+int mixer_report(struct mixer *m, char *buf, int buflen)
+{
+	struct mixer_stream *st;
+	int i, len;
+	double channels = 0;
+
+	/* input channels which one core can mix in real time */
+	if (m->cpu_time && m->rate)
+		channels = (double)m->samples * NSEC_SCALE / m->cpu_time /
+				m->rate;
+
+	len = snprintf(buf, buflen,
+		"mixer %dch %uHz %"PRIu64"frames %d streams, %.1f input channels per core",
+		m->channels, m->rate, m->frames, m->nstreams, channels);
+
+	for (i = 0, st = m->streams; i < m->nstreams && len < buflen;
+							i++, st++)
+		len += snprintf(buf + len, buflen - len,
+			"\n  %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x %.1fdB %"PRIu64"packets %"PRIu64"late %"PRIu64"early %"PRIu64"errors%s",
+			st->StreamID[0], st->StreamID[1],
+			st->StreamID[2], st->StreamID[3],
+			st->StreamID[4], st->StreamID[5],
+			st->StreamID[6], st->StreamID[7],
+			st->gain_db, st->packets, st->late, st->early,
+			st->errors, (st->active) ? "" : " (not received)");
+
+	return len;
+}
@@ -0,0 +1,64 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __MIXER_H__
+#define __MIXER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "avtp.h"
+
+#define MIXER_STREAM_MAX   (16)
+#define MIXER_CHANNELS_MAX (64)
+#define MIXER_FRAMES       (8192) /* frames of the mix timeline */
+
+struct mixer_stream {
+	uint8_t  StreamID[AVTP_STREAMID_SIZE];
+	double   gain_db;
+	int16_t  gain;      /* Q15 */
+	bool     active;    /* received */
+	uint64_t packets;
+	uint64_t late;      /* before the released position */
+	uint64_t early;     /* beyond the timeline */
+	uint64_t errors;    /* format mismatch */
+};
+
+/*
+ * Mix of AAF streams aligned on the presentation time.
+ * Frame k of the timeline is presented at t0 + k / rate on gPTP, the
+ * mix is 16bit with saturation and released when its time is reached.
+ */
+struct mixer {
+	int      channels;
+	uint32_t rate;      /* Hz, from the first stream */
+	double   period;    /* ns per frame */
+
+	int16_t  *acc;      /* MIXER_FRAMES * channels, ring */
+	int16_t  *work;     /* one PDU in 16bit */
+
+	bool     start;
+	uint64_t t0;        /* gPTP time of frame 0 */
+	uint64_t released;  /* next frame to release */
+
+	int      nstreams;
+	struct mixer_stream streams[MIXER_STREAM_MAX];
+
+	/* statistics */
+	uint64_t frames;    /* released */
+	uint64_t samples;   /* mixed */
+	uint64_t cpu_time;  /* nsec */
+};
+
+extern struct mixer *mixer_new(int channels);
+extern void mixer_free(struct mixer *m);
+extern int mixer_set_gain(struct mixer *m, uint8_t streamid[], double db);
+extern int mixer_add(struct mixer *m, void *packet, int len, uint64_t now);
+extern int mixer_release(struct mixer *m, uint64_t now, int16_t *out,
+			 int frames);
+extern int mixer_report(struct mixer *m, char *buf, int buflen);
+
+#endif /* __MIXER_H__ */
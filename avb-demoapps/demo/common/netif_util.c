@@ -11,7 +11,12 @@
 #include <string.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
 #include <net/if.h>
+#include <netpacket/packet.h>
 #include <linux/ethtool.h>
 #include <linux/sockios.h>
 #include <linux/if_ether.h>
@@ -106,3 +111,175 @@ int netif_getlinkspeed(const char *ifname, int *speed)
 }
 
 
+
+/*
+ * AVTP frames of ifname which are not received by the rx queues of the
+ * separation filter, from the AVTP header (SOCK_DGRAM).
+ */
+int netif_open_avtp(const char *ifname)
+{
+	struct sockaddr_ll sll;
+	struct packet_mreq mreq;
+	int fd;
+
+	fd = socket(AF_PACKET, SOCK_DGRAM, htons(ETH_P_1722));
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	memset(&sll, 0, sizeof(sll));
+	sll.sll_family = AF_PACKET;
+	sll.sll_protocol = htons(ETH_P_1722);
+	sll.sll_ifindex = if_nametoindex(ifname);
+	if (!sll.sll_ifindex || bind(fd, (struct sockaddr *)&sll,
+					sizeof(sll)) < 0) {
+		perror("bind");
+		goto error;
+	}
+
+	/* streams are sent to multicast addresses */
+	memset(&mreq, 0, sizeof(mreq));
+	mreq.mr_ifindex = sll.sll_ifindex;
+	mreq.mr_type = PACKET_MR_ALLMULTI;
+	if (setsockopt(fd, SOL_PACKET, PACKET_ADD_MEMBERSHIP,
+				&mreq, sizeof(mreq)) < 0) {
+		perror("PACKET_ADD_MEMBERSHIP");
+		goto error;
+	}
+
+	return fd;
+
+error:
+	close(fd);
+
+	return -1;
+}
+
+/*
+ * parse HOST[:PORT], [HOST][:PORT] of IPv6 or PORT of any address,
+ * the port defaults to defport
+ */
+int netif_parse_udp(const char *str, int defport,
+		    struct sockaddr_storage *addr, socklen_t *addrlen)
+{
+	struct addrinfo hints, *res;
+	char host[256] = "0.0.0.0";
+	char port[16];
+	const char *p, *end;
+	int ret;
+
+	snprintf(port, sizeof(port), "%d", defport);
+
+	if (str[0] && strspn(str, "0123456789") == strlen(str)) {
+		snprintf(port, sizeof(port), "%s", str);
+	} else if (str[0] == '[') {
+		end = strchr(str, ']');
+		if (!end || end - str - 1 >= sizeof(host))
+			return -1;
+		memcpy(host, str + 1, end - str - 1);
+		host[end - str - 1] = '\0';
+		if (end[1] == ':')
+			snprintf(port, sizeof(port), "%s", end + 2);
+		else if (end[1])
+			return -1;
+	} else {
+		p = strrchr(str, ':');
+		if (!p)
+			p = str + strlen(str);
+		else
+			snprintf(port, sizeof(port), "%s", p + 1);
+		if (p - str >= sizeof(host))
+			return -1;
+		memcpy(host, str, p - str);
+		host[p - str] = '\0';
+	}
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_DGRAM;
+
+	ret = getaddrinfo(host, port, &hints, &res);
+	if (ret) {
+		fprintf(stderr, "netif: %s: %s\n", str, gai_strerror(ret));
+		return -1;
+	}
+
+	memcpy(addr, res->ai_addr, res->ai_addrlen);
+	*addrlen = res->ai_addrlen;
+	freeaddrinfo(res);
+
+	return 0;
+}
+
+/* UDP socket sending to addr, or receiving at addr joining its group */
+int netif_open_udp(const struct sockaddr_storage *addr, socklen_t addrlen,
+		   bool rx)
+{
+	const struct sockaddr_in *sin = (const struct sockaddr_in *)addr;
+	const struct sockaddr_in6 *sin6 = (const struct sockaddr_in6 *)addr;
+	int fd, on = 1, size = 4 << 20;
+
+	fd = socket(addr->ss_family, SOCK_DGRAM, 0);
+	if (fd < 0) {
+		perror("socket");
+		return -1;
+	}
+
+	/* room for the bursts of batched datagrams */
+	setsockopt(fd, SOL_SOCKET, (rx) ? SO_RCVBUF : SO_SNDBUF,
+			&size, sizeof(size));
+
+	/* let multicast streams cross routers */
+	if (!rx) {
+		int hops = 16;
+
+		if (addr->ss_family == AF_INET &&
+		    IN_MULTICAST(ntohl(sin->sin_addr.s_addr)))
+			setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL,
+					&hops, sizeof(hops));
+		else if (addr->ss_family == AF_INET6 &&
+			 IN6_IS_ADDR_MULTICAST(&sin6->sin6_addr))
+			setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS,
+					&hops, sizeof(hops));
+		return fd;
+	}
+
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+	if (bind(fd, (const struct sockaddr *)addr, addrlen) < 0) {
+		perror("bind");
+		goto error;
+	}
+
+	if (addr->ss_family == AF_INET &&
+	    IN_MULTICAST(ntohl(sin->sin_addr.s_addr))) {
+		struct ip_mreq mreq;
+
+		memset(&mreq, 0, sizeof(mreq));
+		mreq.imr_multiaddr = sin->sin_addr;
+		mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+		if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP,
+					&mreq, sizeof(mreq)) < 0) {
+			perror("IP_ADD_MEMBERSHIP");
+			goto error;
+		}
+	} else if (addr->ss_family == AF_INET6 &&
+		   IN6_IS_ADDR_MULTICAST(&sin6->sin6_addr)) {
+		struct ipv6_mreq mreq;
+
+		memset(&mreq, 0, sizeof(mreq));
+		mreq.ipv6mr_multiaddr = sin6->sin6_addr;
+		if (setsockopt(fd, IPPROTO_IPV6, IPV6_JOIN_GROUP,
+					&mreq, sizeof(mreq)) < 0) {
+			perror("IPV6_JOIN_GROUP");
+			goto error;
+		}
+	}
+
+	return fd;
+
+error:
+	close(fd);
+
+	return -1;
+}
@@ -7,8 +7,16 @@
 #ifndef __NETIF_UTIL_H__
 #define __NETIF_UTIL_H__
 
+#include <stdbool.h>
+#include <sys/socket.h>
+
 extern int netif_detect(char *ifname);
 extern int netif_gethwaddr(const char *ifname, unsigned char *hwaddr);
 extern int netif_getlinkspeed(const char *ifname, int *speed);
+extern int netif_open_avtp(const char *ifname);
+extern int netif_parse_udp(const char *str, int defport,
+			   struct sockaddr_storage *addr, socklen_t *addrlen);
+extern int netif_open_udp(const struct sockaddr_storage *addr,
+			  socklen_t addrlen, bool rx);
 
 #endif /* __NETIF_UTIL_H__ */
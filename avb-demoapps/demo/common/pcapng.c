@@ -0,0 +1,837 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <limits.h>
+#include <inttypes.h>
+#include <byteswap.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/if_ether.h>
+
+#include "pcapng.h"
+#include "clock.h"
+
+#define NSEC_SCALE (1000000000)
+
+/* frames of the late queues arrive in this time */
+#define PCAPNG_HOLD_NS     (20000000)
+#define PCAPNG_IDLE_NS     (1000000)
+
+/* pcapng block types and options */
+#define PCAPNG_BT_SHB      (0x0a0d0d0a)
+#define PCAPNG_BT_IDB      (0x00000001)
+#define PCAPNG_BT_EPB      (0x00000006)
+#define PCAPNG_BT_EPB_SIZE (sizeof(struct pcapng_epb) + sizeof(uint32_t))
+#define PCAPNG_BYTE_ORDER  (0x1a2b3c4d)
+#define PCAPNG_LINKTYPE_ETHERNET (1)
+#define PCAPNG_OPT_END     (0)
+#define PCAPNG_OPT_IF_NAME (2)
+#define PCAPNG_OPT_IF_TSRESOL (9)
+
+#define PCAPNG_PAD4(x)     (((x) + 3) & ~3)
+
+/* pcap file header */
+#define PCAP_MAGIC_USEC    (0xa1b2c3d4)
+#define PCAP_MAGIC_NSEC    (0xa1b23c4d)
+#define PCAP_MAGIC_USEC_SW (0xd4c3b2a1)
+#define PCAP_MAGIC_NSEC_SW (0x4d3cb2a1)
+#define PCAP_TSRESOL_USEC  (6)
+#define PCAP_TSRESOL_BAD   (0xff) /* frames of the interface are skipped */
+#define PCAP_FRAME_MAX     (262144)
+
+/* records checked in a row to find a record boundary */
+#define PCAP_SYNC_RECORDS  (8)
+#define PCAP_SYNC_SLACK    (60) /* sec before the first record */
+
+struct pcap_file_hdr {
+	uint32_t magic;
+	uint16_t major;
+	uint16_t minor;
+	int32_t  thiszone;
+	uint32_t sigfigs;
+	uint32_t snaplen;
+	uint32_t linktype;
+};
+
+struct pcap_rec_hdr {
+	uint32_t ts_sec;
+	uint32_t ts_frac;
+	uint32_t caplen;
+	uint32_t len;
+};
+
+/* record of a queue, 16 bytes aligned not to split the header */
+#define PCAPNG_REC_ALIGN   (16)
+#define PCAPNG_REC_SIZE(len) \
+	(sizeof(struct pcapng_rec) + \
+	 (((len) + PCAPNG_REC_ALIGN - 1) & ~(PCAPNG_REC_ALIGN - 1)))
+#define PCAPNG_REC_SKIP    (UINT32_MAX) /* to the end of the queue */
+
+struct pcapng_rec {
+	uint64_t ts;
+	uint32_t len;
+	uint32_t reserved;
+	uint8_t  data[];
+};
+
+struct pcapng_block_hdr {
+	uint32_t type;
+	uint32_t len;
+};
+
+struct pcapng_shb {
+	struct pcapng_block_hdr hdr;
+	uint32_t magic;
+	uint16_t major;
+	uint16_t minor;
+	int64_t  section_len;
+	uint32_t len;
+} __attribute__((packed));
+
+struct pcapng_epb {
+	struct pcapng_block_hdr hdr;
+	uint32_t interface;
+	uint32_t ts_high;
+	uint32_t ts_low;
+	uint32_t caplen;
+	uint32_t len;
+} __attribute__((packed));
+
+static int pcapng_write(int fd, void *buf, size_t len)
+{
+	ssize_t ret;
+
+	while (len > 0) {
+		ret = write(fd, buf, len);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		buf += ret;
+		len -= ret;
+	}
+
+	return 0;
+}
+
+static void pcapng_flush(struct pcapng_writer *w)
+{
+	if (!w->out_len)
+		return;
+
+	if (w->fd < 0 || pcapng_write(w->fd, w->out, w->out_len) < 0)
+		w->errors++;
+	w->bytes += w->out_len;
+	w->file_bytes += w->out_len;
+	w->out_len = 0;
+}
+
+static void pcapng_put(struct pcapng_writer *w, const void *data, int len)
+{
+	if (w->out_len + len > PCAPNG_BUFFER_SIZE)
+		pcapng_flush(w);
+
+	memcpy(w->out + w->out_len, data, len);
+	w->out_len += len;
+}
+
+static void pcapng_put_option(struct pcapng_writer *w, uint16_t code,
+			      const void *value, uint16_t len)
+{
+	static const uint8_t zero[4];
+	uint16_t opt[2] = { code, len };
+
+	pcapng_put(w, opt, sizeof(opt));
+	pcapng_put(w, value, len);
+	pcapng_put(w, zero, PCAPNG_PAD4(len) - len);
+}
+
+/* section header and an interface for each queue */
+static void pcapng_put_header(struct pcapng_writer *w)
+{
+	struct pcapng_shb shb = {
+		.hdr.type = PCAPNG_BT_SHB,
+		.hdr.len = sizeof(shb),
+		.magic = PCAPNG_BYTE_ORDER,
+		.major = 1,
+		.minor = 0,
+		.section_len = -1,
+		.len = sizeof(shb),
+	};
+	struct pcapng_block_hdr hdr;
+	uint16_t linktype[2] = { PCAPNG_LINKTYPE_ETHERNET, 0 };
+	uint32_t snaplen = 0, len;
+	uint8_t tsresol = 9; /* nsec */
+	char *name;
+	int i, namelen;
+
+	pcapng_put(w, &shb, sizeof(shb));
+
+	for (i = 0; i < w->nqueues; i++) {
+		name = w->queues[i].name;
+		namelen = strlen(name);
+		len = sizeof(hdr) + sizeof(linktype) + sizeof(snaplen) +
+			4 + PCAPNG_PAD4(namelen) + 4 + 4 + 4 + sizeof(len);
+
+		hdr.type = PCAPNG_BT_IDB;
+		hdr.len = len;
+		pcapng_put(w, &hdr, sizeof(hdr));
+		pcapng_put(w, linktype, sizeof(linktype));
+		pcapng_put(w, &snaplen, sizeof(snaplen));
+		pcapng_put_option(w, PCAPNG_OPT_IF_NAME, name, namelen);
+		pcapng_put_option(w, PCAPNG_OPT_IF_TSRESOL, &tsresol,
+					sizeof(tsresol));
+		pcapng_put_option(w, PCAPNG_OPT_END, NULL, 0);
+		pcapng_put(w, &len, sizeof(len));
+	}
+}
+
+/* close the file and open the next one, NAME, NAME.1, NAME.2, ... */
+static int pcapng_rotate(struct pcapng_writer *w, uint64_t ts)
+{
+	char name[PATH_MAX];
+
+	pcapng_flush(w);
+	if (w->fd >= 0)
+		close(w->fd);
+
+	if (w->files)
+		snprintf(name, sizeof(name), "%s.%d", w->name, w->files);
+	else
+		snprintf(name, sizeof(name), "%s", w->name);
+
+	w->fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (w->fd < 0) {
+		perror(name);
+		w->errors++;
+		return -1;
+	}
+
+	w->files++;
+	w->file_bytes = 0;
+	w->file_start = ts;
+	pcapng_put_header(w);
+
+	return 0;
+}
+
+static void pcapng_put_frame(struct pcapng_writer *w, int queue,
+			     struct pcapng_rec *rec)
+{
+	static const uint8_t zero[4];
+	struct pcapng_epb epb;
+	uint32_t len;
+
+	if (w->fd < 0 ||
+	    (w->size_limit && w->file_bytes + w->out_len >= w->size_limit) ||
+	    (w->time_limit && rec->ts - w->file_start >= w->time_limit))
+		if (pcapng_rotate(w, rec->ts) < 0)
+			return;
+
+	len = sizeof(epb) + PCAPNG_PAD4(rec->len) + sizeof(len);
+	epb.hdr.type = PCAPNG_BT_EPB;
+	epb.hdr.len = len;
+	epb.interface = queue;
+	epb.ts_high = rec->ts >> 32;
+	epb.ts_low = rec->ts;
+	epb.caplen = rec->len;
+	epb.len = rec->len;
+
+	pcapng_put(w, &epb, sizeof(epb));
+	pcapng_put(w, rec->data, rec->len);
+	pcapng_put(w, zero, PCAPNG_PAD4(rec->len) - rec->len);
+	pcapng_put(w, &len, sizeof(len));
+	w->frames++;
+}
+
+/* oldest record of the queue, NULL if empty */
+static struct pcapng_rec *pcapng_queue_peek(struct pcapng_queue *q)
+{
+	struct pcapng_rec *rec;
+	uint64_t head, off;
+
+	for (;;) {
+		head = __atomic_load_n(&q->head, __ATOMIC_ACQUIRE);
+		if (q->tail == head)
+			return NULL;
+
+		off = q->tail & (PCAPNG_QUEUE_SIZE - 1);
+		rec = (struct pcapng_rec *)(q->buf + off);
+		if (rec->len != PCAPNG_REC_SKIP)
+			return rec;
+
+		__atomic_store_n(&q->tail, q->tail + PCAPNG_QUEUE_SIZE - off,
+					__ATOMIC_RELEASE);
+	}
+}
+
+static void *pcapng_writer_thread(void *arg)
+{
+	struct pcapng_writer *w = arg;
+	struct pcapng_rec *rec, *oldest;
+	struct timespec idle = { 0, PCAPNG_IDLE_NS };
+	uint64_t now;
+	bool stopping, all;
+	int i, queue, emitted;
+
+	for (;;) {
+		stopping = __atomic_load_n(&w->stop, __ATOMIC_ACQUIRE);
+		now = clock_getcount(w->clkid);
+
+		for (emitted = 0; ; emitted++) {
+			/* the oldest of the queues, final if no queue is empty */
+			oldest = NULL;
+			queue = -1;
+			all = true;
+			for (i = 0; i < w->nqueues; i++) {
+				rec = pcapng_queue_peek(&w->queues[i]);
+				if (!rec) {
+					all = false;
+					continue;
+				}
+				if (!oldest || rec->ts < oldest->ts) {
+					oldest = rec;
+					queue = i;
+				}
+			}
+			if (!oldest)
+				break;
+			if (!all && !stopping && oldest->ts + PCAPNG_HOLD_NS > now)
+				break;
+
+			pcapng_put_frame(w, queue, oldest);
+			__atomic_store_n(&w->queues[queue].tail,
+				w->queues[queue].tail +
+					PCAPNG_REC_SIZE(oldest->len),
+				__ATOMIC_RELEASE);
+		}
+
+		pcapng_flush(w);
+
+		if (stopping && !oldest)
+			break;
+		if (!emitted)
+			nanosleep(&idle, NULL);
+	}
+
+	return NULL;
+}
+
+/*
+ * public functions
+ */
+struct pcapng_writer *pcapng_writer_new(const char *name,
+		char *ifnames[], int nqueues, uint64_t size_limit,
+		uint64_t time_limit, clockid_t clkid)
+{
+	struct pcapng_writer *w;
+	int i;
+
+	if (nqueues <= 0 || nqueues > PCAPNG_QUEUE_MAX)
+		return NULL;
+
+	w = calloc(1, sizeof(*w));
+	if (!w)
+		return NULL;
+
+	w->fd = -1;
+	w->name = strdup(name);
+	w->size_limit = size_limit;
+	w->time_limit = time_limit;
+	w->clkid = clkid;
+	w->nqueues = nqueues;
+
+	w->out = malloc(PCAPNG_BUFFER_SIZE);
+	if (!w->name || !w->out)
+		goto error;
+
+	for (i = 0; i < nqueues; i++) {
+		w->queues[i].name = strdup(ifnames[i]);
+		w->queues[i].buf = malloc(PCAPNG_QUEUE_SIZE);
+		if (!w->queues[i].name || !w->queues[i].buf)
+			goto error;
+	}
+
+	/* the first file is created before the first frame */
+	if (pcapng_rotate(w, clock_getcount(clkid)) < 0)
+		goto error;
+
+	if (pthread_create(&w->thread, NULL, pcapng_writer_thread, w))
+		goto error;
+
+	return w;
+
+error:
+	if (w->fd >= 0)
+		close(w->fd);
+	for (i = 0; i < nqueues; i++) {
+		free(w->queues[i].name);
+		free(w->queues[i].buf);
+	}
+	free(w->out);
+	free(w->name);
+	free(w);
+
+	return NULL;
+}
+
+/* write all of captured frames and stop the thread */
+void pcapng_writer_stop(struct pcapng_writer *w)
+{
+	if (w->stopped)
+		return;
+
+	__atomic_store_n(&w->stop, true, __ATOMIC_RELEASE);
+	pthread_join(w->thread, NULL);
+	w->stopped = true;
+}
+
+void pcapng_writer_free(struct pcapng_writer *w)
+{
+	int i;
+
+	if (!w)
+		return;
+
+	pcapng_writer_stop(w);
+
+	if (w->fd >= 0)
+		close(w->fd);
+	for (i = 0; i < w->nqueues; i++) {
+		free(w->queues[i].name);
+		free(w->queues[i].buf);
+	}
+	free(w->out);
+	free(w->name);
+	free(w);
+}
+
+/*
+ * Copy a frame with its timestamp (ns on clkid) to the queue, called by
+ * the only thread receiving the queue. The frame is dropped if the
+ * writer is behind.
+ */
+int pcapng_capture(struct pcapng_writer *w, int queue, void *frame,
+		   int len, uint64_t ts)
+{
+	struct pcapng_queue *q = &w->queues[queue];
+	struct pcapng_rec *rec;
+	uint64_t head, tail, off, size, room;
+
+	head = q->head;
+	size = PCAPNG_REC_SIZE(len);
+	off = head & (PCAPNG_QUEUE_SIZE - 1);
+	room = (PCAPNG_QUEUE_SIZE - off < size) ?
+			PCAPNG_QUEUE_SIZE - off + size : size;
+
+	tail = __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE);
+	if (PCAPNG_QUEUE_SIZE - (head - tail) < room) {
+		q->dropped++;
+		return -1;
+	}
+
+	/* a record is not wrapped around */
+	if (room != size) {
+		rec = (struct pcapng_rec *)(q->buf + off);
+		rec->len = PCAPNG_REC_SKIP;
+		head += PCAPNG_QUEUE_SIZE - off;
+		off = 0;
+	}
+
+	rec = (struct pcapng_rec *)(q->buf + off);
+	rec->ts = ts;
+	rec->len = len;
+	memcpy(rec->data, frame, len);
+
+	__atomic_store_n(&q->head, head + size, __ATOMIC_RELEASE);
+	q->frames++;
+
+	return 0;
+}
+
+void pcapng_writer_report(struct pcapng_writer *w, char *buf, int buflen)
+{
+	uint64_t captured = 0, dropped = 0;
+	int i;
+
+	for (i = 0; i < w->nqueues; i++) {
+		captured += w->queues[i].frames;
+		dropped += w->queues[i].dropped;
+	}
+
+	snprintf(buf, buflen,
+		"pcapng %s %"PRIu64"/%"PRIu64" frames captured/written %"PRIu64"bytes %d files %"PRIu64" dropped %"PRIu64" errors",
+		w->name, captured, w->frames, w->bytes, w->files,
+		dropped, w->errors);
+}
+
+/*
+ * pcap and pcapng reader
+ */
+static inline uint16_t pcap_u16(struct pcap_reader *r, uint16_t v)
+{
+	return (r->swap) ? bswap_16(v) : v;
+}
+
+static inline uint32_t pcap_u32(struct pcap_reader *r, uint32_t v)
+{
+	return (r->swap) ? bswap_32(v) : v;
+}
+
+/* if_tsresol of which pcap_ts_nsec() can scale a 64bit timestamp */
+static bool pcap_tsresol_valid(uint8_t tsresol)
+{
+	if (tsresol & 0x80)
+		return (tsresol & 0x7f) < 64;
+
+	return tsresol <= 19;
+}
+
+/* nsec of a timestamp in the units of if_tsresol */
+static uint64_t pcap_ts_nsec(uint64_t ts, uint8_t tsresol)
+{
+	uint64_t scale = 1;
+	int i, exp;
+
+	if (tsresol & 0x80)
+		return (uint64_t)((long double)ts * NSEC_SCALE /
+					(1ULL << (tsresol & 0x7f)));
+
+	exp = tsresol;
+	for (i = 0; i < abs(exp - 9); i++)
+		scale *= 10;
+
+	return (exp <= 9) ? ts * scale : ts / scale;
+}
+
+static void pcapng_read_idb(struct pcap_reader *r, uint8_t *body,
+			    uint32_t len)
+{
+	uint16_t code, optlen;
+	uint32_t off;
+	int i;
+
+	if (r->nifs >= PCAP_IF_MAX || len < 8)
+		return;
+
+	i = r->nifs++;
+	r->if_linktype[i] = pcap_u16(r, *(uint16_t *)body);
+	r->if_tsresol[i] = PCAP_TSRESOL_USEC;
+
+	for (off = 8; off + 4 <= len; off += 4 + PCAPNG_PAD4(optlen)) {
+		code = pcap_u16(r, *(uint16_t *)(body + off));
+		optlen = pcap_u16(r, *(uint16_t *)(body + off + 2));
+		if (code == PCAPNG_OPT_END)
+			break;
+		if (code == PCAPNG_OPT_IF_TSRESOL && optlen == 1 &&
+		    off + 4 < len)
+			r->if_tsresol[i] = pcap_tsresol_valid(body[off + 4]) ?
+				body[off + 4] : PCAP_TSRESOL_BAD;
+	}
+}
+
+static int pcapng_next(struct pcap_reader *r, struct pcap_frame *f)
+{
+	struct pcapng_block_hdr *hdr;
+	struct pcapng_shb *shb;
+	struct pcapng_epb *epb;
+	uint32_t type, len, iface;
+
+	while (r->off + sizeof(*hdr) <= r->size) {
+		hdr = (struct pcapng_block_hdr *)(r->map + r->off);
+		type = hdr->type;
+
+		/* a section defines its own byte order */
+		if (type == PCAPNG_BT_SHB) {
+			shb = (struct pcapng_shb *)hdr;
+			if (r->off + sizeof(*shb) > r->size)
+				return -1;
+			r->swap = (shb->magic != PCAPNG_BYTE_ORDER);
+			r->nifs = 0;
+		}
+
+		type = pcap_u32(r, type);
+		len = pcap_u32(r, hdr->len);
+		if (len < sizeof(*hdr) + sizeof(uint32_t) || len & 3 ||
+		    r->off + len > r->size)
+			return -1;
+		r->off += len;
+
+		if (type == PCAPNG_BT_IDB) {
+			pcapng_read_idb(r, (uint8_t *)(hdr + 1),
+					len - sizeof(*hdr) - sizeof(uint32_t));
+			continue;
+		}
+		if (type != PCAPNG_BT_EPB)
+			continue;
+
+		if (len < PCAPNG_BT_EPB_SIZE) {
+			r->skipped++;
+			continue;
+		}
+
+		epb = (struct pcapng_epb *)hdr;
+		iface = pcap_u32(r, epb->interface);
+		f->caplen = pcap_u32(r, epb->caplen);
+		if (f->caplen > len - PCAPNG_BT_EPB_SIZE ||
+		    iface >= r->nifs ||
+		    r->if_linktype[iface] != PCAPNG_LINKTYPE_ETHERNET ||
+		    r->if_tsresol[iface] == PCAP_TSRESOL_BAD) {
+			r->skipped++;
+			continue;
+		}
+
+		f->data = (uint8_t *)(epb + 1);
+		f->len = pcap_u32(r, epb->len);
+		f->interface = iface;
+		f->ts = pcap_ts_nsec(
+			((uint64_t)pcap_u32(r, epb->ts_high) << 32) |
+				pcap_u32(r, epb->ts_low),
+			r->if_tsresol[iface]);
+		r->frames++;
+		return 1;
+	}
+
+	return 0;
+}
+
+static int pcap_next(struct pcap_reader *r, struct pcap_frame *f)
+{
+	struct pcap_rec_hdr *rec;
+
+	if (r->off + sizeof(*rec) > r->size)
+		return 0;
+
+	rec = (struct pcap_rec_hdr *)(r->map + r->off);
+	f->caplen = pcap_u32(r, rec->caplen);
+	if (r->off + sizeof(*rec) + f->caplen > r->size)
+		return -1;
+
+	f->data = (uint8_t *)(rec + 1);
+	f->len = pcap_u32(r, rec->len);
+	f->interface = 0;
+	f->ts = (uint64_t)pcap_u32(r, rec->ts_sec) * NSEC_SCALE +
+			(uint64_t)pcap_u32(r, rec->ts_frac) * r->ts_scale;
+	r->off += sizeof(*rec) + f->caplen;
+	r->frames++;
+
+	return 1;
+}
+
+/* learn the byte order and interfaces of the first section */
+static void pcapng_prime(struct pcap_reader *r)
+{
+	struct pcap_frame f;
+
+	pcapng_next(r, &f);
+	r->off = 0;
+	r->frames = 0;
+	r->skipped = 0;
+}
+
+/* a pcap record at off followed by valid ones, or the end of file */
+static bool pcap_record_valid(struct pcap_reader *r, size_t off)
+{
+	struct pcap_rec_hdr *rec;
+	uint32_t caplen;
+	int i;
+
+	for (i = 0; i < PCAP_SYNC_RECORDS && off < r->size; i++) {
+		if (off + sizeof(*rec) > r->size)
+			return false;
+		rec = (struct pcap_rec_hdr *)(r->map + off);
+		caplen = pcap_u32(r, rec->caplen);
+		if (caplen < ETH_HLEN || caplen > r->snaplen ||
+		    caplen > pcap_u32(r, rec->len) ||
+		    pcap_u32(r, rec->len) > PCAP_FRAME_MAX ||
+		    pcap_u32(r, rec->ts_frac) >= NSEC_SCALE / r->ts_scale ||
+		    (uint64_t)pcap_u32(r, rec->ts_sec) + PCAP_SYNC_SLACK <
+							r->ts_first)
+			return false;
+		off += sizeof(*rec) + caplen;
+		if (off > r->size)
+			return false;
+	}
+
+	return true;
+}
+
+/* a pcapng EPB at off followed by valid blocks, or the end of file */
+static bool pcapng_block_valid(struct pcap_reader *r, size_t off)
+{
+	struct pcapng_block_hdr *hdr;
+	struct pcapng_epb *epb;
+	uint32_t len;
+	int i;
+
+	for (i = 0; i < PCAP_SYNC_RECORDS && off < r->size; i++) {
+		if (off + sizeof(*hdr) > r->size)
+			return false;
+		hdr = (struct pcapng_block_hdr *)(r->map + off);
+		len = pcap_u32(r, hdr->len);
+		if (len < sizeof(*hdr) + sizeof(uint32_t) || len & 3 ||
+		    off + len > r->size ||
+		    pcap_u32(r, *(uint32_t *)(r->map + off + len - 4)) != len)
+			return false;
+
+		if (pcap_u32(r, hdr->type) == PCAPNG_BT_EPB) {
+			epb = (struct pcapng_epb *)hdr;
+			if (len < PCAPNG_BT_EPB_SIZE ||
+			    pcap_u32(r, epb->caplen) > len - PCAPNG_BT_EPB_SIZE ||
+			    pcap_u32(r, epb->interface) >= r->nifs)
+				return false;
+		} else if (!i) {
+			return false; /* start at a frame */
+		}
+		off += len;
+	}
+
+	return true;
+}
+
+struct pcap_reader *pcap_reader_open(const char *name)
+{
+	struct pcap_reader *r;
+	struct pcap_file_hdr *fh;
+	struct stat st;
+	int fd;
+
+	fd = open(name, O_RDONLY);
+	if (fd < 0) {
+		perror(name);
+		return NULL;
+	}
+
+	r = calloc(1, sizeof(*r));
+	if (!r || fstat(fd, &st) < 0 || st.st_size < sizeof(*fh))
+		goto error;
+
+	r->size = st.st_size;
+	r->map = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (r->map == MAP_FAILED) {
+		perror("mmap");
+		goto error;
+	}
+	close(fd);
+	fd = -1;
+
+	/* the frames are read in order, once or a few times */
+	madvise(r->map, r->size, MADV_SEQUENTIAL);
+	r->name = strdup(name);
+
+	fh = (struct pcap_file_hdr *)r->map;
+	switch (fh->magic) {
+	case PCAPNG_BT_SHB:
+		r->ng = true;
+		pcapng_prime(r);
+		return r;
+	case PCAP_MAGIC_USEC:
+	case PCAP_MAGIC_NSEC:
+		break;
+	case PCAP_MAGIC_USEC_SW:
+	case PCAP_MAGIC_NSEC_SW:
+		r->swap = true;
+		break;
+	default:
+		fprintf(stderr, "%s: not pcap nor pcapng\n", name);
+		goto error;
+	}
+
+	r->ts_scale = (pcap_u32(r, fh->magic) == PCAP_MAGIC_NSEC) ? 1 : 1000;
+	r->linktype = pcap_u32(r, fh->linktype);
+	r->snaplen = pcap_u32(r, fh->snaplen);
+	if (!r->snaplen || r->snaplen > PCAP_FRAME_MAX)
+		r->snaplen = PCAP_FRAME_MAX;
+	if (r->linktype != PCAPNG_LINKTYPE_ETHERNET) {
+		fprintf(stderr, "%s: linktype %u is not Ethernet\n",
+				name, r->linktype);
+		goto error;
+	}
+	r->off = sizeof(*fh);
+	if (r->off + sizeof(struct pcap_rec_hdr) <= r->size)
+		r->ts_first = pcap_u32(r,
+			((struct pcap_rec_hdr *)(r->map + r->off))->ts_sec);
+
+	return r;
+
+error:
+	if (fd >= 0)
+		close(fd);
+	pcap_reader_close(r);
+
+	return NULL;
+}
+
+void pcap_reader_close(struct pcap_reader *r)
+{
+	if (!r)
+		return;
+
+	if (r->map && r->map != MAP_FAILED)
+		munmap(r->map, r->size);
+	free(r->name);
+	free(r);
+}
+
+/* read from the first frame again */
+void pcap_reader_rewind(struct pcap_reader *r)
+{
+	r->off = (r->ng) ? 0 : sizeof(struct pcap_file_hdr);
+}
+
+/* next Ethernet frame, 0 at the end of file, -1 if broken */
+int pcap_reader_next(struct pcap_reader *r, struct pcap_frame *f)
+{
+	return (r->ng) ? pcapng_next(r, f) : pcap_next(r, f);
+}
+
+/*
+ * The first frame at or after off, or the end of file. It finds the
+ * record boundary by the consistency of the following records, so that
+ * a large file is split into the parts read in parallel.
+ */
+size_t pcap_reader_sync(struct pcap_reader *r, size_t off)
+{
+	size_t start = (r->ng) ? 0 : sizeof(struct pcap_file_hdr);
+
+	if (off <= start)
+		return start;
+
+	if (r->ng) {
+		/* blocks are aligned to 32 bits */
+		for (off = PCAPNG_PAD4(off); off < r->size; off += 4)
+			if (pcapng_block_valid(r, off))
+				return off;
+	} else {
+		for (; off < r->size; off++)
+			if (pcap_record_valid(r, off))
+				return off;
+	}
+
+	return r->size;
+}
+
+/*
+ * A reader of frames from start to end of the file read by r, which
+ * shares the mapping and is not closed. A part of pcapng inherits the
+ * interfaces of the first section.
+ */
+void pcap_reader_slice(struct pcap_reader *r, struct pcap_reader *part,
+		       size_t start, size_t end)
+{
+	*part = *r;
+	part->off = start;
+	part->size = end;
+	part->frames = 0;
+	part->skipped = 0;
+}
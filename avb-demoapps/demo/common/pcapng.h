@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __PCAPNG_H__
+#define __PCAPNG_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+
+#define PCAPNG_QUEUE_MAX   (16)
+#define PCAPNG_QUEUE_SIZE  (4 * 1024 * 1024) /* bytes, power of 2 */
+#define PCAPNG_BUFFER_SIZE (1024 * 1024)     /* bytes per write */
+
+/* frames of an rx queue, from the capturing thread to the writer */
+struct pcapng_queue {
+	char     *name;
+	uint8_t  *buf;
+	uint64_t head;      /* written by the capturing thread */
+	uint64_t tail;      /* written by the writer thread */
+	uint64_t frames;
+	uint64_t dropped;   /* the queue is full */
+};
+
+/*
+ * Capture to pcapng files with nanosecond timestamps. Each rx queue is
+ * an interface of the file, the frames of the queues are merged in
+ * timestamp order by the writer thread, held PCAPNG_HOLD_NS for the
+ * late queues. The file rotates by size or time.
+ */
+struct pcapng_writer {
+	char                *name;
+	int                 fd;
+	int                 files;
+	uint64_t            file_bytes;
+	uint64_t            file_start;
+	uint64_t            size_limit;  /* bytes, 0:none */
+	uint64_t            time_limit;  /* ns, 0:none */
+	clockid_t           clkid;
+
+	int                 nqueues;
+	struct pcapng_queue queues[PCAPNG_QUEUE_MAX];
+
+	uint8_t             *out;
+	int                 out_len;
+
+	pthread_t           thread;
+	bool                stop;
+	bool                stopped;
+
+	/* statistics */
+	uint64_t            frames;
+	uint64_t            bytes;
+	uint64_t            errors;
+};
+
+/* a frame of a capture file, in place of the mapped file */
+struct pcap_frame {
+	uint8_t  *data;
+	uint32_t caplen;
+	uint32_t len;       /* on the wire */
+	uint64_t ts;        /* nsec */
+	int      interface;
+};
+
+#define PCAP_IF_MAX (64)
+
+/* reader of pcap and pcapng files mapped to the memory */
+struct pcap_reader {
+	char     *name;
+	uint8_t  *map;
+	size_t   size;
+	size_t   off;
+	bool     ng;        /* pcapng */
+	bool     swap;      /* byte order of the file (section) */
+
+	/* pcap */
+	uint32_t linktype;
+	uint32_t snaplen;
+	uint32_t ts_scale;  /* nsec per unit of the fraction */
+	uint32_t ts_first;  /* sec of the first record */
+
+	/* pcapng interfaces of the section */
+	int      nifs;
+	uint16_t if_linktype[PCAP_IF_MAX];
+	uint8_t  if_tsresol[PCAP_IF_MAX];
+
+	/* statistics */
+	uint64_t frames;
+	uint64_t skipped;   /* not Ethernet, no timestamp or truncated */
+};
+
+extern struct pcap_reader *pcap_reader_open(const char *name);
+extern void pcap_reader_close(struct pcap_reader *r);
+extern void pcap_reader_rewind(struct pcap_reader *r);
+extern int pcap_reader_next(struct pcap_reader *r, struct pcap_frame *f);
+extern size_t pcap_reader_sync(struct pcap_reader *r, size_t off);
+extern void pcap_reader_slice(struct pcap_reader *r, struct pcap_reader *part,
+			      size_t start, size_t end);
+
+extern struct pcapng_writer *pcapng_writer_new(const char *name,
+		char *ifnames[], int nqueues, uint64_t size_limit,
+		uint64_t time_limit, clockid_t clkid);
+extern void pcapng_writer_stop(struct pcapng_writer *w);
+extern void pcapng_writer_free(struct pcapng_writer *w);
+extern int pcapng_capture(struct pcapng_writer *w, int queue, void *frame,
+			  int len, uint64_t ts);
+extern void pcapng_writer_report(struct pcapng_writer *w, char *buf,
+				 int buflen);
+
+#endif /* __PCAPNG_H__ */
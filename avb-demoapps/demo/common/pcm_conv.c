@@ -0,0 +1,183 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+
+#include "pcm_conv.h"
+
+#if defined(__x86_64__)
+#include <tmmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+typedef void (*pcm_conv_fn)(uint8_t *dst, const uint8_t *src, int n);
+
+static pcm_conv_fn pcm_conv_24to32;
+static pcm_conv_fn pcm_conv_32to24;
+static const char *pcm_conv_name;
+
+static void pcm_conv_24to32_sw(uint8_t *dst, const uint8_t *src, int n)
+{
+	for (; n > 0; n--, dst += 4, src += 3) {
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+		dst[3] = 0;
+	}
+}
+
+static void pcm_conv_32to24_sw(uint8_t *dst, const uint8_t *src, int n)
+{
+	for (; n > 0; n--, dst += 3, src += 4) {
+		dst[0] = src[0];
+		dst[1] = src[1];
+		dst[2] = src[2];
+	}
+}
+
+/*
+ * SIMD kernels of L24 <-> INT_32BIT, the samples are byte shuffled only
+ */
+#if defined(__x86_64__)
+/* 16 bytes are loaded and stored for the 12 of 4 packed samples */
+__attribute__((target("ssse3")))
+static void pcm_conv_24to32_simd(uint8_t *dst, const uint8_t *src, int n)
+{
+	const __m128i mask = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1,
+					   6, 7, 8, -1, 9, 10, 11, -1);
+	int i;
+
+	for (i = 0; 3 * i + 16 <= 3 * n; i += 4)
+		_mm_storeu_si128((__m128i *)(dst + 4 * i), _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(src + 3 * i)), mask));
+
+	pcm_conv_24to32_sw(dst + 4 * i, src + 3 * i, n - i);
+}
+
+/* the 4 bytes stored beyond the samples are overwritten by the next */
+__attribute__((target("ssse3")))
+static void pcm_conv_32to24_simd(uint8_t *dst, const uint8_t *src, int n)
+{
+	const __m128i mask = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9,
+					   10, 12, 13, 14, -1, -1, -1, -1);
+	int i;
+
+	for (i = 0; 3 * i + 16 <= 3 * n; i += 4)
+		_mm_storeu_si128((__m128i *)(dst + 3 * i), _mm_shuffle_epi8(
+			_mm_loadu_si128((const __m128i *)(src + 4 * i)), mask));
+
+	pcm_conv_32to24_sw(dst + 3 * i, src + 4 * i, n - i);
+}
+
+static bool pcm_conv_simd_supported(void)
+{
+	return __builtin_cpu_supports("ssse3");
+}
+
+#define PCM_CONV_SIMD_NAME "ssse3"
+#elif defined(__ARM_NEON)
+/* the bytes of 16 samples are deinterleaved into planes */
+static void pcm_conv_24to32_simd(uint8_t *dst, const uint8_t *src, int n)
+{
+	uint8x16x3_t in;
+	uint8x16x4_t out;
+	int i;
+
+	out.val[3] = vdupq_n_u8(0);
+	for (i = 0; i + 16 <= n; i += 16) {
+		in = vld3q_u8(src + 3 * i);
+		out.val[0] = in.val[0];
+		out.val[1] = in.val[1];
+		out.val[2] = in.val[2];
+		vst4q_u8(dst + 4 * i, out);
+	}
+
+	pcm_conv_24to32_sw(dst + 4 * i, src + 3 * i, n - i);
+}
+
+static void pcm_conv_32to24_simd(uint8_t *dst, const uint8_t *src, int n)
+{
+	uint8x16x4_t in;
+	uint8x16x3_t out;
+	int i;
+
+	for (i = 0; i + 16 <= n; i += 16) {
+		in = vld4q_u8(src + 4 * i);
+		out.val[0] = in.val[0];
+		out.val[1] = in.val[1];
+		out.val[2] = in.val[2];
+		vst3q_u8(dst + 3 * i, out);
+	}
+
+	pcm_conv_32to24_sw(dst + 3 * i, src + 4 * i, n - i);
+}
+
+static bool pcm_conv_simd_supported(void)
+{
+	return true;
+}
+
+#define PCM_CONV_SIMD_NAME "neon"
+#endif
+
+/* the other widths of L16 and INT_16BIT */
+static void pcm_conv_any(uint8_t *dst, int dst_width, const uint8_t *src,
+			 int src_width, int n)
+{
+	int w = (dst_width < src_width) ? dst_width : src_width;
+
+	for (; n > 0; n--, dst += dst_width, src += src_width) {
+		memcpy(dst, src, w);
+		memset(dst + w, 0, dst_width - w);
+	}
+}
+
+static void pcm_conv_init(void)
+{
+#ifdef PCM_CONV_SIMD_NAME
+	if (pcm_conv_simd_supported()) {
+		pcm_conv_32to24 = pcm_conv_32to24_simd;
+		pcm_conv_name = PCM_CONV_SIMD_NAME;
+		pcm_conv_24to32 = pcm_conv_24to32_simd;
+		return;
+	}
+#endif
+
+	pcm_conv_32to24 = pcm_conv_32to24_sw;
+	pcm_conv_name = "software";
+	pcm_conv_24to32 = pcm_conv_24to32_sw;
+}
+
+/*
+ * public functions
+ */
+void pcm_conv(void *dst, int dst_width, const void *src, int src_width,
+	      int samples)
+{
+	if (!pcm_conv_24to32)
+		pcm_conv_init();
+
+	if (dst_width == src_width)
+		memcpy(dst, src, samples * dst_width);
+	else if (src_width == 3 && dst_width == 4)
+		pcm_conv_24to32(dst, src, samples);
+	else if (src_width == 4 && dst_width == 3)
+		pcm_conv_32to24(dst, src, samples);
+	else
+		pcm_conv_any(dst, dst_width, src, src_width, samples);
+}
+
+const char *pcm_conv_impl(void)
+{
+	if (!pcm_conv_24to32)
+		pcm_conv_init();
+
+	return pcm_conv_name;
+}
@@ -0,0 +1,25 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __PCM_CONV_H__
+#define __PCM_CONV_H__
+
+#include <stdint.h>
+
+/*
+ * Conversion of big endian integer PCM between sample widths of 2, 3
+ * and 4 bytes, as RTP L16/L24 and AAF INT_16BIT/INT_24BIT/INT_32BIT.
+ * The samples are aligned on the most significant byte, widening fills
+ * zero and narrowing truncates.
+ */
+#define PCM_WIDTH_MIN (2)
+#define PCM_WIDTH_MAX (4)
+
+extern void pcm_conv(void *dst, int dst_width, const void *src, int src_width,
+		     int samples);
+extern const char *pcm_conv_impl(void);
+
+#endif /* __PCM_CONV_H__ */
@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __RTP_H__
+#define __RTP_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+/* RFC 3550 5.1 RTP fixed header */
+#define RTP_HEADER_SIZE (12)
+#define RTP_VERSION     (2)
+
+#define RTP_FLAG_PADDING   (0x20)
+#define RTP_FLAG_EXTENSION (0x10)
+#define RTP_CSRC_COUNT     (0x0f)
+#define RTP_PAYLOAD_TYPE   (0x7f)
+
+/* AES67 5.7 and 7.1, dynamic payload type and standard port */
+#define RTP_AES67_PAYLOAD_TYPE (96)
+#define RTP_AES67_PORT         (5004)
+
+static inline uint8_t get_rtp_payload_type(const void *data)
+{
+	return *((const uint8_t *)data + 1) & RTP_PAYLOAD_TYPE;
+}
+
+static inline uint16_t get_rtp_sequence_num(const void *data)
+{
+	uint16_t v;
+
+	memcpy(&v, (const uint8_t *)data + 2, sizeof(v));
+	return ntohs(v);
+}
+
+static inline uint32_t get_rtp_timestamp(const void *data)
+{
+	uint32_t v;
+
+	memcpy(&v, (const uint8_t *)data + 4, sizeof(v));
+	return ntohl(v);
+}
+
+static inline uint32_t get_rtp_ssrc(const void *data)
+{
+	uint32_t v;
+
+	memcpy(&v, (const uint8_t *)data + 8, sizeof(v));
+	return ntohl(v);
+}
+
+/*
+ * offset of the payload in the packet of len bytes, the payload ends at
+ * the returned *end excluding padding, -1 for a broken packet
+ */
+static inline int rtp_payload_offset(const void *data, int len, int *end)
+{
+	const uint8_t *p = data;
+	int off, pad = 0;
+
+	if (len < RTP_HEADER_SIZE || (p[0] >> 6) != RTP_VERSION)
+		return -1;
+
+	off = RTP_HEADER_SIZE + (p[0] & RTP_CSRC_COUNT) * 4;
+	if (p[0] & RTP_FLAG_EXTENSION) {
+		if (off + 4 > len)
+			return -1;
+		off += 4 + ((p[off + 2] << 8) | p[off + 3]) * 4;
+	}
+	if (p[0] & RTP_FLAG_PADDING)
+		pad = p[len - 1];
+	if (off > len - pad)
+		return -1;
+
+	*end = len - pad;
+	return off;
+}
+
+static inline void rtp_header_build(void *data, uint8_t pt, uint16_t seq,
+				    uint32_t ts, uint32_t ssrc)
+{
+	uint8_t *p = data;
+	uint16_t be16 = htons(seq);
+	uint32_t be32;
+
+	p[0] = RTP_VERSION << 6;
+	p[1] = pt & RTP_PAYLOAD_TYPE;
+	memcpy(p + 2, &be16, sizeof(be16));
+	be32 = htonl(ts);
+	memcpy(p + 4, &be32, sizeof(be32));
+	be32 = htonl(ssrc);
+	memcpy(p + 8, &be32, sizeof(be32));
+}
+
+#endif /* __RTP_H__ */
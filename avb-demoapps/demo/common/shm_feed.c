@@ -0,0 +1,506 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#define _GNU_SOURCE /* memfd_create, accept4, POLLRDHUP */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <poll.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+
+#include "shm_feed.h"
+
+#define SHM_FEED_FDS (4) /* memfd, data, space and underrun */
+
+static inline struct shm_feed_slot *shm_feed_slot_of(struct shm_feed_hdr *hdr,
+						     uint64_t seq)
+{
+	return (struct shm_feed_slot *)(hdr->slot +
+			(size_t)(seq & (hdr->slots - 1)) * hdr->stride);
+}
+
+static uint32_t shm_feed_stride(int slot_size)
+{
+	return (sizeof(struct shm_feed_slot) + slot_size + SHM_FEED_ALIGN - 1) &
+			~(SHM_FEED_ALIGN - 1);
+}
+
+/* abstract unix socket @name */
+static socklen_t shm_feed_sockaddr(const char *name, struct sockaddr_un *sun)
+{
+	size_t len = strlen(name);
+
+	if (len > sizeof(sun->sun_path) - 1)
+		len = sizeof(sun->sun_path) - 1;
+
+	memset(sun, 0, sizeof(*sun));
+	sun->sun_family = AF_UNIX;
+	memcpy(sun->sun_path + 1, name, len);
+
+	return offsetof(struct sockaddr_un, sun_path) + 1 + len;
+}
+
+static struct shm_feed *shm_feed_alloc(const char *name)
+{
+	struct shm_feed *f;
+
+	f = calloc(1, sizeof(*f));
+	if (!f)
+		return NULL;
+
+	f->name = strdup(name);
+	f->hdr = MAP_FAILED;
+	f->memfd = -1;
+	f->data_fd = -1;
+	f->space_fd = -1;
+	f->underrun_fd = -1;
+	f->listen_fd = -1;
+	f->conn_fd = -1;
+
+	return f;
+}
+
+static void shm_feed_free(struct shm_feed *f)
+{
+	if (f->hdr != MAP_FAILED)
+		munmap(f->hdr, f->size);
+	if (f->memfd >= 0)
+		close(f->memfd);
+	if (f->data_fd >= 0)
+		close(f->data_fd);
+	if (f->space_fd >= 0)
+		close(f->space_fd);
+	if (f->underrun_fd >= 0)
+		close(f->underrun_fd);
+	if (f->listen_fd >= 0)
+		close(f->listen_fd);
+	if (f->conn_fd >= 0)
+		close(f->conn_fd);
+	free(f->name);
+	free(f);
+}
+
+/* wake up the other side if it sleeps on the flag */
+static void shm_feed_kick(uint32_t *waiting, int fd)
+{
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	if (__atomic_load_n(waiting, __ATOMIC_RELAXED)) {
+		__atomic_store_n(waiting, 0, __ATOMIC_RELAXED);
+		eventfd_write(fd, 1);
+	}
+}
+
+static void shm_feed_drain(int fd)
+{
+	eventfd_t value;
+
+	eventfd_read(fd, &value);
+}
+
+/* hand the ring to the accepted producer */
+static int shm_feed_accept(struct shm_feed *f)
+{
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		char buf[CMSG_SPACE(SHM_FEED_FDS * sizeof(int))];
+		struct cmsghdr align;
+	} u;
+	int fds[SHM_FEED_FDS] = { f->memfd, f->data_fd, f->space_fd,
+				  f->underrun_fd };
+	char c = 0;
+	int fd;
+
+	fd = accept4(f->listen_fd, NULL, NULL, SOCK_CLOEXEC);
+	if (fd < 0)
+		return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = u.buf;
+	msg.msg_controllen = sizeof(u.buf);
+	cmsg = CMSG_FIRSTHDR(&msg);
+	cmsg->cmsg_level = SOL_SOCKET;
+	cmsg->cmsg_type = SCM_RIGHTS;
+	cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+	memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+
+	if (sendmsg(fd, &msg, MSG_NOSIGNAL) < 0) {
+		perror("sendmsg");
+		close(fd);
+		return 0;
+	}
+
+	/* one producer at a time */
+	f->conn_fd = fd;
+	close(f->listen_fd);
+	f->listen_fd = -1;
+
+	return 1;
+}
+
+/*
+ * talker
+ */
+struct shm_feed *shm_feed_create(const char *name, int slots, int slot_size)
+{
+	struct shm_feed *f;
+	struct sockaddr_un sun;
+	socklen_t len;
+	uint32_t stride;
+
+	if (slots <= 0 || (slots & (slots - 1)) || slot_size <= 0)
+		return NULL;
+
+	f = shm_feed_alloc(name);
+	if (!f)
+		return NULL;
+
+	stride = shm_feed_stride(slot_size);
+	f->size = sizeof(struct shm_feed_hdr) + (size_t)slots * stride;
+
+	f->memfd = memfd_create(name, MFD_CLOEXEC);
+	if (f->memfd < 0) {
+		perror("memfd_create");
+		goto error;
+	}
+	if (ftruncate(f->memfd, f->size) < 0) {
+		perror("ftruncate");
+		goto error;
+	}
+
+	f->hdr = mmap(NULL, f->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			f->memfd, 0);
+	if (f->hdr == MAP_FAILED) {
+		perror("mmap");
+		goto error;
+	}
+	f->hdr->slots = slots;
+	f->hdr->slot_size = slot_size;
+	f->hdr->stride = stride;
+	__atomic_store_n(&f->hdr->magic, SHM_FEED_MAGIC, __ATOMIC_RELEASE);
+
+	f->data_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	f->space_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	f->underrun_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (f->data_fd < 0 || f->space_fd < 0 || f->underrun_fd < 0) {
+		perror("eventfd");
+		goto error;
+	}
+
+	f->listen_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK |
+				SOCK_CLOEXEC, 0);
+	if (f->listen_fd < 0) {
+		perror("socket");
+		goto error;
+	}
+	len = shm_feed_sockaddr(name, &sun);
+	if (bind(f->listen_fd, (struct sockaddr *)&sun, len) < 0) {
+		perror("bind");
+		goto error;
+	}
+	if (listen(f->listen_fd, 1) < 0) {
+		perror("listen");
+		goto error;
+	}
+
+	return f;
+
+error:
+	shm_feed_free(f);
+
+	return NULL;
+}
+
+void shm_feed_destroy(struct shm_feed *f)
+{
+	if (!f)
+		return;
+
+	shm_feed_free(f);
+}
+
+/* number of payloads committed and not consumed */
+int shm_feed_available(struct shm_feed *f)
+{
+	return __atomic_load_n(&f->hdr->head, __ATOMIC_ACQUIRE) - f->consumed;
+}
+
+/* i-th available payload, valid until shm_feed_consume() */
+struct shm_feed_slot *shm_feed_slot(struct shm_feed *f, int i)
+{
+	return shm_feed_slot_of(f->hdr, f->consumed + i);
+}
+
+/* release n payloads to the producer */
+void shm_feed_consume(struct shm_feed *f, int n)
+{
+	f->consumed += n;
+	__atomic_store_n(&f->hdr->tail, f->consumed, __ATOMIC_RELEASE);
+	shm_feed_kick(&f->hdr->producer_waiting, f->space_fd);
+}
+
+/* tell the producer the stream ran out of payloads */
+void shm_feed_underrun(struct shm_feed *f)
+{
+	__atomic_store_n(&f->hdr->underruns, f->hdr->underruns + 1,
+				__ATOMIC_RELAXED);
+	eventfd_write(f->underrun_fd, 1);
+}
+
+/* the producer is gone and all of its payloads are consumed */
+bool shm_feed_eof(struct shm_feed *f)
+{
+	if (!f->hangup && !__atomic_load_n(&f->hdr->closed, __ATOMIC_ACQUIRE))
+		return false;
+
+	return !shm_feed_available(f);
+}
+
+/*
+ * Sleep until payloads are committed, the producer connects or leaves,
+ * fd (-1:none) is readable or timeout in msec, 0 for timeout.
+ */
+int shm_feed_wait(struct shm_feed *f, int fd, int timeout)
+{
+	struct pollfd pfd[3];
+	int ret, n = 0;
+
+	if (f->conn_fd >= 0 && !f->hangup) {
+		__atomic_store_n(&f->hdr->consumer_waiting, 1,
+					__ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_SEQ_CST);
+		if (shm_feed_available(f)) {
+			__atomic_store_n(&f->hdr->consumer_waiting, 0,
+						__ATOMIC_RELAXED);
+			return 1;
+		}
+	}
+
+	pfd[n].fd = (f->conn_fd >= 0) ? f->conn_fd : f->listen_fd;
+	pfd[n++].events = (f->conn_fd >= 0) ? POLLRDHUP : POLLIN;
+	pfd[n].fd = f->data_fd;
+	pfd[n++].events = POLLIN;
+	if (fd >= 0) {
+		pfd[n].fd = fd;
+		pfd[n++].events = POLLIN;
+	}
+
+	ret = poll(pfd, n, timeout);
+	__atomic_store_n(&f->hdr->consumer_waiting, 0, __ATOMIC_RELAXED);
+	if (ret < 0)
+		return (errno == EINTR) ? 0 : -1;
+	if (!ret)
+		return 0;
+
+	if (pfd[1].revents & POLLIN)
+		shm_feed_drain(f->data_fd);
+
+	if (f->conn_fd < 0) {
+		if ((pfd[0].revents & POLLIN) && shm_feed_accept(f) < 0)
+			return -1;
+	} else if (pfd[0].revents & (POLLRDHUP | POLLHUP | POLLERR)) {
+		f->hangup = true;
+	}
+
+	return ret;
+}
+
+void shm_feed_report(struct shm_feed *f, char *buf, int buflen)
+{
+	struct shm_feed_hdr *hdr = f->hdr;
+
+	snprintf(buf, buflen,
+		"shm feed @%s %"PRIu64" payloads on %u slots, %"PRIu64" underruns, "
+		"producer blocked %"PRIu64" times",
+		f->name, f->consumed, hdr->slots, hdr->underruns,
+		__atomic_load_n(&hdr->full_waits, __ATOMIC_RELAXED));
+}
+
+/*
+ * producer
+ */
+struct shm_feed *shm_feed_connect(const char *name)
+{
+	struct shm_feed *f;
+	struct sockaddr_un sun;
+	struct msghdr msg;
+	struct iovec iov;
+	struct cmsghdr *cmsg;
+	union {
+		char buf[CMSG_SPACE(SHM_FEED_FDS * sizeof(int))];
+		struct cmsghdr align;
+	} u;
+	int fds[SHM_FEED_FDS];
+	struct stat st;
+	socklen_t len;
+	char c;
+
+	f = shm_feed_alloc(name);
+	if (!f)
+		return NULL;
+
+	f->conn_fd = socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+	if (f->conn_fd < 0) {
+		perror("socket");
+		goto error;
+	}
+	len = shm_feed_sockaddr(name, &sun);
+	if (connect(f->conn_fd, (struct sockaddr *)&sun, len) < 0) {
+		perror("connect");
+		goto error;
+	}
+
+	iov.iov_base = &c;
+	iov.iov_len = 1;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = u.buf;
+	msg.msg_controllen = sizeof(u.buf);
+	if (recvmsg(f->conn_fd, &msg, MSG_CMSG_CLOEXEC) <= 0) {
+		fprintf(stderr, "shm_feed: @%s refused the producer\n", name);
+		goto error;
+	}
+
+	cmsg = CMSG_FIRSTHDR(&msg);
+	if (!cmsg || cmsg->cmsg_type != SCM_RIGHTS ||
+	    cmsg->cmsg_len != CMSG_LEN(sizeof(fds)))
+		goto error;
+	memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+	f->memfd = fds[0];
+	f->data_fd = fds[1];
+	f->space_fd = fds[2];
+	f->underrun_fd = fds[3];
+
+	if (fstat(f->memfd, &st) < 0 ||
+	    st.st_size < sizeof(struct shm_feed_hdr))
+		goto error;
+	f->size = st.st_size;
+
+	f->hdr = mmap(NULL, f->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			f->memfd, 0);
+	if (f->hdr == MAP_FAILED) {
+		perror("mmap");
+		goto error;
+	}
+
+	if (__atomic_load_n(&f->hdr->magic, __ATOMIC_ACQUIRE) !=
+						SHM_FEED_MAGIC ||
+	    sizeof(struct shm_feed_hdr) +
+	    (size_t)f->hdr->slots * f->hdr->stride > f->size) {
+		fprintf(stderr, "shm_feed: @%s is not ready\n", name);
+		goto error;
+	}
+
+	return f;
+
+error:
+	shm_feed_free(f);
+
+	return NULL;
+}
+
+/* the talker drains the committed payloads and ends the stream */
+void shm_feed_disconnect(struct shm_feed *f)
+{
+	if (!f)
+		return;
+
+	if (f->hdr != MAP_FAILED) {
+		__atomic_store_n(&f->hdr->closed, 1, __ATOMIC_RELEASE);
+		shm_feed_kick(&f->hdr->consumer_waiting, f->data_fd);
+	}
+
+	shm_feed_free(f);
+}
+
+/*
+ * Free slot to write the next payload in place, waiting up to timeout
+ * msec (-1:infinite) while the ring is full. NULL on timeout or when
+ * the talker is gone.
+ */
+void *shm_feed_reserve(struct shm_feed *f, int timeout)
+{
+	struct shm_feed_hdr *hdr = f->hdr;
+	struct pollfd pfd[2];
+	uint64_t head = hdr->head;
+	bool full;
+
+	if (head - __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE) < hdr->slots)
+		return shm_feed_slot_of(hdr, head)->data;
+
+	if (f->hangup || !timeout)
+		return NULL;
+
+	__atomic_store_n(&hdr->full_waits, hdr->full_waits + 1,
+				__ATOMIC_RELAXED);
+	__atomic_store_n(&hdr->producer_waiting, 1, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
+	full = (head - __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE) >=
+							hdr->slots);
+	if (full) {
+		pfd[0].fd = f->space_fd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = f->conn_fd;
+		pfd[1].events = POLLRDHUP;
+		if (poll(pfd, 2, timeout) > 0) {
+			if (pfd[0].revents & POLLIN)
+				shm_feed_drain(f->space_fd);
+			if (pfd[1].revents & (POLLRDHUP | POLLHUP | POLLERR))
+				f->hangup = true;
+		}
+	}
+	__atomic_store_n(&hdr->producer_waiting, 0, __ATOMIC_RELAXED);
+
+	if (head - __atomic_load_n(&hdr->tail, __ATOMIC_ACQUIRE) < hdr->slots)
+		return shm_feed_slot_of(hdr, head)->data;
+
+	return NULL;
+}
+
+/* publish len bytes written to the reserved slot */
+void shm_feed_commit(struct shm_feed *f, int len)
+{
+	struct shm_feed_hdr *hdr = f->hdr;
+	uint64_t head = hdr->head;
+
+	if (len > hdr->slot_size)
+		len = hdr->slot_size;
+	shm_feed_slot_of(hdr, head)->len = len;
+
+	__atomic_store_n(&hdr->head, head + 1, __ATOMIC_RELEASE);
+	shm_feed_kick(&hdr->consumer_waiting, f->data_fd);
+}
+
+/* underruns signalled by the talker since the last call */
+int shm_feed_underruns(struct shm_feed *f)
+{
+	eventfd_t value;
+
+	if (eventfd_read(f->underrun_fd, &value) < 0)
+		return 0;
+
+	return value;
+}
+
+int shm_feed_slot_size(struct shm_feed *f)
+{
+	return f->hdr->slot_size;
+}
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __SHM_FEED_H__
+#define __SHM_FEED_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SHM_FEED_MAGIC     (0x46373232) /* "F722" */
+#define SHM_FEED_ALIGN     (64)         /* cache line */
+
+/* a payload written by the producer */
+struct shm_feed_slot {
+	uint32_t len;
+	uint8_t  data[] __attribute__((aligned(SHM_FEED_ALIGN)));
+};
+
+/*
+ * Each side writes its own cache line only. A side going to sleep sets
+ * its waiting flag and the other side kicks the eventfd when it sees the
+ * flag, so no syscall is made while both sides keep up.
+ */
+struct shm_feed_hdr {
+	uint32_t magic;
+	uint32_t slots;            /* power of 2 */
+	uint32_t slot_size;        /* payload bytes of a slot */
+	uint32_t stride;           /* bytes from a slot to the next */
+
+	/* producer */
+	uint64_t head __attribute__((aligned(SHM_FEED_ALIGN)));
+	uint64_t full_waits;       /* producer blocked by the talker */
+	uint32_t producer_waiting;
+	uint32_t closed;
+
+	/* talker */
+	uint64_t tail __attribute__((aligned(SHM_FEED_ALIGN)));
+	uint64_t underruns;        /* tx queue ran dry for lack of payloads */
+	uint32_t consumer_waiting;
+
+	uint8_t  slot[] __attribute__((aligned(SHM_FEED_ALIGN)));
+};
+
+/*
+ * Lock-free single producer ring of payloads in shared memory from an
+ * application to simple_talker. The talker creates the ring on a memfd
+ * and hands it to the producer connecting to the abstract unix socket
+ * @name, together with the eventfds:
+ *  - data:     producer -> talker, payloads committed to an empty ring
+ *  - space:    talker -> producer, slots released to a full ring
+ *  - underrun: talker -> producer, the stream ran out of payloads
+ * The producer writes payloads in place in the slots.
+ */
+struct shm_feed {
+	char                 *name;
+	struct shm_feed_hdr  *hdr;
+	size_t               size;
+	int                  memfd;
+	int                  data_fd;
+	int                  space_fd;
+	int                  underrun_fd;
+	int                  listen_fd;  /* talker, -1:producer */
+	int                  conn_fd;    /* the producer connection */
+	bool                 hangup;
+	uint64_t             consumed;
+};
+
+/* talker */
+extern struct shm_feed *shm_feed_create(const char *name, int slots,
+					int slot_size);
+extern void shm_feed_destroy(struct shm_feed *f);
+extern int shm_feed_available(struct shm_feed *f);
+extern struct shm_feed_slot *shm_feed_slot(struct shm_feed *f, int i);
+extern void shm_feed_consume(struct shm_feed *f, int n);
+extern void shm_feed_underrun(struct shm_feed *f);
+extern bool shm_feed_eof(struct shm_feed *f);
+extern int shm_feed_wait(struct shm_feed *f, int fd, int timeout);
+extern void shm_feed_report(struct shm_feed *f, char *buf, int buflen);
+
+/* producer */
+extern struct shm_feed *shm_feed_connect(const char *name);
+extern void shm_feed_disconnect(struct shm_feed *f);
+extern void *shm_feed_reserve(struct shm_feed *f, int timeout);
+extern void shm_feed_commit(struct shm_feed *f, int len);
+extern int shm_feed_underruns(struct shm_feed *f);
+extern int shm_feed_slot_size(struct shm_feed *f);
+
+#endif /* __SHM_FEED_H__ */
@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#define _GNU_SOURCE /* asprintf */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm_heartbeat.h"
+
+/*
+ * Both the talker and the standby open the memory, whichever comes
+ * first creates it. The data size is agreed on by the first opener.
+ */
+struct shm_heartbeat *shm_heartbeat_open(const char *name, size_t size)
+{
+	struct shm_heartbeat *hb;
+	struct stat st;
+	uint32_t expected = 0;
+	int fd = -1;
+
+	hb = calloc(1, sizeof(*hb));
+	if (!hb)
+		return NULL;
+
+	hb->hdr = MAP_FAILED;
+	hb->pid = getpid();
+	hb->size = sizeof(*hb->hdr) + size;
+
+	/* POSIX shared memory names start with '/' */
+	if (asprintf(&hb->name, "%s%s", (name[0] == '/') ? "" : "/",
+		     name) < 0) {
+		hb->name = NULL;
+		goto error;
+	}
+
+	fd = shm_open(hb->name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (fd < 0) {
+		perror("shm_open");
+		goto error;
+	}
+	if (fstat(fd, &st) < 0) {
+		perror("fstat");
+		goto error;
+	}
+	if ((size_t)st.st_size < hb->size && ftruncate(fd, hb->size) < 0) {
+		perror("ftruncate");
+		goto error;
+	}
+
+	hb->hdr = mmap(NULL, hb->size, PROT_READ | PROT_WRITE, MAP_SHARED,
+			fd, 0);
+	if (hb->hdr == MAP_FAILED) {
+		perror("mmap");
+		goto error;
+	}
+	close(fd);
+	fd = -1;
+
+	if (!__atomic_compare_exchange_n(&hb->hdr->size, &expected, size,
+					 false, __ATOMIC_SEQ_CST,
+					 __ATOMIC_SEQ_CST) &&
+	    expected != size) {
+		fprintf(stderr, "heartbeat %s: data of %u bytes, not %zu\n",
+				hb->name, expected, size);
+		goto error;
+	}
+	__atomic_store_n(&hb->hdr->magic, SHM_HEARTBEAT_MAGIC,
+				__ATOMIC_RELEASE);
+
+	return hb; /* Success */
+
+error:
+	if (fd >= 0)
+		close(fd);
+	shm_heartbeat_close(hb);
+
+	return NULL;
+}
+
+/*
+ * The stream ends with the owner unless it is handed over, and so does
+ * the memory. A standby still on it sees the end of the stream.
+ */
+void shm_heartbeat_close(struct shm_heartbeat *hb)
+{
+	if (!hb)
+		return;
+
+	if (hb->hdr != MAP_FAILED) {
+		if (shm_heartbeat_owned(hb)) {
+			shm_heartbeat_stop(hb);
+			shm_unlink(hb->name);
+		}
+		munmap(hb->hdr, hb->size);
+	}
+	free(hb->name);
+	free(hb);
+}
+
+bool shm_heartbeat_alive(pid_t pid)
+{
+	if (pid <= 0)
+		return false;
+
+	return !kill(pid, 0) || errno != ESRCH;
+}
+
+static void shm_heartbeat_write(struct shm_heartbeat *hb, uint64_t time,
+				uint64_t due, const void *data)
+{
+	struct shm_heartbeat_hdr *hdr = hb->hdr;
+	uint32_t gen;
+
+	/* odd already if the previous owner crashed in the middle */
+	gen = (hdr->gen + 1) | 1;
+	__atomic_store_n(&hdr->gen, gen, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	hdr->beats = hb->beats;
+	hdr->time = time;
+	hdr->due = due;
+	if (data)
+		memcpy(hdr->data, data, hdr->size);
+
+	__atomic_store_n(&hdr->gen, gen + 1, __ATOMIC_RELEASE);
+}
+
+/* become the owner, unless another talker is streaming */
+int shm_heartbeat_start(struct shm_heartbeat *hb)
+{
+	struct shm_heartbeat_hdr *hdr = hb->hdr;
+	uint32_t owner;
+
+	owner = __atomic_load_n(&hdr->owner, __ATOMIC_ACQUIRE);
+	if (owner != (uint32_t)hb->pid &&
+	    __atomic_load_n(&hdr->state, __ATOMIC_ACQUIRE) ==
+			SHM_HEARTBEAT_RUNNING &&
+	    shm_heartbeat_alive(owner)) {
+		fprintf(stderr, "heartbeat %s: pid %u is streaming\n",
+				hb->name, owner);
+		return -1;
+	}
+
+	if (!__atomic_compare_exchange_n(&hdr->owner, &owner, hb->pid, false,
+					 __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+		fprintf(stderr, "heartbeat %s: taken by pid %u\n",
+				hb->name, owner);
+		return -1;
+	}
+
+	/* no data until the first beat */
+	hb->beats = 0;
+	shm_heartbeat_write(hb, 0, 0, NULL);
+	__atomic_store_n(&hdr->state, SHM_HEARTBEAT_RUNNING, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+/* false once another process has taken the stream over */
+bool shm_heartbeat_owned(struct shm_heartbeat *hb)
+{
+	return __atomic_load_n(&hb->hdr->owner, __ATOMIC_ACQUIRE) ==
+			(uint32_t)hb->pid;
+}
+
+/*
+ * Publish the state of the stream at time, the next beat comes by due.
+ * Returns -1 when another process has taken the stream over.
+ */
+int shm_heartbeat_beat(struct shm_heartbeat *hb, uint64_t time, uint64_t due,
+		       const void *data)
+{
+	if (!shm_heartbeat_owned(hb))
+		return -1;
+
+	hb->beats++;
+	shm_heartbeat_write(hb, time, due, data);
+
+	return 0;
+}
+
+/* the stream is over, the standby must not take it over */
+void shm_heartbeat_stop(struct shm_heartbeat *hb)
+{
+	uint32_t state = SHM_HEARTBEAT_RUNNING;
+
+	if (!shm_heartbeat_owned(hb))
+		return;
+
+	__atomic_compare_exchange_n(&hb->hdr->state, &state,
+				    SHM_HEARTBEAT_DONE, false,
+				    __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+}
+
+/* pass the ownership on to pid, which beats from now */
+int shm_heartbeat_handover(struct shm_heartbeat *hb, pid_t pid)
+{
+	uint32_t expected = hb->pid;
+
+	if (!__atomic_compare_exchange_n(&hb->hdr->owner, &expected, pid,
+					 false, __ATOMIC_SEQ_CST,
+					 __ATOMIC_SEQ_CST)) {
+		fprintf(stderr, "heartbeat %s: taken by pid %u\n",
+				hb->name, expected);
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Copy the last beat. Returns -1 while the owner is writing it or has
+ * not beaten yet, the previous copy stays valid then.
+ */
+int shm_heartbeat_read(struct shm_heartbeat *hb, uint64_t *time,
+		       uint64_t *due, void *data)
+{
+	struct shm_heartbeat_hdr *hdr = hb->hdr;
+	uint32_t gen;
+	uint64_t beats, t, d;
+
+	gen = __atomic_load_n(&hdr->gen, __ATOMIC_ACQUIRE);
+	if (gen & 1)
+		return -1;
+
+	beats = hdr->beats;
+	t = hdr->time;
+	d = hdr->due;
+	if (beats)
+		memcpy(data, hdr->data, hdr->size);
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	if (__atomic_load_n(&hdr->gen, __ATOMIC_RELAXED) != gen || !beats)
+		return -1;
+
+	*time = t;
+	*due = d;
+
+	return 0;
+}
+
+pid_t shm_heartbeat_owner(struct shm_heartbeat *hb)
+{
+	return __atomic_load_n(&hb->hdr->owner, __ATOMIC_ACQUIRE);
+}
+
+int shm_heartbeat_state(struct shm_heartbeat *hb)
+{
+	return __atomic_load_n(&hb->hdr->state, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Swap the owner for this process, the owner stops at its next beat.
+ * Fails if another standby was faster. Also takes back a handover.
+ */
+int shm_heartbeat_takeover(struct shm_heartbeat *hb, pid_t owner)
+{
+	uint32_t expected = owner;
+
+	if (!__atomic_compare_exchange_n(&hb->hdr->owner, &expected, hb->pid,
+					 false, __ATOMIC_SEQ_CST,
+					 __ATOMIC_SEQ_CST))
+		return -1;
+
+	hb->beats = __atomic_load_n(&hb->hdr->beats, __ATOMIC_RELAXED);
+
+	return 0;
+}
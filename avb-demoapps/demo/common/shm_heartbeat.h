@@ -0,0 +1,78 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __SHM_HEARTBEAT_H__
+#define __SHM_HEARTBEAT_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#define SHM_HEARTBEAT_MAGIC  (0x48373232) /* "H722" */
+#define SHM_HEARTBEAT_ALIGN  (64)         /* cache line */
+
+enum {
+	SHM_HEARTBEAT_IDLE = 0,    /* no talker has started yet */
+	SHM_HEARTBEAT_RUNNING,     /* the owner is streaming */
+	SHM_HEARTBEAT_DONE,        /* the owner has ended the stream */
+};
+
+/*
+ * The owner writes the time and the state under the gen counter, odd
+ * while it is writing, so a reader copies a consistent beat without a
+ * lock. A reader takes the stream over by swapping the owner pid, and
+ * the owner stops beating as soon as it sees another pid there.
+ */
+struct shm_heartbeat_hdr {
+	uint32_t magic;
+	uint32_t size;             /* bytes of data */
+	uint32_t owner;            /* pid of the talker streaming */
+	uint32_t state;
+
+	uint32_t gen __attribute__((aligned(SHM_HEARTBEAT_ALIGN)));
+	uint64_t beats;            /* since the owner started, 0:no data yet */
+	uint64_t time;             /* of the beat */
+	uint64_t due;              /* of the next beat at the latest */
+
+	uint8_t  data[] __attribute__((aligned(SHM_HEARTBEAT_ALIGN)));
+};
+
+/*
+ * Heartbeat of a talker to a standby one in the POSIX shared memory
+ * @name. Unlike shm_feed it is not tied to the creating process: it
+ * outlives a talker crashed, and the standby taking over goes on
+ * beating in it for the next standby.
+ */
+struct shm_heartbeat {
+	char                     *name;
+	struct shm_heartbeat_hdr *hdr;
+	size_t                   size;
+	pid_t                    pid;
+	uint64_t                 beats;
+};
+
+extern struct shm_heartbeat *shm_heartbeat_open(const char *name,
+						size_t size);
+extern void shm_heartbeat_close(struct shm_heartbeat *hb);
+extern bool shm_heartbeat_alive(pid_t pid);
+
+/* owner */
+extern int shm_heartbeat_start(struct shm_heartbeat *hb);
+extern bool shm_heartbeat_owned(struct shm_heartbeat *hb);
+extern int shm_heartbeat_beat(struct shm_heartbeat *hb, uint64_t time,
+			      uint64_t due, const void *data);
+extern void shm_heartbeat_stop(struct shm_heartbeat *hb);
+extern int shm_heartbeat_handover(struct shm_heartbeat *hb, pid_t pid);
+
+/* standby */
+extern int shm_heartbeat_read(struct shm_heartbeat *hb, uint64_t *time,
+			      uint64_t *due, void *data);
+extern pid_t shm_heartbeat_owner(struct shm_heartbeat *hb);
+extern int shm_heartbeat_state(struct shm_heartbeat *hb);
+extern int shm_heartbeat_takeover(struct shm_heartbeat *hb, pid_t owner);
+
+#endif /* __SHM_HEARTBEAT_H__ */
@@ -0,0 +1,353 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "shm_ring.h"
+
+/* sequence of a slot being written */
+#define SHM_RING_SEQ_BUSY (UINT64_MAX)
+
+static inline struct shm_ring_slot *shm_ring_slot(struct shm_ring_hdr *hdr,
+						  uint64_t seq)
+{
+	return &hdr->slot[seq & (hdr->slots - 1)];
+}
+
+static size_t shm_ring_size(int slots)
+{
+	return sizeof(struct shm_ring_hdr) +
+		(size_t)slots * sizeof(struct shm_ring_slot);
+}
+
+static struct shm_ring *shm_ring_map(const char *name, int fd, size_t size,
+				     int consumer)
+{
+	struct shm_ring *r;
+
+	r = calloc(1, sizeof(*r));
+	if (!r)
+		return NULL;
+
+	r->hdr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	if (r->hdr == MAP_FAILED) {
+		perror("mmap");
+		free(r);
+		return NULL;
+	}
+
+	r->name = strdup(name);
+	r->size = size;
+	r->consumer = consumer;
+
+	return r;
+}
+
+static void shm_ring_unmap(struct shm_ring *r)
+{
+	munmap(r->hdr, r->size);
+	free(r->name);
+	free(r);
+}
+
+/* take a free cursor or the one of an exited process */
+static int shm_ring_claim(struct shm_ring_hdr *hdr)
+{
+	struct shm_ring_cursor *c;
+	int32_t pid;
+	int i;
+
+	for (i = 0; i < SHM_RING_CONSUMERS; i++) {
+		c = &hdr->consumers[i];
+		pid = __atomic_load_n(&c->pid, __ATOMIC_ACQUIRE);
+		if (pid && (kill(pid, 0) == 0 || errno != ESRCH))
+			continue;
+		if (!__atomic_compare_exchange_n(&c->pid, &pid, getpid(),
+				false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+			continue;
+
+		/* start from the next frame */
+		c->overruns = 0;
+		__atomic_store_n(&c->cursor,
+			__atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE),
+			__ATOMIC_RELEASE);
+		return i;
+	}
+
+	return -1;
+}
+
+/*
+ * public functions
+ */
+/*
+ * The ring of the last run is kept when it has the same slots, so the
+ * consumers still attached go on reading when the listener restarts.
+ */
+struct shm_ring *shm_ring_create(const char *name, int slots)
+{
+	struct shm_ring *r;
+	struct shm_ring_hdr *hdr;
+	struct stat st;
+	size_t size;
+	uint64_t head = 0;
+	int fd, i;
+
+	if (slots <= 0 || (slots & (slots - 1)))
+		return NULL;
+
+	fd = shm_open(name, O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		perror("shm_open");
+		return NULL;
+	}
+
+	size = shm_ring_size(slots);
+	if (fstat(fd, &st) < 0 || st.st_size != size) {
+		/*
+		 * Resizing in place faults the consumers mapping the old
+		 * size, give them a new ring and leave them the old one.
+		 */
+		close(fd);
+		shm_unlink(name);
+		fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+		if (fd < 0) {
+			perror("shm_open");
+			return NULL;
+		}
+		if (ftruncate(fd, size) < 0) {
+			perror("ftruncate");
+			close(fd);
+			shm_unlink(name);
+			return NULL;
+		}
+	}
+
+	r = shm_ring_map(name, fd, size, -1);
+	close(fd);
+	if (!r) {
+		shm_unlink(name);
+		return NULL;
+	}
+	hdr = r->hdr;
+
+	if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) == SHM_RING_MAGIC &&
+	    hdr->slots == slots) {
+		/* go on from the last sequence, the cursors stay valid */
+		head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	} else {
+		/* not ready for attach until initialized */
+		__atomic_store_n(&hdr->magic, 0, __ATOMIC_RELEASE);
+		for (i = 0; i < SHM_RING_CONSUMERS; i++)
+			memset(&hdr->consumers[i], 0,
+					sizeof(hdr->consumers[i]));
+		hdr->slots = slots;
+	}
+
+	/*
+	 * A slot is read only once head passed it, so the sequences of
+	 * the slots need no reset. A slot left busy by the last run is
+	 * skipped as overwritten.
+	 */
+	__atomic_store_n(&hdr->head, head, __ATOMIC_RELEASE);
+	__atomic_store_n(&hdr->magic, SHM_RING_MAGIC, __ATOMIC_RELEASE);
+
+	return r;
+}
+
+/* the ring is left to the consumers still attached for the next run */
+void shm_ring_destroy(struct shm_ring *r)
+{
+	struct shm_ring_cursor *c;
+	int32_t pid;
+	int i;
+
+	if (!r)
+		return;
+
+	for (i = 0; i < SHM_RING_CONSUMERS; i++) {
+		c = &r->hdr->consumers[i];
+		pid = __atomic_load_n(&c->pid, __ATOMIC_ACQUIRE);
+		if (pid && (kill(pid, 0) == 0 || errno != ESRCH))
+			break;
+	}
+	if (i == SHM_RING_CONSUMERS)
+		shm_unlink(r->name);
+
+	shm_ring_unmap(r);
+}
+
+/* copy a frame to the ring, overwriting the oldest one */
+void shm_ring_publish(struct shm_ring *r, void *frame, int len,
+		      uint64_t arrival)
+{
+	struct shm_ring_hdr *hdr = r->hdr;
+	struct shm_ring_slot *slot;
+	uint64_t seq = hdr->head;
+
+	if (len > SHM_RING_FRAME_MAX)
+		len = SHM_RING_FRAME_MAX;
+
+	/* readers of the old frame see the slot is changing */
+	slot = shm_ring_slot(hdr, seq);
+	__atomic_store_n(&slot->seq, SHM_RING_SEQ_BUSY, __ATOMIC_RELAXED);
+	__atomic_thread_fence(__ATOMIC_RELEASE);
+
+	memcpy(slot->frame, frame, len);
+	slot->len = len;
+	slot->arrival = arrival;
+
+	__atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+	__atomic_store_n(&hdr->head, seq + 1, __ATOMIC_RELEASE);
+	r->published++;
+}
+
+void shm_ring_report(struct shm_ring *r, char *buf, int buflen)
+{
+	struct shm_ring_hdr *hdr = r->hdr;
+	struct shm_ring_cursor *c;
+	uint64_t head, cursor;
+	int32_t pid;
+	int i, len;
+
+	head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+	len = snprintf(buf, buflen,
+		"shm %s %"PRIu64" frames on %u slots", r->name,
+		r->published, hdr->slots);
+
+	for (i = 0; i < SHM_RING_CONSUMERS && len < buflen; i++) {
+		c = &hdr->consumers[i];
+		pid = __atomic_load_n(&c->pid, __ATOMIC_ACQUIRE);
+		if (!pid)
+			continue;
+		cursor = __atomic_load_n(&c->cursor, __ATOMIC_ACQUIRE);
+		len += snprintf(buf + len, buflen - len,
+			"\nshm consumer%d pid %d lag %"PRIu64" frames %"PRIu64" overruns",
+			i, pid, head - cursor, c->overruns);
+	}
+}
+
+struct shm_ring *shm_ring_attach(const char *name)
+{
+	struct shm_ring *r;
+	struct stat st;
+	int fd, consumer;
+
+	fd = shm_open(name, O_RDWR, 0);
+	if (fd < 0) {
+		perror("shm_open");
+		return NULL;
+	}
+
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(struct shm_ring_hdr)) {
+		close(fd);
+		return NULL;
+	}
+
+	r = shm_ring_map(name, fd, st.st_size, -1);
+	close(fd);
+	if (!r)
+		return NULL;
+
+	if (__atomic_load_n(&r->hdr->magic, __ATOMIC_ACQUIRE) !=
+						SHM_RING_MAGIC ||
+	    shm_ring_size(r->hdr->slots) > r->size) {
+		fprintf(stderr, "shm_ring: %s is not ready\n", name);
+		goto error;
+	}
+
+	consumer = shm_ring_claim(r->hdr);
+	if (consumer < 0) {
+		fprintf(stderr, "shm_ring: %s has no free consumer\n", name);
+		goto error;
+	}
+	r->consumer = consumer;
+
+	return r;
+
+error:
+	shm_ring_unmap(r);
+
+	return NULL;
+}
+
+void shm_ring_detach(struct shm_ring *r)
+{
+	if (!r)
+		return;
+
+	__atomic_store_n(&r->hdr->consumers[r->consumer].pid, 0,
+				__ATOMIC_RELEASE);
+	shm_ring_unmap(r);
+}
+
+/*
+ * Next frame of the consumer, NULL if none. The frame is used in place
+ * and shm_ring_release() tells whether it was overwritten meanwhile.
+ */
+struct shm_ring_slot *shm_ring_peek(struct shm_ring *r)
+{
+	struct shm_ring_hdr *hdr = r->hdr;
+	struct shm_ring_cursor *c = &hdr->consumers[r->consumer];
+	struct shm_ring_slot *slot;
+	uint64_t head, seq;
+
+	for (;;) {
+		head = __atomic_load_n(&hdr->head, __ATOMIC_ACQUIRE);
+		if (c->cursor == head)
+			return NULL;
+
+		/* skip the overwritten frames */
+		if (head - c->cursor > hdr->slots) {
+			c->overruns += head - hdr->slots - c->cursor;
+			__atomic_store_n(&c->cursor, head - hdr->slots,
+						__ATOMIC_RELEASE);
+		}
+
+		slot = shm_ring_slot(hdr, c->cursor);
+		seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+		if (seq == c->cursor) {
+			r->peeked = slot;
+			return slot;
+		}
+
+		/* being overwritten by the producer */
+		c->overruns++;
+		__atomic_store_n(&c->cursor, c->cursor + 1, __ATOMIC_RELEASE);
+	}
+}
+
+/* done with the peeked frame, -1 if it was overwritten while used */
+int shm_ring_release(struct shm_ring *r)
+{
+	struct shm_ring_cursor *c = &r->hdr->consumers[r->consumer];
+	bool valid;
+
+	if (!r->peeked)
+		return -1;
+
+	__atomic_thread_fence(__ATOMIC_ACQUIRE);
+	valid = (__atomic_load_n(&r->peeked->seq, __ATOMIC_RELAXED) ==
+							c->cursor);
+	r->peeked = NULL;
+
+	__atomic_store_n(&c->cursor, c->cursor + 1, __ATOMIC_RELEASE);
+	if (!valid) {
+		c->overruns++;
+		return -1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __SHM_RING_H__
+#define __SHM_RING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define SHM_RING_MAGIC     (0x31373232) /* "1722" */
+#define SHM_RING_CONSUMERS (16)
+#define SHM_RING_FRAME_MAX (1536)
+#define SHM_RING_ALIGN     (64)         /* cache line */
+
+/* read position of a consumer, written by the consumer only */
+struct shm_ring_cursor {
+	uint64_t cursor;    /* sequence to read next */
+	uint64_t overruns;  /* frames overwritten before read */
+	int32_t  pid;       /* 0:free */
+} __attribute__((aligned(SHM_RING_ALIGN)));
+
+/* a received frame, valid while seq is the sequence of the reader */
+struct shm_ring_slot {
+	uint64_t seq;
+	uint64_t arrival;   /* ns on the clock of the listener, 0:unknown */
+	uint32_t len;
+	uint8_t  frame[SHM_RING_FRAME_MAX] __attribute__((aligned(SHM_RING_ALIGN)));
+} __attribute__((aligned(SHM_RING_ALIGN)));
+
+struct shm_ring_hdr {
+	uint32_t magic;
+	uint32_t slots;     /* power of 2 */
+	uint64_t head __attribute__((aligned(SHM_RING_ALIGN)));
+	struct shm_ring_cursor consumers[SHM_RING_CONSUMERS];
+	struct shm_ring_slot   slot[];
+};
+
+/*
+ * Lock-free ring in POSIX shared memory from one producer to up to
+ * SHM_RING_CONSUMERS readers. The producer never waits for readers, a
+ * reader behind by more than the ring loses the overwritten frames.
+ * Readers use the frames in place without copy.
+ */
+struct shm_ring {
+	char                 *name;
+	struct shm_ring_hdr  *hdr;
+	size_t               size;
+	int                  consumer;  /* index of cursor, -1:producer */
+	struct shm_ring_slot *peeked;
+	uint64_t             published;
+};
+
+/* producer */
+extern struct shm_ring *shm_ring_create(const char *name, int slots);
+extern void shm_ring_destroy(struct shm_ring *r);
+extern void shm_ring_publish(struct shm_ring *r, void *frame, int len,
+			     uint64_t arrival);
+extern void shm_ring_report(struct shm_ring *r, char *buf, int buflen);
+
+/* consumer */
+extern struct shm_ring *shm_ring_attach(const char *name);
+extern void shm_ring_detach(struct shm_ring *r);
+extern struct shm_ring_slot *shm_ring_peek(struct shm_ring *r);
+extern int shm_ring_release(struct shm_ring *r);
+
+#endif /* __SHM_RING_H__ */
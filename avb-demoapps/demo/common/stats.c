@@ -12,6 +12,8 @@
 #include <stdbool.h>
 
 #include "stats.h"
+#include "analyzer.h"
+#include "media_clock.h"
 
 static inline double stats_guess_unit(double value)
 {
@@ -57,6 +59,7 @@ void stats_report(struct app_stats *stats, char *buf, int buflen)
 	uint64_t et, st;
 	double bps, duration;
 	double total;
+	int len;
 
 	/* not started */
 	if (!stats->start)
@@ -72,9 +75,15 @@ void stats_report(struct app_stats *stats, char *buf, int buflen)
 	duration = (double)(et - st) / 1000000;
 	bps = (double)(stats->bytes * 8) / duration;
 
-	snprintf(buf, buflen, "%"PRIu64"packets %.3f%sB/%.3fs=%.3f%sbps",
+	len = snprintf(buf, buflen, "%"PRIu64"packets %.3f%sB/%.3fs=%.3f%sbps",
 		stats->packets,
 		total/stats_guess_unit(total), stats_guess_label(total),
 		duration,
 		bps/stats_guess_unit(bps), stats_guess_label(bps));
+
+	if (stats->analyzer && len < buflen)
+		len += analyzer_report(stats->analyzer, buf + len, buflen - len);
+
+	if (stats->media_clock && len < buflen)
+		media_clock_report(stats->media_clock, buf + len, buflen - len);
 }
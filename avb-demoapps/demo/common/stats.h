@@ -10,6 +10,9 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+struct analyzer;
+struct media_clock;
+
 struct app_stats {
 	bool            start;
 	struct timespec stime;
@@ -17,6 +20,8 @@ struct app_stats {
 	uint64_t        packets;
 	uint64_t        dropped; /* TODO */
 	uint64_t        errors;  /* TODO */
+	struct analyzer *analyzer; /* per-stream summary, optional */
+	struct media_clock *media_clock; /* recovered clock, optional */
 };
 
 extern void stats_process(struct app_stats *stats, int length);
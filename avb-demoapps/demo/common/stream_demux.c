@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "stream_demux.h"
+
+/* the busier stream takes the queue at 25% more packets */
+#define STREAM_DEMUX_HYSTERESIS (125)
+
+static bool stream_demux_streamid_valid(uint8_t streamid[])
+{
+	int i;
+
+	for (i = 0; i < AVTP_STREAMID_SIZE; i++)
+		if (streamid[i])
+			return true;
+
+	return false;
+}
+
+static inline unsigned int stream_demux_hash(uint8_t streamid[])
+{
+	uint64_t key;
+
+	memcpy(&key, streamid, sizeof(key));
+
+	/* Fibonacci hashing */
+	return (key * 0x9e3779b97f4a7c15ULL) >>
+			(64 - __builtin_ctz(STREAM_DEMUX_SLOTS));
+}
+
+/* slot of streamid, or the free slot to insert it */
+static struct demux_stream *stream_demux_slot(struct stream_demux *d,
+					      uint8_t streamid[], int *probe)
+{
+	struct demux_stream *s;
+	unsigned int i;
+
+	i = stream_demux_hash(streamid);
+	for (*probe = 1; ; (*probe)++) {
+		s = &d->streams[i];
+		if (!__atomic_load_n(&s->used, __ATOMIC_ACQUIRE) ||
+		    !memcmp(s->StreamID, streamid, AVTP_STREAMID_SIZE))
+			return s;
+		i = (i + 1) & (STREAM_DEMUX_SLOTS - 1);
+	}
+}
+
+static struct demux_stream *stream_demux_insert(struct stream_demux *d,
+						uint8_t streamid[])
+{
+	struct demux_stream *s;
+	int probe;
+
+	s = stream_demux_slot(d, streamid, &probe);
+	if (s->used)
+		return s;
+	if (d->nstreams >= STREAM_DEMUX_STREAMS)
+		return NULL;
+
+	memcpy(s->StreamID, streamid, AVTP_STREAMID_SIZE);
+	s->queue = -1;
+	s->seqno = -1;
+	__atomic_store_n(&s->used, true, __ATOMIC_RELEASE);
+
+	d->nstreams++;
+	if (probe > d->max_probe)
+		d->max_probe = probe;
+
+	return s;
+}
+
+static int stream_demux_assign(struct stream_demux *d, int queue,
+			       struct demux_stream *s)
+{
+	struct demux_stream *old = d->queues[queue];
+
+	if (d->assign(d->arg, queue, s->StreamID) < 0) {
+		d->errors++;
+		return -1;
+	}
+
+	if (old) {
+		old->queue = -1;
+		old->seqno = -1;
+	}
+	d->queues[queue] = s;
+	s->queue = queue;
+	s->moves++;
+	d->assigns++;
+
+	return 0;
+}
+
+static int stream_demux_free_queue(struct stream_demux *d)
+{
+	int i;
+
+	for (i = 0; i < d->nqueues; i++)
+		if (!d->queues[i])
+			return i;
+
+	return -1;
+}
+
+/* move the busiest software streams to the least busy queues */
+static void stream_demux_rebalance(struct stream_demux *d)
+{
+	struct demux_stream *s, *busiest;
+	uint64_t total;
+	int i, queue, n;
+
+	for (i = 0; i < STREAM_DEMUX_SLOTS; i++) {
+		s = &d->streams[i];
+		if (!s->used)
+			continue;
+		total = s->stats.packets +
+			__atomic_load_n(&s->hw_packets, __ATOMIC_RELAXED);
+		s->rate = total - s->mark;
+		s->mark = total;
+	}
+
+	for (n = 0; n < d->nqueues; n++) {
+		busiest = NULL;
+		for (i = 0; i < STREAM_DEMUX_SLOTS; i++) {
+			s = &d->streams[i];
+			if (s->used && s->queue < 0 && s->rate &&
+			    (!busiest || s->rate > busiest->rate))
+				busiest = s;
+		}
+		if (!busiest)
+			return;
+
+		queue = stream_demux_free_queue(d);
+		if (queue < 0) {
+			for (i = 0; i < d->nqueues; i++)
+				if (queue < 0 || d->queues[i]->rate <
+						d->queues[queue]->rate)
+					queue = i;
+			if (busiest->rate * 100 <= d->queues[queue]->rate *
+						STREAM_DEMUX_HYSTERESIS)
+				return;
+		}
+
+		if (stream_demux_assign(d, queue, busiest) < 0)
+			return;
+	}
+}
+
+/*
+ * public functions
+ */
+struct stream_demux *stream_demux_new(
+		int (*assign)(void *arg, int queue, uint8_t streamid[]),
+		void *arg, uint64_t period)
+{
+	struct stream_demux *d;
+
+	d = calloc(1, sizeof(*d));
+	if (!d)
+		return NULL;
+
+	d->assign = assign;
+	d->arg = arg;
+	d->period = period;
+
+	return d;
+}
+
+void stream_demux_free(struct stream_demux *d)
+{
+	free(d);
+}
+
+/* add a hardware queue with its current StreamID, zero if free */
+int stream_demux_add_queue(struct stream_demux *d, uint8_t streamid[])
+{
+	struct demux_stream *s;
+	int queue;
+
+	if (d->nqueues >= STREAM_DEMUX_QUEUE_MAX)
+		return -1;
+
+	queue = d->nqueues++;
+	if (!stream_demux_streamid_valid(streamid))
+		return queue;
+
+	s = stream_demux_insert(d, streamid);
+	if (!s || s->queue >= 0)
+		return queue;
+
+	d->queues[queue] = s;
+	s->queue = queue;
+
+	return queue;
+}
+
+/* stream of streamid, NULL if not received yet */
+struct demux_stream *stream_demux_lookup(struct stream_demux *d,
+					 uint8_t streamid[])
+{
+	struct demux_stream *s;
+	int probe;
+
+	s = stream_demux_slot(d, streamid, &probe);
+
+	return (__atomic_load_n(&s->used, __ATOMIC_ACQUIRE)) ? s : NULL;
+}
+
+/* a frame of the catch-all path, the stream takes a free queue if any */
+void stream_demux_process(struct stream_demux *d, void *packet, int length)
+{
+	uint8_t streamid[AVTP_STREAMID_SIZE];
+	struct demux_stream *s;
+	int queue, seqno;
+
+	if (!(get_avtp_stream_flags(packet) & AVTP_STREAM_FLAG_SV)) {
+		d->unknown++;
+		return;
+	}
+
+	get_avtp_stream_id(packet, streamid);
+	s = stream_demux_insert(d, streamid);
+	if (!s) {
+		d->unknown++;
+		return;
+	}
+
+	if (s->queue < 0 && !s->moves) {
+		queue = stream_demux_free_queue(d);
+		if (queue >= 0)
+			stream_demux_assign(d, queue, s);
+	}
+
+	d->packets++;
+	stats_process(&s->stats, length);
+
+	seqno = get_avtp_sequence_num(packet);
+	if (s->seqno >= 0 && seqno != s->seqno)
+		s->seq_errors++;
+	s->seqno = (seqno + 1) % (AVTP_SEQUENCE_NUM_MAX + 1);
+}
+
+/* a frame of a hardware queue, called by the worker threads */
+void stream_demux_hw(struct stream_demux *d, void *packet)
+{
+	uint8_t streamid[AVTP_STREAMID_SIZE];
+	struct demux_stream *s;
+
+	get_avtp_stream_id(packet, streamid);
+	s = stream_demux_lookup(d, streamid);
+	if (s)
+		__atomic_fetch_add(&s->hw_packets, 1, __ATOMIC_RELAXED);
+}
+
+/* rebalance once a period, now in ns */
+void stream_demux_tick(struct stream_demux *d, uint64_t now)
+{
+	if (now < d->next)
+		return;
+
+	if (d->next)
+		stream_demux_rebalance(d);
+	d->next = now + d->period;
+}
+
+int stream_demux_report(struct stream_demux *d, char *buf, int buflen)
+{
+	return snprintf(buf, buflen, "%d streams on %d queues %"PRIu64" software packets %"PRIu64" unknown %"PRIu64" assigns %"PRIu64" errors max probe %d",
+			d->nstreams, d->nqueues, d->packets,
+			d->unknown, d->assigns, d->errors, d->max_probe);
+}
+
+/*
+ * Format the stream of the slot, the caller goes through the slots up
+ * to STREAM_DEMUX_SLOTS. Returns 0 for an unused slot.
+ */
+int stream_demux_report_stream(struct stream_demux *d, int slot, char *buf,
+			       int buflen)
+{
+	struct demux_stream *s = &d->streams[slot];
+	char path[16];
+	uint8_t *id;
+
+	if (!s->used)
+		return 0;
+
+	id = s->StreamID;
+	if (s->queue < 0)
+		snprintf(path, sizeof(path), "software");
+	else
+		snprintf(path, sizeof(path), "queue%d", s->queue);
+
+	return snprintf(buf, buflen, "%02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x %s %"PRIu64"/%"PRIu64" hw/sw packets %"PRIu64" sw sequence errors %"PRIu64" moves",
+			id[0], id[1], id[2], id[3],
+			id[4], id[5], id[6], id[7], path,
+			s->hw_packets, s->stats.packets,
+			s->seq_errors, s->moves);
+}
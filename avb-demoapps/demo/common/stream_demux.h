@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __STREAM_DEMUX_H__
+#define __STREAM_DEMUX_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+
+#include "avtp.h"
+#include "stats.h"
+
+#define STREAM_DEMUX_SLOTS     (1024) /* power of 2 */
+#define STREAM_DEMUX_STREAMS   (STREAM_DEMUX_SLOTS / 2)
+#define STREAM_DEMUX_QUEUE_MAX (16)
+
+/* consumer of a received stream, on a hardware queue or in software */
+struct demux_stream {
+	uint8_t          StreamID[AVTP_STREAMID_SIZE];
+	bool             used;
+	int              queue;     /* hardware queue, -1:software */
+
+	/* software path, by the demux thread */
+	struct app_stats stats;
+	int              seqno;
+	uint64_t         seq_errors;
+
+	/* hardware path, by the worker threads */
+	uint64_t         hw_packets;
+
+	/* packets in the last period for the assignment */
+	uint64_t         mark;
+	uint64_t         rate;
+	uint64_t         moves;     /* to a hardware queue */
+};
+
+/*
+ * Assignment of the hardware rx queues to StreamIDs on demand.
+ * A new stream takes a free queue, the others are demultiplexed in
+ * software through a hash table on StreamID. Every period the busiest
+ * software stream takes the queue of the least busy stream.
+ *
+ * Streams are only added by the demux thread, the worker threads of
+ * the hardware queues look them up without lock.
+ */
+struct stream_demux {
+	struct demux_stream streams[STREAM_DEMUX_SLOTS];
+	int                 nstreams;
+
+	int                 nqueues;
+	struct demux_stream *queues[STREAM_DEMUX_QUEUE_MAX]; /* NULL:free */
+	int (*assign)(void *arg, int queue, uint8_t streamid[]);
+	void                *arg;
+
+	uint64_t            period;  /* ns */
+	uint64_t            next;
+
+	/* statistics */
+	uint64_t            packets; /* software path */
+	uint64_t            unknown; /* not AVTP stream or table full */
+	uint64_t            assigns;
+	uint64_t            errors;  /* failed to assign */
+	int                 max_probe;
+};
+
+extern struct stream_demux *stream_demux_new(
+		int (*assign)(void *arg, int queue, uint8_t streamid[]),
+		void *arg, uint64_t period);
+extern void stream_demux_free(struct stream_demux *d);
+extern int stream_demux_add_queue(struct stream_demux *d, uint8_t streamid[]);
+extern struct demux_stream *stream_demux_lookup(struct stream_demux *d,
+						uint8_t streamid[]);
+extern void stream_demux_process(struct stream_demux *d, void *packet,
+				 int length);
+extern void stream_demux_hw(struct stream_demux *d, void *packet);
+extern void stream_demux_tick(struct stream_demux *d, uint64_t now);
+extern int stream_demux_report(struct stream_demux *d, char *buf, int buflen);
+extern int stream_demux_report_stream(struct stream_demux *d, int slot,
+				      char *buf, int buflen);
+
+#endif /* __STREAM_DEMUX_H__ */
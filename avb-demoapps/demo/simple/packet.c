@@ -36,7 +36,7 @@ int avtp_simple_header_build(void *dst, struct avtp_simple_param *param)
 				(cfi << 12) | param->SRvid);
 	set_ieee8021q_ethtype(dst, ETH_P_1722);
 
-	hlen = AVTP_CVF_PAYLOAD_OFFSET;
+	hlen = avtp_simple_payload_offset(param->format);
 	len = param->payload_size;
 
 	/* 1722 header update + payload */
@@ -44,9 +44,74 @@ int avtp_simple_header_build(void *dst, struct avtp_simple_param *param)
 	streamid[6] = (param->uniqueid & 0xff00) >> 8;
 	streamid[7] = param->uniqueid & 0x00ff;
 
-	copy_avtp_cvf_experimental_template(dst);
-	set_avtp_stream_id(dst, streamid);
-	set_avtp_stream_data_length(dst, len);
+	switch (param->format) {
+	case AVTP_SIMPLE_FORMAT_CRF:
+		copy_avtp_crf_template(dst);
+		set_avtp_stream_id(dst, streamid);
+		set_avtp_crf_type(dst, param->crf.type);
+		/* pull:3bit, base_frequency:29bit */
+		set_avtp_crf_pull_base_frequency(dst,
+				(param->crf.pull << AVTP_CRF_PULL_SHIFT) |
+				(param->crf.base_frequency &
+					AVTP_CRF_BASE_FREQUENCY_MAX));
+		set_avtp_crf_data_length(dst, len);
+		set_avtp_crf_timestamp_interval(dst,
+				param->crf.timestamp_interval);
+		break;
+	case AVTP_SIMPLE_FORMAT_NTSCF:
+		copy_avtp_ntscf_template(dst);
+		set_avtp_stream_id(dst, streamid);
+		set_avtp_ntscf_data_length(dst, len);
+		break;
+	case AVTP_SIMPLE_FORMAT_TSCF:
+		copy_avtp_tscf_template(dst);
+		set_avtp_stream_id(dst, streamid);
+		set_avtp_stream_data_length(dst, len);
+		break;
+	case AVTP_SIMPLE_FORMAT_AEF:
+		copy_avtp_aef_continuous_template(dst);
+		set_avtp_stream_id(dst, streamid);
+		set_avtp_stream_data_length(dst, len);
+		set_avtp_aef_encapsulated_subtype(dst, AVTP_SUBTYPE_CVF);
+		break;
+	case AVTP_SIMPLE_FORMAT_AAF:
+		copy_avtp_aaf_template(dst);
+		set_avtp_stream_id(dst, streamid);
+		set_avtp_aaf_format(dst, param->aaf.format);
+		set_avtp_aaf_nsr(dst, param->aaf.nsr);
+		set_avtp_aaf_channels_per_frame(dst, param->aaf.channels);
+		set_avtp_aaf_bit_depth(dst, param->aaf.bit_depth);
+		set_avtp_stream_data_length(dst, len);
+		break;
+	case AVTP_SIMPLE_FORMAT_CVF:
+	default:
+		copy_avtp_cvf_experimental_template(dst);
+		set_avtp_stream_id(dst, streamid);
+		set_avtp_stream_data_length(dst, len);
+		break;
+	}
 
 	return hlen + len;
 }
+
+/*
+ * offset of payload from the top of MAC frame
+ */
+int avtp_simple_payload_offset(int format)
+{
+	switch (format) {
+	case AVTP_SIMPLE_FORMAT_CRF:
+		return AVTP_CRF_PAYLOAD_OFFSET;
+	case AVTP_SIMPLE_FORMAT_NTSCF:
+		return AVTP_NTSCF_PAYLOAD_OFFSET;
+	case AVTP_SIMPLE_FORMAT_TSCF:
+		return AVTP_TSCF_PAYLOAD_OFFSET;
+	case AVTP_SIMPLE_FORMAT_AEF:
+		return AVTP_AEF_PAYLOAD_OFFSET;
+	case AVTP_SIMPLE_FORMAT_AAF:
+		return AVTP_AAF_PAYLOAD_OFFSET;
+	case AVTP_SIMPLE_FORMAT_CVF:
+	default:
+		return AVTP_CVF_PAYLOAD_OFFSET;
+	}
+}
@@ -23,7 +23,33 @@
 #define ETHFRAMELEN_MIN   (ETHFRAMEMTU_MIN + ETHOVERHEAD)
 #define ETHFRAMELEN_MAX   (ETHFRAMEMTU_MAX + ETHOVERHEAD)
 
+enum avtp_simple_format {
+	AVTP_SIMPLE_FORMAT_CVF = 0, /* CVF experimental (default) */
+	AVTP_SIMPLE_FORMAT_CRF,     /* Clock Reference Format */
+	AVTP_SIMPLE_FORMAT_NTSCF,   /* Non Time Synchronous Control Format */
+	AVTP_SIMPLE_FORMAT_TSCF,    /* Time Synchronous Control Format */
+	AVTP_SIMPLE_FORMAT_AEF,     /* AES Encrypted Format (continuous) */
+	AVTP_SIMPLE_FORMAT_AAF,     /* AVTP Audio Format */
+};
+
+struct avtp_simple_crf_param {
+	int type;
+	int pull;
+	uint32_t base_frequency;
+	int timestamp_interval;
+};
+
+struct avtp_simple_aaf_param {
+	int format;        /* enum AVTP_AAF_FORMAT */
+	int nsr;           /* enum AVTP_AAF_NSR */
+	int channels;
+	int bit_depth;
+};
+
 struct avtp_simple_param {
+	int format;
+	struct avtp_simple_crf_param crf;
+	struct avtp_simple_aaf_param aaf;
 	char dest_addr[ETH_ALEN];
 	char source_addr[ETH_ALEN];
 	int payload_size;
@@ -33,5 +59,6 @@ struct avtp_simple_param {
 };
 
 extern int avtp_simple_header_build(void *dst, struct avtp_simple_param *param);
+extern int avtp_simple_payload_offset(int format);
 
 #endif /* __PACKET_H__ */
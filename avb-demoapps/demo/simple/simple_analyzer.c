@@ -0,0 +1,561 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+#include <signal.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <linux/if_ether.h>
+#include <inttypes.h>
+
+#include "msrp.h"
+#include "config.h"
+#include "simple_analyzer.h"
+#include "avtp.h"
+#include "packet.h"
+#include "clock.h"
+
+#define PROGNAME "simple_analyzer"
+#define PROGVERSION "0.1"
+
+static int show_version(struct app_config *cfg)
+{
+	fprintf(stderr, PROGNAME " version " PROGVERSION "\n");
+	return 0;
+}
+
+enum {
+	OPT_VERSION = 1,
+	OPT_SHM,
+};
+
+static const char *optstring = "c:j:S:F:p:i:h";
+static const struct option long_options[] = {
+	{"class",             required_argument, NULL, 'c'},
+	{"threads",           required_argument, NULL, 'j'},
+	{"max-frame-size",    required_argument, NULL, 'S'},
+	{"frame-intervals",   required_argument, NULL, 'F'},
+	{"shm",               required_argument, NULL, OPT_SHM},
+	{"ptp",               required_argument, NULL, 'p'},
+	{"interval",          required_argument, NULL, 'i'},
+	{"version",           no_argument,       NULL, OPT_VERSION},
+	{"help",              no_argument,       NULL, 'h'},
+	{NULL,                0,                 NULL,  0 },
+};
+
+static int show_usage(struct app_config *cfg)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options] <capture> [<capture>...]\n"
+		"       " PROGNAME " [options] --shm=NAME\n"
+		"\n"
+		"Analyze AVTP streams of pcap/pcapng captures. Captures given\n"
+		"together are analyzed as consecutive parts of one capture.\n"
+		"With --shm, analyze the frames of a running listener live.\n"
+		"\n"
+		"options:\n"
+		"    -c, --class=SRCLASS         specify SRClassID A/B/C of the class interval\n"
+		"                                (default:'A')\n"
+		"    -j, --threads=NUM           specify number of threads\n"
+		"                                (default:number of CPUs)\n"
+		"    -S, --max-frame-size=SIZE   check frames against MaxFrameSize\n"
+		"                                (default:0 not checked)\n"
+		"    -F, --frame-intervals=NUM   check class intervals against MaxIntervalFrames\n"
+		"                                (default:0 not checked)\n"
+		"        --shm=NAME              read the shared memory ring --shm=NAME of simple_listener\n"
+		"    -p, --ptp=CLOCK             specify PTP clock name of the listener with --shm\n"
+		"                                (default:/dev/ptp0)\n"
+		"    -i, --interval=SEC          print the interval report every SEC with --shm\n"
+		"                                (default:1, 0 final report only)\n"
+		"    -h, --help                  display this help\n"
+		"        --version               print version information\n"
+		"\n"
+		"examples:\n"
+		" " PROGNAME " -c A -S 124 -F 1 /tmp/soak.pcapng\n"
+		" " PROGNAME " -j 8 /tmp/rx.pcapng /tmp/rx.pcapng.1 /tmp/rx.pcapng.2\n"
+		" " PROGNAME " -c A -S 124 --shm=avb_rx0 -p /dev/ptp0\n"
+		"\n"
+		PROGNAME " version " PROGVERSION "\n");
+	return 0;
+}
+
+/*
+ * config
+ */
+static int config_init(struct app_config *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+
+	cfg->nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	cfg->SRclassID = MSRP_SR_CLASS_A;
+	cfg->SRclassIntervalFrames = MSRP_SR_CLASS_A_INTERVAL_FRAMES;
+	cfg->interval = 1;
+
+	return 0;
+}
+
+static int config_parse(struct app_config *cfg, int argc, char **argv)
+{
+	int c, i;
+	int option_index = 0;
+	char *cname = NULL;
+
+	config_init(cfg);
+
+	/* Process the command line arguments. */
+	while (EOF != (c = getopt_long(argc, argv, optstring,
+					long_options, &option_index))) {
+		switch (c) {
+		case 'c':
+			i = ((char *)optarg)[0];
+			if (i == 'B' || i == 'b') {
+				cfg->SRclassID = MSRP_SR_CLASS_B;
+				cfg->SRclassIntervalFrames =
+						MSRP_SR_CLASS_B_INTERVAL_FRAMES;
+			} else if (i == 'C' || i == 'c') {
+				cfg->SRclassID = MSRP_SR_CLASS_C;
+				cfg->SRclassIntervalFrames =
+						MSRP_SR_CLASS_C_INTERVAL_FRAMES;
+			} else {
+				cfg->SRclassID = MSRP_SR_CLASS_A;
+				cfg->SRclassIntervalFrames =
+						MSRP_SR_CLASS_A_INTERVAL_FRAMES;
+			}
+			break;
+		case 'j':
+			cfg->nthreads = atoi(optarg);
+			break;
+		case 'S':
+			cfg->MaxFrameSize = atoi(optarg);
+			break;
+		case 'F':
+			cfg->MaxIntervalFrames = atoi(optarg);
+			break;
+		case OPT_SHM:
+			free(cfg->shm_name);
+			cfg->shm_name = strdup(optarg);
+			break;
+		case 'p':
+			free(cname);
+			cname = strdup(optarg);
+			break;
+		case 'i':
+			cfg->interval = atoi(optarg);
+			break;
+		case OPT_VERSION:
+			show_version(cfg);
+			exit(EXIT_SUCCESS);
+		case 'h':
+		default:
+			show_usage(cfg);
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	if (cfg->nthreads < 1) {
+		PRINTF1("[AVB] out of range threads=%d, specify greater than 0\n",
+				cfg->nthreads);
+		return -1;
+	}
+
+	if (cfg->MaxFrameSize < 0 || cfg->MaxIntervalFrames < 0) {
+		PRINTF1("[AVB] out of range reservation, specify 0 or greater\n");
+		return -1;
+	}
+
+	if (cfg->shm_name) {
+		if (optind < argc || cfg->interval < 0) {
+			PRINTF("[AVB] --shm cannot be used with capture files, interval 0 or greater\n");
+			free(cname);
+			return -1;
+		}
+		if (!cname)
+			cname = strdup("/dev/ptp0");
+		cfg->clkid = clock_parse(cname);
+		if (cfg->clkid == CLOCK_INVALID) {
+			PRINTF("[AVB] can't parse clock name %s\n", cname);
+			free(cname);
+			return -1;
+		}
+		free(cname);
+		return 0;
+	}
+	free(cname);
+
+	if (optind >= argc) {
+		PRINTF1("[AVB] Please specify the capture files.\n");
+		return -1;
+	}
+
+	for (; optind < argc; optind++) {
+		if (cfg->nfiles >= CAPTURE_FILES_MAX) {
+			PRINTF1("[AVB] too many capture files, up to %d\n",
+					CAPTURE_FILES_MAX);
+			return -1;
+		}
+		cfg->files[cfg->nfiles] = pcap_reader_open(argv[optind]);
+		if (!cfg->files[cfg->nfiles]) {
+			PRINTF1("[AVB] cannot open capture file %s.\n",
+					argv[optind]);
+			return -1;
+		}
+		cfg->nfiles++;
+	}
+
+	return 0;
+}
+
+/*
+ * parts
+ */
+/* split the files into parts of about the same size for the threads */
+static int capture_split(struct app_config *cfg)
+{
+	struct capture_part *part;
+	struct pcap_reader *r;
+	size_t total = 0, target, start, end;
+	int i, k, n, max = 0;
+
+	for (i = 0; i < cfg->nfiles; i++)
+		total += cfg->files[i]->size;
+
+	target = total / cfg->nthreads;
+	if (target < PART_SIZE_MIN)
+		target = PART_SIZE_MIN;
+
+	for (i = 0; i < cfg->nfiles; i++)
+		max += cfg->files[i]->size / target + 1;
+
+	cfg->parts = calloc(max, sizeof(*cfg->parts));
+	if (!cfg->parts)
+		return -1;
+
+	for (i = 0; i < cfg->nfiles; i++) {
+		r = cfg->files[i];
+		n = r->size / target + 1;
+
+		start = pcap_reader_sync(r, 0);
+		for (k = 1; k <= n; k++) {
+			end = (k == n) ? r->size :
+				pcap_reader_sync(r, r->size / n * k);
+			if (end <= start)
+				continue;
+
+			part = &cfg->parts[cfg->nparts++];
+			pcap_reader_slice(r, &part->reader, start, end);
+			part->an = analyzer_new("capture", CLOCK_REALTIME, 0);
+			if (!part->an)
+				return -1;
+			analyzer_set_reservation(part->an,
+				NSEC_SCALE / cfg->SRclassIntervalFrames,
+				cfg->MaxFrameSize, cfg->MaxIntervalFrames);
+			start = end;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * AVTP stream data unit of the frame, with AVTP_OFFSET of Q-Tag. A frame
+ * without the tag is laid out in tagged, the header part of it only.
+ */
+static void *capture_packet(struct pcap_frame *f, uint8_t *tagged, int *len)
+{
+	uint8_t *packet;
+	int subtype, min, avail;
+
+	if (f->caplen < ETH_HLEN)
+		return NULL;
+
+	switch (get_ieee8021q_tpid(f->data)) {
+	case ETH_P_8021Q:
+		if (f->caplen < ETHOVERHEAD ||
+		    get_ieee8021q_ethtype(f->data) != ETH_P_1722)
+			return NULL;
+		packet = f->data;
+		avail = f->caplen;
+		*len = f->len;
+		break;
+	case ETH_P_1722:
+		/*
+		 * The tag is stripped by the receiver. The analyzer reads
+		 * from AVTP_OFFSET only, so the tag is left out.
+		 */
+		avail = f->caplen - ETH_HLEN;
+		if (avail > AVTP_PAYLOAD_OFFSET - AVTP_OFFSET)
+			avail = AVTP_PAYLOAD_OFFSET - AVTP_OFFSET;
+		memcpy(tagged + AVTP_OFFSET, f->data + ETH_HLEN, avail);
+		packet = tagged;
+		avail += AVTP_OFFSET;
+		*len = f->len + (ETHOVERHEAD - ETH_HLEN);
+		break;
+	default:
+		return NULL;
+	}
+
+	if (avail < AVTP_OFFSET + 12)
+		return NULL;
+	if (!(get_avtp_stream_flags(packet) & AVTP_STREAM_FLAG_SV))
+		return NULL;
+
+	subtype = get_avtp_subtype(packet);
+	min = (subtype == AVTP_SUBTYPE_NTSCF) ?
+			AVTP_NTSCF_PAYLOAD_OFFSET : AVTP_PAYLOAD_OFFSET;
+	if (avail < min)
+		return NULL;
+
+	return packet;
+}
+
+static void capture_part_process(struct capture_part *part)
+{
+	struct pcap_frame f;
+	uint8_t tagged[AVTP_PAYLOAD_OFFSET];
+	void *packet;
+	int ret, len;
+
+	while ((ret = pcap_reader_next(&part->reader, &f)) > 0) {
+		packet = capture_packet(&f, tagged, &len);
+		if (!packet) {
+			part->skipped++;
+			continue;
+		}
+		analyzer_process(part->an, packet, len, f.ts);
+		part->frames++;
+	}
+
+	part->broken = (ret < 0);
+}
+
+static void *capture_thread(void *arg)
+{
+	struct app_config *cfg = arg;
+	int i;
+
+	while ((i = __atomic_fetch_add(&cfg->next, 1,
+				       __ATOMIC_RELAXED)) < cfg->nparts)
+		capture_part_process(&cfg->parts[i]);
+
+	return NULL;
+}
+
+/*
+ * live
+ */
+static bool sigint;
+static void sigint_handler(int s)
+{
+	sigint = true;
+}
+
+static int install_sighandler(int s, void (*handler)(int))
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handler;
+	sigemptyset(&sa.sa_mask);
+
+	if (sigaction(s, &sa, NULL) == -1) {
+		perror("sigaction");
+		return -1;
+	}
+
+	return 0;
+}
+
+static void shm_report(struct analyzer *an, uint64_t now, char *buf,
+		       int buflen)
+{
+	if (analyzer_tick(an, now, buf, buflen))
+		PRINTF("%s\n", buf);
+}
+
+/* analyze the frames of the ring of a listener until SIGINT */
+static int shm_analyze(struct app_config *cfg)
+{
+	struct shm_ring *ring;
+	struct shm_ring_slot *slot;
+	struct analyzer *an;
+	uint8_t frame[SHM_RING_FRAME_MAX];
+	uint64_t arrival, frames = 0, skipped = 0;
+	char *buf;
+	int buflen = 384 * ANALYZER_STREAM_MAX;
+	uint32_t len;
+	int ret = -1;
+
+	ring = shm_ring_attach(cfg->shm_name);
+	if (!ring) {
+		PRINTF("[AVB] cannot attach shm %s\n", cfg->shm_name);
+		return -1;
+	}
+
+	an = analyzer_new(cfg->shm_name, cfg->clkid,
+			(uint64_t)cfg->interval * NSEC_SCALE);
+	buf = malloc(buflen);
+	if (!an || !buf) {
+		PRINTF("[AVB] cannot allocate analyzer\n");
+		goto out;
+	}
+	analyzer_set_reservation(an,
+		NSEC_SCALE / cfg->SRclassIntervalFrames,
+		cfg->MaxFrameSize, cfg->MaxIntervalFrames);
+
+	install_sighandler(SIGINT, sigint_handler);
+	install_sighandler(SIGTERM, sigint_handler);
+
+	while (!sigint) {
+		slot = shm_ring_peek(ring);
+		if (!slot) {
+			shm_report(an, analyzer_now(an), buf, buflen);
+			usleep(1000);
+			continue;
+		}
+
+		/*
+		 * The listener does not wait for the consumers, the frame
+		 * is copied and used only when it was not overwritten
+		 * meanwhile.
+		 */
+		len = __atomic_load_n(&slot->len, __ATOMIC_RELAXED);
+		if (len > sizeof(frame))
+			len = sizeof(frame);
+		memcpy(frame, slot->frame, len);
+		arrival = slot->arrival;
+		if (shm_ring_release(ring) < 0)
+			continue;
+
+		if (len < AVTP_PAYLOAD_OFFSET ||
+		    !(get_avtp_stream_flags(frame) & AVTP_STREAM_FLAG_SV)) {
+			skipped++;
+			continue;
+		}
+
+		if (!arrival)
+			arrival = analyzer_now(an);
+		analyzer_process(an, frame, len, arrival);
+		frames++;
+		shm_report(an, arrival, buf, buflen);
+	}
+
+	analyzer_report(an, buf, buflen);
+	printf("%s\n", buf);
+
+	PRINTF1("[AVB] %"PRIu64" AVTP stream frames (%"PRIu64" others) of shm %s, "
+		"%"PRIu64" overruns\n",
+			frames, skipped, cfg->shm_name,
+			ring->hdr->consumers[ring->consumer].overruns);
+
+	ret = 0;
+
+out:
+	free(buf);
+	analyzer_free(an);
+	shm_ring_detach(ring);
+
+	return ret;
+}
+
+int main(int argc, char **argv)
+{
+	struct app_config cfg;
+	struct capture_part *part;
+	pthread_t *threads = NULL;
+	struct timespec t0, t1;
+	uint64_t frames = 0, skipped = 0;
+	size_t bytes = 0;
+	char *buf = NULL;
+	int buflen = 256 * ANALYZER_STREAM_MAX;
+	int i, nthreads, ret = -1;
+	double elapsed;
+
+	if (config_parse(&cfg, argc, argv) < 0)
+		goto out;
+
+	if (cfg.shm_name) {
+		ret = shm_analyze(&cfg);
+		goto out;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+
+	if (capture_split(&cfg) < 0) {
+		PRINTF("[AVB] cannot allocate analyzer\n");
+		goto out;
+	}
+
+	nthreads = (cfg.nthreads < cfg.nparts) ? cfg.nthreads : cfg.nparts;
+	threads = calloc(nthreads, sizeof(*threads));
+	if (!threads)
+		goto out;
+
+	for (i = 0; i < nthreads; i++) {
+		if (pthread_create(&threads[i], NULL, capture_thread, &cfg)) {
+			PRINTF("[AVB] cannot create thread\n");
+			nthreads = i;
+			break;
+		}
+	}
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	if (!nthreads)
+		goto out;
+
+	/* join the parts in order of the capture */
+	for (i = 0, part = cfg.parts; i < cfg.nparts; i++, part++) {
+		if (part->broken)
+			PRINTF1("[AVB] %s: broken capture at offset %zu\n",
+					part->reader.name, part->reader.off);
+		if (i)
+			analyzer_merge(cfg.parts[0].an, part->an);
+		frames += part->frames;
+		skipped += part->skipped;
+	}
+	for (i = 0; i < cfg.nfiles; i++)
+		bytes += cfg.files[i]->size;
+
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	elapsed = (t1.tv_sec - t0.tv_sec) +
+			(t1.tv_nsec - t0.tv_nsec) / (double)NSEC_SCALE;
+
+	buf = malloc(buflen);
+	if (buf && cfg.nparts) {
+		analyzer_report(cfg.parts[0].an, buf, buflen);
+		printf("%s\n", buf);
+	}
+
+	PRINTF1("[AVB] %"PRIu64" AVTP stream frames (%"PRIu64" others) of %d captures, "
+		"%.1fMB in %.3fs (%.1fMB/s) with %d threads\n",
+			frames, skipped, cfg.nfiles, bytes / 1e6, elapsed,
+			(elapsed > 0) ? bytes / 1e6 / elapsed : 0.0, nthreads);
+
+	ret = 0;
+
+out:
+	free(buf);
+	free(threads);
+	if (cfg.parts) {
+		for (i = 0; i < cfg.nparts; i++)
+			analyzer_free(cfg.parts[i].an);
+		free(cfg.parts);
+	}
+	for (i = 0; i < cfg.nfiles; i++)
+		pcap_reader_close(cfg.files[i]);
+	free(cfg.shm_name);
+
+	if (!ret)
+		return 0;
+
+	return -1;
+}
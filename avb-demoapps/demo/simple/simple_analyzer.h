@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __SIMPLE_ANALYZER_H__
+#define __SIMPLE_ANALYZER_H__
+
+#include <stdint.h>
+#include <time.h>
+#include "avtp.h"
+#include "analyzer.h"
+#include "pcapng.h"
+#include "shm_ring.h"
+
+#define NSEC_SCALE     (1000000000)
+
+#define CAPTURE_FILES_MAX (64)
+#define PART_SIZE_MIN     (16 << 20) /* bytes read by a thread at least */
+
+/* a part of a capture file, analyzed by one thread */
+struct capture_part {
+	struct pcap_reader reader;
+	struct analyzer    *an;
+	uint64_t           frames;
+	uint64_t           skipped;  /* not AVTP stream */
+	bool               broken;
+};
+
+struct app_config {
+	int                nthreads;
+	uint8_t            SRclassID;
+	int                SRclassIntervalFrames;
+	int                MaxFrameSize;
+	int                MaxIntervalFrames;
+	int                nfiles;
+	struct pcap_reader *files[CAPTURE_FILES_MAX];
+	int                nparts;
+	struct capture_part *parts;
+	int                next;     /* next part to analyze */
+	char               *shm_name; /* live from the ring of a listener */
+	clockid_t          clkid;
+	int                interval;
+};
+
+#endif /* __SIMPLE_ANALYZER_H__ */
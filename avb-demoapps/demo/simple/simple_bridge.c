@@ -0,0 +1,1124 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#define _GNU_SOURCE /* recvmmsg, sendmmsg */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <math.h>
+#include <pthread.h>
+#include <poll.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <linux/if_ether.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#include "eavb.h"
+#include "msrp.h"
+#include "config.h"
+#include "eavb_device.h"
+#include "simple_bridge.h"
+#include "avtp.h"
+#include "packet.h"
+#include "clock.h"
+#include "rtp.h"
+#include "pcm_conv.h"
+
+#define PROGNAME "simple_bridge"
+#define PROGVERSION "0.1"
+
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof(a[0]))
+
+static unsigned char dest_addr[] = DEST_ADDR;
+
+static int show_version(struct app_config *cfg)
+{
+	fprintf(stderr, PROGNAME " version " PROGVERSION "\n");
+	return 0;
+}
+
+enum {
+	OPT_VERSION = 1,
+	OPT_RTP_IN,
+	OPT_RTP_OUT,
+	OPT_RTP_PT,
+	OPT_RTP_FORMAT,
+	OPT_PTIME,
+	OPT_RATE,
+	OPT_CHANNELS,
+	OPT_AAF_FORMAT,
+	OPT_MEDIA_OFFSET,
+	OPT_LATENCY,
+	OPT_UDP_TX,
+	OPT_UDP_RX,
+	OPT_UDP_OFFLOAD,
+};
+
+static const char *optstring = "c:i:u:a:d:p:h";
+static const struct option long_options[] = {
+	{"class",             required_argument, NULL, 'c'},
+	{"interface",         required_argument, NULL, 'i'},
+	{"uid",               required_argument, NULL, 'u'},
+	{"dest-addr",         required_argument, NULL, 'a'},
+	{"device",            required_argument, NULL, 'd'},
+	{"ptp",               required_argument, NULL, 'p'},
+	{"rtp-in",            required_argument, NULL, OPT_RTP_IN},
+	{"rtp-out",           required_argument, NULL, OPT_RTP_OUT},
+	{"rtp-pt",            required_argument, NULL, OPT_RTP_PT},
+	{"rtp-format",        required_argument, NULL, OPT_RTP_FORMAT},
+	{"ptime",             required_argument, NULL, OPT_PTIME},
+	{"rate",              required_argument, NULL, OPT_RATE},
+	{"channels",          required_argument, NULL, OPT_CHANNELS},
+	{"aaf-format",        required_argument, NULL, OPT_AAF_FORMAT},
+	{"media-offset",      required_argument, NULL, OPT_MEDIA_OFFSET},
+	{"latency",           required_argument, NULL, OPT_LATENCY},
+	{"udp-tx",            required_argument, NULL, OPT_UDP_TX},
+	{"udp-rx",            required_argument, NULL, OPT_UDP_RX},
+	{"udp-offload",       required_argument, NULL, OPT_UDP_OFFLOAD},
+	{"version",           no_argument,       NULL, OPT_VERSION},
+	{"help",              no_argument,       NULL, 'h'},
+	{NULL,                0,                 NULL,  0 },
+};
+
+static int show_usage(struct app_config *cfg)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"Bridge AES67 RTP audio to AAF on a tx queue (--rtp-in) and AAF of an\n"
+		"rx queue to AES67 RTP (--rtp-out), both sharing the PTP timebase.\n"
+		"The streams are not reserved by MSRP, configure the network statically.\n"
+		"\n"
+		"options:\n"
+		"    -c, --class=SRCLASS         specify SRClassID A/B/C of AAF (default:'A')\n"
+		"    -i, --interface=IFNAME      specify network interface name (default:eth0)\n"
+		"    -u, --uid=UNIQUEID          specify UniqueID in StreamID of AAF (default:1)\n"
+		"    -a, --dest-addr=DEST_ADDR   specify destination MAC address of AAF\n"
+		"                                (default:%02x:%02x:%02x:%02x:%02x:XX, XX=UniqueID(lower 8 bits))\n"
+		"    -d, --device=DEVNAME        specify rx device of --rtp-out (default:/dev/avb_rx0)\n"
+		"    -p, --ptp=CLOCK             specify PTP clock name (default:/dev/ptp0)\n"
+		"        --rtp-in=ADDR[:PORT]    receive RTP at ADDR, joining the multicast group\n"
+		"                                (default port:%d)\n"
+		"        --rtp-out=ADDR[:PORT]   send RTP to ADDR (default port:%d)\n"
+		"        --rtp-pt=NUM            specify payload type of --rtp-out (default:%d)\n"
+		"        --rtp-format=FORMAT     specify RTP format L16/L24 (default:L24)\n"
+		"        --ptime=USEC            specify packet time of --rtp-out (default:1000)\n"
+		"        --rate=HZ               specify sample rate (default:48000)\n"
+		"        --channels=NUM          specify number of channels (default:2)\n"
+		"        --aaf-format=FORMAT     specify AAF format int16/int24/int32 (default:int32)\n"
+		"        --media-offset=NUM      specify RTP timestamp offset of mediaclk:direct\n"
+		"                                (default:0)\n"
+		"        --latency=USEC          specify AAF presentation time after the sampling\n"
+		"                                (default:%lu)\n"
+		"        --udp-tx=HOST[:PORT]    send AAF in UDP of IEEE1722 Annex J instead of\n"
+		"                                the tx queue\n"
+		"        --udp-rx=[ADDR:]PORT    receive AAF in UDP of IEEE1722 Annex J instead\n"
+		"                                of the rx queue\n"
+		"        --udp-offload=0|1       use UDP segmentation offloads (default:1)\n"
+		"    -h, --help                  display this help\n"
+		"        --version               print version information\n"
+		"\n"
+		"examples:\n"
+		" " PROGNAME " -i eth1 --rtp-in=239.69.1.1:5004 --channels=8\n"
+		" " PROGNAME " -d /dev/avb_rx0 --rtp-out=239.69.1.2:5004 --ptime=250\n"
+		" " PROGNAME " -p CLOCK_REALTIME --rtp-in=127.0.0.1:5004 --udp-tx=127.0.0.1\n"
+		"   --udp-rx=17220 --rtp-out=127.0.0.1:5006\n"
+		"\n"
+		PROGNAME " version " PROGVERSION "\n",
+		dest_addr[0], dest_addr[1], dest_addr[2],
+		dest_addr[3], dest_addr[4], RTP_AES67_PORT, RTP_AES67_PORT,
+		RTP_AES67_PAYLOAD_TYPE, TSOFFSET);
+	return 0;
+}
+
+/*
+ * config
+ */
+static int config_init(struct app_config *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+
+	cfg->uid = 1;
+	cfg->entrynum = CONFIG_INIT_ENTRYNUM;
+	cfg->SRclassID = MSRP_SR_CLASS_A;
+	cfg->SRpriority = MSRP_SR_CLASS_A_PRIO;
+	cfg->SRclassIntervalFrames = MSRP_SR_CLASS_A_INTERVAL_FRAMES;
+	cfg->SRvid = MSRP_SR_CLASS_VID;
+	memcpy(cfg->dest_addr, dest_addr, ETH_ALEN);
+	cfg->udp_offload = true;
+
+	cfg->au.rate = 48000;
+	cfg->au.channels = 2;
+	cfg->au.rtp_width = 3;
+	cfg->au.rtp_pt = RTP_AES67_PAYLOAD_TYPE;
+	cfg->au.aaf_format = AVTP_AAF_FORMAT_INT_32BIT;
+	cfg->au.latency = TSOFFSET * 1000;
+
+	cfg->tx.sock = -1;
+	cfg->rx.sock = -1;
+	cfg->rx.seq = -1;
+
+	return 0;
+}
+
+static int config_parse_aaf_format(char *arg)
+{
+	if (!strcmp(arg, "int16"))
+		return AVTP_AAF_FORMAT_INT_16BIT;
+	if (!strcmp(arg, "int24"))
+		return AVTP_AAF_FORMAT_INT_24BIT;
+	if (!strcmp(arg, "int32"))
+		return AVTP_AAF_FORMAT_INT_32BIT;
+
+	return -1;
+}
+
+/* derive the frame counts of the packets from the options */
+static int config_check_audio(struct app_config *cfg, int ptime)
+{
+	struct bridge_audio *au = &cfg->au;
+	uint8_t nsr;
+
+	for (nsr = AVTP_AAF_NSR_8KHZ; avtp_aaf_nsr_rate(nsr); nsr++)
+		if (avtp_aaf_nsr_rate(nsr) == au->rate)
+			break;
+	if (!avtp_aaf_nsr_rate(nsr)) {
+		PRINTF1("[AVB] sample rate %d has no AAF nominal sample rate.\n",
+				au->rate);
+		return -1;
+	}
+	au->nsr = nsr;
+
+	if (au->channels < 1 || au->channels > BRIDGE_CHANNELS_MAX) {
+		PRINTF1("[AVB] out of range channels=%d, specify between 1 and %d\n",
+				au->channels, BRIDGE_CHANNELS_MAX);
+		return -1;
+	}
+
+	au->aaf_width = avtp_aaf_sample_size(au->aaf_format);
+	if (au->aaf_width <= 0) {
+		PRINTF1("[AVB] AAF format should be int16, int24 or int32.\n");
+		return -1;
+	}
+
+	/* one PDU per class interval */
+	if (au->rate % cfg->SRclassIntervalFrames) {
+		PRINTF1("[AVB] sample rate %d is not a multiple of the class interval rate %d.\n",
+				au->rate, cfg->SRclassIntervalFrames);
+		return -1;
+	}
+	au->aaf_frames = au->rate / cfg->SRclassIntervalFrames;
+	cfg->MaxFrameSize = AVTP_AAF_PAYLOAD_OFFSET - ETHOVERHEAD +
+			au->aaf_frames * au->channels * au->aaf_width;
+	if (cfg->MaxFrameSize < ETHFRAMEMTU_MIN)
+		cfg->MaxFrameSize = ETHFRAMEMTU_MIN; /* padded */
+	if (cfg->MaxFrameSize > ETHFRAMEMTU_MAX) {
+		PRINTF1("[AVB] too many channels for an AAF PDU.\n");
+		return -1;
+	}
+
+	if (ptime <= 0 || ((uint64_t)au->rate * ptime) % 1000000) {
+		PRINTF1("[AVB] ptime %dus is not a whole number of frames.\n",
+				ptime);
+		return -1;
+	}
+	au->rtp_frames = (uint64_t)au->rate * ptime / 1000000;
+	if (au->rtp_frames * au->channels * au->rtp_width >
+							BRIDGE_RTP_PAYLOAD) {
+		PRINTF1("[AVB] RTP payload of ptime %dus exceeds %d bytes.\n",
+				ptime, BRIDGE_RTP_PAYLOAD);
+		return -1;
+	}
+
+	return 0;
+}
+
+static int config_parse(struct app_config *cfg, int argc, char **argv)
+{
+	int c, i, ret;
+	int option_index = 0;
+	int ptime = 1000;
+	char *iname = NULL;
+	char *cname = NULL;
+	clockid_t clkid;
+
+	config_init(cfg);
+
+	/* Process the command line arguments. */
+	while (EOF != (c = getopt_long(argc, argv, optstring,
+					long_options, &option_index))) {
+		switch (c) {
+		case 'c':
+			i = ((char *)optarg)[0];
+			if (i == 'B' || i == 'b') {
+				cfg->SRclassID = MSRP_SR_CLASS_B;
+				cfg->SRpriority = MSRP_SR_CLASS_B_PRIO;
+				cfg->SRclassIntervalFrames =
+						MSRP_SR_CLASS_B_INTERVAL_FRAMES;
+			} else if (i == 'C' || i == 'c') {
+				cfg->SRclassID = MSRP_SR_CLASS_C;
+				cfg->SRpriority = MSRP_SR_CLASS_C_PRIO;
+				cfg->SRclassIntervalFrames =
+						MSRP_SR_CLASS_C_INTERVAL_FRAMES;
+			} else {
+				cfg->SRclassID = MSRP_SR_CLASS_A;
+				cfg->SRpriority = MSRP_SR_CLASS_A_PRIO;
+				cfg->SRclassIntervalFrames =
+						MSRP_SR_CLASS_A_INTERVAL_FRAMES;
+			}
+			break;
+		case 'i':
+			free(iname);
+			iname = strdup(optarg);
+			break;
+		case 'u':
+			cfg->uid = atoi(optarg);
+			break;
+		case 'a':
+			ret = sscanf(optarg, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+				     &cfg->dest_addr[0], &cfg->dest_addr[1],
+				     &cfg->dest_addr[2], &cfg->dest_addr[3],
+				     &cfg->dest_addr[4], &cfg->dest_addr[5]);
+			if (ret != ETH_ALEN) {
+				PRINTF1("[AVB] Conversion failed mac addr.\n");
+				return -1;
+			}
+			cfg->use_dest_addr = true;
+			break;
+		case 'd':
+			free(cfg->devname);
+			cfg->devname = strdup(optarg);
+			break;
+		case 'p':
+			free(cname);
+			cname = strdup(optarg);
+			break;
+		case OPT_RTP_IN:
+		case OPT_RTP_OUT:
+			ret = (c == OPT_RTP_IN) ?
+				netif_parse_udp(optarg, RTP_AES67_PORT,
+						&cfg->rtp_in_addr,
+						&cfg->rtp_in_addrlen) :
+				netif_parse_udp(optarg, RTP_AES67_PORT,
+						&cfg->rtp_out_addr,
+						&cfg->rtp_out_addrlen);
+			if (ret < 0) {
+				PRINTF1("[AVB] invalid RTP address %s.\n",
+						optarg);
+				return -1;
+			}
+			if (c == OPT_RTP_IN)
+				cfg->rtp_in = true;
+			else
+				cfg->rtp_out = true;
+			break;
+		case OPT_RTP_PT:
+			cfg->au.rtp_pt = atoi(optarg);
+			break;
+		case OPT_RTP_FORMAT:
+			if (!strcasecmp(optarg, "L16")) {
+				cfg->au.rtp_width = 2;
+			} else if (!strcasecmp(optarg, "L24")) {
+				cfg->au.rtp_width = 3;
+			} else {
+				PRINTF1("[AVB] unknown RTP format %s, specify L16 or L24.\n",
+						optarg);
+				return -1;
+			}
+			break;
+		case OPT_PTIME:
+			ptime = atoi(optarg);
+			break;
+		case OPT_RATE:
+			cfg->au.rate = atoi(optarg);
+			break;
+		case OPT_CHANNELS:
+			cfg->au.channels = atoi(optarg);
+			break;
+		case OPT_AAF_FORMAT:
+			cfg->au.aaf_format = config_parse_aaf_format(optarg);
+			break;
+		case OPT_MEDIA_OFFSET:
+			cfg->au.media_offset = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_LATENCY:
+			cfg->au.latency = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case OPT_UDP_TX:
+		case OPT_UDP_RX:
+			ret = (c == OPT_UDP_TX) ?
+				netif_parse_udp(optarg, AVTP_UDP_PORT,
+						&cfg->udp_tx_addr,
+						&cfg->udp_tx_addrlen) :
+				netif_parse_udp(optarg, AVTP_UDP_PORT,
+						&cfg->udp_rx_addr,
+						&cfg->udp_rx_addrlen);
+			if (ret < 0) {
+				PRINTF1("[AVB] invalid UDP address %s.\n",
+						optarg);
+				return -1;
+			}
+			if (c == OPT_UDP_TX)
+				cfg->udp_tx = true;
+			else
+				cfg->udp_rx = true;
+			break;
+		case OPT_UDP_OFFLOAD:
+			cfg->udp_offload = !!atoi(optarg);
+			break;
+		case OPT_VERSION:
+			show_version(cfg);
+			exit(EXIT_SUCCESS);
+		case 'h':
+		default:
+			show_usage(cfg);
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	if (!cfg->rtp_in && !cfg->rtp_out) {
+		PRINTF1("[AVB] Please specify --rtp-in and/or --rtp-out.\n");
+		return -1;
+	}
+
+	if ((cfg->uid < 0) || (cfg->uid > AVTP_UNIQUE_ID_MAX)) {
+		PRINTF1("[AVB] out of range uid=%d, specify between 0 and %d\n",
+				cfg->uid, AVTP_UNIQUE_ID_MAX);
+		return -1;
+	}
+
+	if (cfg->au.rtp_pt < 0 || cfg->au.rtp_pt > RTP_PAYLOAD_TYPE) {
+		PRINTF1("[AVB] out of range rtp-pt=%d, specify between 0 and %d\n",
+				cfg->au.rtp_pt, RTP_PAYLOAD_TYPE);
+		return -1;
+	}
+
+	if (config_check_audio(cfg, ptime) < 0)
+		return -1;
+
+	/* The MAC Address of ethernet is got and it uses for StreamID. */
+	if (!cfg->rtp_in || (cfg->udp_tx && !iname)) {
+		strcpy(cfg->ifname, "udp");
+		cfg->speed = 1000;
+	} else {
+		if (!iname)
+			iname = strdup("eth0");
+
+		if (netif_detect(iname) < 0) {
+			PRINTF1("[AVB] not found network interface\n");
+			return -1;
+		}
+		if (netif_gethwaddr(iname, cfg->source_addr) < 0) {
+			PRINTF1("[AVB] can't get hw address\n");
+			return -1;
+		}
+		if (netif_getlinkspeed(iname, &cfg->speed) < 0) {
+			PRINTF1("[AVB] can't get link speed\n");
+			return -1;
+		}
+
+		strcpy(cfg->ifname, iname);
+	}
+	free(iname);
+
+	if (!cfg->devname)
+		cfg->devname = strdup((cfg->udp_rx) ? "udp" : "/dev/avb_rx0");
+
+	{
+		if (!cname)
+			cname = strdup("/dev/ptp0");
+
+		clkid = clock_parse(cname);
+		if (clkid == CLOCK_INVALID) {
+			PRINTF("[AVB] can't parse clock name %s\n", cname);
+			return -1;
+		}
+		PRINTF("[AVB] clock: select %s (%d)\n", cname, clkid);
+		cfg->clkid = clkid;
+
+		free(cname);
+	}
+
+	return 0;
+}
+
+/* signal handler */
+static bool sigint;
+static void sigint_handler(int s)
+{
+	sigint = true;
+}
+
+static int install_sighandler(int s, void (*handler)(int))
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handler;
+	sigemptyset(&sa.sa_mask);
+	sigaddset(&sa.sa_mask, SIGQUIT);
+
+	if (sigaction(s, &sa, NULL) == -1) {
+		perror("sigaction");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * PTP timebase
+ */
+/* media clock sample at PTP time t, rounded to the nearest */
+static uint64_t bridge_sample_of(struct bridge_audio *au, uint64_t t)
+{
+	return (t / NSEC_SCALE) * au->rate +
+		((t % NSEC_SCALE) * au->rate + NSEC_SCALE / 2) / NSEC_SCALE;
+}
+
+/* PTP time of media clock sample s */
+static uint64_t bridge_time_of(struct bridge_audio *au, uint64_t s)
+{
+	return (s / au->rate) * NSEC_SCALE +
+		((s % au->rate) * NSEC_SCALE + au->rate / 2) / au->rate;
+}
+
+/* media clock sample of RTP timestamp ts, nearest to PTP time now */
+static uint64_t bridge_rtp_sample(struct bridge_audio *au, uint32_t ts,
+				  uint64_t now)
+{
+	uint64_t s = bridge_sample_of(au, now);
+
+	return s + (int32_t)(ts - au->media_offset - (uint32_t)s);
+}
+
+/* PTP time of AVTP timestamp ts, nearest to now */
+static uint64_t bridge_avtp_time(uint32_t ts, uint64_t now)
+{
+	return now + (int32_t)(ts - (uint32_t)now);
+}
+
+static int bridge_calccbsinfo(struct app_config *cfg, struct eavb_cbsparam *cbs)
+{
+	uint64_t value;
+	double bandwidthFraction;
+
+	bandwidthFraction = ((ETHOVERHEAD_REAL + cfg->MaxFrameSize) * 8 *
+			(double)cfg->SRclassIntervalFrames) /
+			((double)cfg->speed * 1000000); /* bit */
+
+	PRINTF1("[AVB] SRclass%s MaxFrameSize=%d MaxIntervalFrames=1 BandwidthFraction=%.8f\n",
+			(cfg->SRclassID == MSRP_SR_CLASS_A) ? "A" :
+			(cfg->SRclassID == MSRP_SR_CLASS_B) ? "B" : "C",
+			cfg->MaxFrameSize, bandwidthFraction);
+
+	value = (uint64_t)(UINT32_MAX * bandwidthFraction);
+	if (value > UINT32_MAX) {
+		memset(cbs, 0, sizeof(*cbs));
+		PRINTF1("[AVB] out of range the bandwidth fraction, it should be less than 1.0.\n");
+		return -1;
+	}
+
+	/* Linear : low accuracy. However, it is compoundable by addition. */
+	cbs->bandwidthFraction = value;
+	cbs->idleSlope = floor(UINT16_MAX * bandwidthFraction);
+	cbs->sendSlope = ceil(UINT16_MAX * (1 - bandwidthFraction));
+
+	return 0;
+}
+
+static void bridge_msgs_init(uint8_t (*bufs)[BRIDGE_RTP_SIZE],
+			     struct mmsghdr *msgs, struct iovec *iov)
+{
+	int i;
+
+	memset(msgs, 0, BRIDGE_BATCH * sizeof(*msgs));
+	for (i = 0; i < BRIDGE_BATCH; i++) {
+		iov[i].iov_base = bufs[i];
+		iov[i].iov_len = BRIDGE_RTP_SIZE;
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+}
+
+/*
+ * RTP -> AAF
+ */
+static int rtp_to_aaf_open(struct app_config *cfg)
+{
+	struct rtp_to_aaf *tx = &cfg->tx;
+	struct eavb_device *dev;
+	struct avtp_simple_param param;
+	struct eavb_txparam txparam;
+	struct eavb_dma_alloc *p;
+	struct eavb_entry *e;
+	char template[ETHFRAMELEN_MAX];
+	int i, len;
+
+	tx->sock = netif_open_udp(&cfg->rtp_in_addr, cfg->rtp_in_addrlen, true);
+	if (tx->sock < 0)
+		return -1;
+
+	tx->bufs = calloc(BRIDGE_BATCH, sizeof(*tx->bufs));
+	if (!tx->bufs)
+		return -1;
+	bridge_msgs_init(tx->bufs, tx->msgs, tx->iov);
+	hdr_hist_reset(&tx->age);
+
+	if (cfg->udp_tx)
+		dev = eavb_device_new_udp(&cfg->udp_tx_addr,
+					  cfg->udp_tx_addrlen, cfg->entrynum,
+					  true, cfg->udp_offload);
+	else
+		dev = eavb_device_new((cfg->SRclassID == MSRP_SR_CLASS_A) ?
+				"/dev/avb_tx1" : "/dev/avb_tx0",
+				cfg->entrynum, O_RDWR);
+	if (!dev)
+		return -1;
+	tx->device = dev;
+
+	/* set StreamID and destination address  */
+	memcpy(tx->StreamID, cfg->source_addr, ETH_ALEN);
+	tx->StreamID[6] = (cfg->uid & 0xff00) >> 8;
+	tx->StreamID[7] = (cfg->uid & 0x00ff);
+	if (!cfg->use_dest_addr)
+		cfg->dest_addr[5] = tx->StreamID[7];
+
+	memset(&param, 0, sizeof(param));
+	memcpy(param.dest_addr, cfg->dest_addr, ETH_ALEN);
+	memcpy(param.source_addr, cfg->source_addr, ETH_ALEN);
+	param.uniqueid = cfg->uid;
+	param.SRpriority = cfg->SRpriority;
+	param.SRvid = cfg->SRvid;
+	param.payload_size = cfg->au.aaf_frames * cfg->au.channels *
+				cfg->au.aaf_width;
+	param.format = AVTP_SIMPLE_FORMAT_AAF;
+	param.aaf.format = cfg->au.aaf_format;
+	param.aaf.nsr = cfg->au.nsr;
+	param.aaf.channels = cfg->au.channels;
+	param.aaf.bit_depth = 8 * ((cfg->au.rtp_width < cfg->au.aaf_width) ?
+				cfg->au.rtp_width : cfg->au.aaf_width);
+
+	len = avtp_simple_header_build(template, &param);
+	if (len < ETHFRAMELEN_MIN)
+		len = ETHFRAMELEN_MIN; /* padded by zero */
+
+	for (i = 0, e = dev->entrybuf, p = dev->framebuf;
+			i < dev->entrynum;
+			i++, e++, p++) {
+		if (eavb_device_alloc_page(dev, p) < 0)
+			return -1;
+		dev->frames[i] = p->dma_vaddr;
+		e->vec[0].base = p->dma_paddr;
+		e->vec[0].len = len;
+		memcpy(p->dma_vaddr, template, len);
+	}
+
+	memset(&txparam, 0, sizeof(txparam));
+	if (bridge_calccbsinfo(cfg, &txparam.cbs) < 0)
+		return -1;
+
+	/* no credit based shaper in the network stack */
+	if (!cfg->udp_tx && eavb_set_txparam(dev->fd, &txparam) < 0)
+		return -1;
+
+	return 0;
+}
+
+/* complete the PDU being filled, it is pushed with the batch */
+static void rtp_to_aaf_complete(struct app_config *cfg, uint64_t now)
+{
+	struct rtp_to_aaf *tx = &cfg->tx;
+	struct eavb_device *dev = tx->device;
+	uint64_t t;
+	void *frame;
+
+	frame = dev->frames[(dev->wp + tx->ready) % dev->entrynum];
+	t = bridge_time_of(&cfg->au, tx->next - tx->fill);
+
+	set_avtp_sequence_num(frame, tx->seq++);
+	set_avtp_timestamp(frame, (uint32_t)(t + cfg->au.latency));
+
+	hdr_hist_record(&tx->age, (now > t) ? now - t : 0);
+	if (now > t + cfg->au.latency)
+		tx->late++;
+
+	tx->ready++;
+	tx->pdus++;
+	tx->fill = 0;
+}
+
+static void rtp_to_aaf_packet(struct app_config *cfg, uint8_t *data, int len,
+			      uint64_t now)
+{
+	struct rtp_to_aaf *tx = &cfg->tx;
+	struct bridge_audio *au = &cfg->au;
+	struct eavb_device *dev = tx->device;
+	int off, end, frames, n, fsize;
+	uint16_t seq;
+	uint64_t s;
+	uint8_t *payload;
+
+	off = rtp_payload_offset(data, len, &end);
+	fsize = au->channels * au->rtp_width;
+	if (off < 0 || (end - off) % fsize) {
+		tx->errors++;
+		return;
+	}
+	frames = (end - off) / fsize;
+	tx->packets++;
+
+	seq = get_rtp_sequence_num(data);
+	if (tx->rtp_seq_valid && seq != tx->rtp_seq &&
+	    (uint16_t)(seq - tx->rtp_seq) < 0x8000)
+		tx->lost += (uint16_t)(seq - tx->rtp_seq);
+	tx->rtp_seq = seq + 1;
+	tx->rtp_seq_valid = true;
+
+	/* restart the PDUs on a gap of the media clock */
+	s = bridge_rtp_sample(au, get_rtp_timestamp(data), now);
+	if (tx->next_valid && s != tx->next) {
+		tx->discont++;
+		tx->next_valid = false;
+	}
+	if (!tx->next_valid) {
+		tx->fill = 0;
+		tx->next = s;
+		tx->next_valid = true;
+	}
+
+	data += off;
+	while (frames > 0) {
+		if (tx->ready >= dev->remain) {
+			/* no free entry, the rest is lost */
+			tx->overruns += frames;
+			tx->next_valid = false;
+			return;
+		}
+
+		n = au->aaf_frames - tx->fill;
+		if (n > frames)
+			n = frames;
+
+		payload = (uint8_t *)dev->frames[(dev->wp + tx->ready) %
+				dev->entrynum] + AVTP_AAF_PAYLOAD_OFFSET;
+		pcm_conv(payload + tx->fill * au->channels * au->aaf_width,
+			 au->aaf_width, data, au->rtp_width, n * au->channels);
+
+		data += n * fsize;
+		frames -= n;
+		tx->fill += n;
+		tx->next += n;
+		if (tx->fill == au->aaf_frames)
+			rtp_to_aaf_complete(cfg, now);
+	}
+}
+
+static void *rtp_to_aaf_loop(void *arg)
+{
+	struct app_config *cfg = arg;
+	struct rtp_to_aaf *tx = &cfg->tx;
+	struct eavb_device *dev = tx->device;
+	struct pollfd pfd[2];
+	uint64_t now;
+	int i, ret;
+
+	pfd[0].fd = tx->sock;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = dev->fd;
+	pfd[1].events = POLLIN;
+
+	while (!sigint) {
+		ret = poll(pfd, (dev->filled) ? 2 : 1, BRIDGE_WAIT_TIME);
+		if (ret <= 0)
+			continue;
+
+		/* completions of the tx queue */
+		if (dev->filled && (pfd[1].revents & POLLIN) &&
+		    dev->take_entry(dev, dev->filled) < 0)
+			break;
+
+		if (!(pfd[0].revents & POLLIN))
+			continue;
+
+		tx->calls++;
+		ret = recvmmsg(tx->sock, tx->msgs, BRIDGE_BATCH,
+			       MSG_DONTWAIT, NULL);
+		if (ret <= 0)
+			continue;
+
+		now = clock_getcount(cfg->clkid);
+		for (i = 0; i < ret; i++)
+			rtp_to_aaf_packet(cfg, tx->bufs[i],
+					  tx->msgs[i].msg_len, now);
+
+		if (tx->ready) {
+			ret = dev->push_entry(dev, tx->ready);
+			if (ret < 0)
+				break;
+			tx->ready -= ret;
+		}
+	}
+
+	return NULL;
+}
+
+static void rtp_to_aaf_report(struct app_config *cfg)
+{
+	struct rtp_to_aaf *tx = &cfg->tx;
+	char buf[256];
+
+	PRINTF("rtp->aaf: %"PRIu64" RTP packets in %"PRIu64" calls, %"PRIu64" lost, %"PRIu64" errors, "
+		"%"PRIu64" discontinuities -> %"PRIu64" AAF PDUs, %"PRIu64" overrun frames\n",
+			tx->packets, tx->calls, tx->lost, tx->errors,
+			tx->discont, tx->pdus, tx->overruns);
+	PRINTF("rtp->aaf: age at push p50/p99/max %"PRIu64"/%"PRIu64"/%"PRIu64"ns, %"PRIu64" late\n",
+			hdr_hist_percentile(&tx->age, 50),
+			hdr_hist_percentile(&tx->age, 99), tx->age.max,
+			tx->late);
+	if (eavb_device_udp_report(tx->device, buf, sizeof(buf)) > 0)
+		PRINTF("rtp->aaf: %s\n", buf);
+}
+
+/*
+ * AAF -> RTP
+ */
+static int aaf_to_rtp_open(struct app_config *cfg)
+{
+	struct aaf_to_rtp *rx = &cfg->rx;
+	struct eavb_device *dev;
+	struct eavb_rxparam rxparam;
+	struct eavb_dma_alloc *p;
+	struct eavb_entry *e;
+	int i;
+
+	rx->sock = netif_open_udp(&cfg->rtp_out_addr, cfg->rtp_out_addrlen,
+				  false);
+	if (rx->sock < 0)
+		return -1;
+	memcpy(&rx->addr, &cfg->rtp_out_addr, cfg->rtp_out_addrlen);
+	rx->addrlen = cfg->rtp_out_addrlen;
+
+	rx->bufs = calloc(BRIDGE_BATCH, sizeof(*rx->bufs));
+	if (!rx->bufs)
+		return -1;
+	bridge_msgs_init(rx->bufs, rx->msgs, rx->iov);
+	for (i = 0; i < BRIDGE_BATCH; i++) {
+		rx->msgs[i].msg_hdr.msg_name = &rx->addr;
+		rx->msgs[i].msg_hdr.msg_namelen = rx->addrlen;
+	}
+	hdr_hist_reset(&rx->age);
+
+	srand(time(NULL) ^ getpid());
+	rx->ssrc = rand();
+	rx->rtp_seq = rand();
+
+	if (cfg->udp_rx)
+		dev = eavb_device_new_udp(&cfg->udp_rx_addr,
+					  cfg->udp_rx_addrlen, cfg->entrynum,
+					  false, cfg->udp_offload);
+	else
+		dev = eavb_device_new(cfg->devname, cfg->entrynum, O_RDWR);
+	if (!dev)
+		return -1;
+	rx->device = dev;
+
+	/* verify that the specified device is avb_rx device */
+	if (!cfg->udp_rx && eavb_get_rxparam(dev->fd, &rxparam) < 0) {
+		PRINTF("[AVB] cannot get rxparam from %s, should be specified avb_rx device file\n",
+				cfg->devname);
+		return -1;
+	}
+
+	for (i = 0, e = dev->entrybuf, p = dev->framebuf;
+			i < dev->entrynum;
+			i++, e++, p++) {
+		if (eavb_device_alloc_page(dev, p) < 0)
+			return -1;
+		dev->frames[i] = p->dma_vaddr;
+		e->vec[0].base = p->dma_paddr;
+		e->vec[0].len = ETHFRAMELEN_MAX;
+	}
+
+	return 0;
+}
+
+static int aaf_to_rtp_flush(struct app_config *cfg)
+{
+	struct aaf_to_rtp *rx = &cfg->rx;
+	int sent, ret;
+
+	for (sent = 0; sent < rx->ready; ) {
+		rx->calls++;
+		ret = sendmmsg(rx->sock, rx->msgs + sent, rx->ready - sent, 0);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			rx->errors += rx->ready - sent;
+			break;
+		}
+		sent += ret;
+	}
+
+	rx->packets += sent;
+	rx->ready = 0;
+
+	return sent;
+}
+
+/* the AAF stream of the bridge, locked to the first one */
+static bool aaf_to_rtp_accept(struct app_config *cfg, void *frame)
+{
+	struct aaf_to_rtp *rx = &cfg->rx;
+	struct bridge_audio *au = &cfg->au;
+	uint8_t streamid[AVTP_STREAMID_SIZE];
+
+	if (get_avtp_subtype(frame) != AVTP_SUBTYPE_AAF ||
+	    get_avtp_aaf_format(frame) != au->aaf_format ||
+	    get_avtp_aaf_nsr(frame) != au->nsr ||
+	    get_avtp_aaf_channels_per_frame(frame) != au->channels)
+		return false;
+
+	get_avtp_stream_id(frame, streamid);
+	if (!rx->locked) {
+		memcpy(rx->StreamID, streamid, AVTP_STREAMID_SIZE);
+		rx->locked = true;
+		PRINTF1("[AVB] aaf->rtp: %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x\n",
+				streamid[0], streamid[1], streamid[2],
+				streamid[3], streamid[4], streamid[5],
+				streamid[6], streamid[7]);
+	}
+
+	return !memcmp(rx->StreamID, streamid, AVTP_STREAMID_SIZE);
+}
+
+static void aaf_to_rtp_complete(struct app_config *cfg, uint64_t now)
+{
+	struct aaf_to_rtp *rx = &cfg->rx;
+	struct bridge_audio *au = &cfg->au;
+	uint64_t t = bridge_time_of(au, rx->start);
+
+	rtp_header_build(rx->bufs[rx->ready], au->rtp_pt, rx->rtp_seq++,
+			 (uint32_t)rx->start + au->media_offset, rx->ssrc);
+	rx->iov[rx->ready].iov_len = RTP_HEADER_SIZE +
+			au->rtp_frames * au->channels * au->rtp_width;
+
+	hdr_hist_record(&rx->age, (now > t) ? now - t : 0);
+	if (now > t + au->latency)
+		rx->late++;
+
+	rx->fill = 0;
+	if (++rx->ready == BRIDGE_BATCH)
+		aaf_to_rtp_flush(cfg);
+}
+
+static void aaf_to_rtp_frame(struct app_config *cfg, void *frame, int len,
+			     uint64_t now)
+{
+	struct aaf_to_rtp *rx = &cfg->rx;
+	struct bridge_audio *au = &cfg->au;
+	int frames, n, fsize, seq, dlen;
+	uint64_t s;
+	uint8_t *data, *payload;
+
+	if (len < AVTP_AAF_PAYLOAD_OFFSET || !aaf_to_rtp_accept(cfg, frame)) {
+		rx->ignored++;
+		return;
+	}
+
+	fsize = au->channels * au->aaf_width;
+	dlen = get_avtp_stream_data_length(frame);
+	if (dlen > len - AVTP_AAF_PAYLOAD_OFFSET)
+		dlen = len - AVTP_AAF_PAYLOAD_OFFSET;
+	frames = dlen / fsize;
+	rx->pdus++;
+
+	seq = get_avtp_sequence_num(frame);
+	if (rx->seq >= 0 && seq != rx->seq)
+		rx->lost += (seq - rx->seq) & 0xff;
+	rx->seq = (seq + 1) & 0xff;
+
+	/*
+	 * The sample of the presentation time continues the packet within
+	 * half a PDU, the timestamps of the talker are not exact samples.
+	 */
+	if (get_avtp_stream_flags(frame) & AVTP_STREAM_FLAG_TV) {
+		s = bridge_sample_of(au, bridge_avtp_time(
+				get_avtp_timestamp(frame), now) - au->latency);
+		if (rx->next_valid &&
+		    llabs((int64_t)(s - rx->next)) > au->aaf_frames / 2) {
+			rx->discont++;
+			rx->next_valid = false;
+		}
+		if (!rx->next_valid) {
+			rx->fill = 0;
+			rx->next = s;
+			rx->next_valid = true;
+		}
+	} else if (!rx->next_valid) {
+		return;
+	}
+
+	data = (uint8_t *)frame + AVTP_AAF_PAYLOAD_OFFSET;
+	while (frames > 0) {
+		if (!rx->fill)
+			rx->start = rx->next;
+
+		n = au->rtp_frames - rx->fill;
+		if (n > frames)
+			n = frames;
+
+		payload = rx->bufs[rx->ready] + RTP_HEADER_SIZE;
+		pcm_conv(payload + rx->fill * au->channels * au->rtp_width,
+			 au->rtp_width, data, au->aaf_width, n * au->channels);
+
+		data += n * fsize;
+		frames -= n;
+		rx->fill += n;
+		rx->next += n;
+		if (rx->fill == au->rtp_frames)
+			aaf_to_rtp_complete(cfg, now);
+	}
+}
+
+static void *aaf_to_rtp_loop(void *arg)
+{
+	struct app_config *cfg = arg;
+	struct aaf_to_rtp *rx = &cfg->rx;
+	struct eavb_device *dev = rx->device;
+	struct eavb_entry *e;
+	uint64_t now;
+	int i, n, rp, ret;
+
+	while (!sigint) {
+		if (dev->remain && dev->push_entry(dev, dev->remain) < 0)
+			break;
+
+		ret = eavb_wait(dev->fd, EAVB_NOTIFY_READ, BRIDGE_WAIT_TIME);
+		if (ret < 0 || !(ret & EAVB_NOTIFY_READ))
+			continue;
+
+		rp = dev->rp;
+		n = dev->take_entry(dev, dev->filled);
+		if (n < 0)
+			break;
+
+		now = clock_getcount(cfg->clkid);
+		for (i = 0; i < n; i++) {
+			e = (struct eavb_entry *)dev->entrybuf +
+					(rp + i) % dev->entrynum;
+			aaf_to_rtp_frame(cfg, dev->frames[(rp + i) %
+					dev->entrynum], e->vec[0].len, now);
+			e->vec[0].len = ETHFRAMELEN_MAX;
+		}
+
+		if (rx->ready)
+			aaf_to_rtp_flush(cfg);
+	}
+
+	return NULL;
+}
+
+static void aaf_to_rtp_report(struct app_config *cfg)
+{
+	struct aaf_to_rtp *rx = &cfg->rx;
+	char buf[256];
+
+	PRINTF("aaf->rtp: %"PRIu64" AAF PDUs, %"PRIu64" lost, %"PRIu64" ignored, %"PRIu64" discontinuities "
+		"-> %"PRIu64" RTP packets in %"PRIu64" calls, %"PRIu64" errors\n",
+			rx->pdus, rx->lost, rx->ignored, rx->discont,
+			rx->packets, rx->calls, rx->errors);
+	PRINTF("aaf->rtp: age at send p50/p99/max %"PRIu64"/%"PRIu64"/%"PRIu64"ns, %"PRIu64" late\n",
+			hdr_hist_percentile(&rx->age, 50),
+			hdr_hist_percentile(&rx->age, 99), rx->age.max,
+			rx->late);
+	if (eavb_device_udp_report(rx->device, buf, sizeof(buf)) > 0)
+		PRINTF("aaf->rtp: %s\n", buf);
+}
+
+int main(int argc, char **argv)
+{
+	struct app_config *cfg = calloc(1, sizeof(*cfg));
+	pthread_t threads[2];
+	int nthreads = 0, ret = -1;
+	int i;
+
+	if (!cfg) {
+		PRINTF("[AVB] cannot allocate cfg\n");
+		return -1;
+	}
+
+	if (config_parse(cfg, argc, argv) < 0)
+		goto out;
+
+	/* install signal handler */
+	install_sighandler(SIGINT, sigint_handler);
+	install_sighandler(SIGTERM, sigint_handler);
+
+	if (cfg->rtp_in) {
+		if (rtp_to_aaf_open(cfg) < 0) {
+			PRINTF("[AVB] cannot setup RTP to AAF\n");
+			goto out;
+		}
+		PRINTF1("[AVB] rtp->aaf: %s: %dMbps / %02x:%02x:%02x:%02x:%02x:%02x+%02x:%02x\n",
+				cfg->ifname, cfg->speed,
+				cfg->tx.StreamID[0], cfg->tx.StreamID[1],
+				cfg->tx.StreamID[2], cfg->tx.StreamID[3],
+				cfg->tx.StreamID[4], cfg->tx.StreamID[5],
+				cfg->tx.StreamID[6], cfg->tx.StreamID[7]);
+	}
+
+	if (cfg->rtp_out && aaf_to_rtp_open(cfg) < 0) {
+		PRINTF("[AVB] cannot setup AAF to RTP\n");
+		goto out;
+	}
+
+	PRINTF1("[AVB] %dHz %dch, RTP L%d %d frames, AAF %dbit %d frames, PCM conversion by %s\n",
+			cfg->au.rate, cfg->au.channels, cfg->au.rtp_width * 8,
+			cfg->au.rtp_frames, cfg->au.aaf_width * 8,
+			cfg->au.aaf_frames, pcm_conv_impl());
+
+	PRINTF1("[AVB] start bridge.\n");
+	if (cfg->rtp_in &&
+	    !pthread_create(&threads[nthreads], NULL, rtp_to_aaf_loop, cfg))
+		nthreads++;
+	if (cfg->rtp_out &&
+	    !pthread_create(&threads[nthreads], NULL, aaf_to_rtp_loop, cfg))
+		nthreads++;
+	for (i = 0; i < nthreads; i++)
+		pthread_join(threads[i], NULL);
+	PRINTF1("[AVB] finish bridge.\n");
+
+	if (cfg->rtp_in)
+		rtp_to_aaf_report(cfg);
+	if (cfg->rtp_out)
+		aaf_to_rtp_report(cfg);
+
+	ret = 0;
+
+out:
+	if (cfg->tx.sock >= 0)
+		close(cfg->tx.sock);
+	free(cfg->tx.bufs);
+	eavb_device_free(cfg->tx.device);
+	if (cfg->rx.sock >= 0)
+		close(cfg->rx.sock);
+	free(cfg->rx.bufs);
+	eavb_device_free(cfg->rx.device);
+	free(cfg->devname);
+	free(cfg);
+
+	if (!ret)
+		return 0;
+
+	return -1;
+}
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __SIMPLE_BRIDGE_H__
+#define __SIMPLE_BRIDGE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include "netif_util.h"
+#include "packet.h"
+#include "eavb_device.h"
+#include "hdr_hist.h"
+
+#define NSEC_SCALE	(1000000000)
+
+#define BRIDGE_BATCH        (32)   /* datagrams of recvmmsg/sendmmsg */
+#define BRIDGE_RTP_SIZE     (1500) /* buffer of a datagram */
+#define BRIDGE_RTP_PAYLOAD  (1440) /* AES67 8.3, payload within the MTU */
+#define BRIDGE_CHANNELS_MAX (64)
+#define BRIDGE_WAIT_TIME    (100)  /* msec */
+
+/*
+ * Audio of both directions. The PTP time of media clock sample s is
+ * s / rate, the RTP timestamp of it is s + media_offset (AES67
+ * mediaclk:direct) and the AAF presentation time is s / rate + latency.
+ */
+struct bridge_audio {
+	int                rate;
+	int                nsr;
+	int                channels;
+	int                rtp_width;    /* bytes per sample, L16 or L24 */
+	int                rtp_pt;
+	int                rtp_frames;   /* frames per RTP packet (ptime) */
+	int                aaf_format;
+	int                aaf_width;
+	int                aaf_frames;   /* frames per AAF PDU */
+	uint32_t           media_offset;
+	uint64_t           latency;      /* nsec */
+};
+
+/* AES67 RTP -> AAF on a tx queue */
+struct rtp_to_aaf {
+	int                sock;
+	struct eavb_device *device;
+	uint8_t            StreamID[AVTP_STREAMID_SIZE];
+	uint8_t            seq;          /* sequence_num of the next PDU */
+	int                ready;        /* PDUs not pushed yet */
+	int                fill;         /* frames of the PDU being filled */
+	uint64_t           next;         /* media clock sample of the next frame */
+	bool               next_valid;
+	uint16_t           rtp_seq;
+	bool               rtp_seq_valid;
+
+	uint8_t            (*bufs)[BRIDGE_RTP_SIZE];
+	struct mmsghdr     msgs[BRIDGE_BATCH];
+	struct iovec       iov[BRIDGE_BATCH];
+
+	/* statistics */
+	uint64_t           packets;
+	uint64_t           calls;
+	uint64_t           lost;         /* RTP sequence gaps */
+	uint64_t           errors;       /* broken or other format */
+	uint64_t           discont;      /* timestamp discontinuities */
+	uint64_t           overruns;     /* frames without free entries */
+	uint64_t           pdus;
+	uint64_t           late;         /* presentation time passed */
+	struct hdr_hist    age;          /* from the sampling to the push */
+};
+
+/* AAF of an rx queue -> AES67 RTP */
+struct aaf_to_rtp {
+	struct eavb_device *device;
+	int                sock;
+	struct sockaddr_storage addr;
+	socklen_t          addrlen;
+	uint8_t            StreamID[AVTP_STREAMID_SIZE];
+	bool               locked;       /* to the first AAF stream */
+	int                seq;          /* expected sequence_num, -1:none */
+	uint16_t           rtp_seq;
+	uint32_t           ssrc;
+	int                ready;        /* RTP packets not sent yet */
+	int                fill;         /* frames of the packet being filled */
+	uint64_t           start;        /* media clock sample of the packet */
+	uint64_t           next;
+	bool               next_valid;
+
+	uint8_t            (*bufs)[BRIDGE_RTP_SIZE];
+	struct mmsghdr     msgs[BRIDGE_BATCH];
+	struct iovec       iov[BRIDGE_BATCH];
+
+	/* statistics */
+	uint64_t           pdus;
+	uint64_t           ignored;      /* other streams and formats */
+	uint64_t           lost;         /* AVTP sequence gaps */
+	uint64_t           discont;
+	uint64_t           packets;
+	uint64_t           calls;
+	uint64_t           errors;
+	uint64_t           late;
+	struct hdr_hist    age;          /* from the sampling to the send */
+};
+
+struct app_config {
+	char               ifname[IFNAMSIZ];
+	uint8_t            source_addr[ETH_ALEN];
+	int                speed;
+	char               *devname;
+	int                entrynum;
+	clockid_t          clkid;
+	uint8_t            SRclassID;
+	uint8_t            SRpriority;
+	uint8_t            SRvid;
+	int                SRclassIntervalFrames;
+	int                MaxFrameSize;
+	int                uid;
+	uint8_t            dest_addr[ETH_ALEN];
+	bool               use_dest_addr;
+
+	struct bridge_audio au;
+
+	bool               rtp_in;
+	struct sockaddr_storage rtp_in_addr;
+	socklen_t          rtp_in_addrlen;
+	bool               rtp_out;
+	struct sockaddr_storage rtp_out_addr;
+	socklen_t          rtp_out_addrlen;
+
+	/* IEEE1722 Annex J UDP transport instead of the eavb queues */
+	bool               udp_tx;
+	struct sockaddr_storage udp_tx_addr;
+	socklen_t          udp_tx_addrlen;
+	bool               udp_rx;
+	struct sockaddr_storage udp_rx_addr;
+	socklen_t          udp_rx_addrlen;
+	bool               udp_offload;
+
+	struct rtp_to_aaf  tx;
+	struct aaf_to_rtp  rx;
+};
+
+#endif /* __SIMPLE_BRIDGE_H__ */
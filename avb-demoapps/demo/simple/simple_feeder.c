@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "config.h"
+#include "simple_feeder.h"
+
+#define PROGNAME "simple_feeder"
+#define PROGVERSION "0.1"
+
+static int show_version(struct app_config *cfg)
+{
+	fprintf(stderr, PROGNAME " version " PROGVERSION "\n");
+	return 0;
+}
+
+enum {
+	OPT_VERSION = 1,
+};
+
+static const char *optstring = "f:P:h";
+static const struct option long_options[] = {
+	{"file",              required_argument, NULL, 'f'},
+	{"pace",              required_argument, NULL, 'P'},
+	{"version",           no_argument,       NULL, OPT_VERSION},
+	{"help",              no_argument,       NULL, 'h'},
+	{NULL,                0,                 NULL,  0 },
+};
+
+static int show_usage(struct app_config *cfg)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options] <name>\n"
+		"\n"
+		"Feed the payloads of a file to simple_talker --shm=<name>.\n"
+		"The payloads are written in place into the slots of the ring.\n"
+		"\n"
+		"options:\n"
+		"    -f, --file=FILE             specify the payload file, '-' for stdin\n"
+		"                                (default:'-')\n"
+		"    -P, --pace=USEC             sleep between the payloads\n"
+		"                                (default:0 as fast as the ring accepts)\n"
+		"    -h, --help                  display this help\n"
+		"        --version               print version information\n"
+		"\n"
+		"examples:\n"
+		" simple_talker -s 1000 --shm=avb_tx0 &\n"
+		" " PROGNAME " -f /tmp/in.bin avb_tx0\n"
+		"\n"
+		PROGNAME " version " PROGVERSION "\n");
+	return 0;
+}
+
+/*
+ * config
+ */
+static int config_init(struct app_config *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+
+	cfg->fd = -1;
+
+	return 0;
+}
+
+static int config_parse(struct app_config *cfg, int argc, char **argv)
+{
+	int c;
+	int option_index = 0;
+	struct stat st;
+
+	config_init(cfg);
+
+	/* Process the command line arguments. */
+	while (EOF != (c = getopt_long(argc, argv, optstring,
+					long_options, &option_index))) {
+		switch (c) {
+		case 'f':
+			free(cfg->filename);
+			cfg->filename = strdup(optarg);
+			break;
+		case 'P':
+			cfg->pace = atoi(optarg);
+			break;
+		case OPT_VERSION:
+			show_version(cfg);
+			exit(EXIT_SUCCESS);
+		case 'h':
+		default:
+			show_usage(cfg);
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	if (cfg->pace < 0) {
+		PRINTF1("[AVB] out of range pace=%d, specify 0 or greater\n",
+				cfg->pace);
+		return -1;
+	}
+
+	if (optind != argc - 1) {
+		PRINTF1("[AVB] Please specify the name of the talker feed.\n");
+		return -1;
+	}
+	cfg->shm_name = strdup(argv[optind]);
+
+	if (!cfg->filename || !strcmp(cfg->filename, "-")) {
+		cfg->fd = STDIN_FILENO;
+	} else {
+		cfg->fd = open(cfg->filename, O_RDONLY);
+		if (cfg->fd < 0) {
+			PRINTF("[AVB] cannot open %s.\n", cfg->filename);
+			return -1;
+		}
+	}
+
+	/* a regular file is copied from its pages, without read per slot */
+	if (fstat(cfg->fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size) {
+		cfg->map = mmap(NULL, st.st_size, PROT_READ,
+				MAP_SHARED | MAP_POPULATE, cfg->fd, 0);
+		if (cfg->map == MAP_FAILED)
+			cfg->map = NULL;
+		else
+			cfg->size = st.st_size;
+	}
+
+	return 0;
+}
+
+/* signal handler */
+static bool sigint;
+static void sigint_handler(int s)
+{
+	sigint = true;
+}
+
+static int install_sighandler(int s, void (*handler)(int))
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handler;
+	sigemptyset(&sa.sa_mask);
+
+	if (sigaction(s, &sa, NULL) == -1) {
+		perror("sigaction");
+		return -1;
+	}
+
+	return 0;
+}
+
+/* fill the slot, short only at the end of the file */
+static int feed_read(struct app_config *cfg, uint8_t *data, int size)
+{
+	int n = 0, ret;
+
+	if (cfg->map) {
+		if (size > cfg->size - cfg->off)
+			size = cfg->size - cfg->off;
+		memcpy(data, cfg->map + cfg->off, size);
+		cfg->off += size;
+		return size;
+	}
+
+	while (n < size) {
+		ret = read(cfg->fd, data + n, size - n);
+		if (ret < 0) {
+			if (errno == EINTR && !sigint)
+				continue;
+			return -1;
+		}
+		if (!ret)
+			break;
+		n += ret;
+	}
+
+	return n;
+}
+
+static int feed_loop(struct app_config *cfg)
+{
+	void *data;
+	int n, size;
+
+	size = shm_feed_slot_size(cfg->feed);
+
+	while (!sigint) {
+		/* wait while the talker has no free slot */
+		data = shm_feed_reserve(cfg->feed, -1);
+		if (!data) {
+			if (sigint)
+				break;
+			PRINTF("[AVB] the talker is gone\n");
+			return -1;
+		}
+
+		n = feed_read(cfg, data, size);
+		if (n < 0) {
+			PRINTF("[AVB] cannot read the payloads\n");
+			return -1;
+		}
+		if (!n)
+			break;
+
+		shm_feed_commit(cfg->feed, n);
+		cfg->payloads++;
+		cfg->bytes += n;
+
+		if (cfg->pace)
+			usleep(cfg->pace);
+	}
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	struct app_config cfg;
+	int ret = -1;
+
+	if (config_parse(&cfg, argc, argv) < 0)
+		goto out;
+
+	install_sighandler(SIGINT, sigint_handler);
+	install_sighandler(SIGTERM, sigint_handler);
+
+	cfg.feed = shm_feed_connect(cfg.shm_name);
+	if (!cfg.feed) {
+		PRINTF("[AVB] cannot connect to the talker on @%s\n",
+				cfg.shm_name);
+		goto out;
+	}
+
+	PRINTF1("[AVB] feeding @%s with payloads of %d bytes.\n",
+			cfg.shm_name, shm_feed_slot_size(cfg.feed));
+
+	ret = feed_loop(&cfg);
+	/* the underrun eventfd is a counter, read once not to syscall per slot */
+	cfg.underruns = shm_feed_underruns(cfg.feed);
+
+	/* the talker ends the stream when the ring is drained */
+	shm_feed_disconnect(cfg.feed);
+
+	PRINTF1("[AVB] %"PRIu64" payloads, %"PRIu64" bytes, %"PRIu64" underruns of the talker\n",
+			cfg.payloads, cfg.bytes, cfg.underruns);
+
+out:
+	if (cfg.map)
+		munmap(cfg.map, cfg.size);
+	if (cfg.fd > STDIN_FILENO)
+		close(cfg.fd);
+	free(cfg.filename);
+	free(cfg.shm_name);
+
+	if (!ret)
+		return 0;
+
+	return -1;
+}
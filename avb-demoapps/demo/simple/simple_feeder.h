@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __SIMPLE_FEEDER_H__
+#define __SIMPLE_FEEDER_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "shm_feed.h"
+
+struct app_config {
+	char               *shm_name;
+	char               *filename;
+	int                fd;
+	uint8_t            *map;      /* regular file, NULL:read */
+	size_t             size;
+	size_t             off;
+	int                pace;      /* usec between payloads, 0:not paced */
+	uint64_t           payloads;
+	uint64_t           bytes;
+	uint64_t           underruns;
+	struct shm_feed    *feed;
+};
+
+#endif /* __SIMPLE_FEEDER_H__ */
@@ -4,6 +4,8 @@
  * http://opensource.org/licenses/mit-license.php
  */
 
+#define _GNU_SOURCE /* CPU_SET */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -13,12 +15,20 @@
 #include <fcntl.h>
 #include <getopt.h>
 #include <stdbool.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/uio.h>
+#include <sys/resource.h>
 
 #include "config.h"
 #include "eavb_device.h"
 #include "simple_listener.h"
 #include "stats.h"
 #include "common.h"
+#include "netif_util.h"
 
 #include "msrp.h"
 #include "eavb.h"
@@ -28,20 +38,79 @@
 
 #define ARRAY_SIZE(a)		(sizeof(a) / sizeof(a[0]))
 
+#define DEMUX_BATCH  (64)         /* frames per recvmmsg() */
+#define DEMUX_PERIOD (NSEC_SCALE) /* reassignment of the queues */
+
 static int show_version(struct app_config *cfg)
 {
 	fprintf(stderr, PROGNAME " version " PROGVERSION "\n");
 	return 0;
 }
 
-static const char *optstring = "d:f:n:m:w:h";
+enum {
+	OPT_VERSION = 1,
+	OPT_CAN,
+	OPT_AEF_KEY,
+	OPT_AEF_MODE,
+	OPT_AEF_KEY_ID,
+	OPT_CRC,
+	OPT_DIRECT,
+	OPT_QUEUES,
+	OPT_THREADS,
+	OPT_CPUS,
+	OPT_HOLD,
+	OPT_MEDIA_CLOCK,
+	OPT_ASRC,
+	OPT_ASRC_RATE,
+	OPT_MIX,
+	OPT_MIX_CHANNELS,
+	OPT_MIX_GAIN,
+	OPT_H264,
+	OPT_DEMUX,
+	OPT_SHM,
+	OPT_SHM_SLOTS,
+	OPT_PCAP,
+	OPT_PCAP_SIZE,
+	OPT_PCAP_TIME,
+	OPT_UDP,
+	OPT_UDP_OFFLOAD,
+};
+
+static const char *optstring = "d:f:n:m:w:a:p:h";
 static const struct option long_options[] = {
 	{"device",            required_argument, NULL, 'd'},
 	{"file",              required_argument, NULL, 'f'},
 	{"frame-num",         required_argument, NULL, 'n'},
 	{"msrp",              required_argument, NULL, 'm'},
 	{"waitmode",          required_argument, NULL, 'w'},
-	{"version",           no_argument,       NULL,  1 },
+	{"analyze",           required_argument, NULL, 'a'},
+	{"ptp",               required_argument, NULL, 'p'},
+	{"can",               required_argument, NULL, OPT_CAN},
+	{"aef-key",           required_argument, NULL, OPT_AEF_KEY},
+	{"aef-mode",          required_argument, NULL, OPT_AEF_MODE},
+	{"aef-key-id",        required_argument, NULL, OPT_AEF_KEY_ID},
+	{"crc",               no_argument,       NULL, OPT_CRC},
+	{"direct",            no_argument,       NULL, OPT_DIRECT},
+	{"queues",            required_argument, NULL, OPT_QUEUES},
+	{"threads",           required_argument, NULL, OPT_THREADS},
+	{"cpus",              required_argument, NULL, OPT_CPUS},
+	{"demux",             required_argument, NULL, OPT_DEMUX},
+	{"hold",              required_argument, NULL, OPT_HOLD},
+	{"media-clock",       required_argument, NULL, OPT_MEDIA_CLOCK},
+	{"asrc",              required_argument, NULL, OPT_ASRC},
+	{"asrc-rate",         required_argument, NULL, OPT_ASRC_RATE},
+	{"mix",               required_argument, NULL, OPT_MIX},
+	{"mix-channels",      required_argument, NULL, OPT_MIX_CHANNELS},
+	{"mix-gain",          required_argument, NULL, OPT_MIX_GAIN},
+	{"h264",              no_argument,       NULL, OPT_H264},
+	{"shm",               required_argument, NULL, OPT_SHM},
+	{"shm-slots",         required_argument, NULL, OPT_SHM_SLOTS},
+	{"pcap",              required_argument, NULL, OPT_PCAP},
+	{"pcap-size",         required_argument, NULL, OPT_PCAP_SIZE},
+	{"pcap-time",         required_argument, NULL, OPT_PCAP_TIME},
+	{"udp",               required_argument, NULL, OPT_UDP},
+	{"udp-offload",       required_argument, NULL, OPT_UDP_OFFLOAD},
+	{"version",           no_argument,       NULL, OPT_VERSION},
 	{"help",              no_argument,       NULL, 'h'},
 	{NULL,                0,                 NULL,  0 },
 };
@@ -58,6 +127,46 @@ static int show_usage(struct app_config *cfg)
 			"    -m, --msrp=MODE             MSRP mode 0:static 1:dynamic (default:1 dynamic)\n"
 			"    -w, --waitmode=MODE         specify wait mode (default:0 poll)\n"
 			"                                0:poll, 1:blocking(NOWAIT) 2:blocking(WAITALL)\n"
+			"    -a, --analyze=SEC           analyze loss, reorder, lateness and jitter per StreamID\n"
+			"                                and report every SEC seconds (0:summary only)\n"
+			"    -p, --ptp=CLOCK             specify PTP clock name of arrival time (default:/dev/ptp0)\n"
+			"        --hold=USEC             write each payload to the file at its presentation time\n"
+			"                                plus USEC, drop late frames (jitter buffer)\n"
+			"        --media-clock=HZ        recover media clock of AAF/CRF with DLL of bandwidth HZ\n"
+			"        --asrc=NAME             write AAF audio converted to the local clock to the file\n"
+			"                                (interleaved 32bit float, needs --media-clock)\n"
+			"        --asrc-rate=HZ          specify sample rate of --asrc output (default:48000)\n"
+			"        --mix=NAME              write the mix of AAF streams aligned on presentation time\n"
+			"                                to the file (interleaved 16bit)\n"
+			"        --mix-channels=NUM      specify number of channels of --mix output (default:2)\n"
+			"        --mix-gain=STREAMID=DB  specify gain of the stream in dB, 0 and below (default:0)\n"
+			"        --h264                  write H.264 CVF to the file as Annex-B byte stream\n"
+			"                                (file or pipe, incomplete access units are dropped)\n"
+			"        --shm=NAME              publish the received frames to the shared memory ring\n"
+			"                                /dev/shm/NAME for local consumers\n"
+			"        --shm-slots=NUM         specify number of frames of --shm, power of 2 (default:4096)\n"
+			"        --pcap=NAME             capture the received frames to pcapng file with\n"
+			"                                nanosecond timestamps of -p clock, queues are merged\n"
+			"        --pcap-size=MB          rotate --pcap file by size (NAME, NAME.1, ...)\n"
+			"        --pcap-time=SEC         rotate --pcap file by time\n"
+			"        --can=IFNAME            specify CAN interface to output NTSCF/TSCF\n"
+			"        --aef-key=FILE          specify AES key file to decrypt AEF (key + 4 bytes salt)\n"
+			"        --aef-mode=MODE         specify AES mode ctr/gcm (default:gcm)\n"
+			"        --aef-key-id=NUM        specify key_id of AEF (default:0)\n"
+			"        --crc                   verify CRC32C trailer of stream data\n"
+			"        --direct                write the file with O_DIRECT\n"
+			"        --queues=LIST           receive /dev/avb_rxN of the list (e.g. 0-15) in one process\n"
+			"                                (statistics only, static MSRP and poll wait mode)\n"
+			"        --threads=NUM           specify number of worker threads of --queues\n"
+			"                                (default:number of online CPUs)\n"
+			"        --cpus=LIST             specify CPUs to pin the worker threads (default:0-)\n"
+			"        --demux=IFNAME          assign the queues of --queues to StreamIDs on demand and\n"
+			"                                receive the other streams from IFNAME in software\n"
+			"        --udp=[ADDR:]PORT       receive AVTPDUs in UDP datagrams of IEEE1722 Annex J\n"
+			"                                instead of the eavb driver, ADDR joins the multicast\n"
+			"                                group (requires -m 0 and -w 0), with --queues the\n"
+			"                                queue N receives on PORT + N\n"
+			"        --udp-offload=0|1       use UDP generic receive offload (default:1)\n"
 			"    -h, --help                  display this help\n"
 			"        --version               print version information\n"
 			"\n"
@@ -66,6 +175,20 @@ static int show_usage(struct app_config *cfg)
 			" -d /dev/avb_rx0 -f /tmp/dump.bin -n 0 -m 1\n"
 			" " PROGNAME " -d /dev/avb_rx1 -n 80000 -m 1\n"
 			" " PROGNAME " -m 0\n"
+			" " PROGNAME " -d /dev/avb_rx2 --can=vcan1\n"
+			" " PROGNAME " -d /dev/avb_rx3 --aef-key=/etc/avb/aef.key -f /tmp/dump.bin\n"
+			" " PROGNAME " -d /dev/avb_rx0 -f /mnt/nvme/dump.bin --direct\n"
+			" " PROGNAME " --queues=0-15 --threads=4 --cpus=0-3\n"
+			" " PROGNAME " --queues=0-15 --threads=4 --demux=eth0\n"
+			" " PROGNAME " -d /dev/avb_rx0 -a 1 -p /dev/ptp0\n"
+			" " PROGNAME " -d /dev/avb_rx0 -f /tmp/dump.bin --hold=500\n"
+			" " PROGNAME " -d /dev/avb_rx0 --media-clock=1\n"
+			" " PROGNAME " -d /dev/avb_rx0 --media-clock=1 --asrc=/tmp/audio.f32\n"
+			" " PROGNAME " -d /dev/avb_rx0 --mix=/tmp/mix.s16 --mix-gain=91:e0:f0:00:fe:00:00:01=-6\n"
+			" " PROGNAME " -d /dev/avb_rx0 --h264 -f - | ffplay -f h264 -\n"
+			" " PROGNAME " -d /dev/avb_rx0 --shm=avb_rx0\n"
+			" " PROGNAME " --queues=0-15 --pcap=/mnt/nvme/avb.pcapng --pcap-size=1024\n"
+			" " PROGNAME " -m 0 --udp=239.0.17.22:17220 -a 1 -p CLOCK_REALTIME\n"
 			"\n"
 			PROGNAME " version " PROGVERSION "\n");
 	return 0;
@@ -86,10 +209,76 @@ static int config_init(struct app_config *cfg)
 	cfg->framenums = 0;
 	cfg->msrp = MSRP_ON;
 	cfg->waitmode = WAIT_MODE_POLL;
+	cfg->acf.fd = -1;
+	cfg->asrc.fd = -1;
+	cfg->asrc.rate = 48000;
+	cfg->mix.fd = -1;
+	cfg->mix.channels = 2;
+	cfg->seq.seqno = -1;
+	cfg->seq.error = -1;
+	cfg->demux_fd = -1;
+	cfg->shm_slots = 4096;
+	cfg->udp_offload = true;
 
 	return 0;
 }
 
+/* parse STREAMID=DB of --mix-gain */
+static int config_parse_mix_gain(struct app_config *cfg, char *str)
+{
+	uint8_t id[AVTP_STREAMID_SIZE];
+	double db;
+
+	if (sscanf(str, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx=%lf",
+			&id[0], &id[1], &id[2], &id[3],
+			&id[4], &id[5], &id[6], &id[7], &db) != 9)
+		return -1;
+
+	if (!cfg->mix.mixer) {
+		cfg->mix.mixer = mixer_new(cfg->mix.channels);
+		if (!cfg->mix.mixer)
+			return -1;
+	}
+
+	return mixer_set_gain(cfg->mix.mixer, id, db);
+}
+
+/* parse list of numbers like "0-3,8,10-11" */
+static int config_parse_list(char *str, int *list, int max)
+{
+	char *p = str;
+	char *end;
+	int first, last, n = 0;
+
+	while (*p) {
+		first = strtol(p, &end, 0);
+		if (end == p || first < 0)
+			return -1;
+		last = first;
+		p = end;
+
+		if (*p == '-') {
+			last = strtol(++p, &end, 0);
+			if (end == p || last < first)
+				return -1;
+			p = end;
+		}
+
+		for (; first <= last; first++) {
+			if (n == max)
+				return -1;
+			list[n++] = first;
+		}
+
+		if (*p == ',')
+			p++;
+		else if (*p)
+			return -1;
+	}
+
+	return n;
+}
+
 static int config_parse_fname(char *name)
 {
 	struct {
@@ -128,6 +317,10 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 	int option_index = 0;
 	char *dname = NULL;
 	char *fname = NULL;
+	char *keyname = NULL;
+	char *cname = NULL;
+	int aef_mode = AVTP_AEF_MODE_GCM;
+	uint32_t aef_key_id = 0;
 
 	config_init(cfg);
 
@@ -150,7 +343,145 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		case 'w':
 			cfg->waitmode = atoi(optarg);
 			break;
-		case 1:
+		case 'a':
+			cfg->analyze = true;
+			cfg->analyze_interval = atoi(optarg);
+			break;
+		case 'p':
+			cname = strdup(optarg);
+			break;
+		case OPT_CAN:
+			cfg->acf.fd = acf_can_open(optarg);
+			if (cfg->acf.fd < 0) {
+				PRINTF("[AVB] cannot open CAN interface %s.\n",
+						optarg);
+				return -1;
+			}
+			break;
+		case OPT_AEF_KEY:
+			keyname = strdup(optarg);
+			break;
+		case OPT_AEF_MODE:
+			aef_mode = aef_parse_mode(optarg);
+			if (aef_mode < 0) {
+				PRINTF("[AVB] unknown AEF mode %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_AEF_KEY_ID:
+			aef_key_id = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_CRC:
+			cfg->crc = true;
+			break;
+		case OPT_DIRECT:
+			cfg->direct = true;
+			break;
+		case OPT_QUEUES:
+			cfg->nqueues = config_parse_list(optarg,
+						cfg->queue_ids, RX_QUEUE_MAX);
+			if (cfg->nqueues <= 0) {
+				PRINTF("[AVB] invalid queue list %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_THREADS:
+			cfg->nworkers = atoi(optarg);
+			break;
+		case OPT_HOLD:
+			cfg->jitter = true;
+			cfg->hold = strtoull(optarg, NULL, 0) * 1000;
+			break;
+		case OPT_MEDIA_CLOCK:
+			cfg->mclk_bandwidth = atof(optarg);
+			if (cfg->mclk_bandwidth <= 0) {
+				PRINTF("[AVB] out of range media-clock=%s, specify greater than 0\n",
+						optarg);
+				return -1;
+			}
+			break;
+		case OPT_ASRC:
+			cfg->asrc.fd = open(optarg,
+					O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (cfg->asrc.fd < 0) {
+				PRINTF("[AVB] cannot open file. %s\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_ASRC_RATE:
+			cfg->asrc.rate = atof(optarg);
+			break;
+		case OPT_MIX:
+			cfg->mix.fd = open(optarg,
+					O_WRONLY | O_CREAT | O_TRUNC, 0644);
+			if (cfg->mix.fd < 0) {
+				PRINTF("[AVB] cannot open file. %s\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_MIX_CHANNELS:
+			if (cfg->mix.mixer) {
+				PRINTF("[AVB] specify --mix-channels before --mix-gain\n");
+				return -1;
+			}
+			cfg->mix.channels = atoi(optarg);
+			break;
+		case OPT_MIX_GAIN:
+			if (config_parse_mix_gain(cfg, optarg) < 0) {
+				PRINTF("[AVB] invalid mix gain %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_H264:
+			cfg->h264 = h264_depay_new();
+			if (!cfg->h264)
+				return -1;
+			break;
+		case OPT_SHM:
+			cfg->shm_name = strdup(optarg);
+			break;
+		case OPT_SHM_SLOTS:
+			cfg->shm_slots = atoi(optarg);
+			break;
+		case OPT_PCAP:
+			cfg->pcap_name = strdup(optarg);
+			break;
+		case OPT_PCAP_SIZE:
+			cfg->pcap_size = strtoull(optarg, NULL, 0) *
+						1024 * 1024;
+			break;
+		case OPT_PCAP_TIME:
+			cfg->pcap_time = strtoull(optarg, NULL, 0) *
+						NSEC_SCALE;
+			break;
+		case OPT_DEMUX:
+			cfg->demux_ifname = strdup(optarg);
+			break;
+		case OPT_CPUS:
+			cfg->ncpus = config_parse_list(optarg, cfg->cpus,
+						RX_QUEUE_MAX);
+			if (cfg->ncpus <= 0) {
+				PRINTF("[AVB] invalid CPU list %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_UDP:
+			if (netif_parse_udp(optarg, AVTP_UDP_PORT,
+					    &cfg->udp_addr,
+					    &cfg->udp_addrlen) < 0) {
+				PRINTF1("[AVB] invalid UDP address %s.\n",
+						optarg);
+				return -1;
+			}
+			free(dname);
+			if (asprintf(&dname, "udp:%s", optarg) < 0)
+				return -1;
+			cfg->udp = true;
+			break;
+		case OPT_UDP_OFFLOAD:
+			cfg->udp_offload = !!atoi(optarg);
+			break;
+		case OPT_VERSION:
 			show_version(cfg);
 			exit(EXIT_SUCCESS);
 		case 'h':
@@ -174,6 +505,70 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		return -1;
 	}
 
+	if (cfg->nqueues) {
+		if ((dname && !cfg->udp) || fname || keyname || cfg->crc ||
+		    cfg->acf.fd >= 0 || cfg->jitter || cfg->asrc.fd >= 0 ||
+		    cfg->mix.fd >= 0 || cfg->h264 || cfg->shm_name) {
+			PRINTF("[AVB] --queues cannot be used with -d, -f, --can, --aef-key, --crc, --hold, --asrc, --mix, --h264 and --shm\n");
+			return -1;
+		}
+		if (cfg->waitmode != WAIT_MODE_POLL) {
+			PRINTF("[AVB] --queues supports only poll wait mode\n");
+			return -1;
+		}
+		if (cfg->nworkers <= 0)
+			cfg->nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+		if (cfg->nworkers > cfg->nqueues)
+			cfg->nworkers = cfg->nqueues;
+		cfg->msrp = MSRP_OFF;
+	}
+
+	if (cfg->shm_name && (keyname || cfg->shm_slots <= 0 ||
+			       (cfg->shm_slots & (cfg->shm_slots - 1)))) {
+		PRINTF("[AVB] --shm needs power of 2 --shm-slots and cannot be used with --aef-key\n");
+		return -1;
+	}
+
+	if (cfg->udp && (cfg->msrp != MSRP_OFF ||
+			 cfg->waitmode != WAIT_MODE_POLL)) {
+		PRINTF("[AVB] --udp needs -m 0 and -w 0\n");
+		return -1;
+	}
+
+	if (cfg->demux_ifname && (!cfg->nqueues || cfg->udp)) {
+		PRINTF("[AVB] --demux needs --queues without --udp\n");
+		return -1;
+	}
+
+	if (cfg->asrc.fd >= 0 && (!cfg->mclk_bandwidth || cfg->asrc.rate <= 0)) {
+		PRINTF("[AVB] --asrc needs --media-clock and positive --asrc-rate\n");
+		return -1;
+	}
+
+	if (cfg->mix.fd >= 0) {
+		if (!cfg->mix.mixer)
+			cfg->mix.mixer = mixer_new(cfg->mix.channels);
+		if (!cfg->mix.mixer) {
+			PRINTF1("[AVB] out of range mix-channels=%d, specify between 1 and %d\n",
+					cfg->mix.channels, MIXER_CHANNELS_MAX);
+			return -1;
+		}
+		cfg->mix.out = calloc(MIXER_FRAMES * cfg->mix.channels,
+					sizeof(*cfg->mix.out));
+		if (!cfg->mix.out)
+			return -1;
+	}
+
+	if (cfg->jitter && !fname) {
+		PRINTF("[AVB] --hold needs the file to write (e.g. -f /dev/null)\n");
+		return -1;
+	}
+
+	if (cfg->h264 && (!fname || keyname || cfg->jitter)) {
+		PRINTF("[AVB] --h264 needs the file to write and cannot be used with --aef-key and --hold\n");
+		return -1;
+	}
+
 	if (fname) {
 		cfg->fd = config_parse_fname(fname);
 		if (cfg->fd < 0) {
@@ -183,6 +578,43 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		free(fname);
 	}
 
+	if (keyname) {
+		cfg->aef = aef_ctx_new(keyname, aef_mode, aef_key_id, 0);
+		if (!cfg->aef) {
+			PRINTF("[AVB] cannot setup AEF with %s.\n", keyname);
+			return -1;
+		}
+		free(keyname);
+
+		cfg->aef_packets = calloc(cfg->entrynum,
+					  sizeof(*cfg->aef_packets));
+		cfg->aef_lens = calloc(cfg->entrynum, sizeof(*cfg->aef_lens));
+		if (!cfg->aef_packets || !cfg->aef_lens) {
+			PRINTF("[AVB] cannot allocate AEF work buffer\n");
+			return -1;
+		}
+	}
+
+	if (cfg->analyze && cfg->analyze_interval < 0) {
+		PRINTF1("[AVB] out of range analyze=%d, specify greater than or equal to 0\n",
+				cfg->analyze_interval);
+		return -1;
+	}
+
+	if (cfg->analyze || cfg->jitter || cfg->asrc.fd >= 0 ||
+	    cfg->mix.fd >= 0 || cfg->shm_name || cfg->pcap_name) {
+		if (!cname)
+			cname = strdup("/dev/ptp0");
+
+		cfg->clkid = clock_parse(cname);
+		if (cfg->clkid == CLOCK_INVALID) {
+			PRINTF("[AVB] can't parse clock name %s\n", cname);
+			return -1;
+		}
+		PRINTF1("[AVB] clock: select %s (%d)\n", cname, cfg->clkid);
+	}
+	free(cname);
+
 	if (!dname)
 		dname = strdup("/dev/avb_rx0");
 
@@ -215,53 +647,59 @@ static int install_sighandler(int s, void (*handler)(int))
 	return 0;
 }
 
-static int verify_1722packet(void *data)
+static int verify_1722packet(struct seq_check *seq, void *data)
 {
-	static int seqno = -1;
-	static int error = -1;
 	int tmp;
 	int ret = 0;
 
-	tmp = get_avtp_sequence_num(data);
+	if (get_avtp_subtype(data) == AVTP_SUBTYPE_NTSCF)
+		tmp = get_avtp_ntscf_sequence_num(data);
+	else
+		tmp = get_avtp_sequence_num(data);
 
-	if (seqno != tmp && seqno != -1) {
-		if (error == -1) {
+	if (seq->seqno != tmp && seq->seqno != -1) {
+		if (seq->error == -1) {
 			PRINTF("avtp sequence number discontinuity,%d->%d=%d\n",
-				seqno, tmp,
-				(tmp + (AVTP_SEQUENCE_NUM_MAX + 1) - seqno)
+				seq->seqno, tmp,
+				(tmp + (AVTP_SEQUENCE_NUM_MAX + 1) - seq->seqno)
 						% (AVTP_SEQUENCE_NUM_MAX + 1));
-			error = 1;
+			seq->error = 1;
 		} else {
-			error++;
+			seq->error++;
 		}
 		ret = -1;
 	} else {
-		if (error != -1) {
+		if (seq->error != -1) {
 			PRINTF("avtp sequence number recovery %d, error count=%d\n",
-					tmp, error);
-			error = -1;
+					tmp, seq->error);
+			seq->error = -1;
 		}
 	}
 
-	seqno = (tmp + 1 + (AVTP_SEQUENCE_NUM_MAX + 1))
+	seq->seqno = (tmp + 1 + (AVTP_SEQUENCE_NUM_MAX + 1))
 				% (AVTP_SEQUENCE_NUM_MAX + 1);
 
 	return ret;
 }
 
 static struct eavb_device *eavb_device_new_for_listener
-					(char *name, int entrynum)
+			(struct app_config *cfg, char *name, int entrynum,
+			 const struct sockaddr_storage *udp_addr)
 {
 	struct eavb_device *dev;
 	int ret;
 	struct eavb_rxparam rxparam;
 
-	dev = eavb_device_new(name, entrynum, O_RDWR);
+	if (cfg->udp)
+		dev = eavb_device_new_udp(udp_addr, cfg->udp_addrlen,
+					  entrynum, false, cfg->udp_offload);
+	else
+		dev = eavb_device_new(name, entrynum, O_RDWR);
 	if (!dev)
 		return NULL;
 
 	/* verify that the specified device is avb_rx device */
-	ret = eavb_get_rxparam(dev->fd, &rxparam);
+	ret = (cfg->udp) ? 0 : eavb_get_rxparam(dev->fd, &rxparam);
 	if (ret < 0) {
 		PRINTF("[AVB] cannot get rxparam from %s, should be specified avb_rx device file", name);
 		goto error;
@@ -277,9 +715,10 @@ static struct eavb_device *eavb_device_new_for_listener
 		for (i = 0, e = dev->entrybuf, p = dev->framebuf;
 				i < dev->entrynum;
 				i++, e++, p++) {
-			ret = eavb_dma_malloc_page(dev->fd, p);
+			ret = eavb_device_alloc_page(dev, p);
 			if (ret < 0)
 				goto error;
+			dev->frames[i] = p->dma_vaddr;
 			evec = &e->vec[0];
 			evec->base = p->dma_paddr;
 			evec->len = ETHFRAMELEN_MAX;
@@ -294,6 +733,300 @@ error:
 	return NULL;
 }
 
+/* unpack CAN frames in NTSCF/TSCF and send them to CAN interface */
+static void acf_can_forward(struct app_config *cfg, void *packet, int length)
+{
+	struct acf_sink *acf = &cfg->acf;
+	struct canfd_frame cf;
+	bool fdf;
+	void *msg;
+	int hlen, len, size;
+
+	switch (get_avtp_subtype(packet)) {
+	case AVTP_SUBTYPE_NTSCF:
+		hlen = AVTP_NTSCF_PAYLOAD_OFFSET;
+		len = get_avtp_ntscf_data_length(packet);
+		break;
+	case AVTP_SUBTYPE_TSCF:
+		hlen = AVTP_TSCF_PAYLOAD_OFFSET;
+		len = get_avtp_stream_data_length(packet);
+		break;
+	default:
+		return;
+	}
+
+	if (hlen + len > length) {
+		acf->errors++;
+		return;
+	}
+
+	for (msg = packet + hlen; len > 0; msg += size, len -= size) {
+		size = acf_can_unpack(msg, len, &cf, &fdf);
+		if (size < 0) {
+			acf->errors++;
+			return;
+		}
+
+		if (!size) {
+			/* not a CAN message, skip it */
+			size = get_acf_msg_length(msg);
+			continue;
+		}
+
+		if (acf_can_write(acf->fd, &cf, fdf) < 0)
+			acf->errors++;
+		else
+			acf->frames++;
+	}
+}
+
+static struct crc_stream_stats *crc_stream_lookup(struct app_config *cfg,
+						   void *packet)
+{
+	struct crc_stream_stats *st;
+	uint8_t streamid[AVTP_STREAMID_SIZE];
+	int i;
+
+	get_avtp_stream_id(packet, streamid);
+
+	for (i = 0, st = cfg->crc_stats; i < cfg->crc_streams; i++, st++)
+		if (!memcmp(st->StreamID, streamid, AVTP_STREAMID_SIZE))
+			return st;
+
+	if (cfg->crc_streams == CRC_STREAM_MAX)
+		return NULL;
+
+	st = &cfg->crc_stats[cfg->crc_streams++];
+	memcpy(st->StreamID, streamid, AVTP_STREAMID_SIZE);
+
+	return st;
+}
+
+/* verify CRC32C trailer which follows the stream data */
+static void crc_verify(struct app_config *cfg, void *packet, int length)
+{
+	struct crc_stream_stats *st;
+	void *data;
+	uint32_t crc;
+	int len;
+
+	switch (get_avtp_subtype(packet)) {
+	case AVTP_SUBTYPE_CVF:
+	case AVTP_SUBTYPE_AEF_CONTINUOUS:
+		break;
+	default:
+		return;
+	}
+
+	st = crc_stream_lookup(cfg, packet);
+	if (!st)
+		return;
+
+	len = get_avtp_stream_data_length(packet);
+	data = packet + AVTP_PAYLOAD_OFFSET;
+
+	st->packets++;
+	if (AVTP_PAYLOAD_OFFSET + len + CRC32C_SIZE > length) {
+		st->errors++;
+		return;
+	}
+
+	memcpy(&crc, data + len, CRC32C_SIZE);
+	if (ntohl(crc) != crc32c(0, data, len))
+		st->errors++;
+}
+
+static void crc_report(struct app_config *cfg)
+{
+	struct crc_stream_stats *st;
+	int i;
+
+	PRINTF("%s: CRC32C by %s\n", cfg->devname, crc32c_impl());
+
+	for (i = 0, st = cfg->crc_stats; i < cfg->crc_streams; i++, st++)
+		PRINTF("%s: %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x CRC %"PRIu64"packets %"PRIu64"corrupted\n",
+				cfg->devname,
+				st->StreamID[0], st->StreamID[1],
+				st->StreamID[2], st->StreamID[3],
+				st->StreamID[4], st->StreamID[5],
+				st->StreamID[6], st->StreamID[7],
+				st->packets, st->errors);
+}
+
+/*
+ * rate of the local output clock against gPTP, measured from the drift of
+ * the offset between them since the start
+ */
+static void asrc_measure_local(struct app_config *cfg)
+{
+	struct asrc_sink *sink = &cfg->asrc;
+	uint64_t mono;
+	int64_t offset;
+
+	mono = clock_getcount(CLOCK_MONOTONIC_RAW);
+	if (sink->measured && mono < sink->next)
+		return;
+
+	offset = clock_getoffset(cfg->clkid, CLOCK_MONOTONIC_RAW);
+	if (!sink->measured) {
+		sink->measured = true;
+		sink->mono = mono;
+		sink->offset = offset;
+		sink->local_ratio = 1.0;
+	} else {
+		/* local ticks per gPTP second */
+		sink->local_ratio = (double)(mono - sink->mono) /
+			((mono - sink->mono) + (offset - sink->offset));
+	}
+	sink->next = mono + NSEC_SCALE;
+}
+
+/* sized by the first AAF stream, the later PDUs must match it */
+static int asrc_sink_open(struct asrc_sink *sink, int channels, double in_rate)
+{
+	sink->asrc = asrc_new(channels, in_rate, sink->rate);
+	sink->in = calloc(ETHFRAMELEN_MAX, sizeof(float));
+	sink->out_frames = (ETHFRAMELEN_MAX * sink->rate / in_rate) +
+					ASRC_TAPS;
+	sink->out = calloc(sink->out_frames * channels, sizeof(float));
+	if (!sink->asrc || !sink->in || !sink->out) {
+		asrc_free(sink->asrc);
+		free(sink->in);
+		free(sink->out);
+		sink->asrc = NULL;
+		sink->in = NULL;
+		sink->out = NULL;
+		return -1;
+	}
+	sink->channels = channels;
+	sink->in_rate = in_rate;
+
+	return 0;
+}
+
+/* convert AAF of the media clock stream to the local output clock */
+static void asrc_sink_process(struct app_config *cfg, void *packet, int len)
+{
+	struct asrc_sink *sink = &cfg->asrc;
+	struct media_clock *mc = cfg->stats.media_clock;
+	struct media_clock_status st;
+	uint8_t streamid[AVTP_STREAMID_SIZE];
+	int frames, n, channels;
+	double in_rate;
+
+	if (len < AVTP_AAF_PAYLOAD_OFFSET ||
+	    get_avtp_subtype(packet) != AVTP_SUBTYPE_AAF || !mc->has_stream)
+		return;
+
+	get_avtp_stream_id(packet, streamid);
+	if (memcmp(mc->StreamID, streamid, AVTP_STREAMID_SIZE))
+		return;
+
+	in_rate = avtp_aaf_nsr_rate(get_avtp_aaf_nsr(packet));
+	channels = get_avtp_aaf_channels_per_frame(packet);
+
+	/* user specified rate or no channel, the PDU cannot be converted */
+	if (!in_rate || !channels) {
+		sink->errors++;
+		return;
+	}
+
+	if (!sink->asrc && asrc_sink_open(sink, channels, in_rate) < 0) {
+		PRINTF("[AVB] cannot start ASRC for %dch %.0fHz\n",
+				channels, in_rate);
+		sink->errors++;
+		return;
+	}
+
+	if (channels != sink->channels || in_rate != sink->in_rate) {
+		sink->errors++;
+		return;
+	}
+
+	frames = asrc_from_aaf(packet, len, sink->in,
+			ETHFRAMELEN_MAX / channels);
+	if (frames <= 0)
+		return;
+
+	/* steer by the stream media clock against the local clock */
+	asrc_measure_local(cfg);
+	media_clock_get(mc, &st);
+	if (st.updates)
+		asrc_set_ratio(sink->asrc, st.ratio / sink->local_ratio);
+
+	n = asrc_process(sink->asrc, sink->in, frames, sink->out,
+				sink->out_frames);
+	if (n > 0 && write(sink->fd, sink->out,
+				n * channels * sizeof(float)) < 0)
+		sink->errors++;
+}
+
+/* write the mix presented by now */
+static void mix_sink_release(struct app_config *cfg, uint64_t now)
+{
+	struct mix_sink *sink = &cfg->mix;
+	int n;
+
+	n = mixer_release(sink->mixer, now, sink->out, MIXER_FRAMES);
+	if (n > 0 && write(sink->fd, sink->out,
+			n * sink->channels * sizeof(*sink->out)) < 0)
+		sink->errors++;
+}
+
+/* hold the frames of an access unit until it is completed or dropped */
+static void h264_sink_process(struct app_config *cfg, void *packet, int len,
+			      int index)
+{
+	struct file_writer *w = cfg->writer;
+	int i, ret, iovcnt;
+
+	ret = h264_depay_process(cfg->h264, packet, len,
+				file_writer_iov(w, index), &iovcnt);
+	file_writer_set_iovcnt(w, index, iovcnt);
+	cfg->h264_held++;
+
+	/* the access unit has to fit in the ring with the frames to receive */
+	if (ret == H264_DEPAY_PENDING && cfg->h264_held >= cfg->entrynum / 2) {
+		h264_depay_drop(cfg->h264);
+		ret = H264_DEPAY_DROP;
+	}
+
+	if (ret == H264_DEPAY_DROP) {
+		for (i = 0; i < cfg->h264_held; i++)
+			file_writer_set_iovcnt(w,
+				(index - i + cfg->entrynum) % cfg->entrynum, 0);
+	}
+
+	if (!h264_depay_busy(cfg->h264)) {
+		file_writer_queue(w, cfg->h264_held);
+		cfg->h264_held = 0;
+	}
+}
+
+/* presentation time plus hold on the gPTP clock, 0 without timestamp */
+static uint64_t jitter_release_time(struct app_config *cfg, void *packet,
+				    uint64_t now)
+{
+	int32_t diff;
+
+	if (!(get_avtp_stream_flags(packet) & AVTP_STREAM_FLAG_TV))
+		return 0;
+
+	/* extend 32bit avtp_timestamp around now */
+	diff = (int32_t)(get_avtp_timestamp(packet) - (uint32_t)now);
+
+	return now + diff + cfg->hold;
+}
+
+/* print the interval report of the analyzer when it is due */
+static void analyze_tick(struct analyzer *an, uint64_t now)
+{
+	char buf[ANALYZER_STREAM_MAX * 384];
+
+	if (analyzer_tick(an, now, buf, sizeof(buf)))
+		PRINTF("%s\n", buf);
+}
+
 static void filedump_process(struct app_config *cfg, int count)
 {
 	static int total_count;
@@ -302,19 +1035,23 @@ static void filedump_process(struct app_config *cfg, int count)
 	struct eavb_entry *e;
 	struct eavb_entryvec *evec;
 	struct iovec *iov;
-	int ret;
-	int i;
+	int i, index, idx;
 	void *packet;
-	void *payload;
-	int payload_size;
+	void **aef_packets = cfg->aef_packets;
+	int *aef_lens = cfg->aef_lens;
+	struct analyzer *an = cfg->stats.analyzer;
+	uint64_t arrival = 0;
+	bool timed;
 
 	dev = cfg->device;
+	index = dev->p;
 
-	iov = calloc(count, sizeof(*iov));
-	if (!iov) {
-		PRINTF("[AVB] cannot allocate iovec\n");
-		return;
-	}
+	timed = (an || cfg->jitter || cfg->mix.fd >= 0 || cfg->shm ||
+		 cfg->pcap);
+
+	/* frames other than AEF are left out of the decryption */
+	if (aef_packets)
+		memset(aef_packets, 0, count * sizeof(*aef_packets));
 
 	for (i = 0; i < count; i++) {
 		dma = dev->framebuf + (dev->p * sizeof(*dma));
@@ -322,11 +1059,42 @@ static void filedump_process(struct app_config *cfg, int count)
 		evec = &e->vec[0];
 		packet = dma->dma_vaddr;
 
-		verify_1722packet(packet);
+		/*
+		 * No rx timestamp in the entry, the arrival of a frame is
+		 * the time it is taken from the ring.
+		 */
+		if (timed)
+			arrival = clock_getcount(cfg->clkid);
+
+		verify_1722packet(&cfg->seq, packet);
 		stats_process(&cfg->stats, evec->len);
 
-		payload_size = get_avtp_stream_data_length(packet);
-		payload = packet + AVTP_PAYLOAD_OFFSET;
+		if (cfg->pcap)
+			pcapng_capture(cfg->pcap, 0, packet, evec->len,
+					arrival);
+
+		if (an)
+			analyzer_process(an, packet, evec->len, arrival);
+
+		if (cfg->stats.media_clock)
+			media_clock_process(cfg->stats.media_clock, packet,
+					evec->len);
+
+		if (cfg->shm)
+			shm_ring_publish(cfg->shm, packet, evec->len, arrival);
+
+		if (cfg->asrc.fd >= 0)
+			asrc_sink_process(cfg, packet, evec->len);
+
+		if (cfg->mix.fd >= 0)
+			mixer_add(cfg->mix.mixer, packet, evec->len,
+					arrival);
+
+		if (cfg->acf.fd >= 0)
+			acf_can_forward(cfg, packet, evec->len);
+
+		if (cfg->crc)
+			crc_verify(cfg, packet, evec->len);
 
 		PRINTF3("count:%d subtype:%d sequence_num:%d timestamp:%d stream_data_length:%d\n",
 				total_count++,
@@ -335,33 +1103,84 @@ static void filedump_process(struct app_config *cfg, int count)
 				get_avtp_timestamp(packet),
 				get_avtp_stream_data_length(packet));
 
-		iov[i].iov_base = payload;
-		iov[i].iov_len = payload_size;
+		/* the payload is written from the DMA frame as it is */
+		if (cfg->h264) {
+			h264_sink_process(cfg, packet, evec->len, dev->p);
+		} else if (cfg->writer) {
+			iov = file_writer_iov(cfg->writer, dev->p);
+			iov->iov_base = packet + AVTP_PAYLOAD_OFFSET;
+			iov->iov_len = get_avtp_stream_data_length(packet);
+		}
+
+		if (cfg->jitter)
+			file_writer_set_release(cfg->writer, dev->p,
+					jitter_release_time(cfg, packet,
+								arrival));
+
+		if (aef_packets &&
+		    get_avtp_subtype(packet) == AVTP_SUBTYPE_AEF_CONTINUOUS) {
+			aef_packets[i] = packet;
+			aef_lens[i] = evec->len;
+		}
 
 		evec->len = ETHFRAMELEN_MAX;
 		dev->p = (dev->p + 1) % cfg->entrynum;
 	}
 
-	if (cfg->fd) {
-		ret = writev(cfg->fd, iov, count);
-		if (ret < -1)
-			PRINTF1("[AVB] File output error\n");
+	/* decrypt the batch, drop the payloads failed to authenticate */
+	if (aef_packets) {
+		aef_decrypt_batch(cfg->aef, aef_packets, aef_lens, count);
+		for (i = 0; cfg->writer && i < count; i++) {
+			if (!aef_packets[i])
+				continue;
+			iov = file_writer_iov(cfg->writer,
+					(index + i) % cfg->entrynum);
+			iov->iov_base = aef_packets[i] +
+						AVTP_AEF_PAYLOAD_OFFSET;
+			iov->iov_len = (aef_lens[i] > 0) ? aef_lens[i] : 0;
+		}
 	}
 
-	free(iov);
+	/* drop the late frames, the release is kept in ring order */
+	for (i = 0; cfg->jitter && i < count; i++) {
+		idx = (index + i) % cfg->entrynum;
+		if (!cfg->writer->release[idx] ||
+		    cfg->writer->release[idx] > arrival)
+			continue;
+		cfg->late++;
+		file_writer_iov(cfg->writer, idx)->iov_len = 0;
+		file_writer_set_release(cfg->writer, idx, 0);
+	}
+
+	if (an)
+		analyze_tick(an, arrival);
+
+	if (cfg->mix.fd >= 0)
+		mix_sink_release(cfg, arrival);
+
+	/* frames are back to the ring after written by the writer thread */
+	if (cfg->writer && !cfg->h264)
+		file_writer_queue(cfg->writer, count);
 }
 
 static int process_wait(struct app_config *cfg, int waitflush)
 {
 	int events, revents;
 
-	if (!waitflush)
+	/* a UDP socket is always writable, wait for it with free entries */
+	if (!waitflush && cfg->device->remain)
 		events = EAVB_NOTIFY_READ | EAVB_NOTIFY_WRITE;
 	else
 		events = EAVB_NOTIFY_READ;
 
 	if (cfg->waitmode) {
 		revents = events;
+	} else if (cfg->udp && (events & EAVB_NOTIFY_WRITE)) {
+		/* dev->fd of UDP_GRO is an epoll fd, readable only */
+		revents = eavb_wait(cfg->device->fd, EAVB_NOTIFY_READ, 0);
+		if (revents < 0)
+			revents = 0;
+		revents |= EAVB_NOTIFY_WRITE;
 	} else {
 		revents = eavb_wait(cfg->device->fd, events, WAIT_TIME_PROCESS);
 		if (revents < 0)
@@ -376,6 +1195,7 @@ static int filedump_loop(struct app_config *cfg)
 	struct eavb_device *dev;
 	int tmp, thresh;
 	int process_size;
+	int inflight, writing;
 
 	int inf, repeat;
 	bool waitflush;
@@ -395,10 +1215,23 @@ static int filedump_loop(struct app_config *cfg)
 		repeat = 1;
 
 	while (inf || !(waitflush && !dev->filled)) {
-		revents = process_wait(cfg, waitflush);
+		/* frames being written or held cannot be pushed */
+		writing = (cfg->writer) ? file_writer_inflight(cfg->writer) : 0;
+		inflight = writing + cfg->h264_held;
+		if (!waitflush && dev->remain == inflight && inflight) {
+			if (!dev->filled && writing) {
+				file_writer_wait(cfg->writer, WAIT_TIME_PROCESS);
+				if (sigint)
+					goto finish;
+				continue;
+			}
+			revents = process_wait(cfg, true);
+		} else {
+			revents = process_wait(cfg, waitflush);
+		}
 
-		if (revents & EAVB_NOTIFY_WRITE) {
-			process_size = dev->remain;
+		if ((revents & EAVB_NOTIFY_WRITE) && dev->remain > inflight) {
+			process_size = dev->remain - inflight;
 
 			if (!inf)
 				if (process_size > repeat)
@@ -445,11 +1278,497 @@ static int filedump_loop(struct app_config *cfg)
 	}
 
 finish:
+	/* the access unit in progress is not completed */
+	if (cfg->h264)
+		h264_depay_drop(cfg->h264);
+
+	/* drain the writer thread */
+	while (cfg->writer && file_writer_inflight(cfg->writer))
+		file_writer_wait(cfg->writer, WAIT_TIME_PROCESS);
+
 	PRINTF1("[AVB] finish file save process loop.\n");
 
 	return 0;
 }
 
+/*
+ * multi-queue mode
+ */
+static void rx_queue_process(struct app_config *cfg, struct rx_queue *q,
+			     int count)
+{
+	struct eavb_device *dev = q->device;
+	struct eavb_dma_alloc *dma;
+	struct eavb_entry *e;
+	struct eavb_entryvec *evec;
+	struct analyzer *an = q->stats.analyzer;
+	uint64_t arrival = 0;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		dma = dev->framebuf + (dev->p * sizeof(*dma));
+		e = dev->entrybuf + (dev->p * sizeof(*e));
+		evec = &e->vec[0];
+
+		if (an || cfg->pcap)
+			arrival = clock_getcount(cfg->clkid);
+
+		if (verify_1722packet(&q->seq, dma->dma_vaddr) < 0)
+			q->seq_errors++;
+		stats_process(&q->stats, evec->len);
+		if (cfg->pcap)
+			pcapng_capture(cfg->pcap, q - cfg->queues,
+					dma->dma_vaddr, evec->len, arrival);
+		if (an)
+			analyzer_process(an, dma->dma_vaddr, evec->len,
+					arrival);
+		if (q->stats.media_clock)
+			media_clock_process(q->stats.media_clock,
+					dma->dma_vaddr, evec->len);
+		if (cfg->demux)
+			stream_demux_hw(cfg->demux, dma->dma_vaddr);
+
+		evec->len = ETHFRAMELEN_MAX;
+		dev->p = (dev->p + 1) % dev->entrynum;
+	}
+
+	if (an)
+		analyze_tick(an, arrival);
+}
+
+static int rx_queue_service(struct app_config *cfg, struct rx_queue *q,
+			    int revents)
+{
+	struct eavb_device *dev = q->device;
+	int tmp, process_size;
+	int thresh = dev->entrynum / 8;
+
+	/* the fd of UDP is readable only, the free entries go on POLLIN */
+	if (((revents & POLLOUT) || cfg->udp) && dev->remain) {
+		process_size = dev->remain;
+		if (cfg->framenums &&
+		    process_size > cfg->framenums - q->pushed)
+			process_size = cfg->framenums - q->pushed;
+
+		if (process_size > 0) {
+			tmp = dev->push_entry(dev, process_size);
+			if (tmp < 0)
+				return -1;
+			q->pushed += tmp;
+		}
+	}
+
+	if ((revents & POLLIN) && dev->filled) {
+		tmp = dev->take_entry(dev,
+			(dev->filled > thresh) ? thresh : dev->filled);
+		if (tmp < 0)
+			return -1;
+
+		rx_queue_process(cfg, q, tmp);
+	}
+
+	if (cfg->framenums && q->pushed >= cfg->framenums && !dev->filled)
+		q->done = true;
+
+	return 0;
+}
+
+static void *rx_worker_thread(void *arg)
+{
+	struct rx_worker *w = arg;
+	struct app_config *cfg = w->cfg;
+	struct pollfd pollfd[RX_QUEUE_MAX];
+	struct rx_queue *q;
+	cpu_set_t cpuset;
+	int i, ret, active;
+
+	CPU_ZERO(&cpuset);
+	CPU_SET(w->cpu, &cpuset);
+	if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset), &cpuset))
+		PRINTF("[AVB] worker%d cannot pin to CPU%d\n", w->id, w->cpu);
+
+	while (!sigint) {
+		for (i = 0, active = 0; i < w->nqueues; i++) {
+			q = w->queues[i];
+			pollfd[i].fd = q->device->fd;
+			pollfd[i].events = 0;
+			pollfd[i].revents = 0;
+			if (q->done)
+				continue;
+			pollfd[i].events = POLLIN;
+			if (q->device->remain && !cfg->udp)
+				pollfd[i].events |= POLLOUT;
+			active++;
+		}
+		if (!active)
+			break;
+
+		ret = poll(pollfd, w->nqueues, WAIT_TIME_PROCESS);
+		if (ret < 0) {
+			if (errno != EINTR)
+				perror("poll failed");
+			continue;
+		}
+
+		for (i = 0; i < w->nqueues; i++) {
+			if (!pollfd[i].revents)
+				continue;
+			if (rx_queue_service(cfg, w->queues[i],
+						pollfd[i].revents) < 0) {
+				PRINTF("[AVB] %s: receive error\n",
+						w->queues[i]->devname);
+				w->queues[i]->done = true;
+			}
+		}
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &w->cputime);
+
+	return NULL;
+}
+
+/* set the separation filter of the queue, called by stream_demux */
+static int demux_assign(void *arg, int queue, uint8_t streamid[])
+{
+	struct app_config *cfg = arg;
+	struct rx_queue *q = &cfg->queues[queue];
+	struct eavb_rxparam rxparam;
+	int ret;
+
+	ret = eavb_get_rxparam(q->device->fd, &rxparam);
+	if (ret < 0)
+		return ret;
+
+	memcpy(rxparam.streamid, streamid, AVTP_STREAMID_SIZE);
+	ret = eavb_set_rxparam(q->device->fd, &rxparam);
+	if (ret < 0)
+		return ret;
+
+	PRINTF1("[AVB] %s: assign %02x:%02x:%02x:%02x:%02x:%02x:%02x:%02x\n",
+			q->devname,
+			streamid[0], streamid[1], streamid[2], streamid[3],
+			streamid[4], streamid[5], streamid[6], streamid[7]);
+
+	return 0;
+}
+
+/* catch-all of the streams without queue, demultiplexed in software */
+static void *demux_thread(void *arg)
+{
+	struct app_config *cfg = arg;
+	struct mmsghdr msgs[DEMUX_BATCH];
+	struct iovec iovs[DEMUX_BATCH];
+	struct pollfd pollfd;
+	uint8_t *bufs;
+	int i, n;
+
+	bufs = malloc(DEMUX_BATCH * ETHFRAMELEN_MAX);
+	if (!bufs) {
+		PRINTF("[AVB] cannot allocate demux buffer\n");
+		return NULL;
+	}
+
+	/* the AVTP header at the offset of the DMA frames */
+	memset(msgs, 0, sizeof(msgs));
+	for (i = 0; i < DEMUX_BATCH; i++) {
+		iovs[i].iov_base = bufs + i * ETHFRAMELEN_MAX + AVTP_OFFSET;
+		iovs[i].iov_len = ETHFRAMELEN_MAX - AVTP_OFFSET;
+		msgs[i].msg_hdr.msg_iov = &iovs[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	pollfd.fd = cfg->demux_fd;
+	pollfd.events = POLLIN;
+
+	while (!sigint && !__atomic_load_n(&cfg->demux_stop,
+						__ATOMIC_RELAXED)) {
+		n = poll(&pollfd, 1, WAIT_TIME_PROCESS);
+		if (n > 0) {
+			n = recvmmsg(cfg->demux_fd, msgs, DEMUX_BATCH,
+					MSG_DONTWAIT, NULL);
+			for (i = 0; i < n; i++)
+				stream_demux_process(cfg->demux,
+					bufs + i * ETHFRAMELEN_MAX,
+					msgs[i].msg_len + AVTP_OFFSET);
+		}
+
+		stream_demux_tick(cfg->demux,
+				clock_getcount(CLOCK_MONOTONIC));
+	}
+
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &cfg->demux_cputime);
+	free(bufs);
+
+	return NULL;
+}
+
+static int demux_open(struct app_config *cfg)
+{
+	uint8_t streamid[AVTP_STREAMID_SIZE];
+	int i;
+
+	cfg->demux = stream_demux_new(demux_assign, cfg, DEMUX_PERIOD);
+	if (!cfg->demux)
+		return -1;
+
+	/* the StreamIDs set by avbtool are kept until reassigned */
+	for (i = 0; i < cfg->nqueues; i++) {
+		if (cfg->queues[i].device->get_separation_filter(
+				cfg->queues[i].device, (char *)streamid) < 0)
+			memset(streamid, 0, sizeof(streamid));
+		stream_demux_add_queue(cfg->demux, streamid);
+	}
+
+	cfg->demux_fd = netif_open_avtp(cfg->demux_ifname);
+	if (cfg->demux_fd < 0) {
+		PRINTF("[AVB] cannot open %s for demux\n", cfg->demux_ifname);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* queue N of --queues with --udp receives on the port of --udp + N */
+static void multiqueue_udp_addr(struct app_config *cfg, int id,
+				struct sockaddr_storage *addr,
+				char *name, size_t len)
+{
+	struct sockaddr_in *sin = (struct sockaddr_in *)addr;
+	struct sockaddr_in6 *sin6 = (struct sockaddr_in6 *)addr;
+	char host[INET6_ADDRSTRLEN];
+	int port;
+
+	*addr = cfg->udp_addr;
+	if (addr->ss_family == AF_INET6) {
+		port = ntohs(sin6->sin6_port) + id;
+		sin6->sin6_port = htons(port);
+		inet_ntop(AF_INET6, &sin6->sin6_addr, host, sizeof(host));
+	} else {
+		port = ntohs(sin->sin_port) + id;
+		sin->sin_port = htons(port);
+		inet_ntop(AF_INET, &sin->sin_addr, host, sizeof(host));
+	}
+	snprintf(name, len, "udp:%s:%d", host, port);
+}
+
+static int multiqueue_open(struct app_config *cfg)
+{
+	struct sockaddr_storage addr;
+	struct rx_queue *q;
+	struct rx_worker *w;
+	int i;
+
+	for (i = 0; i < cfg->nqueues; i++) {
+		q = &cfg->queues[i];
+		if (cfg->udp)
+			multiqueue_udp_addr(cfg, cfg->queue_ids[i], &addr,
+					    q->devname, sizeof(q->devname));
+		else
+			snprintf(q->devname, sizeof(q->devname),
+				 "/dev/avb_rx%d", cfg->queue_ids[i]);
+		q->seq.seqno = -1;
+		q->seq.error = -1;
+		q->device = eavb_device_new_for_listener(cfg, q->devname,
+							cfg->entrynum, &addr);
+		if (!q->device) {
+			PRINTF("[AVB] can't open eavb device %s\n",
+					q->devname);
+			return -1;
+		}
+
+		if (cfg->analyze) {
+			q->stats.analyzer = analyzer_new(q->devname,
+					cfg->clkid,
+					(uint64_t)cfg->analyze_interval * NSEC_SCALE);
+			if (!q->stats.analyzer)
+				return -1;
+		}
+
+		if (cfg->mclk_bandwidth) {
+			q->stats.media_clock =
+				media_clock_new(cfg->mclk_bandwidth);
+			if (!q->stats.media_clock)
+				return -1;
+		}
+	}
+
+	if (cfg->demux_ifname && demux_open(cfg) < 0)
+		return -1;
+
+	if (cfg->pcap_name) {
+		char *ifnames[RX_QUEUE_MAX];
+
+		for (i = 0; i < cfg->nqueues; i++)
+			ifnames[i] = cfg->queues[i].devname;
+		cfg->pcap = pcapng_writer_new(cfg->pcap_name, ifnames,
+				cfg->nqueues, cfg->pcap_size, cfg->pcap_time,
+				cfg->clkid);
+		if (!cfg->pcap) {
+			PRINTF("[AVB] cannot start pcapng capture %s\n",
+					cfg->pcap_name);
+			return -1;
+		}
+	}
+
+	/* assign the queues to the workers in round robin */
+	for (i = 0; i < cfg->nworkers; i++) {
+		w = &cfg->workers[i];
+		w->id = i;
+		w->cfg = cfg;
+		w->cpu = (cfg->ncpus) ? cfg->cpus[i % cfg->ncpus] : i;
+	}
+	for (i = 0; i < cfg->nqueues; i++) {
+		w = &cfg->workers[i % cfg->nworkers];
+		w->queues[w->nqueues++] = &cfg->queues[i];
+	}
+
+	return 0;
+}
+
+static void multiqueue_close(struct app_config *cfg)
+{
+	struct rx_queue *q;
+	int i;
+
+	for (i = 0; i < cfg->nqueues; i++) {
+		q = &cfg->queues[i];
+		analyzer_free(q->stats.analyzer);
+		media_clock_free(q->stats.media_clock);
+		if (!q->device)
+			continue;
+		eavb_close(q->device->fd);
+		eavb_device_free(q->device);
+	}
+
+	pcapng_writer_free(cfg->pcap);
+	free(cfg->pcap_name);
+
+	if (cfg->demux_fd >= 0)
+		close(cfg->demux_fd);
+	stream_demux_free(cfg->demux);
+	free(cfg->demux_ifname);
+}
+
+static int multiqueue_loop(struct app_config *cfg)
+{
+	int i, ret = 0;
+	int started;
+
+	PRINTF1("[AVB] start %d queues on %d workers.\n",
+			cfg->nqueues, cfg->nworkers);
+
+	for (started = 0; started < cfg->nworkers; started++) {
+		if (pthread_create(&cfg->workers[started].thread, NULL,
+				rx_worker_thread, &cfg->workers[started])) {
+			PRINTF("[AVB] cannot create worker%d\n", started);
+			sigint = true;
+			ret = -1;
+			break;
+		}
+	}
+
+	if (cfg->demux && !ret &&
+	    pthread_create(&cfg->demux_thread, NULL, demux_thread, cfg)) {
+		PRINTF("[AVB] cannot create demux thread\n");
+		sigint = true;
+		ret = -1;
+	}
+
+	for (i = 0; i < started; i++)
+		pthread_join(cfg->workers[i].thread, NULL);
+
+	/* the catch-all is stopped with the queues */
+	if (cfg->demux && !ret) {
+		__atomic_store_n(&cfg->demux_stop, true, __ATOMIC_RELAXED);
+		pthread_join(cfg->demux_thread, NULL);
+	}
+
+	PRINTF1("[AVB] finish multi-queue process loop.\n");
+
+	return ret;
+}
+
+static void multiqueue_report(struct app_config *cfg, char *buf, int buflen)
+{
+	struct app_stats total;
+	struct rx_queue *q;
+	struct rx_worker *w;
+	uint64_t seq_errors = 0;
+	int i;
+
+	memset(&total, 0, sizeof(total));
+
+	for (i = 0; i < cfg->nqueues; i++) {
+		q = &cfg->queues[i];
+		if (!q->stats.start)
+			continue;
+
+		buf[0] = '\0';
+		stats_report(&q->stats, buf, buflen);
+		PRINTF("%s: %s %"PRIu64" sequence errors\n",
+				q->devname, buf, q->seq_errors);
+
+		/* aggregate from the earliest start */
+		if (!total.start ||
+		    q->stats.stime.tv_sec < total.stime.tv_sec ||
+		    (q->stats.stime.tv_sec == total.stime.tv_sec &&
+		     q->stats.stime.tv_nsec < total.stime.tv_nsec))
+			total.stime = q->stats.stime;
+		total.start = true;
+		total.bytes += q->stats.bytes;
+		total.packets += q->stats.packets;
+		seq_errors += q->seq_errors;
+	}
+
+	buf[0] = '\0';
+	stats_report(&total, buf, buflen);
+	PRINTF("total %d queues: %s %"PRIu64" sequence errors\n",
+			cfg->nqueues, buf, seq_errors);
+
+	for (i = 0; i < cfg->nworkers; i++) {
+		w = &cfg->workers[i];
+		PRINTF("worker%d: CPU%d %d queues %ld.%03lds CPU time\n",
+				w->id, w->cpu, w->nqueues,
+				(long)w->cputime.tv_sec,
+				w->cputime.tv_nsec / 1000000);
+	}
+
+	if (cfg->pcap) {
+		pcapng_writer_stop(cfg->pcap);
+		pcapng_writer_report(cfg->pcap, buf, buflen);
+		PRINTF("%s\n", buf);
+	}
+
+	if (cfg->demux) {
+		stream_demux_report(cfg->demux, buf, buflen);
+		PRINTF("%s: %s\n", cfg->demux_ifname, buf);
+		for (i = 0; i < STREAM_DEMUX_SLOTS; i++) {
+			if (stream_demux_report_stream(cfg->demux, i, buf,
+						       buflen))
+				PRINTF("%s: %s\n", cfg->demux_ifname, buf);
+		}
+		PRINTF("demux: %ld.%03lds CPU time\n",
+				(long)cfg->demux_cputime.tv_sec,
+				cfg->demux_cputime.tv_nsec / 1000000);
+	}
+}
+
+/* CPU time and memory of the process, to compare with per queue processes */
+static void rusage_report(void)
+{
+	struct rusage ru;
+
+	if (getrusage(RUSAGE_SELF, &ru) < 0)
+		return;
+
+	PRINTF("rusage: user %ld.%03lds sys %ld.%03lds max RSS %ldKB\n",
+			(long)ru.ru_utime.tv_sec,
+			(long)ru.ru_utime.tv_usec / 1000,
+			(long)ru.ru_stime.tv_sec,
+			(long)ru.ru_stime.tv_usec / 1000,
+			ru.ru_maxrss);
+}
+
 static struct msrp_ctx *msrp_init(const struct app_config *cfg,
 				  uint8_t SRclassID, uint8_t SRpriority)
 {
@@ -522,7 +1841,7 @@ static void msrp_exit(struct msrp_ctx *ctx)
 int main(int argc, char **argv)
 {
 	int ret = -1;
-	char stats_buf[2048];
+	char stats_buf[8192];
 	struct msrp_ctx *ctx[] = {NULL, NULL};
 	struct app_config *cfg = calloc(1, sizeof(*cfg));
 
@@ -538,8 +1857,22 @@ int main(int argc, char **argv)
 	install_sighandler(SIGINT, sigint_handler);
 	install_sighandler(SIGTERM, sigint_handler);
 
-	cfg->device = eavb_device_new_for_listener(cfg->devname,
-						cfg->entrynum);
+	if (cfg->nqueues) {
+		ret = multiqueue_open(cfg);
+		if (!ret)
+			ret = multiqueue_loop(cfg);
+		if (!ret) {
+			multiqueue_report(cfg, stats_buf, sizeof(stats_buf));
+			rusage_report();
+		}
+		multiqueue_close(cfg);
+		free(cfg);
+
+		return (ret) ? -1 : 0;
+	}
+
+	cfg->device = eavb_device_new_for_listener(cfg, cfg->devname,
+						cfg->entrynum, &cfg->udp_addr);
 	if (!cfg->device) {
 		PRINTF("[AVB] can't open eavb device %s\n", cfg->devname);
 		goto bad_usage;
@@ -612,17 +1945,143 @@ TALKER_READY:
 		}
 	}
 
+	if (cfg->analyze) {
+		cfg->stats.analyzer = analyzer_new(cfg->devname, cfg->clkid,
+					(uint64_t)cfg->analyze_interval * NSEC_SCALE);
+		if (!cfg->stats.analyzer) {
+			PRINTF("[AVB] cannot allocate analyzer\n");
+			goto bad_usage;
+		}
+	}
+
+	if (cfg->mclk_bandwidth) {
+		cfg->stats.media_clock = media_clock_new(cfg->mclk_bandwidth);
+		if (!cfg->stats.media_clock) {
+			PRINTF("[AVB] cannot allocate media clock\n");
+			goto bad_usage;
+		}
+	}
+
+	if (cfg->shm_name) {
+		cfg->shm = shm_ring_create(cfg->shm_name, cfg->shm_slots);
+		if (!cfg->shm) {
+			PRINTF("[AVB] cannot create shared memory %s\n",
+					cfg->shm_name);
+			goto bad_usage;
+		}
+	}
+
+	if (cfg->pcap_name) {
+		cfg->pcap = pcapng_writer_new(cfg->pcap_name, &cfg->devname,
+				1, cfg->pcap_size, cfg->pcap_time, cfg->clkid);
+		if (!cfg->pcap) {
+			PRINTF("[AVB] cannot start pcapng capture %s\n",
+					cfg->pcap_name);
+			goto bad_usage;
+		}
+	}
+
+	if (cfg->fd) {
+		cfg->writer = file_writer_new(cfg->fd, cfg->entrynum,
+						cfg->direct);
+		if (!cfg->writer) {
+			PRINTF("[AVB] cannot start file writer\n");
+			goto bad_usage;
+		}
+		if (cfg->jitter &&
+		    file_writer_set_paced(cfg->writer, cfg->clkid) < 0) {
+			PRINTF("[AVB] cannot start jitter buffer\n");
+			goto bad_usage;
+		}
+		if (cfg->h264 &&
+		    file_writer_set_chain(cfg->writer, H264_DEPAY_IOV_MAX) < 0) {
+			PRINTF("[AVB] cannot allocate H.264 iovecs\n");
+			goto bad_usage;
+		}
+	}
+
 	ret = filedump_loop(cfg);
 
 	/* report stats */
 	stats_report(&cfg->stats, stats_buf, sizeof(stats_buf));
 	PRINTF("%s: %s\n", cfg->devname, stats_buf);
+	if (cfg->acf.fd >= 0)
+		PRINTF("%s: ACF %"PRIu64" CAN frames, %"PRIu64" errors\n",
+				cfg->devname, cfg->acf.frames, cfg->acf.errors);
+	if (cfg->crc)
+		crc_report(cfg);
+	if (cfg->aef) {
+		aef_report(cfg->aef, stats_buf, sizeof(stats_buf));
+		PRINTF("%s: %s\n", cfg->devname, stats_buf);
+	}
+	if (cfg->writer) {
+		file_writer_report(cfg->writer, stats_buf, sizeof(stats_buf));
+		PRINTF("%s: %s\n", cfg->devname, stats_buf);
+	}
+	if (cfg->pcap) {
+		pcapng_writer_stop(cfg->pcap);
+		pcapng_writer_report(cfg->pcap, stats_buf, sizeof(stats_buf));
+		PRINTF("%s: %s\n", cfg->devname, stats_buf);
+	}
+	if (cfg->shm) {
+		shm_ring_report(cfg->shm, stats_buf, sizeof(stats_buf));
+		PRINTF("%s: %s\n", cfg->devname, stats_buf);
+	}
+	if (cfg->asrc.asrc) {
+		asrc_report(cfg->asrc.asrc, stats_buf, sizeof(stats_buf));
+		PRINTF("%s: %s local clock ratio %.9f %"PRIu64" errors\n",
+				cfg->devname, stats_buf,
+				cfg->asrc.local_ratio, cfg->asrc.errors);
+	}
+	if (cfg->mix.fd >= 0) {
+		mixer_report(cfg->mix.mixer, stats_buf, sizeof(stats_buf));
+		PRINTF("%s: %s\n%s: mix %"PRIu64" write errors\n",
+				cfg->devname, stats_buf,
+				cfg->devname, cfg->mix.errors);
+	}
+	if (cfg->h264) {
+		h264_depay_report(cfg->h264, stats_buf, sizeof(stats_buf));
+		PRINTF("%s: %s\n", cfg->devname, stats_buf);
+	}
+	if (cfg->jitter)
+		PRINTF("%s: jitter buffer hold %"PRIu64"us %"PRIu64" late frames dropped\n",
+				cfg->devname, cfg->hold / 1000, cfg->late);
+	if (cfg->udp) {
+		eavb_device_udp_report(cfg->device, stats_buf,
+				       sizeof(stats_buf));
+		PRINTF("%s: %s\n", cfg->devname, stats_buf);
+	}
+	rusage_report();
 
 bad_usage:
+	/* write out the payloads before releasing the DMA frames */
+	file_writer_free(cfg->writer);
+
 	if (cfg->fd  > 2) {
 		close(cfg->fd);
 		PRINTF1("[AVB] closed the save file.\n");
 	}
+	if (cfg->acf.fd >= 0)
+		close(cfg->acf.fd);
+	aef_ctx_free(cfg->aef);
+	free(cfg->aef_packets);
+	free(cfg->aef_lens);
+	analyzer_free(cfg->stats.analyzer);
+	media_clock_free(cfg->stats.media_clock);
+	if (cfg->asrc.fd >= 0)
+		close(cfg->asrc.fd);
+	asrc_free(cfg->asrc.asrc);
+	free(cfg->asrc.in);
+	free(cfg->asrc.out);
+	if (cfg->mix.fd >= 0)
+		close(cfg->mix.fd);
+	mixer_free(cfg->mix.mixer);
+	free(cfg->mix.out);
+	h264_depay_free(cfg->h264);
+	shm_ring_destroy(cfg->shm);
+	free(cfg->shm_name);
+	pcapng_writer_free(cfg->pcap);
+	free(cfg->pcap_name);
 
 	if (cfg->device) {
 		if (cfg->device->fd) {
@@ -8,11 +8,103 @@
 #define __SIMPLE_LISTENER_H__
 
 #include <stdint.h>
+#include <pthread.h>
+#include <time.h>
 #include <arpa/inet.h>
 #include <stats.h>
 #include "packet.h"
 #include "eavb_device.h"
 #include "avtp.h"
+#include "acf_can.h"
+#include "aef.h"
+#include "crc32c.h"
+#include "file_writer.h"
+#include "analyzer.h"
+#include "media_clock.h"
+#include "asrc.h"
+#include "mixer.h"
+#include "h264_depay.h"
+#include "stream_demux.h"
+#include "shm_ring.h"
+#include "pcapng.h"
+#include "clock.h"
+
+#define NSEC_SCALE     (1000000000)
+
+#define CRC_STREAM_MAX (16)
+#define RX_QUEUE_MAX   (16)
+#define RX_DEVNAME_MAX (64)
+
+/* AVTP sequence number continuity */
+struct seq_check {
+	int                seqno;
+	int                error;
+};
+
+/* CRC32C trailer statistics per StreamID */
+struct crc_stream_stats {
+	uint8_t            StreamID[AVTP_STREAMID_SIZE];
+	uint64_t           packets;
+	uint64_t           errors;
+};
+
+/* CAN frame sink of ACF listener */
+struct acf_sink {
+	int                fd;
+	uint64_t           frames;
+	uint64_t           errors;
+};
+
+/* rx queue of multi-queue mode, owned by one worker */
+struct rx_queue {
+	char               devname[RX_DEVNAME_MAX];
+	struct eavb_device *device;
+	struct app_stats   stats;
+	struct seq_check   seq;
+	uint64_t           seq_errors;
+	uint64_t           pushed;
+	bool               done;
+};
+
+/* worker thread of multi-queue mode */
+struct rx_worker {
+	pthread_t          thread;
+	int                id;
+	int                cpu;
+	int                nqueues;
+	struct rx_queue    *queues[RX_QUEUE_MAX];
+	struct app_config  *cfg;
+	struct timespec    cputime;
+};
+
+/* AAF sink through ASRC locked to the local output clock */
+struct asrc_sink {
+	int                fd;
+	double             rate;      /* Hz of the output */
+	struct asrc        *asrc;
+	int                channels;  /* of the stream converted */
+	double             in_rate;
+	float              *in;
+	float              *out;
+	int                out_frames;
+	uint64_t           errors;
+
+	/* local output clock against gPTP */
+	bool               measured;
+	uint64_t           mono;      /* start of the measurement */
+	int64_t            offset;    /* gPTP - local at mono */
+	uint64_t           next;
+	double             local_ratio;
+};
+
+/* mix of AAF streams */
+struct mix_sink {
+	int                fd;
+	int                channels;
+	struct mixer       *mixer;
+	int16_t            *out;
+	uint64_t           errors;
+};
 
 struct app_config {
 	char               *devname;
@@ -24,10 +116,73 @@ struct app_config {
 	uint8_t            StreamID[AVTP_STREAMID_SIZE];
 	uint64_t           framenums;
 	int                fd;
+	bool               direct;
+	struct file_writer *writer;
 	int                msrp;
 	int                waitmode;
 	struct app_stats   stats;
+	struct acf_sink    acf;
+	struct aef_ctx     *aef;
+	void               **aef_packets; /* per entry, of filedump_process */
+	int                *aef_lens;
+	bool               crc;
+	int                crc_streams;
+	struct crc_stream_stats crc_stats[CRC_STREAM_MAX];
 	struct eavb_device *device;
+	struct seq_check   seq;
+
+	/* per-stream analyzer */
+	bool               analyze;
+	int                analyze_interval; /* sec */
+	clockid_t          clkid;
+
+	/* media clock recovery */
+	double             mclk_bandwidth;   /* Hz, 0:off */
+	struct asrc_sink   asrc;
+	struct mix_sink    mix;
+
+	/* presentation time jitter buffer */
+	bool               jitter;
+	uint64_t           hold;             /* ns */
+	uint64_t           late;
+
+	/* H.264 access units to the file */
+	struct h264_depay  *h264;
+	int                h264_held;        /* frames of the AU in progress */
+
+	/* fan-out of the received frames to local consumers */
+	char               *shm_name;
+	int                shm_slots;
+	struct shm_ring    *shm;
+
+	/* pcapng capture, merged over the queues */
+	char               *pcap_name;
+	uint64_t           pcap_size;        /* bytes, 0:no rotation */
+	uint64_t           pcap_time;        /* ns, 0:no rotation */
+	struct pcapng_writer *pcap;
+
+	/* multi-queue mode */
+	int                nqueues;
+	int                queue_ids[RX_QUEUE_MAX];
+	struct rx_queue    queues[RX_QUEUE_MAX];
+	int                nworkers;
+	int                ncpus;
+	int                cpus[RX_QUEUE_MAX];
+	struct rx_worker   workers[RX_QUEUE_MAX];
+
+	/* dynamic queue assignment and software demux of multi-queue mode */
+	char               *demux_ifname;
+	int                demux_fd;
+	struct stream_demux *demux;
+	pthread_t          demux_thread;
+	bool               demux_stop;
+	struct timespec    demux_cputime;
+
+	/* IEEE1722 Annex J UDP transport instead of the eavb driver */
+	bool               udp;
+	bool               udp_offload;
+	struct sockaddr_storage udp_addr;
+	socklen_t          udp_addrlen;
 };
 
 #endif /* __SIMPLE_LISTENER_H__ */
@@ -0,0 +1,767 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <math.h>
+#include <poll.h>
+#include <getopt.h>
+#include <stdbool.h>
+#include <linux/if_ether.h>
+#include <inttypes.h>
+#include <errno.h>
+
+#include "eavb.h"
+#include "msrp.h"
+#include "config.h"
+#include "eavb_device.h"
+#include "simple_relay.h"
+#include "avtp.h"
+#include "packet.h"
+#include "clock.h"
+#include "common.h"
+
+#define PROGNAME "simple_relay"
+#define PROGVERSION "0.1"
+
+#define ARRAY_SIZE(a)		(sizeof(a) / sizeof(a[0]))
+
+static unsigned char dest_addr[] = DEST_ADDR;
+
+static int show_version(struct app_config *cfg)
+{
+	fprintf(stderr, PROGNAME " version " PROGVERSION "\n");
+	return 0;
+}
+
+enum {
+	OPT_VERSION = 1,
+	OPT_TS_OFFSET,
+	OPT_UDP_TX,
+	OPT_UDP_RX,
+	OPT_UDP_OFFLOAD,
+	OPT_SWAP_PAGES,
+};
+
+static const char *optstring = "c:i:u:a:d:o:p:s:F:n:h";
+static const struct option long_options[] = {
+	{"class",             required_argument, NULL, 'c'},
+	{"interface",         required_argument, NULL, 'i'},
+	{"uid",               required_argument, NULL, 'u'},
+	{"dest-addr",         required_argument, NULL, 'a'},
+	{"device",            required_argument, NULL, 'd'},
+	{"tx-device",         required_argument, NULL, 'o'},
+	{"ptp",               required_argument, NULL, 'p'},
+	{"frame-size",        required_argument, NULL, 's'},
+	{"frame-intervals",   required_argument, NULL, 'F'},
+	{"frame-num",         required_argument, NULL, 'n'},
+	{"ts-offset",         required_argument, NULL, OPT_TS_OFFSET},
+	{"udp-tx",            required_argument, NULL, OPT_UDP_TX},
+	{"udp-rx",            required_argument, NULL, OPT_UDP_RX},
+	{"udp-offload",       required_argument, NULL, OPT_UDP_OFFLOAD},
+	{"swap-pages",        no_argument,       NULL, OPT_SWAP_PAGES},
+	{"version",           no_argument,       NULL, OPT_VERSION},
+	{"help",              no_argument,       NULL, 'h'},
+	{NULL,                0,                 NULL,  0 },
+};
+
+static int show_usage(struct app_config *cfg)
+{
+	fprintf(stderr,
+		"usage: " PROGNAME " [options]\n"
+		"\n"
+		"Relay the frames of an rx queue to a tx queue. The StreamID, the\n"
+		"destination address and the timestamp of AVTP stream frames are\n"
+		"rewritten in place and the frames are copied to the tx queue.\n"
+		"The streams are not reserved by MSRP, configure the network statically.\n"
+		"\n"
+		"options:\n"
+		"    -c, --class=SRCLASS         specify SRClassID A/B/C of tx (default:'A')\n"
+		"    -i, --interface=IFNAME      specify network interface name of tx (default:eth0)\n"
+		"    -u, --uid=UNIQUEID          specify UniqueID in the new StreamID (default:1)\n"
+		"    -a, --dest-addr=DEST_ADDR   specify new destination MAC address\n"
+		"                                (default:%02x:%02x:%02x:%02x:%02x:XX, XX=UniqueID(lower 8 bits))\n"
+		"    -d, --device=DEVNAME        specify rx device (default:/dev/avb_rx0)\n"
+		"    -o, --tx-device=DEVNAME     specify tx device\n"
+		"                                (default:/dev/avb_tx1 class A, /dev/avb_tx0 others)\n"
+		"    -p, --ptp=CLOCK             specify PTP clock name (default:/dev/ptp0)\n"
+		"    -s, --frame-size=SIZE       specify MaxFrameSize of the relayed stream\n"
+		"                                (default:%d)\n"
+		"    -F, --frame-intervals=NUM   specify MaxIntervalFrames (default:1)\n"
+		"    -n, --frame-num=NUM         specify number of frames (default:0=infinite)\n"
+		"        --ts-offset=USEC        add USEC to the presentation time (default:0)\n"
+		"        --udp-tx=HOST[:PORT]    send in UDP of IEEE1722 Annex J instead of\n"
+		"                                the tx queue\n"
+		"        --udp-rx=[ADDR:]PORT    receive in UDP of IEEE1722 Annex J instead\n"
+		"                                of the rx queue\n"
+		"        --udp-offload=0|1       use UDP segmentation offloads (default:1)\n"
+		"        --swap-pages            hand the DMA pages of the rx entries over to the\n"
+		"                                tx queue without copy, the driver should accept\n"
+		"                                the pages of another queue (same transport only)\n"
+		"    -h, --help                  display this help\n"
+		"        --version               print version information\n"
+		"\n"
+		"examples:\n"
+		" " PROGNAME " -i eth1 -d /dev/avb_rx0 -u 10 -s 1000\n"
+		" " PROGNAME " -i eth1 -c B -d /dev/avb_rx1 -u 11 --ts-offset=500\n"
+		" " PROGNAME " -p CLOCK_REALTIME --udp-rx=17220 --udp-tx=127.0.0.1:17221\n"
+		"\n"
+		PROGNAME " version " PROGVERSION "\n",
+		dest_addr[0], dest_addr[1], dest_addr[2],
+		dest_addr[3], dest_addr[4], ETHFRAMEMTU_MAX);
+	return 0;
+}
+
+/*
+ * config
+ */
+static int config_init(struct app_config *cfg)
+{
+	memset(cfg, 0, sizeof(*cfg));
+
+	cfg->uid = 1;
+	cfg->entrynum = CONFIG_INIT_ENTRYNUM;
+	cfg->SRclassID = MSRP_SR_CLASS_A;
+	cfg->SRpriority = MSRP_SR_CLASS_A_PRIO;
+	cfg->SRclassIntervalFrames = MSRP_SR_CLASS_A_INTERVAL_FRAMES;
+	cfg->SRvid = MSRP_SR_CLASS_VID;
+	cfg->MaxFrameSize = ETHFRAMEMTU_MAX;
+	cfg->MaxIntervalFrames = 1;
+	memcpy(cfg->dest_addr, dest_addr, ETH_ALEN);
+	cfg->udp_offload = true;
+
+	return 0;
+}
+
+static int config_parse(struct app_config *cfg, int argc, char **argv)
+{
+	int c, i, ret;
+	int option_index = 0;
+	char *iname = NULL;
+	char *cname = NULL;
+	clockid_t clkid;
+
+	config_init(cfg);
+
+	/* Process the command line arguments. */
+	while (EOF != (c = getopt_long(argc, argv, optstring,
+					long_options, &option_index))) {
+		switch (c) {
+		case 'c':
+			i = ((char *)optarg)[0];
+			if (i == 'B' || i == 'b') {
+				cfg->SRclassID = MSRP_SR_CLASS_B;
+				cfg->SRpriority = MSRP_SR_CLASS_B_PRIO;
+				cfg->SRclassIntervalFrames =
+						MSRP_SR_CLASS_B_INTERVAL_FRAMES;
+			} else if (i == 'C' || i == 'c') {
+				cfg->SRclassID = MSRP_SR_CLASS_C;
+				cfg->SRpriority = MSRP_SR_CLASS_C_PRIO;
+				cfg->SRclassIntervalFrames =
+						MSRP_SR_CLASS_C_INTERVAL_FRAMES;
+			} else {
+				cfg->SRclassID = MSRP_SR_CLASS_A;
+				cfg->SRpriority = MSRP_SR_CLASS_A_PRIO;
+				cfg->SRclassIntervalFrames =
+						MSRP_SR_CLASS_A_INTERVAL_FRAMES;
+			}
+			break;
+		case 'i':
+			free(iname);
+			iname = strdup(optarg);
+			break;
+		case 'u':
+			cfg->uid = atoi(optarg);
+			break;
+		case 'a':
+			ret = sscanf(optarg, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+				     &cfg->dest_addr[0], &cfg->dest_addr[1],
+				     &cfg->dest_addr[2], &cfg->dest_addr[3],
+				     &cfg->dest_addr[4], &cfg->dest_addr[5]);
+			if (ret != ETH_ALEN) {
+				PRINTF1("[AVB] Conversion failed mac addr.\n");
+				return -1;
+			}
+			cfg->use_dest_addr = true;
+			break;
+		case 'd':
+			free(cfg->rx_devname);
+			cfg->rx_devname = strdup(optarg);
+			break;
+		case 'o':
+			free(cfg->tx_devname);
+			cfg->tx_devname = strdup(optarg);
+			break;
+		case 'p':
+			free(cname);
+			cname = strdup(optarg);
+			break;
+		case 's':
+			cfg->MaxFrameSize = atoi(optarg);
+			break;
+		case 'F':
+			cfg->MaxIntervalFrames = atoi(optarg);
+			break;
+		case 'n':
+			cfg->framenums = strtoull(optarg, NULL, 0);
+			break;
+		case OPT_TS_OFFSET:
+			cfg->ts_offset = strtoll(optarg, NULL, 0) * 1000;
+			break;
+		case OPT_UDP_TX:
+		case OPT_UDP_RX:
+			ret = (c == OPT_UDP_TX) ?
+				netif_parse_udp(optarg, AVTP_UDP_PORT,
+						&cfg->udp_tx_addr,
+						&cfg->udp_tx_addrlen) :
+				netif_parse_udp(optarg, AVTP_UDP_PORT,
+						&cfg->udp_rx_addr,
+						&cfg->udp_rx_addrlen);
+			if (ret < 0) {
+				PRINTF1("[AVB] invalid UDP address %s.\n",
+						optarg);
+				return -1;
+			}
+			if (c == OPT_UDP_TX)
+				cfg->udp_tx = true;
+			else
+				cfg->udp_rx = true;
+			break;
+		case OPT_UDP_OFFLOAD:
+			cfg->udp_offload = !!atoi(optarg);
+			break;
+		case OPT_SWAP_PAGES:
+			cfg->zero_copy = true;
+			break;
+		case OPT_VERSION:
+			show_version(cfg);
+			exit(EXIT_SUCCESS);
+		case 'h':
+		default:
+			show_usage(cfg);
+			exit(EXIT_SUCCESS);
+		}
+	}
+
+	if ((cfg->uid < 0) || (cfg->uid > AVTP_UNIQUE_ID_MAX)) {
+		PRINTF1("[AVB] out of range uid=%d, specify between 0 and %d\n",
+				cfg->uid, AVTP_UNIQUE_ID_MAX);
+		return -1;
+	}
+
+	if ((cfg->MaxFrameSize < ETHFRAMEMTU_MIN) ||
+				(cfg->MaxFrameSize > ETHFRAMEMTU_MAX)) {
+		PRINTF1("[AVB] out of range frame-size=%d, specify between %d and %d\n",
+				cfg->MaxFrameSize, ETHFRAMEMTU_MIN,
+				ETHFRAMEMTU_MAX);
+		return -1;
+	}
+
+	if (cfg->MaxIntervalFrames < 1) {
+		PRINTF1("[AVB] out of range MaxIntervalFrames=%d, specify greater than 0\n",
+				cfg->MaxIntervalFrames);
+		return -1;
+	}
+
+	/* The MAC Address of ethernet is got and it uses for StreamID. */
+	if (cfg->udp_tx && !iname) {
+		strcpy(cfg->ifname, "udp");
+		cfg->speed = 1000;
+	} else {
+		if (!iname)
+			iname = strdup("eth0");
+
+		if (netif_detect(iname) < 0) {
+			PRINTF1("[AVB] not found network interface\n");
+			return -1;
+		}
+		if (netif_gethwaddr(iname, cfg->source_addr) < 0) {
+			PRINTF1("[AVB] can't get hw address\n");
+			return -1;
+		}
+		if (netif_getlinkspeed(iname, &cfg->speed) < 0) {
+			PRINTF1("[AVB] can't get link speed\n");
+			return -1;
+		}
+
+		strcpy(cfg->ifname, iname);
+	}
+	free(iname);
+
+	memcpy(cfg->StreamID, cfg->source_addr, ETH_ALEN);
+	cfg->StreamID[6] = (cfg->uid & 0xff00) >> 8;
+	cfg->StreamID[7] = (cfg->uid & 0x00ff);
+	if (!cfg->use_dest_addr)
+		cfg->dest_addr[5] = cfg->StreamID[7];
+
+	if (!cfg->rx_devname)
+		cfg->rx_devname = strdup((cfg->udp_rx) ? "udp" :
+					 "/dev/avb_rx0");
+	if (!cfg->tx_devname)
+		cfg->tx_devname = strdup((cfg->udp_tx) ? "udp" :
+				(cfg->SRclassID == MSRP_SR_CLASS_A) ?
+				"/dev/avb_tx1" : "/dev/avb_tx0");
+
+	/* the DMA frames move between the queues of the same transport */
+	if (cfg->zero_copy && cfg->udp_rx != cfg->udp_tx) {
+		PRINTF("[AVB] --swap-pages needs rx and tx of the same transport\n");
+		return -1;
+	}
+
+	{
+		if (!cname)
+			cname = strdup("/dev/ptp0");
+
+		clkid = clock_parse(cname);
+		if (clkid == CLOCK_INVALID) {
+			PRINTF("[AVB] can't parse clock name %s\n", cname);
+			return -1;
+		}
+		PRINTF("[AVB] clock: select %s (%d)\n", cname, clkid);
+		cfg->clkid = clkid;
+
+		free(cname);
+	}
+
+	return 0;
+}
+
+/* signal handler */
+static bool sigint;
+static void sigint_handler(int s)
+{
+	sigint = true;
+}
+
+static int install_sighandler(int s, void (*handler)(int))
+{
+	struct sigaction sa;
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = handler;
+	sigemptyset(&sa.sa_mask);
+	sigaddset(&sa.sa_mask, SIGQUIT);
+
+	if (sigaction(s, &sa, NULL) == -1) {
+		perror("sigaction");
+		return -1;
+	}
+
+	return 0;
+}
+
+static int relay_calccbsinfo(struct app_config *cfg, struct eavb_cbsparam *cbs)
+{
+	uint64_t value;
+	double bandwidthFraction;
+
+	bandwidthFraction = ((ETHOVERHEAD_REAL + cfg->MaxFrameSize) * 8 *
+			(double)cfg->SRclassIntervalFrames *
+			cfg->MaxIntervalFrames) /
+			((double)cfg->speed * 1000000); /* bit */
+
+	PRINTF1("[AVB] SRclass%s MaxFrameSize=%d MaxIntervalFrames=%d BandwidthFraction=%.8f\n",
+			(cfg->SRclassID == MSRP_SR_CLASS_A) ? "A" :
+			(cfg->SRclassID == MSRP_SR_CLASS_B) ? "B" : "C",
+			cfg->MaxFrameSize, cfg->MaxIntervalFrames,
+			bandwidthFraction);
+
+	value = (uint64_t)(UINT32_MAX * bandwidthFraction);
+	if (value > UINT32_MAX) {
+		memset(cbs, 0, sizeof(*cbs));
+		PRINTF1("[AVB] out of range the bandwidth fraction, it should be less than 1.0.\n");
+		return -1;
+	}
+
+	/* Linear : low accuracy. However, it is compoundable by addition. */
+	cbs->bandwidthFraction = value;
+	cbs->idleSlope = floor(UINT16_MAX * bandwidthFraction);
+	cbs->sendSlope = ceil(UINT16_MAX * (1 - bandwidthFraction));
+
+	return 0;
+}
+
+/*
+ * eavb devices
+ */
+static int relay_open(struct app_config *cfg)
+{
+	struct eavb_device *dev;
+	struct eavb_rxparam rxparam;
+	struct eavb_txparam txparam;
+	struct eavb_dma_alloc *p;
+	struct eavb_entry *e;
+	int i;
+
+	/* rx, all entries are queued for the receive */
+	if (cfg->udp_rx)
+		dev = eavb_device_new_udp(&cfg->udp_rx_addr,
+					  cfg->udp_rx_addrlen, cfg->entrynum,
+					  false, cfg->udp_offload);
+	else
+		dev = eavb_device_new(cfg->rx_devname, cfg->entrynum, O_RDWR);
+	if (!dev)
+		return -1;
+	cfg->rx = dev;
+
+	/* verify that the specified device is avb_rx device */
+	if (!cfg->udp_rx && eavb_get_rxparam(dev->fd, &rxparam) < 0) {
+		PRINTF("[AVB] cannot get rxparam from %s, should be specified avb_rx device file\n",
+				cfg->rx_devname);
+		return -1;
+	}
+
+	for (i = 0, e = dev->entrybuf, p = dev->framebuf;
+			i < dev->entrynum;
+			i++, e++, p++) {
+		if (eavb_device_alloc_page(dev, p) < 0)
+			return -1;
+		dev->frames[i] = p->dma_vaddr;
+		e->vec[0].base = p->dma_paddr;
+		e->vec[0].len = ETHFRAMELEN_MAX;
+	}
+
+	/* tx, the pages are spares until relayed frames take their place */
+	if (cfg->udp_tx)
+		dev = eavb_device_new_udp(&cfg->udp_tx_addr,
+					  cfg->udp_tx_addrlen, cfg->entrynum,
+					  true, cfg->udp_offload);
+	else
+		dev = eavb_device_new(cfg->tx_devname, cfg->entrynum, O_RDWR);
+	if (!dev)
+		return -1;
+	cfg->tx = dev;
+
+	for (i = 0, e = dev->entrybuf, p = dev->framebuf;
+			i < dev->entrynum;
+			i++, e++, p++) {
+		if (eavb_device_alloc_page(dev, p) < 0)
+			return -1;
+		dev->frames[i] = p->dma_vaddr;
+		e->vec[0].base = p->dma_paddr;
+		e->vec[0].len = 0;
+	}
+
+	memset(&txparam, 0, sizeof(txparam));
+	if (relay_calccbsinfo(cfg, &txparam.cbs) < 0)
+		return -1;
+
+	/* no credit based shaper in the network stack */
+	if (!cfg->udp_tx && eavb_set_txparam(dev->fd, &txparam) < 0)
+		return -1;
+
+	cfg->taken = calloc(dev->entrynum, sizeof(*cfg->taken));
+	if (!cfg->taken)
+		return -1;
+
+	return 0;
+}
+
+/*
+ * relay
+ */
+/* rewrite the header of an AVTP stream frame for the tx side */
+static void relay_rewrite(struct app_config *cfg, void *frame, int len)
+{
+	struct relay_stats *st = &cfg->stats;
+	uint8_t flags;
+
+	if (len < AVTP_PAYLOAD_OFFSET ||
+	    get_ieee8021q_ethtype(frame) != ETH_P_1722) {
+		st->others++;
+		return;
+	}
+
+	flags = get_avtp_stream_flags(frame);
+	if (!(flags & AVTP_STREAM_FLAG_SV)) {
+		st->others++;
+		return;
+	}
+
+	set_ieee8021q_dest(frame, cfg->dest_addr);
+	set_avtp_stream_id(frame, cfg->StreamID);
+	if ((flags & AVTP_STREAM_FLAG_TV) && cfg->ts_offset)
+		set_avtp_timestamp(frame, get_avtp_timestamp(frame) +
+				(uint32_t)cfg->ts_offset);
+	st->streams++;
+}
+
+/* exchange the pages of rx entry s and tx entry d */
+static void relay_swap(struct eavb_device *rx, int s,
+		       struct eavb_device *tx, int d)
+{
+	struct eavb_dma_alloc *a = (struct eavb_dma_alloc *)rx->framebuf + s;
+	struct eavb_dma_alloc *b = (struct eavb_dma_alloc *)tx->framebuf + d;
+	struct eavb_dma_alloc page;
+	void *frame;
+
+	page = *a;
+	*a = *b;
+	*b = page;
+
+	frame = rx->frames[s];
+	rx->frames[s] = tx->frames[d];
+	tx->frames[d] = frame;
+
+	((struct eavb_entry *)rx->entrybuf + s)->vec[0].base = a->dma_paddr;
+	((struct eavb_entry *)tx->entrybuf + d)->vec[0].base = b->dma_paddr;
+}
+
+/* move the received frames to free tx entries */
+static int relay_forward(struct app_config *cfg)
+{
+	struct eavb_device *rx = cfg->rx;
+	struct eavb_device *tx = cfg->tx;
+	struct relay_stats *st = &cfg->stats;
+	struct eavb_entry *re, *te;
+	uint64_t now;
+	int i, n, s, d, rp, len;
+
+	n = tx->remain - cfg->ready;
+	if (cfg->framenums && n > cfg->framenums - st->frames)
+		n = cfg->framenums - st->frames;
+	if (n > rx->filled)
+		n = rx->filled;
+
+	rp = rx->rp;
+	n = rx->take_entry(rx, n);
+	if (n <= 0)
+		return n;
+
+	now = clock_getcount(cfg->clkid);
+
+	for (i = 0; i < n; i++) {
+		s = (rp + i) % rx->entrynum;
+		d = (tx->wp + cfg->ready) % tx->entrynum;
+		re = (struct eavb_entry *)rx->entrybuf + s;
+		te = (struct eavb_entry *)tx->entrybuf + d;
+		len = re->vec[0].len;
+
+		relay_rewrite(cfg, rx->frames[s], len);
+
+		if (cfg->zero_copy) {
+			relay_swap(rx, s, tx, d);
+		} else {
+			memcpy(tx->frames[d], rx->frames[s], len);
+			st->copied += len;
+		}
+		te->vec[0].len = len;
+		re->vec[0].len = ETHFRAMELEN_MAX;
+
+		cfg->taken[d] = now;
+		cfg->ready++;
+	}
+	st->frames += n;
+
+	return n;
+}
+
+static int relay_push(struct app_config *cfg)
+{
+	struct eavb_device *tx = cfg->tx;
+	struct relay_stats *st = &cfg->stats;
+	uint64_t now;
+	int32_t margin;
+	void *frame;
+	int i, d, wp, n;
+
+	wp = tx->wp;
+	now = clock_getcount(cfg->clkid);
+
+	for (i = 0; i < cfg->ready; i++) {
+		frame = tx->frames[(wp + i) % tx->entrynum];
+		if (get_ieee8021q_ethtype(frame) != ETH_P_1722 ||
+		    (get_avtp_stream_flags(frame) &
+		     (AVTP_STREAM_FLAG_SV | AVTP_STREAM_FLAG_TV)) !=
+		    (AVTP_STREAM_FLAG_SV | AVTP_STREAM_FLAG_TV))
+			continue;
+
+		margin = get_avtp_timestamp(frame) - (uint32_t)now;
+		if (margin < 0)
+			st->late++;
+		else
+			hdr_hist_record(&st->margin, margin);
+	}
+
+	n = tx->push_entry(tx, cfg->ready);
+	if (n <= 0)
+		return n;
+
+	now = clock_getcount(cfg->clkid);
+	for (i = 0; i < n; i++) {
+		d = (wp + i) % tx->entrynum;
+		hdr_hist_record(&st->relay, now - cfg->taken[d]);
+	}
+	cfg->ready -= n;
+
+	return n;
+}
+
+/* take back the transmitted entries, their pages are spares again */
+static int relay_reclaim(struct app_config *cfg)
+{
+	struct eavb_device *tx = cfg->tx;
+	uint64_t now;
+	int i, n, rp;
+
+	rp = tx->rp;
+	n = tx->take_entry(tx, tx->filled);
+	if (n <= 0)
+		return n;
+
+	now = clock_getcount(cfg->clkid);
+	for (i = 0; i < n; i++)
+		hdr_hist_record(&cfg->stats.egress,
+				now - cfg->taken[(rp + i) % tx->entrynum]);
+
+	return n;
+}
+
+static int relay_loop(struct app_config *cfg)
+{
+	struct eavb_device *rx = cfg->rx;
+	struct eavb_device *tx = cfg->tx;
+	struct relay_stats *st = &cfg->stats;
+	struct pollfd pfd[2];
+	bool full = false;
+	int ret;
+
+	while (!sigint && (!cfg->framenums || st->frames < cfg->framenums)) {
+		/* keep every free rx entry queued for the receive */
+		if (rx->remain && rx->push_entry(rx, rx->remain) < 0)
+			break;
+
+		/* no free tx entries, the rx queue has to wait */
+		if (tx->remain == cfg->ready) {
+			if (!full)
+				st->tx_full++;
+			full = true;
+		} else {
+			full = false;
+		}
+
+		pfd[0].fd = rx->fd;
+		pfd[0].events = (full) ? 0 : POLLIN;
+		pfd[1].fd = tx->fd;
+		pfd[1].events = (tx->filled) ? POLLIN : 0;
+
+		ret = poll(pfd, ARRAY_SIZE(pfd), WAIT_TIME_PROCESS);
+		if (ret < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("[AVB] poll");
+			break;
+		}
+
+		if ((pfd[1].revents & POLLIN) && relay_reclaim(cfg) < 0)
+			break;
+
+		if ((pfd[0].revents & POLLIN) && relay_forward(cfg) < 0)
+			break;
+
+		if (cfg->ready && relay_push(cfg) < 0)
+			break;
+	}
+
+	/* wait for transmission of remaining entries */
+	while (tx->filled > 0) {
+		ret = eavb_wait(tx->fd, EAVB_NOTIFY_READ, WAIT_TIME_PROCESS);
+		if (ret <= 0 || !(ret & EAVB_NOTIFY_READ) ||
+		    relay_reclaim(cfg) <= 0)
+			break;
+	}
+
+	return 0;
+}
+
+static void relay_report(struct app_config *cfg)
+{
+	struct relay_stats *st = &cfg->stats;
+	char buf[256];
+
+	PRINTF("relay: %"PRIu64" frames, %"PRIu64" streams rewritten, %"PRIu64" others, "
+		"%s, %"PRIu64" bytes copied, %"PRIu64" tx full\n",
+			st->frames, st->streams, st->others,
+			(cfg->zero_copy) ? "pages swapped" : "copied",
+			st->copied, st->tx_full);
+	PRINTF("relay: added latency per frame p50/p99/max take->push %"PRIu64"/%"PRIu64"/%"PRIu64"ns, "
+		"take->tx done %"PRIu64"/%"PRIu64"/%"PRIu64"ns\n",
+			hdr_hist_percentile(&st->relay, 50),
+			hdr_hist_percentile(&st->relay, 99), st->relay.max,
+			hdr_hist_percentile(&st->egress, 50),
+			hdr_hist_percentile(&st->egress, 99), st->egress.max);
+	if (st->margin.count || st->late)
+		PRINTF("relay: presentation time left at push p50/p1/min %"PRIu64"/%"PRIu64"/%"PRIu64"ns, "
+			"%"PRIu64" late\n",
+				hdr_hist_percentile(&st->margin, 50),
+				hdr_hist_percentile(&st->margin, 1),
+				st->margin.min, st->late);
+	if (eavb_device_udp_report(cfg->rx, buf, sizeof(buf)) > 0)
+		PRINTF("relay: %s\n", buf);
+	if (eavb_device_udp_report(cfg->tx, buf, sizeof(buf)) > 0)
+		PRINTF("relay: %s\n", buf);
+}
+
+int main(int argc, char **argv)
+{
+	struct app_config *cfg = calloc(1, sizeof(*cfg));
+	int ret = -1;
+
+	if (!cfg) {
+		PRINTF("[AVB] cannot allocate cfg\n");
+		return -1;
+	}
+
+	if (config_parse(cfg, argc, argv) < 0)
+		goto out;
+
+	/* install signal handler */
+	install_sighandler(SIGINT, sigint_handler);
+	install_sighandler(SIGTERM, sigint_handler);
+
+	hdr_hist_reset(&cfg->stats.relay);
+	hdr_hist_reset(&cfg->stats.egress);
+	hdr_hist_reset(&cfg->stats.margin);
+
+	if (relay_open(cfg) < 0) {
+		PRINTF("[AVB] cannot setup the relay\n");
+		goto out;
+	}
+
+	PRINTF1("[AVB] %s -> %s: %s: %dMbps / %02x:%02x:%02x:%02x:%02x:%02x+%02x:%02x\n",
+			cfg->rx_devname, cfg->tx_devname,
+			cfg->ifname, cfg->speed,
+			cfg->StreamID[0], cfg->StreamID[1],
+			cfg->StreamID[2], cfg->StreamID[3],
+			cfg->StreamID[4], cfg->StreamID[5],
+			cfg->StreamID[6], cfg->StreamID[7]);
+
+	PRINTF1("[AVB] start relay.\n");
+	relay_loop(cfg);
+	PRINTF1("[AVB] finish relay.\n");
+
+	relay_report(cfg);
+
+	ret = 0;
+
+out:
+	eavb_device_free(cfg->rx);
+	eavb_device_free(cfg->tx);
+	free(cfg->taken);
+	free(cfg->rx_devname);
+	free(cfg->tx_devname);
+	free(cfg);
+
+	if (!ret)
+		return 0;
+
+	return -1;
+}
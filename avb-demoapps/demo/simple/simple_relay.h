@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2014-2017 Renesas Electronics Corporation
+ * Released under the MIT license
+ * http://opensource.org/licenses/mit-license.php
+ */
+
+#ifndef __SIMPLE_RELAY_H__
+#define __SIMPLE_RELAY_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <net/if.h>
+#include <sys/socket.h>
+#include <linux/if_ether.h>
+#include "netif_util.h"
+#include "packet.h"
+#include "eavb_device.h"
+#include "hdr_hist.h"
+
+#define NSEC_SCALE	(1000000000)
+
+/*
+ * Frames taken from the rx queue are rewritten in place and copied to
+ * the tx queue. With --swap-pages their pages are swapped with spare
+ * pages of the tx queue instead, so the same DMA frames go out and the
+ * rx queue is refilled at once. That relies on the driver taking pages
+ * allocated for another queue, and works between queues of the same
+ * transport only.
+ */
+struct relay_stats {
+	uint64_t           frames;
+	uint64_t           streams;      /* AVTP stream frames rewritten */
+	uint64_t           others;       /* forwarded as they are */
+	uint64_t           copied;       /* bytes copied across transports */
+	uint64_t           tx_full;      /* rx waited for free tx entries */
+	uint64_t           late;         /* presentation time passed */
+	struct hdr_hist    relay;        /* from the take to the push */
+	struct hdr_hist    egress;       /* from the take to the tx completion */
+	struct hdr_hist    margin;       /* presentation time left at the push */
+};
+
+struct app_config {
+	char               ifname[IFNAMSIZ];
+	uint8_t            source_addr[ETH_ALEN];
+	int                speed;
+	char               *rx_devname;
+	char               *tx_devname;
+	int                entrynum;
+	clockid_t          clkid;
+	uint8_t            SRclassID;
+	uint8_t            SRpriority;
+	uint8_t            SRvid;
+	int                SRclassIntervalFrames;
+	int                MaxFrameSize;
+	int                MaxIntervalFrames;
+	int                uid;
+	uint8_t            StreamID[AVTP_STREAMID_SIZE];
+	uint8_t            dest_addr[ETH_ALEN];
+	bool               use_dest_addr;
+	int64_t            ts_offset;    /* nsec added to avtp_timestamp */
+	uint64_t           framenums;
+
+	/* IEEE1722 Annex J UDP transport instead of the eavb queues */
+	bool               udp_tx;
+	struct sockaddr_storage udp_tx_addr;
+	socklen_t          udp_tx_addrlen;
+	bool               udp_rx;
+	struct sockaddr_storage udp_rx_addr;
+	socklen_t          udp_rx_addrlen;
+	bool               udp_offload;
+
+	struct eavb_device *rx;
+	struct eavb_device *tx;
+	bool               zero_copy;    /* --swap-pages */
+	int                ready;        /* tx entries not pushed yet */
+	uint64_t           *taken;       /* take time of the tx entries */
+
+	struct relay_stats stats;
+};
+
+#endif /* __SIMPLE_RELAY_H__ */
@@ -4,11 +4,16 @@
  * http://opensource.org/licenses/mit-license.php
  */
 
+#define _GNU_SOURCE /* ppoll */
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
 #include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
 #include <time.h>
 #include <signal.h>
 #include <sys/types.h>
@@ -21,6 +26,7 @@
 #include <stdbool.h>
 #include <linux/if_ether.h>
 #include <inttypes.h>
+#include <errno.h>
 
 #include "eavb.h"
 #include "msrp.h"
@@ -47,7 +53,40 @@ static int show_version(struct app_config *cfg)
 	return 0;
 }
 
-static const char *optstring = "c:i:p:u:s:f:F:n:m:w:a:h";
+enum {
+	OPT_VERSION = 1,
+	OPT_CRF_TYPE,
+	OPT_CRF_BASE_FREQ,
+	OPT_CRF_PULL,
+	OPT_CRF_TIMESTAMPS,
+	OPT_CRF_INTERVAL,
+	OPT_CAN,
+	OPT_ACF_LATENCY,
+	OPT_AEF_KEY,
+	OPT_AEF_MODE,
+	OPT_AEF_KEY_ID,
+	OPT_CRC,
+	OPT_REPLAY,
+	OPT_REPLAY_ALIGN,
+	OPT_REMAP,
+	OPT_REMAP_ADDR,
+	OPT_UDP,
+	OPT_UDP_OFFLOAD,
+	OPT_SHM,
+	OPT_SHM_SLOTS,
+	OPT_ALSA,
+	OPT_ALSA_PERIOD,
+	OPT_RATE,
+	OPT_CHANNELS,
+	OPT_AAF_FORMAT,
+	OPT_UPGRADE_EXEC,
+	OPT_TAKEOVER,
+	OPT_HEARTBEAT,
+	OPT_STANDBY,
+	OPT_STANDBY_INTERVALS,
+};
+
+static const char *optstring = "c:i:p:u:s:f:F:n:m:w:a:t:h";
 static const struct option long_options[] = {
 	{"class",             required_argument, NULL, 'c'},
 	{"interface",         required_argument, NULL, 'i'},
@@ -60,7 +99,37 @@ static const struct option long_options[] = {
 	{"msrp",              required_argument, NULL, 'm'},
 	{"waitmode",          required_argument, NULL, 'w'},
 	{"dest-addr",         required_argument, NULL, 'a'},
-	{"version",           no_argument,       NULL,  1 },
+	{"format",            required_argument, NULL, 't'},
+	{"crf-type",          required_argument, NULL, OPT_CRF_TYPE},
+	{"crf-base-freq",     required_argument, NULL, OPT_CRF_BASE_FREQ},
+	{"crf-pull",          required_argument, NULL, OPT_CRF_PULL},
+	{"crf-timestamps",    required_argument, NULL, OPT_CRF_TIMESTAMPS},
+	{"crf-interval",      required_argument, NULL, OPT_CRF_INTERVAL},
+	{"can",               required_argument, NULL, OPT_CAN},
+	{"acf-latency",       required_argument, NULL, OPT_ACF_LATENCY},
+	{"aef-key",           required_argument, NULL, OPT_AEF_KEY},
+	{"aef-mode",          required_argument, NULL, OPT_AEF_MODE},
+	{"aef-key-id",        required_argument, NULL, OPT_AEF_KEY_ID},
+	{"crc",               no_argument,       NULL, OPT_CRC},
+	{"replay",            required_argument, NULL, OPT_REPLAY},
+	{"replay-align",      no_argument,       NULL, OPT_REPLAY_ALIGN},
+	{"remap",             required_argument, NULL, OPT_REMAP},
+	{"remap-addr",        required_argument, NULL, OPT_REMAP_ADDR},
+	{"udp",               required_argument, NULL, OPT_UDP},
+	{"udp-offload",       required_argument, NULL, OPT_UDP_OFFLOAD},
+	{"shm",               required_argument, NULL, OPT_SHM},
+	{"shm-slots",         required_argument, NULL, OPT_SHM_SLOTS},
+	{"alsa",              required_argument, NULL, OPT_ALSA},
+	{"alsa-period",       required_argument, NULL, OPT_ALSA_PERIOD},
+	{"rate",              required_argument, NULL, OPT_RATE},
+	{"channels",          required_argument, NULL, OPT_CHANNELS},
+	{"aaf-format",        required_argument, NULL, OPT_AAF_FORMAT},
+	{"upgrade-exec",      required_argument, NULL, OPT_UPGRADE_EXEC},
+	{"takeover",          required_argument, NULL, OPT_TAKEOVER},
+	{"heartbeat",         required_argument, NULL, OPT_HEARTBEAT},
+	{"standby",           required_argument, NULL, OPT_STANDBY},
+	{"standby-intervals", required_argument, NULL, OPT_STANDBY_INTERVALS},
+	{"version",           no_argument,       NULL, OPT_VERSION},
 	{"help",              no_argument,       NULL, 'h'},
 	{NULL,                0,                 NULL,  0 },
 };
@@ -84,6 +153,57 @@ static int show_usage(struct app_config *cfg)
 		"                                0:poll, 1:blocking(NOWAIT) 2:blocking(WAITALL)\n"
 		"    -a, --dest-addr=DEST_ADDR   specify destination MAC address\n"
 		"                                (default:%02x:%02x:%02x:%02x:%02x:XX, XX=UniqueID(lower 8 bits))\n"
+		"    -t, --format=FORMAT         specify stream format cvf/crf/ntscf/tscf/aef/aaf\n"
+		"                                (default:cvf)\n"
+		"        --crf-type=TYPE         specify CRF type audio/video (default:audio)\n"
+		"        --crf-base-freq=HZ      specify CRF base frequency\n"
+		"                                (default:48000 audio, 30 video)\n"
+		"        --crf-pull=PULL         specify CRF pull multiplier (default:0)\n"
+		"                                0:1.0 1:1/1.001 2:1.001 3:24/25 4:25/24 5:1/8\n"
+		"        --crf-timestamps=NUM    specify CRF timestamps per PDU\n"
+		"                                (default:6 audio, 1 video)\n"
+		"        --crf-interval=NUM      specify CRF timestamp interval\n"
+		"                                (default:160 audio, 1 video)\n"
+		"        --can=IFNAME            specify CAN interface for ntscf/tscf\n"
+		"        --acf-latency=USEC      specify CAN frame aggregation latency\n"
+		"                                (default:1000)\n"
+		"        --aef-key=FILE          specify AES key file for aef (key + 4 bytes salt)\n"
+		"        --aef-mode=MODE         specify AES mode ctr/gcm (default:gcm)\n"
+		"        --aef-key-id=NUM        specify key_id of aef (default:0)\n"
+		"        --crc                   append CRC32C of stream data to cvf/aef frames\n"
+		"        --replay=FILE[,FILE...] replay AVTP frames of pcap/pcapng captures\n"
+		"                                with the captured timing (requires -m 0)\n"
+		"        --replay-align          start all captures at once instead of\n"
+		"                                keeping their relative capture time\n"
+		"        --remap=OLD=NEW         replace StreamID OLD by NEW in replay\n"
+		"                                (xx:xx:xx:xx:xx:xx:xx:xx, repeatable)\n"
+		"        --remap-addr=OLD=NEW    replace destination MAC address OLD by NEW\n"
+		"                                in replay (repeatable)\n"
+		"        --udp=HOST[:PORT]       send AVTPDUs in UDP datagrams of IEEE1722\n"
+		"                                Annex J instead of the eavb driver\n"
+		"                                (default port:%d, requires -m 0 and -w 0)\n"
+		"        --udp-offload=0|1       use UDP segmentation offload (default:1)\n"
+		"        --shm=NAME              take the payloads from the shared memory ring of\n"
+		"                                a producer connecting to @NAME instead of -f,\n"
+		"                                e.g. simple_feeder\n"
+		"        --shm-slots=NUM         specify number of payloads of --shm, power of 2\n"
+		"                                (default:1024)\n"
+		"        --alsa=PCM              capture aaf from the ALSA device PCM in mmap mode\n"
+		"        --alsa-period=USEC      specify ALSA period, rounded to whole PDUs\n"
+		"                                (default:1000)\n"
+		"        --rate=HZ               specify aaf sample rate (default:48000)\n"
+		"        --channels=NUM          specify aaf channels (default:2)\n"
+		"        --aaf-format=FORMAT     specify aaf format int16/int24/int32 (default:int32)\n"
+		"        --upgrade-exec=PATH     specify the binary to hand the stream over to\n"
+		"                                on SIGUSR2, with -f or crf (default:argv[0])\n"
+		"        --takeover=FD           take the stream over from the talker at the\n"
+		"                                socket FD, set by the hot upgrade\n"
+		"        --heartbeat=NAME        beat in the shared memory NAME for a standby\n"
+		"                                talker, with -f or crf\n"
+		"        --standby=NAME          stand by for the talker beating in NAME and\n"
+		"                                take its stream over when it stops\n"
+		"        --standby-intervals=NUM specify class intervals of missed heartbeat to\n"
+		"                                take over (default:16)\n"
 		"    -h, --help                  display this help\n"
 		"        --version               print version information\n"
 		"\n"
@@ -93,10 +213,18 @@ static int show_usage(struct app_config *cfg)
 		" " PROGNAME
 		" -i eth1 -u 2 -n 80000 -m 1 -f /tmp/test.bin\n"
 		" " PROGNAME " -i eth1 -m 0 -f /tmp/test.bin\n"
+		" " PROGNAME " -i eth1 -u 3 -t crf --crf-type=audio --crf-base-freq=48000\n"
+		" " PROGNAME " -i eth1 -u 4 -t ntscf --can=vcan0 --acf-latency=500\n"
+		" " PROGNAME " -i eth1 -u 5 -t aef --aef-key=/etc/avb/aef.key -f /tmp/test.bin\n"
+		" " PROGNAME " -i eth1 -m 0 --replay=/tmp/a.pcapng,/tmp/b.pcap\n"
+		" " PROGNAME " -m 0 --udp=239.0.17.22 -f /tmp/test.bin\n"
+		" " PROGNAME " -i eth1 -s 1000 --shm=avb_tx &\n"
+		" simple_feeder -f /tmp/in.bin avb_tx\n"
+		" " PROGNAME " -i eth1 -u 6 -t aaf --alsa=plughw:0 --aaf-format=int24\n"
 		"\n"
 		PROGNAME " version " PROGVERSION "\n",
 		dest_addr[0], dest_addr[1], dest_addr[2],
-		dest_addr[3], dest_addr[4]);
+		dest_addr[3], dest_addr[4], AVTP_UDP_PORT);
 	return 0;
 }
 
@@ -120,6 +248,20 @@ static int config_init(struct app_config *cfg)
 	cfg->msrp = MSRP_ON;
 	cfg->waitmode = WAIT_MODE_POLL;
 	memcpy(cfg->dest_addr, dest_addr, ETH_ALEN);
+	cfg->format = AVTP_SIMPLE_FORMAT_CVF;
+	cfg->crf.type = AVTP_CRF_TYPE_AUDIO_SAMPLE;
+	cfg->crf.pull = AVTP_CRF_PULL_1_0;
+	cfg->acf.fd = -1;
+	cfg->acf.latency = 1000;
+	cfg->aef_mode = AVTP_AEF_MODE_GCM;
+	cfg->udp_offload = true;
+	cfg->shm_slots = 1024;
+	cfg->alsa.rate = 48000;
+	cfg->alsa.channels = 2;
+	cfg->alsa.period = 1000;
+	cfg->aaf.format = AVTP_AAF_FORMAT_INT_32BIT;
+	cfg->upgrade.sock = -1;
+	cfg->standby.intervals = STANDBY_INTERVALS;
 
 	return 0;
 }
@@ -155,6 +297,252 @@ static int config_parse_fname(char *name)
 	return fd;
 }
 
+static int config_parse_format(char *name)
+{
+	if (!strcmp(name, "cvf"))
+		return AVTP_SIMPLE_FORMAT_CVF;
+	else if (!strcmp(name, "crf"))
+		return AVTP_SIMPLE_FORMAT_CRF;
+	else if (!strcmp(name, "ntscf"))
+		return AVTP_SIMPLE_FORMAT_NTSCF;
+	else if (!strcmp(name, "tscf"))
+		return AVTP_SIMPLE_FORMAT_TSCF;
+	else if (!strcmp(name, "aef"))
+		return AVTP_SIMPLE_FORMAT_AEF;
+	else if (!strcmp(name, "aaf"))
+		return AVTP_SIMPLE_FORMAT_AAF;
+
+	return -1;
+}
+
+static int config_parse_crf_type(char *name)
+{
+	if (!strcmp(name, "audio"))
+		return AVTP_CRF_TYPE_AUDIO_SAMPLE;
+	else if (!strcmp(name, "video"))
+		return AVTP_CRF_TYPE_VIDEO_FRAME;
+
+	return -1;
+}
+
+static int config_check_crf(struct app_config *cfg)
+{
+	struct avtp_simple_crf_param *crf = &cfg->crf;
+	bool audio = (crf->type == AVTP_CRF_TYPE_AUDIO_SAMPLE);
+
+	if (!crf->base_frequency)
+		crf->base_frequency = (audio) ? 48000 : 30;
+	if (!crf->timestamp_interval)
+		crf->timestamp_interval = (audio) ? 160 : 1;
+	if (!cfg->crf_timestamps)
+		cfg->crf_timestamps = (audio) ? 6 : 1;
+
+	if ((crf->pull < AVTP_CRF_PULL_1_0) ||
+				(crf->pull > AVTP_CRF_PULL_MAX)) {
+		PRINTF1("[AVB] out of range crf-pull=%d, specify between %d and %d\n",
+				crf->pull, AVTP_CRF_PULL_1_0,
+				AVTP_CRF_PULL_MAX);
+		return -1;
+	}
+
+	if (crf->base_frequency > AVTP_CRF_BASE_FREQUENCY_MAX) {
+		PRINTF1("[AVB] out of range crf-base-freq=%u, specify between 1 and %d\n",
+				crf->base_frequency,
+				AVTP_CRF_BASE_FREQUENCY_MAX);
+		return -1;
+	}
+
+	if ((crf->timestamp_interval < 1) ||
+				(crf->timestamp_interval > UINT16_MAX)) {
+		PRINTF1("[AVB] out of range crf-interval=%d, specify between 1 and %d\n",
+				crf->timestamp_interval, UINT16_MAX);
+		return -1;
+	}
+
+	if (cfg->crf_timestamps < 1) {
+		PRINTF1("[AVB] out of range crf-timestamps=%d, specify greater than 0\n",
+				cfg->crf_timestamps);
+		return -1;
+	}
+
+	cfg->payload_size = cfg->crf_timestamps * AVTP_CRF_TIMESTAMP_SIZE;
+
+	return 0;
+}
+
+static bool config_is_acf(struct app_config *cfg)
+{
+	return (cfg->format == AVTP_SIMPLE_FORMAT_NTSCF ||
+		cfg->format == AVTP_SIMPLE_FORMAT_TSCF);
+}
+
+static int config_check_acf(struct app_config *cfg, char *canname)
+{
+	if (!canname) {
+		PRINTF1("[AVB] Please specify the CAN interface (--can option).\n");
+		return -1;
+	}
+
+	if (cfg->acf.latency < 0) {
+		PRINTF1("[AVB] out of range acf-latency=%d, specify 0 or greater\n",
+				cfg->acf.latency);
+		return -1;
+	}
+
+	if (cfg->payload_size < ACF_CAN_MSG_SIZE_MAX ||
+	    (cfg->format == AVTP_SIMPLE_FORMAT_NTSCF &&
+	     cfg->payload_size > AVTP_NTSCF_DATA_LENGTH_MAX)) {
+		PRINTF1("[AVB] out of range payload size=%d, specify between %d and %d\n",
+				cfg->payload_size, ACF_CAN_MSG_SIZE_MAX,
+				AVTP_NTSCF_DATA_LENGTH_MAX);
+		return -1;
+	}
+
+	cfg->acf.fd = acf_can_open(canname);
+	if (cfg->acf.fd < 0) {
+		PRINTF1("[AVB] cannot open CAN interface %s.\n", canname);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* the state of the other sources stays in the process */
+static bool config_can_upgrade(struct app_config *cfg)
+{
+	return !cfg->replay && !cfg->shm_name && !config_is_acf(cfg) &&
+		cfg->format != AVTP_SIMPLE_FORMAT_AAF &&
+		cfg->format != AVTP_SIMPLE_FORMAT_AEF;
+}
+
+static int config_parse_aaf_format(char *name)
+{
+	if (!strcmp(name, "int16"))
+		return AVTP_AAF_FORMAT_INT_16BIT;
+	else if (!strcmp(name, "int24"))
+		return AVTP_AAF_FORMAT_INT_24BIT;
+	else if (!strcmp(name, "int32"))
+		return AVTP_AAF_FORMAT_INT_32BIT;
+
+	return -1;
+}
+
+/* derive the PDU of the AAF stream from the ALSA capture options */
+static int config_check_aaf(struct app_config *cfg)
+{
+	struct alsa_source *as = &cfg->alsa;
+	struct avtp_simple_aaf_param *aaf = &cfg->aaf;
+	int intervals;
+	uint8_t nsr;
+
+	if (!as->name) {
+		PRINTF1("[AVB] Please specify the ALSA capture device (--alsa option).\n");
+		return -1;
+	}
+
+	for (nsr = AVTP_AAF_NSR_8KHZ; avtp_aaf_nsr_rate(nsr); nsr++)
+		if (avtp_aaf_nsr_rate(nsr) == as->rate)
+			break;
+	if (!avtp_aaf_nsr_rate(nsr)) {
+		PRINTF1("[AVB] sample rate %d has no AAF nominal sample rate.\n",
+				as->rate);
+		return -1;
+	}
+
+	if (as->channels < 1) {
+		PRINTF1("[AVB] out of range channels=%d, specify greater than 0\n",
+				as->channels);
+		return -1;
+	}
+
+	if (as->period < 1) {
+		PRINTF1("[AVB] out of range alsa-period=%d, specify greater than 0\n",
+				as->period);
+		return -1;
+	}
+
+	/* a PDU per interval of MaxIntervalFrames */
+	intervals = cfg->SRclassIntervalFrames * cfg->MaxIntervalFrames;
+	if (as->rate % intervals) {
+		PRINTF1("[AVB] sample rate %d is not a multiple of %d PDUs per second.\n",
+				as->rate, intervals);
+		return -1;
+	}
+	as->frames = as->rate / intervals;
+	as->pdu_ns = NSEC_SCALE / intervals;
+	as->width = avtp_aaf_sample_size(aaf->format);
+
+	aaf->nsr = nsr;
+	aaf->channels = as->channels;
+	aaf->bit_depth = as->width * 8;
+
+	cfg->payload_size = as->frames * as->channels * as->width;
+
+	return 0;
+}
+
+/* open the comma separated capture files of --replay */
+static int config_parse_replay(struct app_config *cfg, char *list)
+{
+	struct replay_source *rp = &cfg->rp;
+	char *name, *save = NULL;
+
+	for (name = strtok_r(list, ",", &save); name;
+			name = strtok_r(NULL, ",", &save)) {
+		if (rp->nfiles >= REPLAY_FILES_MAX) {
+			PRINTF1("[AVB] too many capture files, up to %d\n",
+					REPLAY_FILES_MAX);
+			return -1;
+		}
+		rp->files[rp->nfiles] = pcap_reader_open(name);
+		if (!rp->files[rp->nfiles]) {
+			PRINTF1("[AVB] cannot open capture file %s.\n", name);
+			return -1;
+		}
+		rp->nfiles++;
+	}
+
+	cfg->replay = true;
+
+	return 0;
+}
+
+/* parse OLD=NEW of --remap (StreamID) or --remap-addr (MAC address) */
+static int config_parse_remap(struct app_config *cfg, char *str, bool addr)
+{
+	struct replay_source *rp = &cfg->rp;
+	struct replay_remap *r;
+	uint8_t *a, *b;
+	int *n;
+
+	n = (addr) ? &rp->naddrs : &rp->nstreams;
+	if (*n >= REPLAY_REMAP_MAX)
+		return -1;
+
+	r = (addr) ? &rp->addrs[*n] : &rp->streams[*n];
+	a = r->from;
+	b = r->to;
+
+	if (addr) {
+		if (sscanf(str, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx="
+				"%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+				&a[0], &a[1], &a[2], &a[3], &a[4], &a[5],
+				&b[0], &b[1], &b[2], &b[3], &b[4], &b[5]) != 12)
+			return -1;
+	} else {
+		if (sscanf(str, "%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx="
+				"%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx:%hhx",
+				&a[0], &a[1], &a[2], &a[3],
+				&a[4], &a[5], &a[6], &a[7],
+				&b[0], &b[1], &b[2], &b[3],
+				&b[4], &b[5], &b[6], &b[7]) != 16)
+			return -1;
+	}
+	(*n)++;
+
+	return 0;
+}
+
 static int config_parse(struct app_config *cfg, int argc, char **argv)
 {
 	int c, i, ret;
@@ -162,7 +550,9 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 	char *iname = NULL;
 	char *fname = NULL;
 	char *cname = NULL;
-	int header_size = AVTP_CVF_PAYLOAD_OFFSET - ETHOVERHEAD;
+	char *canname = NULL;
+	char *keyname = NULL;
+	int header_size;
 	clockid_t clkid;
 
 	config_init(cfg);
@@ -228,7 +618,127 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 			}
 			cfg->use_dest_addr = true;
 			break;
-		case 1:
+		case 't':
+			cfg->format = config_parse_format(optarg);
+			if (cfg->format < 0) {
+				PRINTF1("[AVB] unknown format %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_CRF_TYPE:
+			cfg->crf.type = config_parse_crf_type(optarg);
+			if (cfg->crf.type < 0) {
+				PRINTF1("[AVB] unknown CRF type %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_CRF_BASE_FREQ:
+			cfg->crf.base_frequency = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_CRF_PULL:
+			cfg->crf.pull = atoi(optarg);
+			break;
+		case OPT_CRF_TIMESTAMPS:
+			cfg->crf_timestamps = atoi(optarg);
+			break;
+		case OPT_CRF_INTERVAL:
+			cfg->crf.timestamp_interval = atoi(optarg);
+			break;
+		case OPT_CAN:
+			canname = strdup(optarg);
+			break;
+		case OPT_ACF_LATENCY:
+			cfg->acf.latency = atoi(optarg);
+			break;
+		case OPT_AEF_KEY:
+			keyname = strdup(optarg);
+			break;
+		case OPT_AEF_MODE:
+			cfg->aef_mode = aef_parse_mode(optarg);
+			if (cfg->aef_mode < 0) {
+				PRINTF1("[AVB] unknown AEF mode %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_AEF_KEY_ID:
+			cfg->aef_key_id = strtoul(optarg, NULL, 0);
+			break;
+		case OPT_CRC:
+			cfg->crc = true;
+			break;
+		case OPT_REPLAY:
+			if (config_parse_replay(cfg, optarg) < 0)
+				return -1;
+			break;
+		case OPT_REPLAY_ALIGN:
+			cfg->rp.align = true;
+			break;
+		case OPT_REMAP:
+		case OPT_REMAP_ADDR:
+			if (config_parse_remap(cfg, optarg,
+					c == OPT_REMAP_ADDR) < 0) {
+				PRINTF1("[AVB] invalid remap %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_UDP:
+			if (netif_parse_udp(optarg, AVTP_UDP_PORT,
+					    &cfg->udp_addr,
+					    &cfg->udp_addrlen) < 0) {
+				PRINTF1("[AVB] invalid UDP destination %s.\n",
+						optarg);
+				return -1;
+			}
+			cfg->udp = true;
+			break;
+		case OPT_UDP_OFFLOAD:
+			cfg->udp_offload = !!atoi(optarg);
+			break;
+		case OPT_SHM:
+			free(cfg->shm_name);
+			cfg->shm_name = strdup(optarg);
+			break;
+		case OPT_SHM_SLOTS:
+			cfg->shm_slots = atoi(optarg);
+			break;
+		case OPT_ALSA:
+			free(cfg->alsa.name);
+			cfg->alsa.name = strdup(optarg);
+			break;
+		case OPT_ALSA_PERIOD:
+			cfg->alsa.period = atoi(optarg);
+			break;
+		case OPT_RATE:
+			cfg->alsa.rate = atoi(optarg);
+			break;
+		case OPT_CHANNELS:
+			cfg->alsa.channels = atoi(optarg);
+			break;
+		case OPT_AAF_FORMAT:
+			cfg->aaf.format = config_parse_aaf_format(optarg);
+			if (cfg->aaf.format < 0) {
+				PRINTF1("[AVB] unknown AAF format %s.\n", optarg);
+				return -1;
+			}
+			break;
+		case OPT_UPGRADE_EXEC:
+			free(cfg->upgrade.path);
+			cfg->upgrade.path = strdup(optarg);
+			break;
+		case OPT_TAKEOVER:
+			cfg->upgrade.sock = atoi(optarg);
+			cfg->upgrade.takeover = true;
+			break;
+		case OPT_HEARTBEAT:
+		case OPT_STANDBY:
+			free(cfg->standby.name);
+			cfg->standby.name = strdup(optarg);
+			cfg->standby.passive = (c == OPT_STANDBY);
+			break;
+		case OPT_STANDBY_INTERVALS:
+			cfg->standby.intervals = atoi(optarg);
+			break;
+		case OPT_VERSION:
 			show_version(cfg);
 			exit(EXIT_SUCCESS);
 		case 'h':
@@ -238,17 +748,119 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		}
 	}
 
-	if (!fname) {
+	if (cfg->replay) {
+		if (fname || cfg->crc ||
+		    cfg->format != AVTP_SIMPLE_FORMAT_CVF) {
+			PRINTF1("[AVB] --replay sends the captured frames, without -f, -t and --crc.\n");
+			return -1;
+		}
+		if (cfg->msrp != MSRP_OFF) {
+			PRINTF1("[AVB] --replay carries the captured streams, use static MSRP (-m 0).\n");
+			return -1;
+		}
+	} else if (cfg->rp.align || cfg->rp.nstreams || cfg->rp.naddrs) {
+		PRINTF1("[AVB] --replay-align, --remap and --remap-addr require --replay.\n");
+		return -1;
+	}
+
+	if (cfg->shm_name) {
+		if (fname || cfg->replay ||
+		    (cfg->format != AVTP_SIMPLE_FORMAT_CVF &&
+		     cfg->format != AVTP_SIMPLE_FORMAT_AEF)) {
+			PRINTF1("[AVB] --shm replaces -f of cvf and aef, without --replay.\n");
+			return -1;
+		}
+		if (cfg->shm_slots <= 0 ||
+		    (cfg->shm_slots & (cfg->shm_slots - 1))) {
+			PRINTF1("[AVB] --shm-slots should be power of 2.\n");
+			return -1;
+		}
+	}
+
+	if (!cfg->replay && !fname && !cfg->shm_name &&
+	    (cfg->format == AVTP_SIMPLE_FORMAT_CVF ||
+	     cfg->format == AVTP_SIMPLE_FORMAT_AEF)) {
 		PRINTF1("[AVB] Please specify the file name (-f option).\n");
 		return -1;
 	}
 
+	if (cfg->format == AVTP_SIMPLE_FORMAT_CRF) {
+		if (config_check_crf(cfg) < 0)
+			return -1;
+	}
+
+	if (config_is_acf(cfg)) {
+		if (config_check_acf(cfg, canname) < 0)
+			return -1;
+		free(canname);
+	}
+
+	if (cfg->crc && cfg->format != AVTP_SIMPLE_FORMAT_CVF &&
+			cfg->format != AVTP_SIMPLE_FORMAT_AEF) {
+		PRINTF1("[AVB] CRC trailer is supported with cvf and aef.\n");
+		return -1;
+	}
+
+	if (cfg->format == AVTP_SIMPLE_FORMAT_AEF) {
+		if (!keyname) {
+			PRINTF1("[AVB] Please specify the key file (--aef-key option).\n");
+			return -1;
+		}
+		cfg->aef = aef_ctx_new(keyname, cfg->aef_mode,
+					cfg->aef_key_id, 1);
+		if (!cfg->aef) {
+			PRINTF1("[AVB] cannot setup AEF with %s.\n", keyname);
+			return -1;
+		}
+		free(keyname);
+
+		cfg->aef_lens = calloc(cfg->entrynum, sizeof(*cfg->aef_lens));
+		if (!cfg->aef_lens) {
+			PRINTF1("[AVB] cannot allocate AEF work buffer\n");
+			return -1;
+		}
+	}
+
 	if (cfg->MaxIntervalFrames < 1) {
 		PRINTF1("[AVB] out of range MaxIntervalFrames=%d, specify greater than 0\n",
 				cfg->MaxIntervalFrames);
 		return -1;
 	}
 
+	if (cfg->format == AVTP_SIMPLE_FORMAT_AAF) {
+		if (fname) {
+			PRINTF1("[AVB] aaf is captured by --alsa, without -f.\n");
+			return -1;
+		}
+		if (config_check_aaf(cfg) < 0)
+			return -1;
+	} else if (cfg->alsa.name) {
+		PRINTF1("[AVB] --alsa captures the audio of aaf (-t aaf).\n");
+		return -1;
+	}
+
+	if ((cfg->upgrade.path || cfg->upgrade.takeover) &&
+	    !config_can_upgrade(cfg)) {
+		PRINTF1("[AVB] hot upgrade hands over the stream of -f or crf, without aef.\n");
+		return -1;
+	}
+	cfg->upgrade.argv = argv;
+	if (!cfg->upgrade.path)
+		cfg->upgrade.path = strdup(argv[0]);
+
+	if (cfg->standby.name && !config_can_upgrade(cfg)) {
+		PRINTF1("[AVB] standby takes over the stream of -f or crf, without aef.\n");
+		return -1;
+	}
+	if (cfg->standby.intervals <= 0) {
+		PRINTF1("[AVB] out of range standby-intervals=%d\n",
+				cfg->standby.intervals);
+		return -1;
+	}
+	/* the new binary of a hot upgrade streams at once */
+	if (cfg->upgrade.takeover)
+		cfg->standby.passive = false;
+
 	if ((cfg->msrp < MSRP_OFF) || (cfg->msrp > MSRP_ON)) {
 		PRINTF1("[AVB] out of range msrp=%d, specify %d or %d\n",
 				cfg->msrp, MSRP_OFF, MSRP_ON);
@@ -269,7 +881,21 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		return -1;
 	}
 
+	if (cfg->udp && (cfg->msrp != MSRP_OFF ||
+			 cfg->waitmode != WAIT_MODE_POLL)) {
+		PRINTF1("[AVB] --udp has no stream reservation, use -m 0 and -w 0.\n");
+		return -1;
+	}
+
+	header_size = avtp_simple_payload_offset(cfg->format) - ETHOVERHEAD;
+	if (cfg->format == AVTP_SIMPLE_FORMAT_AEF)
+		header_size += aef_icv_size(cfg->aef_mode);
+	if (cfg->crc)
+		header_size += CRC32C_SIZE;
 	cfg->MaxFrameSize = header_size + cfg->payload_size;
+	if (cfg->format != AVTP_SIMPLE_FORMAT_CVF &&
+				cfg->MaxFrameSize < ETHFRAMEMTU_MIN)
+		cfg->MaxFrameSize = ETHFRAMEMTU_MIN; /* padded */
 	if ((cfg->MaxFrameSize < ETHFRAMEMTU_MIN) ||
 				(cfg->MaxFrameSize > ETHFRAMEMTU_MAX)) {
 		PRINTF1("[AVB] out of range the maximum size of a ethernet frame\n"
@@ -279,15 +905,27 @@ static int config_parse(struct app_config *cfg, int argc, char **argv)
 		return -1;
 	}
 
-	cfg->fd = config_parse_fname(fname);
-	if (cfg->fd < 0) {
-		PRINTF1("[AVB] cannot open file %s.\n", fname);
-		return -1;
+	if (fname) {
+		cfg->fd = config_parse_fname(fname);
+		if (cfg->fd < 0) {
+			PRINTF1("[AVB] cannot open file %s.\n", fname);
+			return -1;
+		}
+		free(fname);
+
+		/* the standby reads from the position of the talker */
+		if (cfg->standby.name && lseek(cfg->fd, 0, SEEK_CUR) < 0) {
+			PRINTF1("[AVB] standby needs a file to seek.\n");
+			return -1;
+		}
 	}
-	free(fname);
 
 	/* The MAC Address of ethernet is got and it uses for StreamID. */
-	{
+	if (cfg->udp && !iname) {
+		/* StreamID of the zero address unless -i is given */
+		strcpy(cfg->ifname, "udp");
+		cfg->speed = 1000;
+	} else {
 		if (!iname)
 			iname = strdup("eth0");
 
@@ -333,12 +971,13 @@ static void sigint_handler(int s)
 	sigint = true;
 }
 
-static int install_sighandler(int s, void (*handler)(int))
+static int install_sighandler(int s, void (*handler)(int), int flags)
 {
 	struct sigaction sa;
 
 	memset(&sa, 0, sizeof(sa));
 	sa.sa_handler = handler;
+	sa.sa_flags = flags;
 	sigemptyset(&sa.sa_mask);
 	sigaddset(&sa.sa_mask, SIGQUIT);
 
@@ -404,31 +1043,35 @@ static int talker_calccbsinfo(struct app_config *cfg, struct eavb_cbsparam *cbs)
 /*
  * eavb device
  */
-static struct eavb_device *eavb_device_new_for_talker
-					(struct app_config *cfg, int id)
+/* Calculate CBS parameter and set Tx param */
+static int talker_reserve(struct app_config *cfg, struct eavb_device *dev)
 {
-	struct eavb_device *dev;
+	struct eavb_txparam txparam;
 	int ret;
-	char template[2048];
-	int len;
-	char *name;
 
-	if (cfg->SRclassID == MSRP_SR_CLASS_A)
-		name = "/dev/avb_tx1";
-	else
-		name = "/dev/avb_tx0";
+	memset(&txparam, 0, sizeof(txparam));
 
-	dev = eavb_device_new(name, cfg->entrynum, O_RDWR);
-	if (!dev)
-		return NULL;
+	ret = talker_calccbsinfo(cfg, &txparam.cbs);
+	if (ret < 0)
+		return ret;
 
-	if (cfg->waitmode == WAIT_MODE_BLOCK_WAITALL) {
-		ret = eavb_set_optblockmode(dev->fd, EAVB_BLOCK_WAITALL);
-		if (ret < 0)
-			goto error;
-	}
+	/* no credit based shaper in the network stack */
+	if (cfg->udp)
+		return 0;
+
+	return eavb_set_txparam(dev->fd, &txparam);
+}
+
+/*
+ * set StreamID and destination address of dev, and build the frame
+ * template in template, returns the length of the frame
+ */
+static int talker_frame_template(struct app_config *cfg,
+				 struct eavb_device *dev, int id,
+				 char *template)
+{
+	int len;
 
-	/* set StreamID and destination address  */
 	memcpy(dev->StreamID, cfg->source_addr, ETH_ALEN);
 	dev->StreamID[6] = (id & 0xff00) >> 8;
 	dev->StreamID[7] = (id & 0x00ff);
@@ -445,15 +1088,57 @@ static struct eavb_device *eavb_device_new_for_talker
 		param.SRpriority = cfg->SRpriority;
 		param.SRvid = cfg->SRvid;
 		param.payload_size = cfg->payload_size;
+		param.format = cfg->format;
+		param.crf = cfg->crf;
+		param.aaf = cfg->aaf;
 
 		len = avtp_simple_header_build(template, &param);
+		if (cfg->format == AVTP_SIMPLE_FORMAT_AEF)
+			len += aef_icv_size(cfg->aef_mode);
+		if (cfg->crc)
+			len += CRC32C_SIZE;
+		if (len < ETHFRAMELEN_MIN && cfg->format != AVTP_SIMPLE_FORMAT_CVF)
+			len = ETHFRAMELEN_MIN; /* padded by zero */
+
+		/* replay reserves the bandwidth measured in the captures */
+		if (!cfg->replay)
+			cfg->MaxFrameSize = (len < ETHFRAMELEN_MIN) ?
+					ETHFRAMEMTU_MIN : len - ETHOVERHEAD;
+	}
+
+	return len;
+}
+
+static struct eavb_device *eavb_device_new_for_talker
+					(struct app_config *cfg, int id)
+{
+	struct eavb_device *dev;
+	int ret;
+	char template[2048];
+	int len;
+	char *name;
+
+	if (cfg->SRclassID == MSRP_SR_CLASS_A)
+		name = "/dev/avb_tx1";
+	else
+		name = "/dev/avb_tx0";
+
+	if (cfg->udp)
+		dev = eavb_device_new_udp(&cfg->udp_addr, cfg->udp_addrlen,
+					  cfg->entrynum, true, cfg->udp_offload);
+	else
+		dev = eavb_device_new(name, cfg->entrynum, O_RDWR);
+	if (!dev)
+		return NULL;
 
-		if (len < ETHFRAMELEN_MIN)
-			cfg->MaxFrameSize = ETHFRAMEMTU_MIN;
-		else
-			cfg->MaxFrameSize = len - ETHOVERHEAD;
+	if (cfg->waitmode == WAIT_MODE_BLOCK_WAITALL) {
+		ret = eavb_set_optblockmode(dev->fd, EAVB_BLOCK_WAITALL);
+		if (ret < 0)
+			goto error;
 	}
 
+	len = talker_frame_template(cfg, dev, id, template);
+
 	/* allocate ether frame buffer and prepare hader */
 	{
 		int i;
@@ -464,9 +1149,10 @@ static struct eavb_device *eavb_device_new_for_talker
 		for (i = 0, e = dev->entrybuf, p = dev->framebuf;
 				i < dev->entrynum;
 				i++, e++, p++) {
-			ret = eavb_dma_malloc_page(dev->fd, p);
+			ret = eavb_device_alloc_page(dev, p);
 			if (ret < 0)
 				goto error;
+			dev->frames[i] = p->dma_vaddr;
 			evec = &e->vec[0];
 			evec->base = p->dma_paddr;
 			evec->len = len;
@@ -474,212 +1160,1875 @@ static struct eavb_device *eavb_device_new_for_talker
 		}
 	}
 
-	/* Calculate CBS parameter and set Tx param */
-	{
-		struct eavb_txparam txparam;
-
-		memset(&txparam, 0, sizeof(txparam));
-
-		ret = talker_calccbsinfo(cfg, &txparam.cbs);
+	/*
+	 * The queue of a standby is not reserved while the talker it
+	 * watches still streams, the bandwidth would be counted twice.
+	 */
+	if (!cfg->standby.passive) {
+		ret = talker_reserve(cfg, dev);
 		if (ret < 0)
 			goto error;
+	}
 
-		ret = eavb_set_txparam(dev->fd, &txparam);
-		if (ret < 0)
-			goto error;
+	return dev; /* Success */
+
+error:
+	eavb_device_free(dev);
+
+	return NULL;
+}
+
+/* stamp the AVTP header of count frames from p, across the ring end */
+static void talker_stamp(struct app_config *cfg, int p, int count,
+			 uint8_t seq, uint32_t ts, uint32_t delta_ts,
+			 uint16_t len)
+{
+	void **frames = cfg->device->frames;
+	int n;
+
+	n = cfg->entrynum - p;
+	if (n > count)
+		n = count;
+
+	stamp_avtp_stream_batch(frames + p, n, seq, ts, delta_ts, len);
+	stamp_avtp_stream_batch(frames, count - n, seq + n,
+				ts + n * delta_ts, delta_ts, len);
+}
+
+/* encrypt the frames prepared by talker_process */
+static int talker_encrypt(struct app_config *cfg, int p, int count)
+{
+	struct eavb_device *dev;
+	struct eavb_entry *e;
+	int *lens = cfg->aef_lens;
+	int i, n;
+
+	dev = cfg->device;
+
+	n = cfg->entrynum - p;
+	if (n > count)
+		n = count;
+
+	if (aef_encrypt_batch(cfg->aef, dev->frames + p, lens, n) < 0 ||
+	    aef_encrypt_batch(cfg->aef, dev->frames, lens + n, count - n) < 0) {
+		PRINTF1("[AVB] error : AEF encryption\n");
+		return -1;
+	}
+
+	for (i = 0; i < count; i++) {
+		e = dev->entrybuf + (((p + i) % cfg->entrynum) * sizeof(*e));
+		e->vec[0].len = lens[i];
+	}
+
+	return 0;
+}
+
+/*
+ * append CRC32C of the stream data to the frames prepared by
+ * talker_process, the trailer is not counted in stream_data_length.
+ */
+static void talker_append_crc(struct app_config *cfg, int p, int count)
+{
+	struct eavb_device *dev;
+	struct eavb_entry *e;
+	void *packet, *data;
+	uint32_t crc;
+	int i, len;
+
+	dev = cfg->device;
+
+	for (i = 0; i < count; i++) {
+		e = dev->entrybuf + (((p + i) % cfg->entrynum) * sizeof(*e));
+		packet = dev->frames[(p + i) % cfg->entrynum];
+
+		len = get_avtp_stream_data_length(packet);
+		data = packet + AVTP_PAYLOAD_OFFSET;
+
+		crc = htonl(crc32c(0, data, len));
+		memcpy(data + len, &crc, CRC32C_SIZE);
+
+		e->vec[0].len = AVTP_PAYLOAD_OFFSET + len + CRC32C_SIZE;
+	}
+}
+
+static int talker_process(struct app_config *cfg, int p, int count)
+{
+	struct eavb_device *dev;
+	int read_size, hlen, payload_size;
+	int i;
+	uint32_t time_stamp, delta_ts, classIntervalFrames;
+	uint64_t t;
+
+	struct eavb_dma_alloc *dma;
+	struct eavb_entry *e;
+	struct eavb_entryvec *evec;
+	struct iovec *iov;
+	void *packet = NULL;
+	void *payload;
+
+	/* get current timestamp */
+	t = clock_getcount(cfg->clkid);
+	time_stamp = (uint32_t)t + TSOFFSET * 1000;
+
+	PRINTF3("[AVB] talker proc entry num of %d (timestamp:%u)\n",
+							count, time_stamp);
+
+	classIntervalFrames = cfg->SRclassIntervalFrames;
+	delta_ts = NSEC_SCALE / (classIntervalFrames * cfg->MaxIntervalFrames);
+
+	hlen = avtp_simple_payload_offset(cfg->format);
+	payload_size = cfg->payload_size;
+
+	dev = cfg->device;
+
+	/* the frames read ahead by the standby go first */
+	if (cfg->standby.prefilled && count > cfg->standby.prefilled)
+		count = cfg->standby.prefilled;
+
+	iov = calloc(count, sizeof(*iov));
+	if (!iov) {
+		PRINTF("[AVB] cannot allocate iovec\n");
+		read_end = true;
+		return count;
+	}
+
+	talker_stamp(cfg, dev->p, count, cfg->seqnum, time_stamp, delta_ts,
+			payload_size);
+
+	for (i = 0; i < count; i++) {
+		e = dev->entrybuf + (dev->p * sizeof(*e));
+		evec = &e->vec[0];
+		packet = dev->frames[dev->p];
+		payload = packet + hlen;
+
+		iov[i].iov_base = payload;
+		iov[i].iov_len = payload_size;
+
+		evec->len = hlen + payload_size;
+		dev->p = (dev->p + 1) % cfg->entrynum;
+	}
+
+	if (cfg->standby.prefilled) {
+		read_size = count * payload_size;
+		cfg->standby.prefilled -= count;
+	} else {
+		read_size = readv(cfg->fd, iov, count);
+	}
+	if (read_size < 0) {
+		PRINTF1("[AVB] error : File read\n");
+		read_end = true;
+	} else if (read_size == 0) {
+		PRINTF2("[AVB] File read end.\n");
+		count = 0;
+		read_end = true;
+	} else if (read_size < payload_size * count) {
+		i = read_size / payload_size;
+		payload_size = read_size % payload_size;
+		dev->p = (dev->p + i + cfg->entrynum - count) % cfg->entrynum;
+		if (payload_size != 0) {
+			dma = (dev->framebuf + (dev->p * sizeof(*dma)));
+			e = dev->entrybuf + (dev->p * sizeof(*e));
+			evec = &e->vec[0];
+			packet = dma->dma_vaddr;
+			set_avtp_stream_data_length(packet, payload_size);
+			evec->len = hlen + payload_size;
+			dev->p = (dev->p + 1) % cfg->entrynum;
+			count = i + 1;
+		} else {
+			count = i;
+		}
+	}
+
+	free(iov);
+
+	/* only the frames read are sent, a short read keeps the sequence */
+	cfg->seqnum += count;
+	if (read_size > 0)
+		cfg->standby.pos += read_size;
+
+	if (cfg->aef && count > 0) {
+		if (talker_encrypt(cfg, p, count) < 0) {
+			read_end = true;
+			count = 0;
+		}
+	}
+
+	if (cfg->crc && count > 0)
+		talker_append_crc(cfg, p, count);
+
+	return count;
+}
+
+/*
+ * CRF media clock
+ */
+static void crf_timeline_init(struct app_config *cfg, uint64_t start)
+{
+	static const struct {
+		uint64_t num;
+		uint64_t den;
+	} pull_table[] = {
+		[AVTP_CRF_PULL_1_0]    = { 1, 1 },
+		[AVTP_CRF_PULL_1_1001] = { 1000, 1001 },
+		[AVTP_CRF_PULL_1001]   = { 1001, 1000 },
+		[AVTP_CRF_PULL_24_25]  = { 24, 25 },
+		[AVTP_CRF_PULL_25_24]  = { 25, 24 },
+		[AVTP_CRF_PULL_1_8]    = { 1, 8 },
+	};
+	struct crf_timeline *tl = &cfg->crf_timeline;
+	uint64_t num;
+
+	/* interval[events] / (base_frequency * pull)[events/sec] */
+	num = (uint64_t)cfg->crf.timestamp_interval * NSEC_SCALE *
+					pull_table[cfg->crf.pull].den;
+	tl->den = (uint64_t)cfg->crf.base_frequency *
+					pull_table[cfg->crf.pull].num;
+	tl->step = num / tl->den;
+	tl->rem_step = num % tl->den;
+	tl->rem = 0;
+	tl->next = start;
+}
+
+static uint64_t crf_timeline_next(struct crf_timeline *tl)
+{
+	uint64_t t = tl->next;
+
+	tl->next += tl->step;
+	tl->rem += tl->rem_step;
+	if (tl->rem >= tl->den) {
+		tl->rem -= tl->den;
+		tl->next++;
+	}
+
+	return t;
+}
+
+/* prepare one CRF PDU, return the time when the PDU can be sent */
+static uint64_t crf_process(struct app_config *cfg)
+{
+	struct eavb_device *dev;
+	struct eavb_dma_alloc *dma;
+	void *packet;
+	uint64_t t = 0;
+	int i;
+
+	dev = cfg->device;
+
+	dma = (dev->framebuf + (dev->p * sizeof(*dma)));
+	packet = dma->dma_vaddr;
+
+	set_avtp_sequence_num(packet, cfg->seqnum++);
+
+	for (i = 0; i < cfg->crf_timestamps; i++) {
+		t = crf_timeline_next(&cfg->crf_timeline);
+		set_avtp_crf_timestamp(packet, i, t + TSOFFSET * 1000);
+	}
+
+	dev->p = (dev->p + 1) % cfg->entrynum;
+
+	return t;
+}
+
+/*
+ * ACF CAN tunneling
+ */
+/* bytes on the wire for the frame, including preamble, CRC and IFG */
+static inline int wire_size(int len)
+{
+	if (len < ETHFRAMELEN_MIN)
+		len = ETHFRAMELEN_MIN;
+
+	return len + ETHOVERHEAD_IFG - ETHOVERHEAD;
+}
+
+/* wait and read a CAN frame until the deadline (CLOCK_MONOTONIC) */
+static int acf_read_frame(struct app_config *cfg, uint64_t deadline)
+{
+	struct acf_source *acf = &cfg->acf;
+	struct pollfd pfd;
+	struct timespec ts;
+	uint64_t now, wait;
+	int ret;
+
+	if (deadline) {
+		now = clock_getcount(CLOCK_MONOTONIC);
+		wait = (deadline > now) ? deadline - now : 0;
+	} else {
+		wait = (uint64_t)WAIT_TIME_PROCESS * 1000000;
+	}
+	ts.tv_sec = wait / NSEC_SCALE;
+	ts.tv_nsec = wait % NSEC_SCALE;
+
+	pfd.fd = acf->fd;
+	pfd.events = POLLIN;
+
+	ret = ppoll(&pfd, 1, &ts, NULL);
+	if (ret < 0)
+		return (errno == EINTR) ? 0 : -1;
+	if (!ret)
+		return 0;
+
+	if (acf_can_read(acf->fd, &acf->frame, &acf->fdf) < 0) {
+		PRINTF1("[AVB] error : CAN read\n");
+		return 0;
+	}
+	acf->time = clock_getcount(cfg->clkid);
+	acf->pending = true;
+
+	return 1;
+}
+
+/* pack CAN frames into one ACF PDU, return number of packed frames */
+static int acf_process(struct app_config *cfg)
+{
+	struct eavb_device *dev;
+	struct acf_source *acf = &cfg->acf;
+	struct eavb_dma_alloc *dma;
+	struct eavb_entry *e;
+	struct eavb_entryvec *evec;
+	void *packet, *payload;
+	uint64_t deadline = 0, first = 0;
+	bool brief;
+	int hlen, len, size, n, ret;
+
+	dev = cfg->device;
+
+	dma = (dev->framebuf + (dev->p * sizeof(*dma)));
+	e = dev->entrybuf + (dev->p * sizeof(*e));
+	evec = &e->vec[0];
+	packet = dma->dma_vaddr;
+
+	/* NTSCF carries no timestamp, so use the brief CAN message */
+	brief = (cfg->format == AVTP_SIMPLE_FORMAT_NTSCF);
+	hlen = avtp_simple_payload_offset(cfg->format);
+	payload = packet + hlen;
+
+	for (len = 0, n = 0; len < cfg->payload_size; ) {
+		if (!acf->pending) {
+			ret = acf_read_frame(cfg, deadline);
+			if (ret < 0)
+				return -1;
+			if (!ret)
+				break;
+		}
+
+		size = acf_can_msg_size(&acf->frame, brief);
+		if (len + size > cfg->payload_size)
+			break; /* leave it to the next PDU */
+
+		acf_can_pack(payload + len, &acf->frame, acf->fdf,
+				brief, acf->time);
+		acf->pending = false;
+		acf->wire_bytes_single += wire_size(hlen + size);
+
+		if (!n++) {
+			first = acf->time;
+			deadline = clock_getcount(CLOCK_MONOTONIC) +
+					(uint64_t)acf->latency * 1000;
+		}
+		len += size;
+
+		if (!acf->latency)
+			break;
+	}
+
+	if (!n)
+		return 0;
+
+	if (brief) {
+		set_avtp_ntscf_sequence_num(packet, cfg->seqnum++);
+		set_avtp_ntscf_data_length(packet, len);
+	} else {
+		set_avtp_sequence_num(packet, cfg->seqnum++);
+		set_avtp_timestamp(packet, (uint32_t)first + TSOFFSET * 1000);
+		set_avtp_stream_data_length(packet, len);
+	}
+
+	len += hlen;
+	if (len < ETHFRAMELEN_MIN) {
+		memset(packet + len, 0, ETHFRAMELEN_MIN - len);
+		len = ETHFRAMELEN_MIN;
+	}
+	evec->len = len;
+
+	acf->frames += n;
+	acf->pdus++;
+	acf->wire_bytes += wire_size(len);
+
+	dev->p = (dev->p + 1) % cfg->entrynum;
+
+	return n;
+}
+
+/*
+ * MSRP
+ */
+static void talker_msrp_property(struct app_config *cfg,
+				 struct eavb_device *dev,
+				 struct mrp_property *prop)
+{
+	int i;
+
+	memset(prop, 0, sizeof(*prop));
+
+	for (i = 0; i < 8; i++) {
+		prop->streamid = (prop->streamid << 8) +
+			dev->StreamID[i];
+	}
+	for (i = 0; i < 6; i++) {
+		prop->destaddr = (prop->destaddr << 8) +
+			dev->dest_addr[i];
+	}
+	prop->verbose  = DEBUG_LEVEL;
+	prop->vlan     = cfg->SRvid;
+	prop->MaxFrameSize = cfg->MaxFrameSize;
+	prop->MaxIntervalFrames = cfg->MaxIntervalFrames;
+	prop->priority = cfg->SRpriority;
+	prop->rank     = cfg->SRrank;
+	prop->latency  = LATENCY_TIME_MSRP;
+	prop->class    = cfg->SRclassID;
+}
+
+/*
+ * hot upgrade
+ */
+static bool upgrade_request;
+static void upgrade_handler(int s)
+{
+	upgrade_request = true;
+}
+
+static void upgrade_abort(struct app_config *cfg)
+{
+	struct talker_upgrade *up = &cfg->upgrade;
+
+	close(up->sock);
+	up->sock = -1;
+	waitpid(up->pid, NULL, WNOHANG);
+}
+
+/* run the new binary and hand it the pages and the fds */
+static int upgrade_start(struct app_config *cfg, struct msrp_ctx *ctx)
+{
+	struct talker_upgrade *up = &cfg->upgrade;
+	struct eavb_device *dev = cfg->device;
+	struct upgrade_prepare *msg;
+	int fds[UPGRADE_FDS];
+	char **argv;
+	ssize_t len;
+	int i, n, ret = -1;
+
+	len = eavb_device_export_pages(dev, NULL, 0, fds);
+	if (len < 0)
+		return -1;
+
+	msg = calloc(1, sizeof(*msg) + len);
+	if (!msg)
+		return -1;
+
+	msg->version = UPGRADE_VERSION;
+	msg->pid = getpid();
+	memcpy(msg->StreamID, dev->StreamID, AVTP_STREAMID_SIZE);
+	memcpy(msg->dest_addr, dev->dest_addr, ETH_ALEN);
+	msg->format = cfg->format;
+	msg->entrynum = cfg->entrynum;
+	msg->payload_size = cfg->payload_size;
+	msg->msrp = cfg->msrp;
+	eavb_device_export_pages(dev, msg->pages, len, fds);
+	fds[UPGRADE_FD_FILE] = (cfg->fd > 2) ? cfg->fd : -1;
+	fds[UPGRADE_FD_MRPD] = (ctx) ? ctx->mrpd_sock : -1;
+
+	/* the arguments of this process, without its own --takeover */
+	for (n = 0; up->argv[n]; n++)
+		;
+	argv = calloc(n + 1, sizeof(*argv));
+	if (!argv)
+		goto out;
+	for (i = 0, n = 0; up->argv[i]; i++) {
+		if (!strcmp(up->argv[i], "--takeover")) {
+			/* --takeover FD */
+			if (up->argv[i + 1])
+				i++;
+			continue;
+		}
+		if (!strncmp(up->argv[i], "--takeover=", 11))
+			continue;
+		argv[n++] = up->argv[i];
+	}
+
+	up->pid = handoff_spawn(up->path, argv, "--takeover", &up->sock);
+	free(argv);
+	if (up->pid < 0)
+		goto out;
+	up->started = clock_getcount(cfg->clkid);
+
+	if (handoff_send(up->sock, UPGRADE_PREPARE, msg, sizeof(*msg) + len,
+			 fds, UPGRADE_FDS) < 0) {
+		upgrade_abort(cfg);
+		goto out;
+	}
+
+	PRINTF1("[AVB] upgrade: started %s as pid %d.\n", up->path, up->pid);
+	ret = 0;
+
+out:
+	free(msg);
+
+	return ret;
+}
+
+/* stop here and hand the entries and the stream state over */
+static int upgrade_commit(struct app_config *cfg, struct msrp_ctx *ctx,
+			  uint64_t framenums)
+{
+	struct talker_upgrade *up = &cfg->upgrade;
+	struct eavb_device *dev = cfg->device;
+	struct shm_heartbeat *hb = cfg->standby.hb;
+	struct upgrade_commit *msg;
+	ssize_t len;
+	int ret = 0;
+
+	/* the new process beats from the commit, or a standby has the stream */
+	if (hb && shm_heartbeat_handover(hb, up->pid) < 0) {
+		upgrade_abort(cfg);
+		return 0;
+	}
+
+	len = eavb_device_export_ring(dev, NULL, 0);
+	msg = calloc(1, sizeof(*msg) + len);
+	if (!msg) {
+		if (hb)
+			shm_heartbeat_takeover(hb, up->pid);
+		upgrade_abort(cfg);
+		return 0;
+	}
+
+	msg->time = clock_getcount(cfg->clkid);
+	msg->pos = cfg->standby.pos;
+	msg->seqnum = cfg->seqnum;
+	msg->framenums = framenums;
+	msg->crf_timeline = cfg->crf_timeline;
+	eavb_device_export_ring(dev, msg->ring, len);
+
+	/*
+	 * The socket of mrpd is shared with the new process since the
+	 * prepare. Stop reading it before the new process starts to, and
+	 * hand over the listeners known until then.
+	 */
+	if (ctx) {
+		msrp_ctx_detach(ctx);
+		memcpy(msg->listeners, ctx->devices, sizeof(msg->listeners));
+	}
+
+	if (handoff_send(up->sock, UPGRADE_COMMIT, msg, sizeof(*msg) + len,
+			 NULL, 0) < 0) {
+		PRINTF1("[AVB] upgrade: pid %d has gone, keep streaming.\n",
+				up->pid);
+		if (ctx && msrp_ctx_resume(ctx) < 0)
+			PRINTF("[AVB] upgrade: cannot monitor mrpd again.\n");
+		if (hb)
+			shm_heartbeat_takeover(hb, up->pid);
+		upgrade_abort(cfg);
+		goto out;
+	}
+
+	/* mrpd keeps the registration for the new process */
+	PRINTF1("[AVB] upgrade: handed over to pid %d at sequence_num %u, %d frames queued.\n",
+			up->pid, (uint8_t)cfg->seqnum, dev->filled);
+
+	close(up->sock);
+	up->sock = -1;
+	up->done = true;
+	ret = 1;
+
+out:
+	free(msg);
+
+	return ret;
+}
+
+/*
+ * Called by the loops between two pushes, framenums is the number of
+ * frames left to send, 0 for infinite. Returns 1 when the stream is
+ * handed over and the loop has to end at once.
+ */
+static int upgrade_poll(struct app_config *cfg, struct msrp_ctx *ctx,
+			uint64_t framenums)
+{
+	struct talker_upgrade *up = &cfg->upgrade;
+	uint32_t type;
+	ssize_t ret;
+
+	if (upgrade_request) {
+		upgrade_request = false;
+		if (up->sock >= 0)
+			PRINTF1("[AVB] upgrade: in progress already.\n");
+		else if (upgrade_start(cfg, ctx) < 0)
+			PRINTF1("[AVB] upgrade: cannot start %s.\n", up->path);
+	}
+
+	if (up->sock < 0)
+		return 0;
+
+	ret = handoff_recv(up->sock, &type, NULL, 0, NULL, 0, 0);
+	if (ret == -EAGAIN) {
+		if (clock_getcount(cfg->clkid) - up->started >
+				(uint64_t)UPGRADE_TIMEOUT * 1000000) {
+			PRINTF1("[AVB] upgrade: pid %d did not arm, keep streaming.\n",
+					up->pid);
+			upgrade_abort(cfg);
+		}
+		return 0;
+	}
+	if (ret < 0 || type != UPGRADE_ARMED) {
+		PRINTF1("[AVB] upgrade: pid %d failed, keep streaming.\n",
+				up->pid);
+		upgrade_abort(cfg);
+		return 0;
+	}
+
+	return upgrade_commit(cfg, ctx, framenums);
+}
+
+/* the new process, continue the stream of the talker at --takeover */
+static int talker_takeover(struct app_config *cfg, struct msrp_ctx **ctx)
+{
+	struct talker_upgrade *up = &cfg->upgrade;
+	struct upgrade_prepare *prep;
+	struct upgrade_commit *commit;
+	struct eavb_device *dev;
+	struct mrp_property prop;
+	char template[2048];
+	int fds[UPGRADE_FDS];
+	uint64_t took, interval;
+	uint32_t type;
+	ssize_t len;
+	pid_t pid;
+	int mrpd;
+	int ret = -1;
+
+	prep = malloc(UPGRADE_MSG_SIZE);
+	if (!prep)
+		return -1;
+
+	len = handoff_recv(up->sock, &type, prep, UPGRADE_MSG_SIZE,
+			   fds, UPGRADE_FDS, UPGRADE_TIMEOUT);
+	if (len < (ssize_t)sizeof(*prep) || type != UPGRADE_PREPARE ||
+	    prep->version != UPGRADE_VERSION) {
+		PRINTF1("[AVB] takeover: no state from the running talker.\n");
+		if (len >= 0) {
+			close(fds[UPGRADE_FD_FILE]);
+			close(fds[UPGRADE_FD_MRPD]);
+			eavb_device_free(eavb_device_import_pages(NULL, 0, fds));
+		}
+		goto out;
+	}
+	pid = prep->pid;
+	mrpd = fds[UPGRADE_FD_MRPD];
+
+	/* the device fds belong to the device from here */
+	dev = eavb_device_import_pages(prep->pages, len - sizeof(*prep), fds);
+	if (!dev) {
+		close(fds[UPGRADE_FD_FILE]);
+		close(mrpd);
+		goto out;
+	}
+	cfg->device = dev;
+	talker_frame_template(cfg, dev, cfg->uid, template);
+
+	if (memcmp(prep->StreamID, dev->StreamID, AVTP_STREAMID_SIZE) ||
+	    memcmp(prep->dest_addr, dev->dest_addr, ETH_ALEN) ||
+	    prep->format != cfg->format || prep->entrynum != cfg->entrynum ||
+	    prep->payload_size != cfg->payload_size ||
+	    prep->msrp != cfg->msrp) {
+		PRINTF1("[AVB] takeover: the configuration differs from pid %d.\n",
+				pid);
+		close(fds[UPGRADE_FD_FILE]);
+		close(mrpd);
+		goto out;
+	}
+
+	/* the file position is shared with the running talker */
+	if (fds[UPGRADE_FD_FILE] >= 0) {
+		if (cfg->fd > 2)
+			close(cfg->fd);
+		cfg->fd = fds[UPGRADE_FD_FILE];
+	}
+
+	if (handoff_send(up->sock, UPGRADE_ARMED, NULL, 0, NULL, 0) < 0) {
+		close(mrpd);
+		goto out;
+	}
+
+	commit = (struct upgrade_commit *)prep;
+	len = handoff_recv(up->sock, &type, commit, UPGRADE_MSG_SIZE,
+			   NULL, 0, UPGRADE_TIMEOUT);
+	if (len < (ssize_t)sizeof(*commit) || type != UPGRADE_COMMIT ||
+	    eavb_device_import_ring(dev, commit->ring,
+				    len - sizeof(*commit)) < 0) {
+		PRINTF1("[AVB] takeover: pid %d did not hand over.\n", pid);
+		close(mrpd);
+		goto out;
+	}
+
+	cfg->standby.pos = commit->pos;
+	cfg->seqnum = commit->seqnum;
+	cfg->framenums = commit->framenums;
+	cfg->crf_timeline = commit->crf_timeline;
+
+	if (cfg->msrp) {
+		talker_msrp_property(cfg, dev, &prop);
+		*ctx = msrp_ctx_attach(&prop, mrpd, commit->listeners);
+		if (!*ctx) {
+			close(mrpd);
+			goto out;
+		}
+	}
+
+	took = clock_getcount(cfg->clkid) - commit->time;
+	interval = NSEC_SCALE / cfg->SRclassIntervalFrames;
+	PRINTF1("[AVB] took over from pid %d in %"PRIu64"us (%.2f class intervals), %d frames queued.\n",
+			pid, took / 1000, (double)took / interval, dev->filled);
+
+	/* catch up the declarations the old process has seen last */
+	if (*ctx && msrp_query_database(*ctx) < 0)
+		PRINTF("[AVB] failed to query MSRP register database.\n");
+
+	ret = 0;
+
+out:
+	close(up->sock);
+	up->sock = -1;
+	free(prep);
+
+	return ret;
+}
+
+/*
+ * hot standby
+ */
+/* 1 when a standby has taken the stream over, checked before a push */
+static int standby_taken(struct app_config *cfg)
+{
+	struct talker_standby *sb = &cfg->standby;
+
+	if (!sb->hb || shm_heartbeat_owned(sb->hb))
+		return 0;
+
+	PRINTF1("[AVB] standby: pid %d has taken the stream over.\n",
+			shm_heartbeat_owner(sb->hb));
+	sb->passive = true;
+
+	return 1;
+}
+
+/* publish the state after the frames pushed, 1 when the stream is taken */
+static int standby_beat(struct app_config *cfg, uint64_t framenums,
+			uint64_t due)
+{
+	struct talker_standby *sb = &cfg->standby;
+	struct standby_state st;
+	uint64_t now, took, interval;
+
+	if (!sb->hb)
+		return 0;
+
+	memset(&st, 0, sizeof(st));
+	st.pos = sb->pos;
+	st.seqnum = cfg->seqnum;
+	st.framenums = framenums;
+	st.crf_timeline = cfg->crf_timeline;
+
+	now = clock_getcount(cfg->clkid);
+	if (shm_heartbeat_beat(sb->hb, now, due ? due : now, &st) < 0)
+		return standby_taken(cfg);
+
+	/*
+	 * The first beat after the first push of the standby. The push is
+	 * behind the schedule by the time the talker was due to beat.
+	 */
+	if (sb->took && cfg->seqnum != sb->took_seqnum) {
+		interval = NSEC_SCALE / cfg->SRclassIntervalFrames;
+		took = (now > sb->due) ? now - sb->due : 0;
+		PRINTF1("[AVB] standby: took over from pid %d at sequence_num %u, detected %"PRIu64"us after its last heartbeat, first push %"PRIu64"us (%.2f class intervals) behind the schedule.\n",
+				sb->from, (uint8_t)sb->took_seqnum,
+				(sb->took - sb->last) / 1000, took / 1000,
+				(double)took / interval);
+		sb->took = 0;
+	}
+
+	return 0;
+}
+
+static void standby_stop(struct app_config *cfg)
+{
+	if (cfg->standby.hb)
+		shm_heartbeat_stop(cfg->standby.hb);
+}
+
+/* read ahead the frames from pos into the entries, keeping those read */
+static void standby_prefill(struct app_config *cfg, uint64_t pos)
+{
+	struct talker_standby *sb = &cfg->standby;
+	struct eavb_device *dev = cfg->device;
+	int payload_size = cfg->payload_size;
+	int hlen, slot, n, i;
+	ssize_t ret;
+
+	if (cfg->fd <= 2)
+		return;
+
+	if (pos >= sb->pos && !((pos - sb->pos) % payload_size) &&
+	    (pos - sb->pos) / payload_size <= (uint64_t)sb->prefilled)
+		n = (pos - sb->pos) / payload_size;
+	else
+		n = sb->prefilled;
+	sb->slot = (sb->slot + n) % cfg->entrynum;
+	sb->prefilled -= n;
+	sb->pos = pos;
+
+	hlen = avtp_simple_payload_offset(cfg->format);
+	while (sb->prefilled < cfg->entrynum) {
+		slot = (sb->slot + sb->prefilled) % cfg->entrynum;
+		n = cfg->entrynum - sb->prefilled;
+		if (n > cfg->entrynum - slot)
+			n = cfg->entrynum - slot;
+
+		for (i = 0; i < n; i++) {
+			sb->iov[i].iov_base = dev->frames[slot + i] + hlen;
+			sb->iov[i].iov_len = payload_size;
+		}
+
+		ret = preadv(cfg->fd, sb->iov, n,
+			     pos + (off_t)sb->prefilled * payload_size);
+		if (ret <= 0)
+			break;
+		sb->prefilled += ret / payload_size;
+		if (ret < (ssize_t)n * payload_size)
+			break;
+	}
+}
+
+/*
+ * Follow the heartbeat until the talker stops. Returns 1 when the stream
+ * is taken over, 0 when the talker has ended it or on SIGINT.
+ */
+static int standby_wait(struct app_config *cfg)
+{
+	struct talker_standby *sb = &cfg->standby;
+	struct eavb_device *dev = cfg->device;
+	struct standby_state st, last;
+	uint64_t interval, limit, now;
+	uint64_t time = 0, due = 0;
+	bool valid = false;
+	pid_t owner;
+
+	interval = NSEC_SCALE / cfg->SRclassIntervalFrames;
+	limit = (uint64_t)sb->intervals * interval;
+
+	PRINTF1("[AVB] standby: watching heartbeat %s.\n", sb->name);
+
+	for (now = clock_getcount(cfg->clkid); !sigint;
+	     now = clock_getcount(cfg->clkid)) {
+		if (clock_sleep_until(cfg->clkid, now + interval) == EINTR)
+			continue;
+
+		switch (shm_heartbeat_state(sb->hb)) {
+		case SHM_HEARTBEAT_RUNNING:
+			break;
+		case SHM_HEARTBEAT_DONE:
+			PRINTF1("[AVB] standby: the talker has ended the stream.\n");
+			return 0;
+		default:
+			continue;
+		}
+
+		owner = shm_heartbeat_owner(sb->hb);
+		if (!shm_heartbeat_read(sb->hb, &time, &due, &st)) {
+			if (!valid || st.pos != last.pos)
+				standby_prefill(cfg, st.pos);
+			last = st;
+			valid = true;
+		}
+		if (!valid)
+			continue;
+
+		now = clock_getcount(cfg->clkid);
+		if (shm_heartbeat_alive(owner) && now <= due + limit)
+			continue;
+
+		/* another standby may be faster */
+		if (shm_heartbeat_takeover(sb->hb, owner) < 0)
+			continue;
+		sb->took = now;
+
+		/* the owner may have beaten once more before the swap */
+		if (!shm_heartbeat_read(sb->hb, &time, &due, &st))
+			last = st;
+
+		/*
+		 * The talker stops at its next push when it is still alive,
+		 * and gives its queue up when it exits.
+		 */
+		if (talker_reserve(cfg, dev) < 0) {
+			PRINTF1("[AVB] standby: cannot reserve the bandwidth of the stream.\n");
+			return 0;
+		}
+
+		sb->passive = false;
+		sb->from = owner;
+		sb->last = time;
+		sb->due = due;
+		sb->took_seqnum = last.seqnum;
+
+		/*
+		 * The stream goes on from the last heartbeat. The frames the
+		 * talker pushed after it are sent again with the same
+		 * sequence_num, so the delivery is at least once and the
+		 * listener sees them as duplicates, never as a gap.
+		 */
+		cfg->seqnum = last.seqnum;
+		cfg->framenums = last.framenums;
+		cfg->crf_timeline = last.crf_timeline;
+
+		/* the entries read ahead are pushed first */
+		if (cfg->fd > 2) {
+			standby_prefill(cfg, last.pos);
+			dev->wp = dev->rp = dev->p = sb->slot;
+			lseek(cfg->fd, last.pos +
+			      (off_t)sb->prefilled * cfg->payload_size,
+			      SEEK_SET);
+		}
+
+		return 1;
+	}
+
+	return 0;
+}
+
+static int standby_open(struct app_config *cfg)
+{
+	struct talker_standby *sb = &cfg->standby;
+
+	sb->hb = shm_heartbeat_open(sb->name, sizeof(struct standby_state));
+	if (!sb->hb)
+		return -1;
+
+	if (sb->passive) {
+		sb->iov = calloc(cfg->entrynum, sizeof(*sb->iov));
+		if (!sb->iov)
+			return -1;
+		return 0;
+	}
+
+	/* the new binary of a hot upgrade is handed the heartbeat too */
+	if (cfg->upgrade.takeover)
+		return 0;
+
+	return shm_heartbeat_start(sb->hb);
+}
+
+static int process_wait(struct app_config *cfg, int waitflush)
+{
+	int events, revents;
+
+	/* the eventfd of UDP is always writable, wait for free entries */
+	if (!waitflush && cfg->device->remain)
+		events = EAVB_NOTIFY_READ | EAVB_NOTIFY_WRITE;
+	else
+		events = EAVB_NOTIFY_READ;
+
+	if (cfg->waitmode) {
+		revents = events;
+	} else {
+		revents = eavb_wait(cfg->device->fd, events, WAIT_TIME_PROCESS);
+		if (revents < 0)
+			revents = 0;
+	}
+
+	return revents;
+}
+
+static int process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
+{
+	struct eavb_device *dev;
+	int tmp, thresh;
+	int process_size;
+
+	bool inf, waitflush;
+	int repeat;
+	int revents;
+	uint64_t left;
+
+	/* entry control info */
+	dev = cfg->device;
+
+	/* repeat control info */
+	repeat = cfg->framenums;
+	if (repeat)
+		inf = false;
+	else
+		inf = true;
+
+	waitflush = false;
+	thresh = cfg->entrynum / 8;
+
+	if (inf)
+		repeat = 1;
+
+	while (inf || !waitflush) {
+		left = cfg->framenums ? repeat : 0;
+		if (waitflush)
+			standby_stop(cfg);
+		else if (upgrade_poll(cfg, ctx, left) ||
+			 standby_beat(cfg, left, 0))
+			return 0;
+
+		revents = process_wait(cfg, waitflush);
+
+		if (revents & EAVB_NOTIFY_WRITE) {
+			if (standby_taken(cfg))
+				return 0;
+
+			process_size = talker_process
+					(cfg, dev->wp, dev->remain);
+
+			if (!inf) {
+				if (process_size > repeat)
+					process_size = repeat;
+			}
+
+			tmp = dev->push_entry(dev, process_size);
+			PRINTF3("-> push entry num of %d from %d\n",
+							tmp, dev->wp);
+			if (tmp < 0)
+				break;
+
+			if (!inf) {
+				repeat -= tmp;
+				if (repeat <= 0) {
+					read_end = true;
+					inf = true;
+				}
+			}
+		}
+
+		if (revents & EAVB_NOTIFY_READ) {
+			tmp = dev->take_entry(dev,
+				(dev->filled > thresh) ? thresh : dev->filled);
+			PRINTF3("<- take entry num of %d from %d\n",
+								tmp, dev->rp);
+			if (tmp < 0)
+				break;
+		}
+
+		if (sigint || (cfg->msrp && !msrp_exist_listener(ctx))) {
+			inf = false;
+			waitflush = true;
+		}
+
+		if (read_end) {
+			waitflush = true;
+			if (dev->filled == 0)
+				inf = false;
+		}
+	}
+
+	return 0;
+}
+
+/* wait for transmission of remaining entries */
+static void process_flush(struct app_config *cfg)
+{
+	struct eavb_device *dev = cfg->device;
+	int tmp, revents;
+
+	while (dev->filled > 0 && !sigint) {
+		revents = process_wait(cfg, true);
+		if (revents & EAVB_NOTIFY_READ) {
+			tmp = dev->take_entry(dev, dev->filled);
+			if (tmp < 0)
+				break;
+		}
+	}
+}
+
+/*
+ * shared memory feed
+ */
+/* fill up to count frames from p with the payloads of the producer */
+static int feed_process(struct app_config *cfg, int p, int count)
+{
+	struct eavb_device *dev;
+	struct shm_feed_slot *slot;
+	struct eavb_entry *e;
+	uint32_t time_stamp, delta_ts, len;
+	void *packet;
+	int i, k, n, hlen;
+
+	n = shm_feed_available(cfg->feed);
+	if (n > count)
+		n = count;
+	if (!n)
+		return 0;
+
+	dev = cfg->device;
+	hlen = avtp_simple_payload_offset(cfg->format);
+
+	/* the DMA frames of the driver are not shared, copy once */
+	for (i = 0, k = 0; i < n; i++) {
+		slot = shm_feed_slot(cfg->feed, i);
+
+		/* the producer is not trusted, take the length once */
+		len = __atomic_load_n(&slot->len, __ATOMIC_RELAXED);
+		if (len > cfg->payload_size) {
+			cfg->feed_errors++;
+			continue;
+		}
+
+		e = dev->entrybuf + (((p + k) % cfg->entrynum) * sizeof(*e));
+		packet = dev->frames[(p + k) % cfg->entrynum];
+		memcpy(packet + hlen, slot->data, len);
+		e->vec[0].len = hlen + len;
+		k++;
+	}
+	shm_feed_consume(cfg->feed, n);
+	if (!k)
+		return 0;
+
+	time_stamp = (uint32_t)clock_getcount(cfg->clkid) + TSOFFSET * 1000;
+	delta_ts = NSEC_SCALE /
+		(cfg->SRclassIntervalFrames * cfg->MaxIntervalFrames);
+
+	talker_stamp(cfg, p, k, cfg->seqnum, time_stamp, delta_ts,
+			cfg->payload_size);
+	cfg->seqnum += k;
+
+	for (i = 0; i < k; i++) {
+		e = dev->entrybuf + (((p + i) % cfg->entrynum) * sizeof(*e));
+		len = e->vec[0].len - hlen;
+		if (len != cfg->payload_size)
+			set_avtp_stream_data_length(
+				dev->frames[(p + i) % cfg->entrynum], len);
+	}
+
+	if (cfg->aef && talker_encrypt(cfg, p, k) < 0)
+		return -1;
+
+	if (cfg->crc)
+		talker_append_crc(cfg, p, k);
+
+	return k;
+}
+
+static int feed_process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
+{
+	struct eavb_device *dev;
+	struct shm_feed *feed = cfg->feed;
+	char feed_buf[256];
+	uint64_t repeat, sent;
+	bool streaming = false;
+	int ready = 0;
+	int n, tmp, revents;
+
+	dev = cfg->device;
+
+	repeat = cfg->framenums;
+	sent = 0;
+
+	PRINTF1("[AVB] waiting for the producer on @%s.\n", cfg->shm_name);
+
+	while (!repeat || sent < repeat) {
+		if (sigint || (cfg->msrp && !msrp_exist_listener(ctx)))
+			break;
+
+		/* reclaim transmitted entries without blocking */
+		if (dev->filled > 0) {
+			revents = eavb_wait(dev->fd, EAVB_NOTIFY_READ, 0);
+			if (revents > 0 && (revents & EAVB_NOTIFY_READ)) {
+				tmp = dev->take_entry(dev, dev->filled);
+				PRINTF3("<- take entry num of %d from %d\n",
+								tmp, dev->rp);
+				if (tmp < 0)
+					break;
+			}
+		}
+
+		if (!ready) {
+			if (!dev->remain) {
+				process_wait(cfg, true);
+				continue;
+			}
+
+			n = dev->remain;
+			if (repeat && sent + n > repeat)
+				n = repeat - sent;
+			ready = feed_process(cfg, dev->wp, n);
+			if (ready < 0) {
+				PRINTF1("[AVB] error : AEF encryption\n");
+				break;
+			}
+		}
+
+		if (!ready) {
+			if (shm_feed_eof(feed))
+				break;
+
+			/* the tx queue ran dry, tell the producer once */
+			if (streaming && !dev->filled) {
+				shm_feed_underrun(feed);
+				streaming = false;
+			}
+
+			if (shm_feed_wait(feed, (dev->filled) ? dev->fd : -1,
+					  WAIT_TIME_PROCESS) < 0)
+				break;
+			continue;
+		}
+		streaming = true;
+
+		tmp = dev->push_entry(dev, ready);
+		PRINTF3("-> push entry num of %d from %d\n", tmp, dev->wp);
+		if (tmp < 0)
+			break;
+		ready -= tmp;
+		sent += tmp;
+	}
+
+	process_flush(cfg);
+
+	shm_feed_report(feed, feed_buf, sizeof(feed_buf));
+	PRINTF1("[AVB] %s, %"PRIu64" bad payloads dropped\n", feed_buf,
+			cfg->feed_errors);
+
+	return 0;
+}
+
+static int crf_process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
+{
+	struct eavb_device *dev;
+	uint64_t repeat, sent;
+	uint64_t due, now;
+	uint64_t late, late_max, late_total;
+	bool inf;
+	int tmp, revents;
+
+	dev = cfg->device;
+
+	repeat = cfg->framenums;
+	inf = !repeat;
+	sent = 0;
+	late_max = 0;
+	late_total = 0;
+
+	/* the timeline handed over goes on */
+	if (!cfg->upgrade.takeover && !cfg->standby.from)
+		crf_timeline_init(cfg, clock_getcount(cfg->clkid));
+
+	while (inf || sent < repeat) {
+		if (sigint || (cfg->msrp && !msrp_exist_listener(ctx)))
+			break;
+
+		/* the next PDU is sent at its last timestamp */
+		due = cfg->crf_timeline.next + (uint64_t)(cfg->crf_timestamps - 1) *
+			cfg->crf_timeline.step;
+		if (upgrade_poll(cfg, ctx, inf ? 0 : repeat - sent) ||
+		    standby_beat(cfg, inf ? 0 : repeat - sent, due))
+			return 0;
+
+		/*
+		 * All entries except the latest one were pushed at least
+		 * one PDU interval ago, so they are already transmitted.
+		 */
+		if (dev->filled > 1) {
+			tmp = dev->take_entry(dev, dev->filled - 1);
+			PRINTF3("<- take entry num of %d from %d\n",
+								tmp, dev->rp);
+			if (tmp < 0)
+				break;
+		}
+		if (!dev->remain) {
+			/* the ring is full, wait for the driver to complete */
+			revents = process_wait(cfg, true);
+			if (revents & EAVB_NOTIFY_READ) {
+				tmp = dev->take_entry(dev, dev->filled);
+				PRINTF3("<- take entry num of %d from %d\n",
+								tmp, dev->rp);
+				if (tmp < 0)
+					break;
+			}
+			continue;
+		}
+
+		due = crf_process(cfg);
+		if (clock_sleep_until(cfg->clkid, due) == EINTR && sigint)
+			break;
+
+		now = clock_getcount(cfg->clkid);
+		late = (now > due) ? now - due : 0;
+		late_total += late;
+		if (late > late_max)
+			late_max = late;
+
+		if (standby_taken(cfg))
+			return 0;
+
+		tmp = dev->push_entry(dev, 1);
+		PRINTF3("-> push entry num of %d from %d\n", tmp, dev->wp);
+		if (tmp < 0)
+			break;
+		sent += tmp;
+	}
+
+	/* the standby must not take over the PDUs flushed */
+	standby_stop(cfg);
+	process_flush(cfg);
+
+	if (sent)
+		PRINTF1("[AVB] CRF %"PRIu64" PDUs, push latency avg %"PRIu64"ns max %"PRIu64"ns\n",
+				sent, late_total / sent, late_max);
+
+	return 0;
+}
+
+static int acf_process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
+{
+	struct eavb_device *dev;
+	struct acf_source *acf = &cfg->acf;
+	uint64_t repeat, sent;
+	bool inf;
+	int tmp, revents;
+
+	dev = cfg->device;
+
+	repeat = cfg->framenums;
+	inf = !repeat;
+	sent = 0;
+
+	while (inf || sent < repeat) {
+		if (sigint || (cfg->msrp && !msrp_exist_listener(ctx)))
+			break;
+
+		/* reclaim transmitted entries without blocking */
+		if (dev->filled > 0) {
+			revents = eavb_wait(dev->fd, EAVB_NOTIFY_READ, 0);
+			if (revents > 0 && (revents & EAVB_NOTIFY_READ)) {
+				tmp = dev->take_entry(dev, dev->filled);
+				PRINTF3("<- take entry num of %d from %d\n",
+								tmp, dev->rp);
+				if (tmp < 0)
+					break;
+			}
+		}
+		if (!dev->remain) {
+			process_wait(cfg, true);
+			continue;
+		}
+
+		tmp = acf_process(cfg);
+		if (tmp < 0) {
+			PRINTF1("[AVB] error : CAN read\n");
+			break;
+		}
+		if (!tmp)
+			continue;
+
+		tmp = dev->push_entry(dev, 1);
+		PRINTF3("-> push entry num of %d from %d\n", tmp, dev->wp);
+		if (tmp < 0)
+			break;
+		sent += tmp;
+	}
+
+	process_flush(cfg);
+
+	if (acf->pdus)
+		PRINTF1("[AVB] ACF %"PRIu64" CAN frames in %"PRIu64" PDUs (%.2f frames/PDU), "
+			"%"PRIu64" bytes on wire (%"PRIu64" bytes by per-frame PDUs, %.1f%% saved)\n",
+				acf->frames, acf->pdus,
+				(double)acf->frames / acf->pdus,
+				acf->wire_bytes, acf->wire_bytes_single,
+				100.0 * (1.0 - (double)acf->wire_bytes /
+						acf->wire_bytes_single));
+
+	return 0;
+}
+
+/*
+ * ALSA capture
+ */
+/* gPTP time of the captured frame at tstamp on CLOCK_MONOTONIC */
+static uint64_t aaf_timeline(struct app_config *cfg, uint64_t tstamp)
+{
+	struct alsa_source *as = &cfg->alsa;
+	uint64_t t;
+	int64_t err;
+
+	if (!as->offset_time ||
+	    (int64_t)(tstamp - as->offset_time) > ALSA_OFFSET_REFRESH) {
+		as->offset = clock_getoffset(cfg->clkid, CLOCK_MONOTONIC);
+		as->offset_time = tstamp;
+	}
+	t = tstamp + as->offset;
+
+	/*
+	 * The timestamps jitter by the period wakeups and the correlation,
+	 * follow them slowly unless the capture was restarted.
+	 */
+	err = (int64_t)(t - as->next);
+	if (!as->valid || err > ALSA_RESYNC || err < -ALSA_RESYNC) {
+		if (as->valid)
+			as->resyncs++;
+		as->next = t;
+		as->valid = true;
+		return t;
+	}
+	hdr_hist_record(&as->jitter, (err < 0) ? -err : err);
+	as->next += err / ALSA_TIMELINE_GAIN;
+
+	return as->next;
+}
+
+/* fill up to count frames from p with the captured PDUs */
+static int aaf_process(struct app_config *cfg, int p, int count)
+{
+	struct alsa_source *as = &cfg->alsa;
+	struct eavb_device *dev;
+	uint64_t tstamp, t;
+	uint8_t *data;
+	void *packet;
+	int i, n, hlen;
+
+	n = alsa_capture_begin(as->cap, (void **)&data, count * as->frames,
+			       &tstamp);
+	if (n == -1) {
+		/* overrun, the timeline restarts with the capture */
+		as->valid = false;
+		return 0;
 	}
+	if (n < 0)
+		return -1;
 
-	return dev; /* Success */
+	/* the buffer is whole periods of whole PDUs, no PDU is split */
+	n /= as->frames;
+	if (!n)
+		return 0;
 
-error:
-	eavb_device_free(dev);
+	dev = cfg->device;
 
-	return NULL;
+	t = aaf_timeline(cfg, tstamp);
+	hlen = avtp_simple_payload_offset(cfg->format);
+
+	talker_stamp(cfg, p, n, cfg->seqnum, (uint32_t)t + TSOFFSET * 1000,
+			as->pdu_ns, cfg->payload_size);
+	cfg->seqnum += n;
+
+	/* the DMA frames of the driver are not shared, copy once */
+	for (i = 0; i < n; i++) {
+		packet = dev->frames[(p + i) % cfg->entrynum];
+		memcpy(packet + hlen, data + i * cfg->payload_size,
+				cfg->payload_size);
+	}
+	alsa_capture_commit(as->cap, n * as->frames);
+
+	as->next += n * as->pdu_ns;
+	as->pdus += n;
+
+	return n;
 }
 
-static int talker_process(struct app_config *cfg, int p, int count)
+static int aaf_process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
 {
 	struct eavb_device *dev;
-	static int seqnum;
-	int read_size, hlen, payload_size;
-	int i;
-	uint32_t time_stamp, delta_ts, classIntervalFrames;
-	uint64_t t;
+	struct alsa_source *as = &cfg->alsa;
+	struct alsa_capture *cap = as->cap;
+	uint64_t repeat, sent;
+	int ready = 0;
+	int n, tmp, revents;
 
-	struct eavb_dma_alloc *dma;
-	struct eavb_entry *e;
-	struct eavb_entryvec *evec;
-	struct iovec *iov;
-	void *packet = NULL;
-	void *payload;
+	dev = cfg->device;
 
-	/* get current timestamp */
-	t = clock_getcount(cfg->clkid);
-	time_stamp = (uint32_t)t + TSOFFSET * 1000;
+	repeat = cfg->framenums;
+	sent = 0;
 
-	PRINTF3("[AVB] talker proc entry num of %d (timestamp:%u)\n",
-							count, time_stamp);
+	hdr_hist_reset(&as->jitter);
 
-	classIntervalFrames = cfg->SRclassIntervalFrames;
-	delta_ts = NSEC_SCALE / (classIntervalFrames * cfg->MaxIntervalFrames);
+	/* started now, the periods captured so far would be stale */
+	if (alsa_capture_start(cap) < 0)
+		return -1;
 
-	hlen = AVTP_CVF_PAYLOAD_OFFSET;
-	payload_size = cfg->payload_size;
+	while (!repeat || sent < repeat) {
+		if (sigint || (cfg->msrp && !msrp_exist_listener(ctx)))
+			break;
 
-	dev = cfg->device;
+		/* reclaim transmitted entries without blocking */
+		if (dev->filled > 0) {
+			revents = eavb_wait(dev->fd, EAVB_NOTIFY_READ, 0);
+			if (revents > 0 && (revents & EAVB_NOTIFY_READ)) {
+				tmp = dev->take_entry(dev, dev->filled);
+				PRINTF3("<- take entry num of %d from %d\n",
+								tmp, dev->rp);
+				if (tmp < 0)
+					break;
+			}
+		}
 
-	iov = calloc(count, sizeof(*iov));
-	if (!iov) {
-		PRINTF("[AVB] cannot allocate iovec\n");
-		read_end = true;
-		return count;
+		if (!ready) {
+			if (!dev->remain) {
+				process_wait(cfg, true);
+				continue;
+			}
+
+			n = dev->remain;
+			if (repeat && sent + n > repeat)
+				n = repeat - sent;
+			ready = aaf_process(cfg, dev->wp, n);
+			if (ready < 0) {
+				PRINTF1("[AVB] error : ALSA capture\n");
+				break;
+			}
+		}
+
+		if (!ready) {
+			if (alsa_capture_wait(cap, WAIT_TIME_PROCESS) < 0) {
+				PRINTF1("[AVB] error : ALSA capture\n");
+				break;
+			}
+			continue;
+		}
+
+		tmp = dev->push_entry(dev, ready);
+		PRINTF3("-> push entry num of %d from %d\n", tmp, dev->wp);
+		if (tmp < 0)
+			break;
+		ready -= tmp;
+		sent += tmp;
 	}
 
-	for (i = 0; i < count; i++) {
-		dma = (dev->framebuf + (dev->p * sizeof(*dma)));
-		e = dev->entrybuf + (dev->p * sizeof(*e));
-		evec = &e->vec[0];
-		packet = dma->dma_vaddr;
-		payload = packet + AVTP_CVF_PAYLOAD_OFFSET;
+	process_flush(cfg);
 
-		iov[i].iov_base = payload;
-		iov[i].iov_len = payload_size;
+	PRINTF1("[AVB] ALSA %s: %"PRIu64" frames in %"PRIu64" PDUs, "
+		"%"PRIu64" wakeups, %"PRIu64" xruns, %"PRIu64" resyncs, "
+		"%"PRIu64" timestamps by CPU\n",
+			as->name, cap->frames, as->pdus, cap->wakeups,
+			cap->xruns, as->resyncs, cap->no_tstamp);
+	if (as->jitter.count)
+		PRINTF1("[AVB] ALSA timestamp to gPTP timeline p50 %"PRIu64"ns "
+			"p99 %"PRIu64"ns max %"PRIu64"ns\n",
+				hdr_hist_percentile(&as->jitter, 50),
+				hdr_hist_percentile(&as->jitter, 99),
+				as->jitter.max);
+
+	return 0;
+}
 
-		set_avtp_sequence_num(packet, seqnum++);
-		set_avtp_timestamp(packet, time_stamp);
-		set_avtp_stream_data_length(packet, payload_size);
+/*
+ * replay of captured frames
+ */
+#define REPLAY_LEAD (10000000) /* nsec from start to the first frame */
 
-		time_stamp += delta_ts;
+/* read the captures from the first frame again */
+static void replay_rewind(struct replay_source *rp)
+{
+	int i;
 
-		evec->len = hlen + payload_size;
-		dev->p = (dev->p + 1) % cfg->entrynum;
+	for (i = 0; i < rp->nfiles; i++) {
+		pcap_reader_rewind(rp->files[i]);
+		rp->valid[i] = (pcap_reader_next(rp->files[i],
+						 &rp->next[i]) > 0);
 	}
+}
 
-	read_size = readv(cfg->fd, iov, count);
-	if (read_size < 0) {
-		PRINTF1("[AVB] error : File read\n");
-		read_end = true;
-	} else if (read_size == 0) {
-		PRINTF2("[AVB] File read end.\n");
-		count = 0;
-		read_end = true;
-	} else if (read_size < payload_size * count) {
-		i = read_size / payload_size;
-		payload_size = read_size % payload_size;
-		dev->p = (dev->p + i + cfg->entrynum - count) % cfg->entrynum;
-		if (payload_size != 0) {
-			dma = (dev->framebuf + (dev->p * sizeof(*dma)));
-			e = dev->entrybuf + (dev->p * sizeof(*e));
-			evec = &e->vec[0];
-			packet = dma->dma_vaddr;
-			set_avtp_stream_data_length(packet, payload_size);
-			evec->len = hlen + payload_size;
-			dev->p = (dev->p + 1) % cfg->entrynum;
-			count = i + 1;
-		} else {
-			count = i;
+/* take the earliest frame of the captures, returns its file or -1 */
+static int replay_next(struct replay_source *rp, struct pcap_frame *f,
+		       uint64_t *t)
+{
+	struct pcap_reader *r;
+	uint64_t due, min = UINT64_MAX;
+	int i, file = -1, ret;
+
+	for (i = 0; i < rp->nfiles; i++) {
+		if (!rp->valid[i])
+			continue;
+		due = (rp->next[i].ts > rp->origin[i]) ?
+			rp->next[i].ts - rp->origin[i] : 0;
+		if (due < min) {
+			min = due;
+			file = i;
 		}
 	}
+	if (file < 0)
+		return -1;
 
-	free(iov);
+	*f = rp->next[file];
+	*t = min;
 
-	return count;
+	r = rp->files[file];
+	ret = pcap_reader_next(r, &rp->next[file]);
+	if (ret < 0)
+		PRINTF1("[AVB] %s: broken capture at offset %zu\n",
+				r->name, r->off);
+	rp->valid[file] = (ret > 0);
+
+	return file;
 }
 
-static int process_wait(struct app_config *cfg, int waitflush)
+/* length of the frame with Q-Tag to send, 0 if it is not replayed */
+static int replay_frame_len(struct pcap_frame *f)
 {
-	int events, revents;
-
-	if (!waitflush)
-		events = EAVB_NOTIFY_READ | EAVB_NOTIFY_WRITE;
-	else
-		events = EAVB_NOTIFY_READ;
+	int len;
 
-	if (cfg->waitmode) {
-		revents = events;
-	} else {
-		revents = eavb_wait(cfg->device->fd, events, WAIT_TIME_PROCESS);
-		if (revents < 0)
-			revents = 0;
+	if (f->caplen < f->len || f->caplen < ETH_HLEN)
+		return 0; /* truncated by the capture */
+
+	switch (get_ieee8021q_tpid(f->data)) {
+	case ETH_P_8021Q:
+		if (f->caplen < ETHOVERHEAD ||
+		    get_ieee8021q_ethtype(f->data) != ETH_P_1722)
+			return 0;
+		len = f->caplen;
+		break;
+	case ETH_P_1722:
+		/* the receiver has stripped the tag */
+		len = f->caplen + (ETHOVERHEAD - ETH_HLEN);
+		break;
+	default:
+		return 0;
 	}
 
-	return revents;
+	/* up to the StreamID */
+	if (len < AVTP_OFFSET + 12 || len > ETHFRAMELEN_MAX)
+		return 0;
+
+	return len;
 }
 
-static int process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
+/* reserve the bandwidth of the busiest class interval of the captures */
+static int replay_scan(struct app_config *cfg)
 {
-	struct eavb_device *dev;
-	int tmp, thresh;
-	int process_size;
+	struct replay_source *rp = &cfg->rp;
+	struct pcap_frame f;
+	uint64_t t, interval, slot = UINT64_MAX;
+	uint64_t frames = 0, first = UINT64_MAX;
+	int i, len, count = 0, maxlen = 0, maxcount = 0;
+
+	/* captured time of the start of replay */
+	replay_rewind(rp);
+	for (i = 0; i < rp->nfiles; i++) {
+		if (!rp->valid[i])
+			continue;
+		rp->origin[i] = rp->next[i].ts;
+		if (rp->origin[i] < first)
+			first = rp->origin[i];
+	}
+	if (!rp->align) {
+		for (i = 0; i < rp->nfiles; i++)
+			rp->origin[i] = first;
+	}
 
-	bool inf, waitflush;
-	int repeat;
-	int revents;
+	interval = NSEC_SCALE / cfg->SRclassIntervalFrames;
+	while (replay_next(rp, &f, &t) >= 0) {
+		len = replay_frame_len(&f);
+		if (!len)
+			continue;
+
+		frames++;
+		if (len > maxlen)
+			maxlen = len;
+		if (t / interval != slot) {
+			slot = t / interval;
+			count = 0;
+		}
+		if (++count > maxcount)
+			maxcount = count;
+	}
 
-	/* entry control info */
-	dev = cfg->device;
+	if (!frames) {
+		PRINTF1("[AVB] no AVTP frame in the captures.\n");
+		return -1;
+	}
 
-	/* repeat control info */
-	repeat = cfg->framenums;
-	if (repeat)
-		inf = false;
-	else
-		inf = true;
+	cfg->MaxFrameSize = (maxlen < ETHFRAMELEN_MIN) ?
+			ETHFRAMEMTU_MIN : maxlen - ETHOVERHEAD;
+	if (maxcount > cfg->MaxIntervalFrames)
+		cfg->MaxIntervalFrames = maxcount;
 
-	waitflush = false;
-	thresh = cfg->entrynum / 8;
+	PRINTF1("[AVB] replay %"PRIu64" AVTP frames of %d captures\n",
+			frames, rp->nfiles);
 
-	if (inf)
-		repeat = 1;
+	replay_rewind(rp);
 
-	while (inf || !waitflush) {
-		revents = process_wait(cfg, waitflush);
+	return 0;
+}
 
-		if (revents & EAVB_NOTIFY_WRITE) {
-			process_size = talker_process
-					(cfg, dev->wp, dev->remain);
+/*
+ * Copy the captured frame to the entry at dev->p as a frame of this
+ * talker. The AVTP timestamps keep their distance from the transmission,
+ * which expects the capture stamped by gPTP like simple_listener --pcap.
+ */
+static bool replay_frame(struct app_config *cfg, struct pcap_frame *f,
+			 uint64_t due)
+{
+	struct eavb_device *dev = cfg->device;
+	struct replay_source *rp = &cfg->rp;
+	struct eavb_entry *e;
+	uint8_t id[AVTP_STREAMID_SIZE];
+	uint8_t *packet;
+	uint8_t subtype;
+	uint64_t delta;
+	bool remapped = false;
+	int i, len, n;
+
+	len = replay_frame_len(f);
+	if (!len) {
+		rp->skipped++;
+		return false;
+	}
 
-			if (!inf) {
-				if (process_size > repeat)
-					process_size = repeat;
-			}
+	packet = dev->frames[dev->p];
+	e = dev->entrybuf + (dev->p * sizeof(*e));
 
-			tmp = dev->push_entry(dev, process_size);
-			PRINTF3("-> push entry num of %d from %d\n",
-							tmp, dev->wp);
-			if (tmp < 0)
-				break;
+	if (len == f->caplen) {
+		memcpy(packet, f->data, len);
+	} else {
+		memcpy(packet, f->data, ETH_ALEN * 2);
+		memcpy(packet + ETHOVERHEAD - 2, f->data + ETH_ALEN * 2,
+				f->caplen - ETH_ALEN * 2);
+		set_ieee8021q_tpid(packet, ETH_P_8021Q);
+	}
+	set_ieee8021q_tci(packet, (cfg->SRpriority << 13) | cfg->SRvid);
+	set_ieee8021q_source(packet, cfg->source_addr);
 
-			if (!inf) {
-				repeat -= tmp;
-				if (repeat <= 0) {
-					read_end = true;
-					inf = true;
-				}
-			}
+	for (i = 0; i < rp->naddrs; i++) {
+		if (!memcmp(packet, rp->addrs[i].from, ETH_ALEN)) {
+			set_ieee8021q_dest(packet, rp->addrs[i].to);
+			remapped = true;
+			break;
 		}
+	}
 
-		if (revents & EAVB_NOTIFY_READ) {
-			tmp = dev->take_entry(dev,
-				(dev->filled > thresh) ? thresh : dev->filled);
-			PRINTF3("<- take entry num of %d from %d\n",
-								tmp, dev->rp);
-			if (tmp < 0)
+	if (get_avtp_stream_flags(packet) & AVTP_STREAM_FLAG_SV) {
+		get_avtp_stream_id(packet, id);
+		for (i = 0; i < rp->nstreams; i++) {
+			if (!memcmp(id, rp->streams[i].from, sizeof(id))) {
+				set_avtp_stream_id(packet, rp->streams[i].to);
+				remapped = true;
 				break;
+			}
 		}
+	}
 
-		if (sigint || (cfg->msrp && !msrp_exist_listener(ctx))) {
-			inf = false;
-			waitflush = true;
+	subtype = get_avtp_subtype(packet);
+	delta = due - f->ts;
+	if (subtype == AVTP_SUBTYPE_CRF) {
+		n = get_avtp_crf_data_length(packet) / AVTP_CRF_TIMESTAMP_SIZE;
+		if (len < AVTP_CRF_PAYLOAD_OFFSET)
+			n = 0;
+		else if (n > (len - AVTP_CRF_PAYLOAD_OFFSET) /
+						AVTP_CRF_TIMESTAMP_SIZE)
+			n = (len - AVTP_CRF_PAYLOAD_OFFSET) /
+						AVTP_CRF_TIMESTAMP_SIZE;
+		for (i = 0; i < n; i++)
+			set_avtp_crf_timestamp(packet, i,
+				get_avtp_crf_timestamp(packet, i) + delta);
+	} else if (subtype <= AVTP_SUBTYPE_EF_STREAM &&
+		   len >= AVTP_PAYLOAD_OFFSET &&
+		   (get_avtp_stream_flags(packet) & AVTP_STREAM_FLAG_TV)) {
+		set_avtp_timestamp(packet,
+			get_avtp_timestamp(packet) + (uint32_t)delta);
+	}
+
+	if (len < ETHFRAMELEN_MIN) {
+		memset(packet + len, 0, ETHFRAMELEN_MIN - len);
+		len = ETHFRAMELEN_MIN;
+	}
+	e->vec[0].len = len;
+
+	rp->frames++;
+	if (remapped)
+		rp->remapped++;
+
+	dev->p = (dev->p + 1) % cfg->entrynum;
+
+	return true;
+}
+
+static int replay_process_loop(struct app_config *cfg, struct msrp_ctx *ctx)
+{
+	struct eavb_device *dev;
+	struct replay_source *rp = &cfg->rp;
+	struct pcap_frame f;
+	uint64_t repeat, sent;
+	uint64_t start, t, due, now;
+	int file, n, tmp, revents;
+
+	dev = cfg->device;
+
+	repeat = cfg->framenums;
+	sent = 0;
+	hdr_hist_reset(&rp->late);
+
+	/* wake up in time for the captured intervals */
+	prctl(PR_SET_TIMERSLACK, 1);
+
+	start = clock_getcount(cfg->clkid) + REPLAY_LEAD;
+	file = replay_next(rp, &f, &t);
+
+	while (file >= 0 && (!repeat || sent < repeat)) {
+		if (sigint || (cfg->msrp && !msrp_exist_listener(ctx)))
+			break;
+
+		/* reclaim transmitted entries without blocking */
+		if (dev->filled > 0) {
+			revents = eavb_wait(dev->fd, EAVB_NOTIFY_READ, 0);
+			if (revents > 0 && (revents & EAVB_NOTIFY_READ)) {
+				tmp = dev->take_entry(dev, dev->filled);
+				PRINTF3("<- take entry num of %d from %d\n",
+								tmp, dev->rp);
+				if (tmp < 0)
+					break;
+			}
+		}
+		if (!dev->remain) {
+			process_wait(cfg, true);
+			continue;
 		}
 
-		if (read_end) {
-			waitflush = true;
-			if (dev->filled == 0)
-				inf = false;
+		if (clock_sleep_until(cfg->clkid, start + t) == EINTR)
+			continue;
+		now = clock_getcount(cfg->clkid);
+
+		/* push all frames due by now at once */
+		for (n = 0; file >= 0 && n < dev->remain; ) {
+			if (repeat && sent + n >= repeat)
+				break;
+			due = start + t;
+			if (due > now)
+				break;
+			if (replay_frame(cfg, &f, due)) {
+				hdr_hist_record(&rp->late, now - due);
+				n++;
+			}
+			file = replay_next(rp, &f, &t);
 		}
+		if (!n)
+			continue;
+
+		tmp = dev->push_entry(dev, n);
+		PRINTF3("-> push entry num of %d from %d\n", tmp, dev->wp);
+		if (tmp < 0)
+			break;
+		sent += tmp;
 	}
 
+	process_flush(cfg);
+
+	PRINTF1("[AVB] replay %"PRIu64" frames (%"PRIu64" remapped, %"PRIu64" skipped), "
+		"behind schedule p50 %"PRIu64"ns p99 %"PRIu64"ns max %"PRIu64"ns\n",
+			rp->frames, rp->remapped, rp->skipped,
+			hdr_hist_percentile(&rp->late, 50),
+			hdr_hist_percentile(&rp->late, 99), rp->late.max);
+
 	return 0;
 }
 
@@ -689,21 +3038,72 @@ int main(int argc, char **argv)
 	struct eavb_device *dev;
 	struct msrp_ctx *ctx = NULL;
 	int ret = -1;
+	int i;
 
 	if (config_parse(&cfg, argc, argv) < 0)
 		return -1;
 
 	/* install signal handler */
-	install_sighandler(SIGINT, sigint_handler);
-	install_sighandler(SIGTERM, sigint_handler);
+	install_sighandler(SIGINT, sigint_handler, 0);
+	install_sighandler(SIGTERM, sigint_handler, 0);
 	signal(SIGUSR1, SIG_IGN);
+	/* the stream goes on, so a blocking read of the source is restarted */
+	if (config_can_upgrade(&cfg))
+		install_sighandler(SIGUSR2, upgrade_handler, SA_RESTART);
+	else
+		signal(SIGUSR2, SIG_IGN);
 
-	dev = eavb_device_new_for_talker(&cfg, cfg.uid);
-	if (!dev) {
-		PRINTF("[AVB] cannot setup eavb device\n");
+	if (cfg.replay && replay_scan(&cfg) < 0)
+		goto bad_usage;
+
+	if (cfg.upgrade.takeover) {
+		if (talker_takeover(&cfg, &ctx) < 0) {
+			PRINTF("[AVB] cannot take over the stream\n");
+			goto bad_usage;
+		}
+		dev = cfg.device;
+	} else {
+		dev = eavb_device_new_for_talker(&cfg, cfg.uid);
+		if (!dev) {
+			PRINTF("[AVB] cannot setup eavb device\n");
+			goto bad_usage;
+		}
+		cfg.device = dev;
+	}
+
+	if (cfg.standby.name && standby_open(&cfg) < 0) {
+		PRINTF("[AVB] cannot open heartbeat %s\n", cfg.standby.name);
 		goto bad_usage;
 	}
-	cfg.device = dev;
+
+	if (cfg.shm_name) {
+		cfg.feed = shm_feed_create(cfg.shm_name, cfg.shm_slots,
+					   cfg.payload_size);
+		if (!cfg.feed) {
+			PRINTF("[AVB] cannot create shared memory feed @%s\n",
+					cfg.shm_name);
+			goto bad_usage;
+		}
+	}
+
+	if (cfg.alsa.name) {
+		struct alsa_source *as = &cfg.alsa;
+		int period;
+
+		/* a period of whole PDUs, so no PDU wraps the ring buffer */
+		period = (int64_t)as->period * as->rate / 1000000 /
+			as->frames * as->frames;
+		if (period < as->frames)
+			period = as->frames;
+
+		as->cap = alsa_capture_open(as->name, as->rate, as->channels,
+					    as->width, period, ALSA_PERIODS);
+		if (!as->cap) {
+			PRINTF("[AVB] cannot open ALSA capture device %s\n",
+					as->name);
+			goto bad_usage;
+		}
+	}
 
 	PRINTF1("[AVB] %s: %dMbps / %02x:%02x:%02x:%02x:%02x:%02x+%02x:%02x\n",
 			cfg.ifname, cfg.speed,
@@ -711,28 +3111,11 @@ int main(int argc, char **argv)
 			dev->StreamID[3], dev->StreamID[4], dev->StreamID[5],
 			dev->StreamID[6], dev->StreamID[7]);
 
-	if (cfg.msrp) {
-		int i;
+	/* the registration is handed over with the stream */
+	if (cfg.msrp && !cfg.upgrade.takeover) {
 		struct mrp_property prop;
 
-		memset(&prop, 0, sizeof(prop));
-
-		for (i = 0; i < 8; i++) {
-			prop.streamid = (prop.streamid << 8) +
-				dev->StreamID[i];
-		}
-		for (i = 0; i < 6; i++) {
-			prop.destaddr = (prop.destaddr << 8) +
-				dev->dest_addr[i];
-		}
-		prop.verbose  = DEBUG_LEVEL;
-		prop.vlan     = cfg.SRvid;
-		prop.MaxFrameSize = cfg.MaxFrameSize;
-		prop.MaxIntervalFrames = cfg.MaxIntervalFrames;
-		prop.priority = cfg.SRpriority;
-		prop.rank     = cfg.SRrank;
-		prop.latency  = LATENCY_TIME_MSRP;
-		prop.class    = cfg.SRclassID;
+		talker_msrp_property(&cfg, dev, &prop);
 
 		ctx = msrp_ctx_init(&prop);
 		if (ctx == NULL) {
@@ -777,15 +3160,65 @@ int main(int argc, char **argv)
 			goto bad_usage;
 	}
 
+	/* the declarations are made already, the stream only moves */
+	if (cfg.standby.passive && !standby_wait(&cfg)) {
+		ret = 0;
+		goto bad_usage;
+	}
+
 	PRINTF1("[AVB] start process loop.\n");
-	process_loop(&cfg, ctx);
+	if (cfg.replay)
+		replay_process_loop(&cfg, ctx);
+	else if (cfg.format == AVTP_SIMPLE_FORMAT_CRF)
+		crf_process_loop(&cfg, ctx);
+	else if (config_is_acf(&cfg))
+		acf_process_loop(&cfg, ctx);
+	else if (cfg.format == AVTP_SIMPLE_FORMAT_AAF)
+		aaf_process_loop(&cfg, ctx);
+	else if (cfg.feed)
+		feed_process_loop(&cfg, ctx);
+	else
+		process_loop(&cfg, ctx);
 	PRINTF1("[AVB] finish process loop.\n");
 
+	if (cfg.crc)
+		PRINTF1("[AVB] CRC32C by %s\n", crc32c_impl());
+
+	if (cfg.aef) {
+		char aef_buf[256];
+
+		aef_report(cfg.aef, aef_buf, sizeof(aef_buf));
+		PRINTF1("[AVB] %s\n", aef_buf);
+	}
+
+	if (cfg.udp) {
+		char udp_buf[256];
+
+		eavb_device_udp_report(dev, udp_buf, sizeof(udp_buf));
+		PRINTF1("[AVB] %s\n", udp_buf);
+	}
+
 	ret = 0;
 
 bad_usage:
 	if (cfg.fd > 2)
 		close(cfg.fd);
+	if (cfg.acf.fd >= 0)
+		close(cfg.acf.fd);
+	aef_ctx_free(cfg.aef);
+	free(cfg.aef_lens);
+	shm_feed_destroy(cfg.feed);
+	free(cfg.shm_name);
+	alsa_capture_close(cfg.alsa.cap);
+	free(cfg.alsa.name);
+	for (i = 0; i < cfg.rp.nfiles; i++)
+		pcap_reader_close(cfg.rp.files[i]);
+	if (cfg.upgrade.sock >= 0)
+		close(cfg.upgrade.sock);
+	free(cfg.upgrade.path);
+	shm_heartbeat_close(cfg.standby.hb);
+	free(cfg.standby.name);
+	free(cfg.standby.iov);
 
 	if (cfg.device) {
 		if (cfg.device->fd) {
@@ -793,7 +3226,12 @@ bad_usage:
 			PRINTF1("[AVB] closed the device file.\n");
 		}
 
-		if (cfg.msrp && ctx) {
+		/*
+		 * The new process keeps the declarations after the upgrade,
+		 * and the talker does while this one stands by.
+		 */
+		if (cfg.msrp && ctx && !cfg.upgrade.done &&
+		    !cfg.standby.passive) {
 			usleep(TSOFFSET);
 			PRINTF1("[AVB] unadvertising stream.\n");
 			msrp_talker_unadvertise(ctx);
@@ -805,6 +3243,9 @@ bad_usage:
 			ret = mvrp_leave_vlan(ctx);
 			if (ret < 0)
 				PRINTF("[AVB] failed to leave vlan.\n");
+		}
+
+		if (cfg.msrp && ctx) {
 
 			ret = msrp_ctx_destroy(ctx);
 			if (ret < 0)
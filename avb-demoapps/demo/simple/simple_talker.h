@@ -13,9 +13,191 @@
 #include "netif_util.h"
 #include "packet.h"
 #include "eavb_device.h"
+#include "acf_can.h"
+#include "aef.h"
+#include "crc32c.h"
+#include "pcapng.h"
+#include "hdr_hist.h"
+#include "shm_feed.h"
+#include "alsa_capture.h"
+#include "handoff.h"
+#include "shm_heartbeat.h"
+#include "msrp.h"
 
 #define NSEC_SCALE	(1000000000)
 
+/* CAN frame source of ACF talker */
+struct acf_source {
+	int                fd;
+	int                latency;  /* aggregation latency [usec] */
+	struct canfd_frame frame;    /* read but not packed yet */
+	bool               fdf;
+	bool               pending;
+	uint64_t           time;     /* gPTP time when the frame was read */
+	/* statistics */
+	uint64_t           frames;
+	uint64_t           pdus;
+	uint64_t           wire_bytes;
+	uint64_t           wire_bytes_single;
+};
+
+#define ALSA_PERIODS        (16)         /* periods of the capture buffer */
+#define ALSA_OFFSET_REFRESH (NSEC_SCALE) /* nsec, gPTP correlation interval */
+#define ALSA_TIMELINE_GAIN  (16)         /* 1/16 of an error is corrected */
+#define ALSA_RESYNC         (1000000)    /* nsec, error to restart timeline */
+
+/*
+ * ALSA capture source of AAF talker. The presentation time of a PDU is
+ * the gPTP time of its first sample plus TSOFFSET. The hardware
+ * timestamps of the periods on CLOCK_MONOTONIC are correlated to gPTP
+ * and smoothed by a timeline advancing a PDU interval per PDU.
+ */
+struct alsa_source {
+	char               *name;
+	int                rate;
+	int                channels;
+	int                width;    /* bytes per sample */
+	int                period;   /* [usec] */
+	int                frames;   /* frames per PDU */
+	uint64_t           pdu_ns;
+	struct alsa_capture *cap;
+	int64_t            offset;   /* gPTP - CLOCK_MONOTONIC */
+	uint64_t           offset_time;
+	uint64_t           next;     /* gPTP time of the next frame */
+	bool               valid;
+	/* statistics */
+	uint64_t           pdus;
+	uint64_t           resyncs;
+	struct hdr_hist    jitter;   /* timestamps against the timeline */
+};
+
+/* media clock timeline of CRF talker */
+struct crf_timeline {
+	uint64_t           next;     /* next event time [nsec] */
+	uint64_t           step;     /* integer part of event interval */
+	uint64_t           rem_step; /* fractional part of event interval */
+	uint64_t           rem;
+	uint64_t           den;
+};
+
+#define REPLAY_FILES_MAX  (8)
+#define REPLAY_REMAP_MAX  (16)
+
+/* rewrite of StreamID or destination address of replayed frames */
+struct replay_remap {
+	uint8_t            from[AVTP_STREAMID_SIZE];
+	uint8_t            to[AVTP_STREAMID_SIZE];
+};
+
+/* captured frames replayed by the talker */
+struct replay_source {
+	int                nfiles;
+	struct pcap_reader *files[REPLAY_FILES_MAX];
+	struct pcap_frame  next[REPLAY_FILES_MAX]; /* head of each file */
+	bool               valid[REPLAY_FILES_MAX];
+	uint64_t           origin[REPLAY_FILES_MAX]; /* capture time of start */
+	bool               align;    /* start all files at once */
+	int                nstreams;
+	struct replay_remap streams[REPLAY_REMAP_MAX];
+	int                naddrs;
+	struct replay_remap addrs[REPLAY_REMAP_MAX]; /* ETH_ALEN bytes used */
+	/* statistics */
+	uint64_t           frames;
+	uint64_t           skipped;  /* not AVTP, truncated or too long */
+	uint64_t           remapped;
+	struct hdr_hist    late;     /* push time behind the schedule */
+};
+
+#define UPGRADE_VERSION     (2)
+#define UPGRADE_TIMEOUT     (10000)      /* msec for the new binary to arm */
+#define UPGRADE_MSG_SIZE    (65536)
+
+/*
+ * Hot upgrade. On SIGUSR2 the talker runs the binary again with its
+ * arguments and --takeover. The frame pages and the fds are handed over
+ * while the stream goes on, and the new process maps them and arms. Then
+ * the talker stops between two pushes and the new process continues from
+ * the entries, sequence_num, media timeline and MSRP registration handed
+ * over, while the frames queued in the driver keep the wire busy.
+ */
+enum {
+	UPGRADE_PREPARE = 1,  /* configuration, pages and fds */
+	UPGRADE_ARMED,        /* the new process is ready to take over */
+	UPGRADE_COMMIT,       /* the entries and the state of the stream */
+};
+
+/* fds of UPGRADE_PREPARE, the device ones first */
+enum {
+	UPGRADE_FD_FILE = EAVB_DEVICE_FDS,
+	UPGRADE_FD_MRPD,
+	UPGRADE_FDS,
+};
+
+struct upgrade_prepare {
+	uint32_t           version;
+	pid_t              pid;
+	uint8_t            StreamID[AVTP_STREAMID_SIZE];
+	uint8_t            dest_addr[ETH_ALEN];
+	int                format;
+	int                entrynum;
+	uint16_t           payload_size;
+	int                msrp;
+	uint8_t            pages[];  /* eavb_device_export_pages() */
+};
+
+struct upgrade_commit {
+	uint64_t           time;     /* gPTP time the talker stopped */
+	uint64_t           pos;      /* source position of the next frame */
+	int                seqnum;
+	uint64_t           framenums; /* frames left, 0:infinite */
+	struct crf_timeline crf_timeline;
+	struct monitor_listener listeners[MSRP_MAX_STREAMS];
+	uint8_t            ring[];   /* eavb_device_export_ring() */
+};
+
+struct talker_upgrade {
+	char               *path;    /* binary to run, argv[0] by default */
+	char               **argv;
+	int                sock;     /* to the other process, -1:none */
+	pid_t              pid;      /* of the new process */
+	uint64_t           started;
+	bool               takeover; /* run by the upgrade of a talker */
+	bool               done;     /* the stream is handed over */
+};
+
+#define STANDBY_INTERVALS   (16)  /* class intervals missed to take over */
+
+/*
+ * Hot standby. The talker beats in the shared memory with the state of
+ * the stream after each push. A standby talker of the same stream sets
+ * up its own queue and MSRP declarations, reads ahead the frames from
+ * the position of the talker into its entries, and pushes them at once
+ * when the talker has exited or has missed its heartbeat for the given
+ * class intervals. Then it goes on beating for the next standby.
+ */
+struct standby_state {
+	uint64_t           pos;      /* source position of the next frame */
+	int                seqnum;
+	uint64_t           framenums; /* frames left, 0:infinite */
+	struct crf_timeline crf_timeline;
+};
+
+struct talker_standby {
+	char               *name;    /* of the heartbeat, NULL:none */
+	int                intervals;
+	struct shm_heartbeat *hb;
+	bool               passive;  /* not the owner of the stream */
+	pid_t              from;     /* the talker taken over */
+	uint64_t           last;     /* its last heartbeat */
+	uint64_t           due;      /* and the next one */
+	uint64_t           took;     /* detected, 0:not taken over */
+	int                took_seqnum;
+	uint64_t           pos;      /* source position of the next frame */
+	int                slot;     /* entry of the frame at pos */
+	int                prefilled; /* frames read ahead from pos */
+	struct iovec       *iov;
+};
+
 struct app_config {
 	int                fd;
 	char               ifname[IFNAMSIZ];
@@ -39,6 +221,31 @@ struct app_config {
 	int                msrp;
 	int                waitmode;
 	bool               use_dest_addr;
+	int                format;
+	struct avtp_simple_crf_param crf;
+	int                crf_timestamps;
+	struct crf_timeline crf_timeline;
+	struct acf_source  acf;
+	struct avtp_simple_aaf_param aaf;
+	struct alsa_source alsa;
+	int                aef_mode;
+	uint32_t           aef_key_id;
+	struct aef_ctx     *aef;
+	int                *aef_lens; /* per entry, of talker_encrypt */
+	bool               crc;
+	bool               replay;
+	struct replay_source rp;
+	bool               udp;
+	bool               udp_offload;
+	struct sockaddr_storage udp_addr;
+	socklen_t          udp_addrlen;
+	char               *shm_name;
+	int                shm_slots;
+	struct shm_feed    *feed;
+	uint64_t           feed_errors; /* payloads longer than a frame */
+	int                seqnum;   /* sequence_num of the next PDU */
+	struct talker_upgrade upgrade;
+	struct talker_standby standby;
 	struct eavb_device *device;
 };
 
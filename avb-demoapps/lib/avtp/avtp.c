@@ -116,6 +116,70 @@ struct avtp_cvf_hdr {
 } __attribute__((packed));
 #endif
 
+/* IEEE1722-2016 10.2 CRF AVTPDU header */
+#if __BYTE_ORDER == __BIG_ENDIAN
+struct avtp_crf_hdr {
+	uint8_t  subtype;
+	uint8_t  sv:1;
+	uint8_t  version:3;
+	uint8_t  mr:1;
+	uint8_t  reserved0:1;
+	uint8_t  fs:1;
+	uint8_t  tu:1;
+	uint8_t  sequence_num;
+	uint8_t  type;
+	uint64_t stream_id;
+	uint32_t pull_base_frequency;
+	uint16_t crf_data_length;
+	uint16_t timestamp_interval;
+	uint8_t  payload[0];
+} __attribute__((packed));
+#else
+struct avtp_crf_hdr {
+	uint8_t  subtype;
+	uint8_t  tu:1;
+	uint8_t  fs:1;
+	uint8_t  reserved0:1;
+	uint8_t  mr:1;
+	uint8_t  version:3;
+	uint8_t  sv:1;
+	uint8_t  sequence_num;
+	uint8_t  type;
+	uint64_t stream_id;
+	uint32_t pull_base_frequency;
+	uint16_t crf_data_length;
+	uint16_t timestamp_interval;
+	uint8_t  payload[0];
+} __attribute__((packed));
+#endif
+
+/* IEEE1722-2016 9.2 NTSCF AVTPDU header */
+#if __BYTE_ORDER == __BIG_ENDIAN
+struct avtp_ntscf_hdr {
+	uint8_t  subtype;
+	uint8_t  sv:1;
+	uint8_t  version:3;
+	uint8_t  reserved0:1;
+	uint8_t  ntscf_data_length_h:3;
+	uint8_t  ntscf_data_length_l;
+	uint8_t  sequence_num;
+	uint64_t stream_id;
+	uint8_t  payload[0];
+} __attribute__((packed));
+#else
+struct avtp_ntscf_hdr {
+	uint8_t  subtype;
+	uint8_t  ntscf_data_length_h:3;
+	uint8_t  reserved0:1;
+	uint8_t  version:3;
+	uint8_t  sv:1;
+	uint8_t  ntscf_data_length_l;
+	uint8_t  sequence_num;
+	uint64_t stream_id;
+	uint8_t  payload[0];
+} __attribute__((packed));
+#endif
+
 /* AVTP Streame common header */
 static const struct avtp_stream_hdr avtp_stream_hdr_tmpl = {
 	.subtype                = 0,
@@ -138,6 +202,28 @@ void copy_avtp_stream_template(void *data)
 	memcpy(data, &avtp_stream_hdr_tmpl, sizeof(avtp_stream_hdr_tmpl));
 }
 
+/* AVTP Audio Format header */
+static const struct avtp_stream_hdr avtp_aaf_hdr_tmpl = {
+	.subtype                = AVTP_SUBTYPE_AAF,
+	.sv                     = 1,
+	.version                = 0,
+	.mr                     = 0,
+	.f_s_d                  = 0,
+	.tv                     = 1,
+	.sequence_num           = 0,
+	.format_specific_data_1	= 0,
+	.tu                     = 0,
+	.stream_id              = 0,
+	.avtp_timestamp         = 0,
+	.format_specific_data_2 = 0,
+	.stream_data_length     = 0,
+	.format_specific_data_3 = 0,
+};
+void copy_avtp_aaf_template(void *data)
+{
+	memcpy(data + AVTP_OFFSET, &avtp_aaf_hdr_tmpl, sizeof(avtp_aaf_hdr_tmpl));
+}
+
 /* AVTP Video (CVF) Experimental header */
 static const struct avtp_cvf_hdr avtp_cvf_experimental_hdr_tmpl = {
 	.subtype               = AVTP_SUBTYPE_CVF,
@@ -165,3 +251,83 @@ void copy_avtp_cvf_experimental_template(void *data)
 	memcpy(data + AVTP_OFFSET, &avtp_cvf_experimental_hdr_tmpl, sizeof(avtp_cvf_experimental_hdr_tmpl));
 }
 
+/* AVTP Clock Reference Format header */
+static const struct avtp_crf_hdr avtp_crf_hdr_tmpl = {
+	.subtype               = AVTP_SUBTYPE_CRF,
+	.sv                    = 1,
+	.version               = 0,
+	.mr                    = 0,
+	.reserved0             = 0,
+	.fs                    = 0,
+	.tu                    = 0,
+	.sequence_num          = 0,
+	.type                  = AVTP_CRF_TYPE_AUDIO_SAMPLE,
+	.stream_id             = 0,
+	.pull_base_frequency   = 0,
+	.crf_data_length       = 0,
+	.timestamp_interval    = 0,
+};
+void copy_avtp_crf_template(void *data)
+{
+	memcpy(data + AVTP_OFFSET, &avtp_crf_hdr_tmpl, sizeof(avtp_crf_hdr_tmpl));
+}
+
+/* AVTP Non Time Synchronous Control Format header */
+static const struct avtp_ntscf_hdr avtp_ntscf_hdr_tmpl = {
+	.subtype               = AVTP_SUBTYPE_NTSCF,
+	.sv                    = 1,
+	.version               = 0,
+	.reserved0             = 0,
+	.ntscf_data_length_h   = 0,
+	.ntscf_data_length_l   = 0,
+	.sequence_num          = 0,
+	.stream_id             = 0,
+};
+void copy_avtp_ntscf_template(void *data)
+{
+	memcpy(data + AVTP_OFFSET, &avtp_ntscf_hdr_tmpl, sizeof(avtp_ntscf_hdr_tmpl));
+}
+
+/* AVTP Time Synchronous Control Format header */
+static const struct avtp_stream_hdr avtp_tscf_hdr_tmpl = {
+	.subtype                = AVTP_SUBTYPE_TSCF,
+	.sv                     = 1,
+	.version                = 0,
+	.mr                     = 0,
+	.f_s_d                  = 0,
+	.tv                     = 1,
+	.sequence_num           = 0,
+	.format_specific_data_1	= 0,
+	.tu                     = 0,
+	.stream_id              = 0,
+	.avtp_timestamp         = 0,
+	.format_specific_data_2 = 0,
+	.stream_data_length     = 0,
+	.format_specific_data_3 = 0,
+};
+void copy_avtp_tscf_template(void *data)
+{
+	memcpy(data + AVTP_OFFSET, &avtp_tscf_hdr_tmpl, sizeof(avtp_tscf_hdr_tmpl));
+}
+
+/* AVTP AES Encrypted Format (continuous) header */
+static const struct avtp_stream_hdr avtp_aef_continuous_hdr_tmpl = {
+	.subtype                = AVTP_SUBTYPE_AEF_CONTINUOUS,
+	.sv                     = 1,
+	.version                = 0,
+	.mr                     = 0,
+	.f_s_d                  = 0,
+	.tv                     = 1,
+	.sequence_num           = 0,
+	.format_specific_data_1	= 0,
+	.tu                     = 0,
+	.stream_id              = 0,
+	.avtp_timestamp         = 0,
+	.format_specific_data_2 = 0,
+	.stream_data_length     = 0,
+	.format_specific_data_3 = 0,
+};
+void copy_avtp_aef_continuous_template(void *data)
+{
+	memcpy(data + AVTP_OFFSET, &avtp_aef_continuous_hdr_tmpl, sizeof(avtp_aef_continuous_hdr_tmpl));
+}
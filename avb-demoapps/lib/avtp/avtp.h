@@ -8,10 +8,15 @@
 #define __AVTP_H__
 
 #include <stdint.h>
+#include <string.h>
 #include <arpa/inet.h>
 
 #define ETH_P_1722 (0x22F0)
 
+/* IEEE1722-2016 Annex J: encapsulation_sequence_num precedes the AVTPDU */
+#define AVTP_UDP_PORT        (17220)
+#define AVTP_UDP_HEADER_SIZE (4)
+
 #ifndef AVTP_OFFSET
 /* Ethernet frame header length (DA + SA + Qtag + EthType) */
 #define AVTP_OFFSET (18)
@@ -19,12 +24,71 @@
 
 #define AVTP_PAYLOAD_OFFSET (24 + AVTP_OFFSET)
 #define AVTP_CVF_PAYLOAD_OFFSET (AVTP_PAYLOAD_OFFSET)
+/* RFC H.264 carries h264_timestamp before the NAL units */
+#define AVTP_CVF_H264_PAYLOAD_OFFSET (4 + AVTP_PAYLOAD_OFFSET)
+#define AVTP_CRF_PAYLOAD_OFFSET (20 + AVTP_OFFSET)
+
+#define AVTP_CRF_TIMESTAMP_SIZE (8)
+
+#define AVTP_NTSCF_PAYLOAD_OFFSET (12 + AVTP_OFFSET)
+#define AVTP_TSCF_PAYLOAD_OFFSET (AVTP_PAYLOAD_OFFSET)
+
+#define AVTP_NTSCF_DATA_LENGTH_MAX (0x7ff)
+
+/* AEF: common stream header + 64bit packet number (explicit IV) */
+#define AVTP_AEF_PAYLOAD_OFFSET (8 + AVTP_PAYLOAD_OFFSET)
+#define AVTP_AAF_PAYLOAD_OFFSET (AVTP_PAYLOAD_OFFSET)
+#define AVTP_AEF_ICV_SIZE (16)
 
 #define AVTP_STREAMID_SIZE (8)
 
 #define AVTP_SEQUENCE_NUM_MAX (255)
 #define AVTP_UNIQUE_ID_MAX  (65535)
 
+/*
+ * Big endian fields at any alignment. The AVTPDU follows the 18 bytes
+ * of the Ethernet header, so its 16/32-bit fields are not aligned.
+ */
+static inline uint16_t avtp_load16(const void *p)
+{
+	uint16_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return ntohs(v);
+}
+
+static inline void avtp_store16(void *p, uint16_t value)
+{
+	value = htons(value);
+	memcpy(p, &value, sizeof(value));
+}
+
+static inline uint32_t avtp_load32(const void *p)
+{
+	uint32_t v;
+
+	memcpy(&v, p, sizeof(v));
+	return ntohl(v);
+}
+
+static inline void avtp_store32(void *p, uint32_t value)
+{
+	value = htonl(value);
+	memcpy(p, &value, sizeof(value));
+}
+
+static inline uint64_t avtp_load64(const void *p)
+{
+	return ((uint64_t)avtp_load32(p) << 32) |
+		avtp_load32((const uint8_t *)p + 4);
+}
+
+static inline void avtp_store64(void *p, uint64_t value)
+{
+	avtp_store32(p, value >> 32);
+	avtp_store32((uint8_t *)p + 4, value & 0xffffffff);
+}
+
 #define DEF_GETTER_UINT8(name, offset) \
 	static inline uint8_t get_##name(void *data) \
 	{ \
@@ -44,13 +108,13 @@
 #define DEF_GETTER_UINT16(name, offset) \
 	static inline uint16_t get_##name(void *data) \
 	{ \
-		return htons(*((uint16_t *)(data + offset))); \
+		return avtp_load16(data + offset); \
 	}
 
 #define DEF_SETTER_UINT16(name, offset) \
 	static inline void set_##name(void *data, uint16_t value) \
 	{ \
-		*((uint16_t *)(data + offset)) = htons(value); \
+		avtp_store16(data + offset, value); \
 	}
 
 #define DEF_ACCESSER_UINT16(name, offset) \
@@ -60,13 +124,13 @@
 #define DEF_GETTER_UINT32(name, offset) \
 	static inline uint32_t get_##name(void *data) \
 	{ \
-		return htonl(*((uint32_t *)(data + offset))); \
+		return avtp_load32(data + offset); \
 	}
 
 #define DEF_SETTER_UINT32(name, offset) \
 	static inline void set_##name(void *data, uint32_t value) \
 	{ \
-		*((uint32_t *)(data + offset)) = htonl(value); \
+		avtp_store32(data + offset, value); \
 	}
 
 #define DEF_ACCESSER_UINT32(name, offset) \
@@ -128,6 +192,108 @@ enum AVTP_CVF_FORMAT {
 	AVTP_CVF_FORMAT_EXPERIMENTAL = 0xff, /* P1722a/D5 */
 };
 
+/* IEEE1722-2016 Table 16. CVF format subtype field */
+enum AVTP_CVF_FORMAT_SUBTYPE {
+	AVTP_CVF_FORMAT_SUBTYPE_MJPEG    = 0, /* RFC 2435 */
+	AVTP_CVF_FORMAT_SUBTYPE_H264     = 1, /* RFC 6184 */
+	AVTP_CVF_FORMAT_SUBTYPE_JPEG2000 = 2, /* RFC 5371 */
+};
+
+#define AVTP_CVF_FLAG_PTV (0x20) /* h264_timestamp valid */
+#define AVTP_CVF_FLAG_M   (0x10) /* last packet of a video frame */
+
+/* IEEE1722-2016 Table 8. AAF format field */
+enum AVTP_AAF_FORMAT {
+	AVTP_AAF_FORMAT_USER        = 0, /* User Specified */
+	AVTP_AAF_FORMAT_FLOAT_32BIT = 1, /* 32bit floating point */
+	AVTP_AAF_FORMAT_INT_32BIT   = 2, /* 32bit integer */
+	AVTP_AAF_FORMAT_INT_24BIT   = 3, /* 24bit integer */
+	AVTP_AAF_FORMAT_INT_16BIT   = 4, /* 16bit integer */
+	AVTP_AAF_FORMAT_AES3_32BIT  = 5, /* 32bit AES3 format */
+};
+
+/* IEEE1722-2016 Table 9. AAF nominal sample rate field */
+enum AVTP_AAF_NSR {
+	AVTP_AAF_NSR_USER    = 0x0, /* User specified */
+	AVTP_AAF_NSR_8KHZ    = 0x1,
+	AVTP_AAF_NSR_16KHZ   = 0x2,
+	AVTP_AAF_NSR_32KHZ   = 0x3,
+	AVTP_AAF_NSR_44_1KHZ = 0x4,
+	AVTP_AAF_NSR_48KHZ   = 0x5,
+	AVTP_AAF_NSR_88_2KHZ = 0x6,
+	AVTP_AAF_NSR_96KHZ   = 0x7,
+	AVTP_AAF_NSR_176_4KHZ = 0x8,
+	AVTP_AAF_NSR_192KHZ  = 0x9,
+	AVTP_AAF_NSR_24KHZ   = 0xa,
+};
+
+#define AVTP_AAF_SP_SPARSE (0x10) /* sparse timestamp mode */
+
+/* IEEE1722-2016 Table 26. CRF type field */
+enum AVTP_CRF_TYPE {
+	AVTP_CRF_TYPE_USER          = 0, /* User Specified */
+	AVTP_CRF_TYPE_AUDIO_SAMPLE  = 1, /* Audio sample timestamp */
+	AVTP_CRF_TYPE_VIDEO_FRAME   = 2, /* Video frame sync timestamp */
+	AVTP_CRF_TYPE_VIDEO_LINE    = 3, /* Video line sync timestamp */
+	AVTP_CRF_TYPE_MACHINE_CYCLE = 4, /* Machine cycle timestamp */
+};
+
+/* IEEE1722-2016 Table 27. CRF pull field */
+enum AVTP_CRF_PULL {
+	AVTP_CRF_PULL_1_0           = 0, /* Multiply by 1.0 */
+	AVTP_CRF_PULL_1_1001        = 1, /* Multiply by 1/1.001 */
+	AVTP_CRF_PULL_1001          = 2, /* Multiply by 1.001 */
+	AVTP_CRF_PULL_24_25         = 3, /* Multiply by 24/25 */
+	AVTP_CRF_PULL_25_24         = 4, /* Multiply by 25/24 */
+	AVTP_CRF_PULL_1_8           = 5, /* Multiply by 1/8 */
+	AVTP_CRF_PULL_MAX           = AVTP_CRF_PULL_1_8,
+};
+
+#define AVTP_CRF_BASE_FREQUENCY_MAX (0x1fffffff)
+#define AVTP_CRF_PULL_SHIFT         (29)
+
+/* IEEE1722-2016 Table 22. ACF message type */
+enum ACF_MSG_TYPE {
+	ACF_MSG_TYPE_FLEXRAY      = 0x00, /* FlexRay */
+	ACF_MSG_TYPE_CAN          = 0x01, /* CAN/CAN FD */
+	ACF_MSG_TYPE_CAN_BRIEF    = 0x02, /* Abbreviated CAN/CAN FD */
+	ACF_MSG_TYPE_LIN          = 0x03, /* LIN */
+	ACF_MSG_TYPE_MOST         = 0x04, /* MOST */
+	ACF_MSG_TYPE_GPC          = 0x05, /* General purpose control */
+	ACF_MSG_TYPE_SERIAL       = 0x06, /* Serial port */
+	ACF_MSG_TYPE_PARALLEL     = 0x07, /* Parallel port */
+	ACF_MSG_TYPE_SENSOR       = 0x08, /* Analog sensor */
+	ACF_MSG_TYPE_SENSOR_BRIEF = 0x09, /* Abbreviated sensor */
+	ACF_MSG_TYPE_AECP         = 0x0a, /* IEEE 1722.1 AECP */
+	ACF_MSG_TYPE_ANCILLARY    = 0x0b, /* Video ancillary data */
+	ACF_MSG_TYPE_USER0        = 0x78, /* User defined */
+};
+
+/* AEF cipher mode (format_specific_data_3 upper 8 bits) */
+enum AVTP_AEF_MODE {
+	AVTP_AEF_MODE_CTR = 1, /* AES-CTR, no integrity check value */
+	AVTP_AEF_MODE_GCM = 2, /* AES-GCM, 16 bytes ICV follows the payload */
+};
+
+/* ACF message header (acf_msg_type:7bit, acf_msg_length:9bit) */
+#define ACF_MSG_HEADER_SIZE (2)
+#define ACF_MSG_LENGTH_MAX  (0x1ff) /* quadlets */
+
+/* IEEE1722-2016 9.4.4 ACF CAN message */
+#define ACF_CAN_HEADER_SIZE       (16)
+#define ACF_CAN_BRIEF_HEADER_SIZE (8)
+
+#define ACF_CAN_FLAG_MTV (0x20) /* message_timestamp valid */
+#define ACF_CAN_FLAG_RTR (0x10) /* remote transmission request */
+#define ACF_CAN_FLAG_EFF (0x08) /* extended frame format */
+#define ACF_CAN_FLAG_BRS (0x04) /* bit rate switch */
+#define ACF_CAN_FLAG_FDF (0x02) /* CAN FD frame */
+#define ACF_CAN_FLAG_ESI (0x01) /* error state indicator */
+
+#define ACF_CAN_PAD_SHIFT    (6)
+#define ACF_CAN_BUS_ID_MASK  (0x1f)
+#define ACF_CAN_ID_MASK      (0x1fffffff)
+
 /**
  * Accessor - IEEE802.1Q
  */
@@ -183,6 +349,11 @@ DEF_AVTP_ACCESSER_UINT8(sequence_num, 2)
 DEF_AVTP_ACCESSER_UINT32(timestamp, 12)
 DEF_AVTP_ACCESSER_UINT16(stream_data_length, 20)
 
+/* sv, version, mr, gv and tv of the stream data header */
+DEF_AVTP_GETTER_UINT8(stream_flags, 1)
+#define AVTP_STREAM_FLAG_TV (0x01)
+#define AVTP_STREAM_FLAG_SV (0x80)
+
 static inline void get_avtp_stream_id(void *data, uint8_t value[8])
 {
 	value[0] = *((uint8_t *)(data + 4 + AVTP_OFFSET));
@@ -207,10 +378,227 @@ static inline void set_avtp_stream_id(void *data, uint8_t value[8])
 	*((uint8_t *)(data + 11 + AVTP_OFFSET)) = value[7];
 }
 
+/**
+ * Accessor - IEEE1722 Compressed Video Format
+ *
+ * cvf_flags has ptv, M and evt of the RFC format.
+ */
+DEF_AVTP_ACCESSER_UINT8(cvf_format, 16)
+DEF_AVTP_ACCESSER_UINT8(cvf_format_subtype, 17)
+DEF_AVTP_ACCESSER_UINT8(cvf_flags, 22)
+
+/**
+ * Accessor - IEEE1722 AVTP Audio Format
+ *
+ * channels_per_frame is a 10bit field following the 4bit nsr.
+ */
+DEF_AVTP_ACCESSER_UINT8(aaf_format, 16)
+DEF_AVTP_ACCESSER_UINT8(aaf_bit_depth, 19)
+DEF_AVTP_ACCESSER_UINT8(aaf_sp_evt, 22)
+
+static inline uint8_t get_avtp_aaf_nsr(void *data)
+{
+	return *((uint8_t *)(data + 17 + AVTP_OFFSET)) >> 4;
+}
+
+static inline void set_avtp_aaf_nsr(void *data, uint8_t value)
+{
+	uint8_t *p = data + 17 + AVTP_OFFSET;
+
+	*p = (*p & 0x0f) | (value << 4);
+}
+
+static inline uint16_t get_avtp_aaf_channels_per_frame(void *data)
+{
+	return avtp_load16(data + 17 + AVTP_OFFSET) & 0x3ff;
+}
+
+static inline void set_avtp_aaf_channels_per_frame(void *data, uint16_t value)
+{
+	void *p = data + 17 + AVTP_OFFSET;
+
+	avtp_store16(p, (avtp_load16(p) & ~0x3ff) | (value & 0x3ff));
+}
+
+/* sample rate in Hz of nsr, 0 for user specified or reserved */
+static inline uint32_t avtp_aaf_nsr_rate(uint8_t nsr)
+{
+	static const uint32_t rate[] = {
+		0, 8000, 16000, 32000, 44100, 48000,
+		88200, 96000, 176400, 192000, 24000,
+	};
+
+	return (nsr < sizeof(rate) / sizeof(rate[0])) ? rate[nsr] : 0;
+}
+
+/* bytes per sample of format, 0 for user specified or reserved */
+static inline int avtp_aaf_sample_size(uint8_t format)
+{
+	switch (format) {
+	case AVTP_AAF_FORMAT_FLOAT_32BIT:
+	case AVTP_AAF_FORMAT_INT_32BIT:
+	case AVTP_AAF_FORMAT_AES3_32BIT:
+		return 4;
+	case AVTP_AAF_FORMAT_INT_24BIT:
+		return 3;
+	case AVTP_AAF_FORMAT_INT_16BIT:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+/**
+ * Accessor - IEEE1722 Clock Reference Format
+ */
+DEF_AVTP_ACCESSER_UINT8(crf_type, 3)
+DEF_AVTP_ACCESSER_UINT32(crf_pull_base_frequency, 12)
+DEF_AVTP_ACCESSER_UINT16(crf_data_length, 16)
+DEF_AVTP_ACCESSER_UINT16(crf_timestamp_interval, 18)
+
+static inline uint64_t get_avtp_crf_timestamp(void *data, int index)
+{
+	void *p = data + AVTP_CRF_PAYLOAD_OFFSET +
+				(index * AVTP_CRF_TIMESTAMP_SIZE);
+
+	return avtp_load64(p);
+}
+
+static inline void set_avtp_crf_timestamp(void *data, int index,
+					  uint64_t value)
+{
+	void *p = data + AVTP_CRF_PAYLOAD_OFFSET +
+				(index * AVTP_CRF_TIMESTAMP_SIZE);
+
+	avtp_store64(p, value);
+}
+
+/**
+ * Accessor - IEEE1722 AES Encrypted Format (continuous)
+ *
+ * The key_id is in format_specific_data_2, the cipher mode and the
+ * subtype of the encapsulated stream in format_specific_data_3, and the
+ * 64bit packet number used as explicit IV precedes the encrypted data.
+ */
+DEF_AVTP_ACCESSER_UINT32(aef_key_id, 16)
+DEF_AVTP_ACCESSER_UINT8(aef_mode, 22)
+DEF_AVTP_ACCESSER_UINT8(aef_encapsulated_subtype, 23)
+
+static inline uint64_t get_avtp_aef_packet_number(void *data)
+{
+	return avtp_load64(data + 24 + AVTP_OFFSET);
+}
+
+static inline void set_avtp_aef_packet_number(void *data, uint64_t value)
+{
+	avtp_store64(data + 24 + AVTP_OFFSET, value);
+}
+
+/**
+ * Accessor - IEEE1722 Control Formats (NTSCF/TSCF)
+ *
+ * NTSCF has a short header, so the sequence_num is in a different place
+ * from the other stream headers. TSCF uses the common stream header.
+ */
+DEF_AVTP_ACCESSER_UINT8(ntscf_sequence_num, 3)
+
+static inline uint16_t get_avtp_ntscf_data_length(void *data)
+{
+	return avtp_load16(data + 1 + AVTP_OFFSET) &
+						AVTP_NTSCF_DATA_LENGTH_MAX;
+}
+
+static inline void set_avtp_ntscf_data_length(void *data, uint16_t value)
+{
+	void *p = data + 1 + AVTP_OFFSET;
+
+	avtp_store16(p, (avtp_load16(p) & ~AVTP_NTSCF_DATA_LENGTH_MAX) |
+			(value & AVTP_NTSCF_DATA_LENGTH_MAX));
+}
+
+/**
+ * Accessor - IEEE1722 ACF messages (relative to the top of message)
+ */
+DEF_ACCESSER_UINT16(acf_msg_header, 0)
+DEF_ACCESSER_UINT8(acf_can_flags, 2)
+DEF_ACCESSER_UINT8(acf_can_bus_id, 3)
+DEF_ACCESSER_UINT32(acf_can_identifier, 12)
+DEF_ACCESSER_UINT32(acf_can_brief_identifier, 4)
+
+static inline uint8_t get_acf_msg_type(void *msg)
+{
+	return get_acf_msg_header(msg) >> 9;
+}
+
+/* length of the message in bytes, including the header */
+static inline int get_acf_msg_length(void *msg)
+{
+	return (get_acf_msg_header(msg) & ACF_MSG_LENGTH_MAX) * 4;
+}
+
+static inline void set_acf_msg_type_length(void *msg, uint8_t type, int len)
+{
+	set_acf_msg_header(msg, (type << 9) |
+				((len / 4) & ACF_MSG_LENGTH_MAX));
+}
+
+static inline uint64_t get_acf_can_message_timestamp(void *msg)
+{
+	return avtp_load64(msg + 4);
+}
+
+static inline void set_acf_can_message_timestamp(void *msg, uint64_t value)
+{
+	avtp_store64(msg + 4, value);
+}
+
+/**
+ * Batch stamping - IEEE1722/1722a
+ *
+ * Stamp sequence_num, avtp_timestamp and stream_data_length on count
+ * frames in one call, sequence_num and avtp_timestamp are incremented
+ * by 1 and delta_ts for each frame. All stream data headers (CVF, AAF,
+ * AEF, ...) share the offsets of these fields, so one stamper covers
+ * them. CRF has no avtp_timestamp and stamps crf_data_length instead.
+ */
+static inline void stamp_avtp_stream_batch(void **frames, int count,
+					   uint8_t seq, uint32_t ts,
+					   uint32_t delta_ts, uint16_t len)
+{
+	uint8_t *p;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		p = (uint8_t *)frames[i] + AVTP_OFFSET;
+		p[2] = seq++;
+		avtp_store32(p + 12, ts);
+		avtp_store16(p + 20, len);
+		ts += delta_ts;
+	}
+}
+
+static inline void stamp_avtp_crf_batch(void **frames, int count,
+					uint8_t seq, uint16_t len)
+{
+	uint8_t *p;
+	int i;
+
+	for (i = 0; i < count; i++) {
+		p = (uint8_t *)frames[i] + AVTP_OFFSET;
+		p[2] = seq++;
+		avtp_store16(p + 16, len);
+	}
+}
+
 /**
  * Template - IEEE1722/1722a
  */
 extern void copy_avtp_stream_template(void *data);
+extern void copy_avtp_aaf_template(void *data);
 extern void copy_avtp_cvf_experimental_template(void *data);
+extern void copy_avtp_crf_template(void *data);
+extern void copy_avtp_ntscf_template(void *data);
+extern void copy_avtp_tscf_template(void *data);
+extern void copy_avtp_aef_continuous_template(void *data);
 
 #endif /* __AVTP_H__ */
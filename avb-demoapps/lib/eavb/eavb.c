@@ -305,6 +305,22 @@ int eavb_dma_malloc_page(int fd, struct eavb_dma_alloc *page)
 		return -1;
 	}
 
+	return eavb_dma_map_page(fd, page);
+}
+
+/*
+ * map page allocated already, e.g. by another process of the stream queue
+ *
+ * @fd       specify fd of stream queue
+ * @page     page information, dma_paddr and mmap_size
+ */
+int eavb_dma_map_page(int fd, struct eavb_dma_alloc *page)
+{
+	if (!page) {
+		perror("invalid pointer");
+		return -1;
+	}
+
 	page->dma_vaddr = (void *)mmap(NULL,
 			page->mmap_size,
 			PROT_READ | PROT_WRITE,
@@ -313,6 +329,7 @@ int eavb_dma_malloc_page(int fd, struct eavb_dma_alloc *page)
 			page->dma_paddr);
 
 	if (MAP_FAILED == page->dma_vaddr) {
+		page->dma_vaddr = NULL;
 		perror("mmap");
 		return -1;
 	}
@@ -27,6 +27,7 @@ extern int eavb_push(int fd, struct eavb_entry *entrybuf, int entrynum);
 extern int eavb_take(int fd, struct eavb_entry *entrybuf, int entrynum);
 extern int eavb_wait(int fd, int flags, int timeout);
 extern int eavb_dma_malloc_page(int fd, struct eavb_dma_alloc *page);
+extern int eavb_dma_map_page(int fd, struct eavb_dma_alloc *page);
 extern void eavb_dma_free_page(int fd, struct eavb_dma_alloc *page);
 
 #endif /* __EAVB_H__ */
@@ -42,6 +42,7 @@
 #include <errno.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/eventfd.h>
 #include <net/if.h>
 #include <arpa/inet.h>
 #include <pthread.h>
@@ -251,6 +252,7 @@ static int msg_process(struct msrp_ctx *ctx, char *buf, int buflen)
 static void *msrp_monitor_thread(void *arg)
 {
 	struct msrp_ctx *ctx = NULL;
+	struct pollfd pfd[2];
 	char *msgbuf;
 	int rc;
 
@@ -268,7 +270,25 @@ static void *msrp_monitor_thread(void *arg)
 
 	DEBUG_PRINTF("[MRP] monitor thread start\n");
 
+	pfd[0].fd = ctx->mrpd_sock;
+	pfd[0].events = POLLIN;
+	pfd[1].fd = ctx->wake_fd;
+	pfd[1].events = POLLIN;
+
 	while (!ctx->halt_flag) {
+		/* woken up by msrp_ctx_detach() or msrp_ctx_destroy() */
+		rc = poll(pfd, 2, -1);
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			perror("[MRP] poll");
+			break;
+		}
+		if (pfd[1].revents)
+			break;
+		if (!pfd[0].revents)
+			continue;
+
 		msgbuf = (char *)calloc(1, MRPDCLIENT_MAX_MSG_SIZE);
 		if (msgbuf == NULL) {
 			fprintf(stderr, "[MRP] massage buf is NULL. recv\n");
@@ -305,6 +325,17 @@ static int msrp_monitor(struct msrp_ctx *ctx)
 			msrp_monitor_thread, (void *)ctx);
 }
 
+static void msrp_monitor_stop(struct msrp_ctx *ctx)
+{
+	if (ctx->monitor_thread == 0)
+		return;
+
+	ctx->halt_flag = true;
+	eventfd_write(ctx->wake_fd, 1);
+	pthread_join(ctx->monitor_thread, NULL);
+	ctx->monitor_thread = 0;
+}
+
 static int mrp_send(struct msrp_ctx *ctx, const char *format, ...)
 {
 	va_list arg;
@@ -343,9 +374,12 @@ static int mrp_send(struct msrp_ctx *ctx, const char *format, ...)
 /*
  * public functions
  */
-struct msrp_ctx *msrp_ctx_init(struct mrp_property *prop)
+/* sock of mrpd to take over, or SOCKET_ERROR for a new one */
+static struct msrp_ctx *msrp_ctx_create(struct mrp_property *prop, int sock,
+					const struct monitor_listener *devices)
 {
 	struct msrp_ctx *ctx;
+	int i;
 
 	if (prop == NULL) {
 		fprintf(stderr, "[MRP] prop is NULL. ctx init\n");
@@ -373,7 +407,10 @@ struct msrp_ctx *msrp_ctx_init(struct mrp_property *prop)
 		return NULL;
 	}
 
-	ctx->mrpd_sock = mrpdclient_init();
+	if (sock == SOCKET_ERROR)
+		ctx->mrpd_sock = mrpdclient_init();
+	else
+		ctx->mrpd_sock = sock;
 	if (ctx->mrpd_sock == SOCKET_ERROR) {
 		free(ctx->msgbuf);
 		free(ctx->prop);
@@ -396,10 +433,23 @@ struct msrp_ctx *msrp_ctx_init(struct mrp_property *prop)
 	ctx->talker_found = false;
 	ctx->listeners  = 0;
 
+	/* the listeners known to the previous owner of the socket */
+	if (devices) {
+		for (i = 0; i < MSRP_MAX_STREAMS; i++) {
+			ctx->devices[i] = devices[i];
+			if (devices[i].attached)
+				ctx->listeners++;
+		}
+	}
+
 	ctx->halt_flag = false;
 
-	if (msrp_monitor(ctx)) {
-		mrpdclient_close(&ctx->mrpd_sock);
+	ctx->wake_fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+	if (ctx->wake_fd < 0 || msrp_monitor(ctx)) {
+		if (ctx->wake_fd >= 0)
+			close(ctx->wake_fd);
+		if (sock == SOCKET_ERROR)
+			mrpdclient_close(&ctx->mrpd_sock);
 		free(ctx->msgbuf);
 		free(ctx->prop);
 		free(ctx);
@@ -410,6 +460,65 @@ struct msrp_ctx *msrp_ctx_init(struct mrp_property *prop)
 	return ctx;
 }
 
+struct msrp_ctx *msrp_ctx_init(struct mrp_property *prop)
+{
+	return msrp_ctx_create(prop, SOCKET_ERROR, NULL);
+}
+
+/*
+ * Take over the socket of mrpd handed by msrp_ctx_detach() of another
+ * process, with the listeners it knew. The declarations made through the
+ * socket stay registered with mrpd.
+ */
+struct msrp_ctx *msrp_ctx_attach(struct mrp_property *prop, int sock,
+				 const struct monitor_listener *devices)
+{
+	if (sock == SOCKET_ERROR) {
+		fprintf(stderr, "[MRP] socket is NULL. ctx attach\n");
+		return NULL;
+	}
+
+	return msrp_ctx_create(prop, sock, devices);
+}
+
+/*
+ * Give up the socket of mrpd to hand it over to another process. The
+ * monitor thread is stopped before return, so no message of mrpd is
+ * read by this process any more, and msrp_ctx_destroy() closes the
+ * socket without BYE to mrpd afterwards.
+ */
+int msrp_ctx_detach(struct msrp_ctx *ctx)
+{
+	if (ctx == NULL) {
+		fprintf(stderr, "[MRP] ctx is NULL. ctx detach\n");
+		return SOCKET_ERROR;
+	}
+
+	msrp_monitor_stop(ctx);
+	ctx->detached = true;
+
+	return ctx->mrpd_sock;
+}
+
+/* keep the socket after msrp_ctx_detach() when the handover failed */
+int msrp_ctx_resume(struct msrp_ctx *ctx)
+{
+	eventfd_t val;
+
+	if (ctx == NULL) {
+		fprintf(stderr, "[MRP] ctx is NULL. ctx resume\n");
+		return -1;
+	}
+	if (!ctx->detached)
+		return 0;
+
+	eventfd_read(ctx->wake_fd, &val);
+	ctx->halt_flag = false;
+	ctx->detached = false;
+
+	return msrp_monitor(ctx);
+}
+
 int msrp_ctx_destroy(struct msrp_ctx *ctx)
 {
 	int rc = 0;
@@ -419,11 +528,12 @@ int msrp_ctx_destroy(struct msrp_ctx *ctx)
 		return -1;
 	}
 
-	if (ctx->monitor_thread != 0) {
-		ctx->halt_flag = true;
-		pthread_join(ctx->monitor_thread, NULL);
-	}
-	if (ctx->mrpd_sock != SOCKET_ERROR) {
+	msrp_monitor_stop(ctx);
+	close(ctx->wake_fd);
+	if (ctx->mrpd_sock != SOCKET_ERROR && ctx->detached) {
+		closesocket(ctx->mrpd_sock);
+		ctx->mrpd_sock = SOCKET_ERROR;
+	} else if (ctx->mrpd_sock != SOCKET_ERROR) {
 		rc = mrpdclient_close(&ctx->mrpd_sock);
 		if (rc < 0)
 			fprintf(stderr, "[MRP] could not close socket.\n");
@@ -91,10 +91,12 @@ struct monitor_listener {
 struct msrp_ctx {
 	int mrpd_sock;
 	bool halt_flag;
+	bool detached;     /* the socket is handed over to another process */
 	bool talker_found;
 	int talker_leave;
 	int listeners;
 	pthread_t monitor_thread;
+	int wake_fd;       /* eventfd to stop the monitor thread at once */
 	struct mrp_property *prop;
 	char *msgbuf;
 	struct monitor_listener devices[MSRP_MAX_STREAMS];
@@ -102,6 +104,10 @@ struct msrp_ctx {
 
 extern struct msrp_ctx *msrp_ctx_init(struct mrp_property *prop);
 extern int msrp_ctx_destroy(struct msrp_ctx *ctx);
+extern struct msrp_ctx *msrp_ctx_attach(struct mrp_property *prop, int sock,
+					const struct monitor_listener *devices);
+extern int msrp_ctx_detach(struct msrp_ctx *ctx);
+extern int msrp_ctx_resume(struct msrp_ctx *ctx);
 extern int msrp_exist_listener(struct msrp_ctx *ctx);
 extern bool msrp_exist_talker(struct msrp_ctx *ctx);
 extern int mvrp_join_vlan(struct msrp_ctx *ctx);